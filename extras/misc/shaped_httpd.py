@@ -0,0 +1,146 @@
+#!/usr/bin/env python
+#####################################################################
+# Copyright (C) 2014 VideoLAN and AUTHORS
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#####################################################################
+#
+# HTTP server with bandwidth shaping, to benchmark adaptive streaming
+# (DASH, HLS) against changing network conditions.
+#
+# Serves the current directory. The rate follows a schedule of
+# kbit/s:seconds steps, repeated, shared by all the connections:
+#
+#   shaped_httpd.py --port 8080 --schedule 4000:30,800:20,2000:30
+#   vlc --dash-logic=5 -vv http://localhost:8080/manifest.mpd
+#
+# --dash-logic takes a LogicType value: 5 (NearOptimal) is the "Buffer and
+# Bandwidth Adaptive" logic, 3 (RateBased) the "Bandwidth Adaptive" one.
+#
+# Each change of rate is printed with a timestamp, so it can be put
+# side by side with the adaptation messages from the player.
+#####################################################################
+
+import os
+import sys
+import time
+import threading
+from optparse import OptionParser
+
+try:
+    from http.server import SimpleHTTPRequestHandler, HTTPServer
+    from socketserver import ThreadingMixIn
+except ImportError:
+    from SimpleHTTPServer import SimpleHTTPRequestHandler
+    from BaseHTTPServer import HTTPServer
+    from SocketServer import ThreadingMixIn
+
+
+class Shaper(object):
+    """Token bucket following the rate schedule"""
+
+    def __init__(self, schedule, latency):
+        self.schedule = schedule
+        self.latency = latency
+        self.period = sum(d for r, d in schedule)
+        self.start = time.time()
+        self.lock = threading.Lock()
+        self.tokens = 0.0
+        self.last = self.start
+        self.current = None
+
+    def rate(self, now):
+        t = (now - self.start) % self.period
+        for r, d in self.schedule:
+            if t < d:
+                return r
+            t -= d
+        return self.schedule[-1][0]
+
+    def consume(self, size):
+        """Blocks until size bytes may be sent"""
+        while True:
+            with self.lock:
+                now = time.time()
+                rate = self.rate(now) * 1000 / 8.
+                if rate != self.current:
+                    sys.stderr.write("%8.2f rate %d kbit/s\n" %
+                                     (now - self.start, rate * 8 / 1000))
+                    self.current = rate
+                self.tokens = min(self.tokens + (now - self.last) * rate,
+                                  rate / 10.)
+                self.last = now
+                if self.tokens >= size:
+                    self.tokens -= size
+                    return
+                wait = (size - self.tokens) / rate
+            time.sleep(min(wait, 0.05))
+
+
+class ShapedFile(object):
+    def __init__(self, wfile, shaper):
+        self.wfile = wfile
+        self.shaper = shaper
+
+    def write(self, data):
+        for i in range(0, len(data), 4096):
+            chunk = data[i:i + 4096]
+            self.shaper.consume(len(chunk))
+            self.wfile.write(chunk)
+
+    def flush(self):
+        self.wfile.flush()
+
+
+class Handler(SimpleHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    shaper = None
+
+    def send_head(self):
+        if self.shaper.latency > 0:
+            time.sleep(self.shaper.latency / 1000.)
+        return SimpleHTTPRequestHandler.send_head(self)
+
+    def copyfile(self, source, outputfile):
+        SimpleHTTPRequestHandler.copyfile(self, source,
+                                          ShapedFile(outputfile, self.shaper))
+
+    def log_message(self, format, *args):
+        sys.stderr.write("%8.2f %s\n" % (time.time() - self.shaper.start,
+                                         format % args))
+
+
+class Server(ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+
+
+def main():
+    parser = OptionParser(usage="%prog [options]")
+    parser.add_option("-p", "--port", type="int", default=8080)
+    parser.add_option("-d", "--directory", default=".")
+    parser.add_option("-s", "--schedule", default="2000:60",
+                      help="kbit/s:seconds steps, comma separated")
+    parser.add_option("-l", "--latency", type="int", default=0,
+                      help="delay before each response (ms)")
+    (options, args) = parser.parse_args()
+
+    try:
+        schedule = [tuple(int(v) for v in step.split(":"))
+                    for step in options.schedule.split(",")]
+    except ValueError:
+        parser.error("bad schedule: %s" % options.schedule)
+
+    os.chdir(options.directory)
+    Handler.shaper = Shaper(schedule, options.latency)
+    server = Server(("", options.port), Handler)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -95,10 +95,35 @@ struct filter_t
             int         (*pf_mouse)( filter_t *, vlc_mouse_t *,
                                      const vlc_mouse_t *p_old,
                                      const vlc_mouse_t *p_new );
+            /* Optional band processing.
+             *
+             * If non-NULL, each output line must only depend on the same
+             * input line(s), and no state may be kept across calls. The
+             * filter chain then allocates the output picture itself, splits
+             * both pictures in horizontal bands and processes them from
+             * several threads at once, instead of calling pf_filter.
+             * The pictures are views of one band: they must not be held,
+             * released nor have their properties changed.
+             * The last parameter is the value returned by pf_slice_prepare
+             * for this picture, or NULL if there is none.
+             */
+            void        (*pf_slice)( filter_t *, picture_t *, picture_t *,
+                                     const void * );
+            /* Optional preparation of the band processing.
+             *
+             * If non-NULL, it is called once per input picture, on the
+             * calling thread, before the bands are processed. It reads the
+             * filter parameters and computes what all the bands share, so
+             * that they use the same values. The returned data belongs to
+             * the filter, and must stay valid until the next call.
+             */
+            const void *(*pf_slice_prepare)( filter_t *, picture_t * );
         } video;
 #define pf_video_filter     u.video.pf_filter
 #define pf_video_flush      u.video.pf_flush
 #define pf_video_mouse      u.video.pf_mouse
+#define pf_video_slice      u.video.pf_slice
+#define pf_video_slice_prepare u.video.pf_slice_prepare
 
         struct
         {
@@ -107,6 +107,10 @@ typedef struct httpd_message_t
 
 typedef struct httpd_url_t      httpd_url_t;
 typedef struct httpd_callback_sys_t httpd_callback_sys_t;
+/* A callback can postpone its answer by returning VLC_SUCCESS with the
+ * answer left untouched (i_type HTTPD_MSG_NONE): it is then called again
+ * every few milliseconds until it answers. answer->i_body_offset is kept
+ * between the calls, and must be 0 in the final answer. */
 typedef int    (*httpd_callback_t)( httpd_callback_sys_t *, httpd_client_t *, httpd_message_t *answer, const httpd_message_t *query );
 /* register a new url */
 VLC_API httpd_url_t * httpd_UrlNew( httpd_host_t *, const char *psz_url, const char *psz_user, const char *psz_password ) VLC_USED;
@@ -144,6 +148,12 @@ VLC_API void httpd_StreamDelete( httpd_stream_t * );
 VLC_API int httpd_StreamHeader( httpd_stream_t *, uint8_t *p_data, int i_data );
 VLC_API int httpd_StreamSend( httpd_stream_t *, const block_t *p_block );
 VLC_API int httpd_StreamSetHTTPHeaders(httpd_stream_t *, httpd_header *, size_t);
+/**
+ * Makes new clients start with the last group of pictures, sent at once,
+ * instead of waiting for the next keyframe. The stream keeps up to i_max
+ * bytes for that purpose (0 disables instant start).
+ */
+VLC_API int httpd_StreamSetInstantStart(httpd_stream_t *, size_t i_max);
 
 /* Msg functions facilities */
 VLC_API void httpd_MsgAdd( httpd_message_t *, const char *psz_name, const char *psz_value, ... ) VLC_FORMAT( 3, 4 );
@@ -318,6 +318,10 @@ struct input_stats_t
     int64_t i_demux_corrupted;
     int64_t i_demux_discontinuity;
 
+    /* Stream prefetching */
+    int64_t i_prefetch_level;     /**< bytes read ahead of the demuxer */
+    int64_t i_prefetch_underruns; /**< times the demuxer waited for data */
+
     /* Decoders */
     int64_t i_decoded_audio;
     int64_t i_decoded_video;
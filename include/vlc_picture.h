@@ -91,6 +91,7 @@ struct picture_t
     bool            b_progressive;          /**< is it a progressive frame ? */
     bool            b_top_field_first;             /**< which field is first */
     unsigned int    i_nb_fields;                  /**< # of displayed fields */
+    bool            b_keyframe;   /**< encoders must start a GOP (IDR) here */
     void          * context;          /**< video format-specific data pointer,
              * must point to a (void (*)(void*)) pointer to free the context */
     /**@}*/
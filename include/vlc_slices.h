@@ -0,0 +1,67 @@
+/*****************************************************************************
+ * vlc_slices.h: band processing on worker threads
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_SLICES_H
+#define VLC_SLICES_H 1
+
+/**
+ * \file
+ * This file defines a pool of worker threads, shared by the whole process,
+ * to split a job (typically a picture) in bands processed in parallel.
+ */
+
+/**
+ * Band processing function.
+ *
+ * @param data data of the job, as given to vlc_slices_run()
+ * @param slice index of the band to process
+ * @param slices number of bands of the job
+ */
+typedef void (*vlc_slice_cb)( void *data, unsigned slice, unsigned slices );
+
+/**
+ * Holds the worker threads.
+ *
+ * The first holder starts one thread less than there are CPUs, so that
+ * the calling thread of vlc_slices_run() takes the last one.
+ * @see vlc_slices_release()
+ */
+VLC_API void vlc_slices_hold( void );
+
+/**
+ * Releases the worker threads, stopping them with the last holder.
+ */
+VLC_API void vlc_slices_release( void );
+
+/**
+ * Runs a job on bands, and waits for its end.
+ *
+ * The job is split in as many bands as there are threads (calling thread
+ * included), up to max. If the threads are busy with another job, the whole
+ * job runs on the calling thread as a single band rather than waiting.
+ * The caller must hold the threads, see vlc_slices_hold().
+ *
+ * @param cb band processing function
+ * @param data data of the job, given to cb
+ * @param max maximum number of bands
+ */
+VLC_API void vlc_slices_run( vlc_slice_cb cb, void *data, unsigned max );
+
+#endif
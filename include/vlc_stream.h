@@ -83,6 +83,18 @@ struct stream_t
     input_thread_t *p_input;
 };
 
+/**
+ * Statistics of the stream cache (see STREAM_GET_CACHE_STATS)
+ */
+typedef struct
+{
+    uint64_t i_hits;       /**< bytes read from the cache */
+    uint64_t i_disk_hits;  /**< of which read back from the disk */
+    uint64_t i_misses;     /**< bytes read from the access */
+    uint64_t i_memory;     /**< bytes cached in memory */
+    uint64_t i_disk;       /**< bytes cached on disk */
+} stream_cache_stats_t;
+
 /**
  * Possible commands to send to stream_Control() and stream_vaControl()
  */
@@ -105,6 +117,8 @@ enum stream_query_e
      * FIXME find a way to avoid it */
     STREAM_UPDATE_SIZE,
 
+    STREAM_GET_CACHE_STATS,     /**< arg1= stream_cache_stats_t * res=can fail */
+
     /* */
     STREAM_GET_PTS_DELAY = 0x101,/**< arg1= int64_t* res=cannot fail */
     STREAM_GET_TITLE_INFO, /**< arg1=input_title_t*** arg2=int* res=can fail */
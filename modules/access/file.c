@@ -52,6 +52,9 @@
 #   include <unistd.h>
 #endif
 #include <dirent.h>
+#ifdef HAVE_MMAP
+#   include <sys/mman.h>
+#endif
 
 #include <vlc_common.h>
 #include "fs.h"
@@ -70,6 +73,13 @@ struct access_sys_t
 
     bool b_pace_control;
     uint64_t size;
+
+#ifdef HAVE_MMAP
+    /* Memory-mapped reading */
+    size_t   mmap_size;   /* bytes mapped per block */
+    size_t   pagemask;
+    uint64_t ahead;       /* end of the read-ahead window */
+#endif
 };
 
 #if !defined (_WIN32) && !defined (__OS2__)
@@ -127,11 +137,18 @@ static bool IsRemote (const char *path)
 #ifndef HAVE_POSIX_FADVISE
 # define posix_fadvise(fd, off, len, adv)
 #endif
+#ifndef HAVE_POSIX_MADVISE
+# define posix_madvise(addr, len, adv)
+#endif
 
 static ssize_t FileRead (access_t *, uint8_t *, size_t);
 static int FileSeek (access_t *, uint64_t);
 static ssize_t StreamRead (access_t *, uint8_t *, size_t);
 static int NoSeek (access_t *, uint64_t);
+#ifdef HAVE_MMAP
+static block_t *MmapBlock (access_t *);
+static int MmapSeek (access_t *, uint64_t);
+#endif
 static int FileControl (access_t *, int, va_list);
 
 /*****************************************************************************
@@ -243,6 +260,28 @@ int FileOpen( vlc_object_t *p_this )
             fcntl (fd, F_RDAHEAD, 0);
         else
             fcntl (fd, F_RDAHEAD, 1);
+#endif
+#ifdef HAVE_MMAP
+        /* Remote files may be truncated under our feet (SIGBUS) */
+        if (S_ISREG (st.st_mode) && var_InheritBool (p_access, "file-mmap")
+         && !IsRemote(fd, p_access->psz_filepath))
+        {
+            size_t pagesize = sysconf (_SC_PAGE_SIZE);
+            /* The range is not enforced on values from the MRL or command
+             * line, and an empty mapping would read as the end of file */
+            int64_t kb = var_InheritInteger (p_access, "file-mmap-size");
+            size_t mmap_size = VLC_CLIP (kb, MMAP_SIZE_MIN, MMAP_SIZE_MAX);
+
+            mmap_size = (mmap_size << 10) + pagesize - 1;
+            p_sys->pagemask = pagesize - 1;
+            p_sys->mmap_size = mmap_size & ~p_sys->pagemask;
+            p_sys->ahead = 0;
+            p_access->pf_read = NULL;
+            p_access->pf_block = MmapBlock;
+            p_access->pf_seek = MmapSeek;
+            msg_Dbg (p_access, "mapping file in %zu bytes blocks",
+                     p_sys->mmap_size);
+        }
 #endif
     }
     else
@@ -267,7 +306,7 @@ void FileClose (vlc_object_t * p_this)
 {
     access_t     *p_access = (access_t*)p_this;
 
-    if (p_access->pf_read == NULL)
+    if (p_access->pf_read == NULL && p_access->pf_block == NULL)
     {
         DirClose (p_this);
         return;
@@ -333,6 +372,90 @@ static int FileSeek (access_t *p_access, uint64_t i_pos)
     return VLC_SUCCESS;
 }
 
+#ifdef HAVE_MMAP
+/**
+ * Returns the next block of a regular file, pointing directly into a
+ * read-only mapping of the file rather than into a copy of it.
+ */
+static block_t *MmapBlock (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    uint64_t pos = p_access->info.i_pos;
+
+    if (pos >= p_sys->size)
+    {   /* The file may have grown since */
+        struct stat st;
+
+        if (fstat (p_sys->fd, &st) == 0)
+            p_sys->size = st.st_size;
+        if (pos >= p_sys->size)
+        {
+            p_access->info.b_eof = true;
+            return NULL;
+        }
+    }
+
+    /* Map from the page boundary, so that blocks stay page-aligned */
+    uint64_t offset = pos & ~(uint64_t)p_sys->pagemask;
+    size_t skip = pos - offset;
+    size_t length = p_sys->mmap_size;
+
+    if (offset + length > p_sys->size)
+        length = p_sys->size - offset;
+
+    void *addr = mmap (NULL, length, PROT_READ, MAP_SHARED, p_sys->fd,
+                       offset);
+    if (addr == MAP_FAILED)
+    {
+        msg_Err (p_access, "memory mapping error: %s",
+                 vlc_strerror_c(errno));
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+    posix_madvise (addr, length, POSIX_MADV_SEQUENTIAL);
+
+    /* Keep the kernel one mapping ahead of the demuxer. The window
+     * restarts from the current position after a seek. */
+    uint64_t end = offset + length;
+    if (p_sys->ahead < end)
+        p_sys->ahead = end;
+    if (p_sys->ahead < p_sys->size && p_sys->ahead < end + p_sys->mmap_size)
+    {
+        posix_fadvise (p_sys->fd, p_sys->ahead, p_sys->mmap_size,
+                       POSIX_FADV_WILLNEED);
+        p_sys->ahead += p_sys->mmap_size;
+    }
+
+    block_t *block = block_mmap_Alloc (addr, length);
+    if (unlikely(block == NULL))
+        return NULL;
+
+    block->p_buffer += skip;
+    block->i_buffer -= skip;
+    p_access->info.i_pos = end;
+    return block;
+}
+
+static int MmapSeek (access_t *p_access, uint64_t i_pos)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    p_access->info.i_pos = i_pos;
+    p_access->info.b_eof = false;
+
+    /* Slide the read-ahead window to the new position */
+    p_sys->ahead = 0;
+    if (i_pos < p_sys->size)
+    {
+        uint64_t offset = i_pos & ~(uint64_t)p_sys->pagemask;
+
+        posix_fadvise (p_sys->fd, offset, p_sys->mmap_size,
+                       POSIX_FADV_WILLNEED);
+    }
+    return VLC_SUCCESS;
+}
+#endif
+
 /**
  * Reads from a non-seekable file.
  */
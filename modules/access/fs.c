@@ -48,6 +48,15 @@ static const char *const psz_recursive_list_text[] = {
         "This is useful if you add directories that contain playlist files " \
         "for instance. Use a comma-separated list of extensions." )
 
+#define MMAP_TEXT N_("Memory-mapped reading")
+#define MMAP_LONGTEXT N_( \
+    "Read local files through memory mappings instead of copying them. " \
+    "This saves one copy of all the data, but the file must not be " \
+    "truncated while it is being read." )
+#define MMAP_SIZE_TEXT N_("Memory mapping size (kB)")
+#define MMAP_SIZE_LONGTEXT N_( \
+    "Size of each memory-mapped block, and of the read-ahead window." )
+
 static const char *const psz_sort_list[] = { "collate", "version", "none" };
 static const char *const psz_sort_list_text[] = {
     N_("Sort alphabetically according to the current language's collation rules."),
@@ -67,6 +76,12 @@ vlc_module_begin ()
     set_capability( "access", 50 )
     add_shortcut( "file", "fd", "stream" )
     set_callbacks( FileOpen, FileClose )
+#ifdef HAVE_MMAP
+    add_bool( "file-mmap", false, MMAP_TEXT, MMAP_LONGTEXT, true )
+    add_integer_with_range( "file-mmap-size", 1024, MMAP_SIZE_MIN,
+                            MMAP_SIZE_MAX, MMAP_SIZE_TEXT,
+                            MMAP_SIZE_LONGTEXT, true )
+#endif
 
     add_submodule()
     set_section( N_("Directory" ), NULL )
@@ -20,6 +20,10 @@
 
 #include <dirent.h>
 
+/* Range of file-mmap-size (kB) */
+#define MMAP_SIZE_MIN 64
+#define MMAP_SIZE_MAX 65536
+
 int FileOpen (vlc_object_t *);
 void FileClose (vlc_object_t *);
 
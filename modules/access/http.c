@@ -88,6 +88,21 @@ static void Close( vlc_object_t * );
 #define REFERER_TEXT N_("HTTP referer value")
 #define REFERER_LONGTEXT N_("Customize the HTTP referer, simulating a previous document")
 
+#define PARALLEL_TEXT N_("Parallel range requests")
+#define PARALLEL_LONGTEXT N_( \
+    "Number of connections fetching the upcoming byte ranges of a " \
+    "seekable resource in parallel. Seeking then does not reconnect, " \
+    "and recently fetched ranges are kept. 0 reads a single response." )
+
+#define RANGE_SIZE_TEXT N_("Range request size (kB)")
+#define RANGE_SIZE_LONGTEXT N_( \
+    "Size of the byte ranges requested by parallel range requests." )
+
+#define RANGE_CACHE_TEXT N_("Range cache size (kB)")
+#define RANGE_CACHE_LONGTEXT N_( \
+    "Amount of already fetched ranges kept for seeking back, in " \
+    "addition to the ranges being read ahead." )
+
 #define UA_TEXT N_("User Agent")
 #define UA_LONGTEXT N_("The name and version of the program will be " \
     "provided to the HTTP server. They must be separated by a forward " \
@@ -118,6 +133,12 @@ vlc_module_begin ()
         change_safe()
     add_bool( "http-forward-cookies", true, FORWARD_COOKIES_TEXT,
               FORWARD_COOKIES_LONGTEXT, true )
+    add_integer_with_range( "http-parallel", 0, 0, 16, PARALLEL_TEXT,
+                            PARALLEL_LONGTEXT, true )
+    add_integer_with_range( "http-range-size", 1024, 16, 65536,
+                            RANGE_SIZE_TEXT, RANGE_SIZE_LONGTEXT, true )
+    add_integer_with_range( "http-range-cache-size", 8192, 0, 262144,
+                            RANGE_CACHE_TEXT, RANGE_CACHE_LONGTEXT, true )
     /* 'itpc' = iTunes Podcast */
     add_shortcut( "http", "https", "unsv", "itpc", "icyx" )
     set_callbacks( Open, Close )
@@ -127,6 +148,33 @@ vlc_module_end ()
  * Local prototypes
  *****************************************************************************/
 
+/* A byte range of the resource, fetched by a worker connection */
+typedef struct
+{
+    uint64_t i_index;       /* range number */
+    enum
+    {
+        RANGE_FREE,
+        RANGE_LOADING,
+        RANGE_DONE,
+        RANGE_ERROR,
+    } i_state;
+    uint8_t *p_buffer;
+    size_t   i_size;
+    size_t   i_filled;
+    uint64_t i_used;        /* last use date, for LRU */
+} http_range_t;
+
+typedef struct
+{
+    access_t    *p_access;
+    vlc_thread_t thread;
+    int          fd;
+    vlc_tls_t   *p_tls;
+    v_socket_t  *p_vs;
+    bool         b_close;   /* the server closes after the response */
+} http_range_conn_t;
+
 struct access_sys_t
 {
     int fd;
@@ -187,6 +235,22 @@ struct access_sys_t
     bool b_pace_control;
     bool b_persist;
     bool b_has_size;
+
+    /* Parallel range requests */
+    struct
+    {
+        bool               b_active;
+        bool               b_closing;
+        http_range_conn_t *p_conns;
+        unsigned           i_conns;
+        http_range_t      *p_ranges;
+        unsigned           i_ranges;
+        size_t             i_size;      /* of a range */
+        uint64_t           i_clock;
+        vlc_mutex_t        lock;
+        vlc_cond_t         wait;        /* workers wait for ranges to fetch */
+        vlc_cond_t         data;        /* the reader waits for data */
+    } range;
 };
 
 /* */
@@ -204,6 +268,11 @@ static int Connect( access_t *, uint64_t );
 static int Request( access_t *p_access, uint64_t i_tell );
 static void Disconnect( access_t * );
 
+static int  RangeStart( access_t * );
+static void RangeStop( access_t * );
+static ssize_t RangeRead( access_t *, uint8_t *, size_t );
+static int  RangeSeek( access_t *, uint64_t );
+
 
 static void AuthReply( access_t *p_acces, const char *psz_prefix,
                        vlc_url_t *p_url, http_auth_t *p_auth );
@@ -274,6 +343,8 @@ static int OpenRedirected( vlc_object_t *p_this, const char *psz_access,
     p_sys->b_persist = false;
     p_sys->b_has_size = false;
     p_sys->size = 0;
+    p_sys->range.b_active = false;
+    p_sys->range.i_conns = 0;
     p_access->info.i_pos  = 0;
     p_access->info.b_eof  = false;
 
@@ -580,6 +651,8 @@ connect:
 
     if( p_sys->b_reconnect ) msg_Dbg( p_access, "auto re-connect enabled" );
 
+    RangeStart( p_access );
+
     return VLC_SUCCESS;
 
 error:
@@ -626,6 +699,7 @@ static void Close( vlc_object_t *p_this )
     free( p_sys->psz_user_agent );
     free( p_sys->psz_referrer );
 
+    RangeStop( p_access );
     Disconnect( p_access );
     vlc_tls_Delete( p_sys->p_creds );
 
@@ -950,7 +1024,7 @@ static int Control( access_t *p_access, int i_query, va_list args )
             break;
         case ACCESS_CAN_FASTSEEK:
             pb_bool = (bool*)va_arg( args, bool* );
-            *pb_bool = false;
+            *pb_bool = p_sys->range.b_active;
             break;
         case ACCESS_CAN_PAUSE:
         case ACCESS_CAN_CONTROL_PACE:
@@ -1548,6 +1622,476 @@ static void Disconnect( access_t *p_access )
 
 }
 
+/*****************************************************************************
+ * Parallel range requests: worker connections fetch the ranges from the read
+ * position onwards, the reader copies from them. Seeking only moves the
+ * window; the least recently used ranges out of it are recycled.
+ *****************************************************************************/
+static http_range_t *RangeFind( access_sys_t *p_sys, uint64_t i_index )
+{
+    for( unsigned i = 0; i < p_sys->range.i_ranges; i++ )
+    {
+        http_range_t *p_range = &p_sys->range.p_ranges[i];
+        if( p_range->i_state != RANGE_FREE && p_range->i_index == i_index )
+            return p_range;
+    }
+    return NULL;
+}
+
+/* Picks the next range to fetch, with the lock held */
+static http_range_t *RangeNext( access_t *p_access )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    const size_t i_size = p_sys->range.i_size;
+    const uint64_t i_first = p_access->info.i_pos / i_size;
+    const uint64_t i_last = __MIN( i_first + p_sys->range.i_conns,
+                                   (p_sys->size - 1) / i_size );
+
+    for( uint64_t i_index = i_first; i_index <= i_last; i_index++ )
+    {
+        if( RangeFind( p_sys, i_index ) != NULL )
+            continue;
+
+        /* A free slot, else the least recently used one out of the window */
+        http_range_t *p_slot = NULL;
+        for( unsigned i = 0; i < p_sys->range.i_ranges; i++ )
+        {
+            http_range_t *p_range = &p_sys->range.p_ranges[i];
+
+            if( p_range->i_state == RANGE_FREE )
+            {
+                p_slot = p_range;
+                break;
+            }
+            if( p_range->i_state == RANGE_LOADING ||
+                ( p_range->i_index >= i_first && p_range->i_index <= i_last ) )
+                continue;
+            if( p_slot == NULL || p_range->i_used < p_slot->i_used )
+                p_slot = p_range;
+        }
+        if( p_slot == NULL )
+            return NULL;
+
+        if( p_slot->p_buffer == NULL )
+        {
+            p_slot->p_buffer = malloc( i_size );
+            if( unlikely(p_slot->p_buffer == NULL) )
+                return NULL;
+        }
+        p_slot->i_index = i_index;
+        p_slot->i_state = RANGE_LOADING;
+        p_slot->i_size = __MIN( i_size, p_sys->size - i_index * i_size );
+        p_slot->i_filled = 0;
+        p_slot->i_used = ++p_sys->range.i_clock;
+        return p_slot;
+    }
+    return NULL;
+}
+
+static void RangeDisconnect( http_range_conn_t *p_conn )
+{
+    access_sys_t *p_sys = p_conn->p_access->p_sys;
+
+    vlc_mutex_lock( &p_sys->range.lock );
+    int fd = p_conn->fd;
+    vlc_tls_t *p_tls = p_conn->p_tls;
+    p_conn->fd = -1;
+    p_conn->p_tls = NULL;
+    p_conn->p_vs = NULL;
+    vlc_mutex_unlock( &p_sys->range.lock );
+
+    if( p_tls != NULL )
+        vlc_tls_SessionDelete( p_tls );
+    if( fd != -1 )
+        net_Close( fd );
+}
+
+static int RangeConnect( http_range_conn_t *p_conn )
+{
+    access_t *p_access = p_conn->p_access;
+    access_sys_t *p_sys = p_access->p_sys;
+
+    int fd = net_ConnectTCP( p_access, p_sys->url.psz_host,
+                             p_sys->url.i_port );
+    if( fd == -1 )
+        return VLC_EGENERIC;
+    setsockopt (fd, SOL_SOCKET, SO_KEEPALIVE, &(int){ 1 }, sizeof (int));
+
+    vlc_tls_t *p_tls = NULL;
+    if( p_sys->p_creds != NULL )
+    {
+        const char *alpn[] = { "http/1.1", NULL };
+
+        p_tls = vlc_tls_ClientSessionCreate( p_sys->p_creds, fd,
+                                             p_sys->url.psz_host, "https",
+                                             alpn, NULL );
+        if( p_tls == NULL )
+        {
+            net_Close( fd );
+            return VLC_EGENERIC;
+        }
+    }
+
+    /* Published under the lock, for RangeStop() to interrupt */
+    vlc_mutex_lock( &p_sys->range.lock );
+    p_conn->fd = fd;
+    p_conn->p_tls = p_tls;
+    p_conn->p_vs = p_tls != NULL ? &p_tls->sock : NULL;
+    p_conn->b_close = false;
+    bool b_closing = p_sys->range.b_closing;
+    vlc_mutex_unlock( &p_sys->range.lock );
+
+    return b_closing ? VLC_EGENERIC : VLC_SUCCESS;
+}
+
+static int RangeRequest( http_range_conn_t *p_conn, uint64_t i_start,
+                         uint64_t i_end )
+{
+    access_t *p_access = p_conn->p_access;
+    access_sys_t *p_sys = p_access->p_sys;
+    const v_socket_t *pvs = p_conn->p_vs;
+    char psz_port[8] = "";
+    char *psz_cookies = NULL;
+
+    const char *psz_path = p_sys->url.psz_path;
+    if( !psz_path || !*psz_path )
+        psz_path = "/";
+    if( p_sys->url.i_port != (pvs ? 443 : 80) )
+        snprintf( psz_port, sizeof( psz_port ), ":%d", p_sys->url.i_port );
+    if( p_sys->cookies )
+        psz_cookies = vlc_http_cookies_for_url( p_sys->cookies, &p_sys->url );
+
+    int i_ret = net_Printf( p_access, p_conn->fd, pvs,
+                            "GET %s HTTP/1.1\r\n"
+                            "Host: %s%s\r\n"
+                            "User-Agent: %s\r\n"
+                            "%s%s%s"
+                            "%s%s%s"
+                            "Range: bytes=%"PRIu64"-%"PRIu64"\r\n"
+                            "\r\n",
+                            psz_path, p_sys->url.psz_host, psz_port,
+                            p_sys->psz_user_agent,
+                            p_sys->psz_referrer ? "Referer: " : "",
+                            p_sys->psz_referrer ? p_sys->psz_referrer : "",
+                            p_sys->psz_referrer ? "\r\n" : "",
+                            psz_cookies ? "Cookie: " : "",
+                            psz_cookies ? psz_cookies : "",
+                            psz_cookies ? "\r\n" : "",
+                            i_start, i_end );
+    free( psz_cookies );
+    if( i_ret < 0 )
+        return VLC_EGENERIC;
+
+    char *psz = net_Gets( p_access, p_conn->fd, pvs );
+    if( psz == NULL )
+        return VLC_EGENERIC;
+
+    int i_code = 0;
+    if( !strncmp( psz, "HTTP/1.", 7 ) )
+    {
+        i_code = atoi( &psz[9] );
+        p_conn->b_close = psz[7] == '0';
+    }
+    free( psz );
+
+    uint64_t i_length = 0;
+    bool b_chunked = false;
+    while( ( psz = net_Gets( p_access, p_conn->fd, pvs ) ) != NULL )
+    {
+        char *p = strchr( psz, ':' );
+
+        if( *psz == '\0' )
+        {
+            free( psz );
+            break;
+        }
+        if( p != NULL )
+        {
+            *p++ = '\0';
+            p += strspn( p, " \t" );
+
+            if( !strcasecmp( psz, "Content-Length" ) )
+                i_length = strtoull( p, NULL, 10 );
+            else if( !strcasecmp( psz, "Transfer-Encoding" ) )
+                b_chunked = true;
+            else if( !strcasecmp( psz, "Connection" ) &&
+                     !strncasecmp( p, "close", 5 ) )
+                p_conn->b_close = true;
+        }
+        free( psz );
+    }
+    if( psz == NULL )
+        return VLC_EGENERIC;
+
+    if( i_code != 206 || b_chunked || i_length != i_end - i_start + 1 )
+    {
+        msg_Err( p_access, "range request failed (code %d)", i_code );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static int RangeFetch( http_range_conn_t *p_conn, http_range_t *p_range )
+{
+    access_t *p_access = p_conn->p_access;
+    access_sys_t *p_sys = p_access->p_sys;
+    const uint64_t i_start = p_range->i_index * p_sys->range.i_size;
+
+    /* Once more on a new connection if the server closed this one,
+     * resuming from what was already received */
+    for( unsigned i_try = 0; i_try < 2; i_try++ )
+    {
+        if( p_conn->fd == -1 && RangeConnect( p_conn ) )
+        {
+            RangeDisconnect( p_conn );
+            continue;
+        }
+
+        if( RangeRequest( p_conn, i_start + p_range->i_filled,
+                          i_start + p_range->i_size - 1 ) == VLC_SUCCESS )
+        {
+            while( p_range->i_filled < p_range->i_size )
+            {
+                ssize_t i_read = net_Read( p_access, p_conn->fd, p_conn->p_vs,
+                                           p_range->p_buffer + p_range->i_filled,
+                                           p_range->i_size - p_range->i_filled,
+                                           false );
+                if( i_read <= 0 )
+                    break;
+
+                vlc_mutex_lock( &p_sys->range.lock );
+                p_range->i_filled += i_read;
+                vlc_cond_broadcast( &p_sys->range.data );
+                vlc_mutex_unlock( &p_sys->range.lock );
+            }
+
+            if( p_range->i_filled == p_range->i_size )
+            {
+                if( p_conn->b_close )
+                    RangeDisconnect( p_conn );
+                return VLC_SUCCESS;
+            }
+        }
+        RangeDisconnect( p_conn );
+
+        if( !vlc_object_alive( p_access ) )
+            break;
+    }
+    return VLC_EGENERIC;
+}
+
+static void *RangeThread( void *data )
+{
+    http_range_conn_t *p_conn = data;
+    access_t *p_access = p_conn->p_access;
+    access_sys_t *p_sys = p_access->p_sys;
+
+    vlc_mutex_lock( &p_sys->range.lock );
+    while( !p_sys->range.b_closing )
+    {
+        http_range_t *p_range = RangeNext( p_access );
+        if( p_range == NULL )
+        {
+            vlc_cond_wait( &p_sys->range.wait, &p_sys->range.lock );
+            continue;
+        }
+        vlc_mutex_unlock( &p_sys->range.lock );
+
+        int i_ret = RangeFetch( p_conn, p_range );
+
+        vlc_mutex_lock( &p_sys->range.lock );
+        p_range->i_state = i_ret ? RANGE_ERROR : RANGE_DONE;
+        vlc_cond_broadcast( &p_sys->range.data );
+    }
+    vlc_mutex_unlock( &p_sys->range.lock );
+
+    RangeDisconnect( p_conn );
+    return NULL;
+}
+
+/* Moves the read position, with the lock held */
+static void RangeSetPos( access_t *p_access, uint64_t i_pos )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if( i_pos / p_sys->range.i_size !=
+        p_access->info.i_pos / p_sys->range.i_size )
+        vlc_cond_broadcast( &p_sys->range.wait ); /* the window moved */
+    p_access->info.i_pos = i_pos;
+}
+
+static ssize_t RangeRead( access_t *p_access, uint8_t *p_buffer, size_t i_len )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    const uint64_t i_pos = p_access->info.i_pos;
+    const size_t i_offset = i_pos % p_sys->range.i_size;
+    http_range_t *p_range;
+
+    if( i_pos >= p_sys->size || i_len == 0 )
+    {
+        p_access->info.b_eof = i_pos >= p_sys->size;
+        return 0;
+    }
+
+    vlc_mutex_lock( &p_sys->range.lock );
+    while( ( p_range = RangeFind( p_sys, i_pos / p_sys->range.i_size ) ) == NULL
+        || ( p_range->i_state == RANGE_LOADING && p_range->i_filled <= i_offset ) )
+        vlc_cond_wait( &p_sys->range.data, &p_sys->range.lock );
+
+    if( p_range->i_state == RANGE_ERROR )
+    {
+        vlc_mutex_unlock( &p_sys->range.lock );
+        if( !vlc_object_alive( p_access ) )
+            goto fatal;
+
+        /* Back to a single response from here */
+        msg_Warn( p_access, "range request failed, falling back to a single "
+                  "connection" );
+        RangeStop( p_access );
+        p_access->pf_read = Read;
+        p_access->pf_seek = Seek;
+        if( Connect( p_access, i_pos ) )
+            goto fatal;
+        return Read( p_access, p_buffer, i_len );
+    }
+
+    size_t i_copy = __MIN( i_len, p_range->i_filled - i_offset );
+    memcpy( p_buffer, p_range->p_buffer + i_offset, i_copy );
+    p_range->i_used = ++p_sys->range.i_clock;
+    RangeSetPos( p_access, i_pos + i_copy );
+    vlc_mutex_unlock( &p_sys->range.lock );
+
+    return i_copy;
+
+fatal:
+    p_access->info.b_eof = true;
+    return 0;
+}
+
+static int RangeSeek( access_t *p_access, uint64_t i_pos )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    vlc_mutex_lock( &p_sys->range.lock );
+    RangeSetPos( p_access, i_pos );
+    vlc_mutex_unlock( &p_sys->range.lock );
+    p_access->info.b_eof = false;
+    return VLC_SUCCESS;
+}
+
+static int RangeStart( access_t *p_access )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    unsigned i_conns = var_InheritInteger( p_access, "http-parallel" );
+
+    if( i_conns == 0 )
+        return VLC_EGENERIC;
+
+    /* Plain seekable resources of known size only */
+    if( !p_sys->b_seekable || !p_sys->b_has_size || p_sys->size == 0 ||
+        p_sys->i_version == 0 || strcmp( p_sys->psz_protocol, "HTTP" ) ||
+        p_sys->b_continuous || p_sys->b_proxy || p_sys->i_icy_meta > 0 ||
+        p_sys->url.psz_username != NULL || p_sys->auth.psz_realm != NULL
+#ifdef HAVE_ZLIB_H
+        || p_sys->b_compressed
+#endif
+      )
+    {
+        msg_Dbg( p_access, "no parallel range requests for this resource" );
+        return VLC_EGENERIC;
+    }
+
+    /* The ranges of the options are not enforced on the command line */
+    size_t i_size = VLC_CLIP( var_InheritInteger( p_access,
+                                  "http-range-size" ), 16, 65536 ) << 10;
+    size_t i_cache = VLC_CLIP( var_InheritInteger( p_access,
+                                  "http-range-cache-size" ), 0, 262144 ) << 10;
+
+    p_sys->range.i_size = i_size;
+    p_sys->range.i_ranges = i_conns + 1 + i_cache / i_size;
+    p_sys->range.p_ranges = calloc( p_sys->range.i_ranges,
+                                    sizeof( *p_sys->range.p_ranges ) );
+    p_sys->range.p_conns = calloc( i_conns, sizeof( *p_sys->range.p_conns ) );
+    if( unlikely(p_sys->range.p_ranges == NULL || p_sys->range.p_conns == NULL) )
+    {
+        free( p_sys->range.p_ranges );
+        free( p_sys->range.p_conns );
+        return VLC_ENOMEM;
+    }
+    for( unsigned i = 0; i < p_sys->range.i_ranges; i++ )
+        p_sys->range.p_ranges[i].i_state = RANGE_FREE;
+
+    p_sys->range.b_closing = false;
+    p_sys->range.i_clock = 0;
+    vlc_mutex_init( &p_sys->range.lock );
+    vlc_cond_init( &p_sys->range.wait );
+    vlc_cond_init( &p_sys->range.data );
+
+    for( unsigned i = 0; i < i_conns; i++ )
+    {
+        http_range_conn_t *p_conn = &p_sys->range.p_conns[i];
+
+        p_conn->p_access = p_access;
+        p_conn->fd = -1;
+        p_conn->p_tls = NULL;
+        p_conn->p_vs = NULL;
+        if( vlc_clone( &p_conn->thread, RangeThread, p_conn,
+                       VLC_THREAD_PRIORITY_INPUT ) )
+            break;
+        p_sys->range.i_conns++;
+    }
+    if( p_sys->range.i_conns == 0 )
+    {
+        vlc_cond_destroy( &p_sys->range.data );
+        vlc_cond_destroy( &p_sys->range.wait );
+        vlc_mutex_destroy( &p_sys->range.lock );
+        free( p_sys->range.p_ranges );
+        free( p_sys->range.p_conns );
+        return VLC_EGENERIC;
+    }
+
+    /* The workers make their own requests */
+    Disconnect( p_access );
+    p_sys->range.b_active = true;
+    p_access->pf_read = RangeRead;
+    p_access->pf_seek = RangeSeek;
+
+    msg_Dbg( p_access, "%u parallel range requests of %zu bytes, "
+             "%u ranges kept", p_sys->range.i_conns, i_size,
+             p_sys->range.i_ranges );
+    return VLC_SUCCESS;
+}
+
+static void RangeStop( access_t *p_access )
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->range.i_conns == 0 )
+        return;
+
+    vlc_mutex_lock( &p_sys->range.lock );
+    p_sys->range.b_closing = true;
+    vlc_cond_broadcast( &p_sys->range.wait );
+    /* Interrupt the transfers in progress */
+    for( unsigned i = 0; i < p_sys->range.i_conns; i++ )
+        if( p_sys->range.p_conns[i].fd != -1 )
+            shutdown( p_sys->range.p_conns[i].fd, SHUT_RDWR );
+    vlc_mutex_unlock( &p_sys->range.lock );
+
+    for( unsigned i = 0; i < p_sys->range.i_conns; i++ )
+        vlc_join( p_sys->range.p_conns[i].thread, NULL );
+
+    for( unsigned i = 0; i < p_sys->range.i_ranges; i++ )
+        free( p_sys->range.p_ranges[i].p_buffer );
+    free( p_sys->range.p_ranges );
+    free( p_sys->range.p_conns );
+    vlc_cond_destroy( &p_sys->range.data );
+    vlc_cond_destroy( &p_sys->range.wait );
+    vlc_mutex_destroy( &p_sys->range.lock );
+    p_sys->range.i_conns = 0;
+    p_sys->range.b_active = false;
+}
+
 /*****************************************************************************
  * HTTP authentication
  *****************************************************************************/
@@ -37,13 +37,18 @@
 #endif
 
 #include <errno.h>
+#include <time.h>
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_access.h>
 #include <vlc_network.h>
 #include <vlc_block.h>
+#ifdef HAVE_POLL
+# include <poll.h>
+#endif
 
 #define MTU 65535
+#define BATCH_MAX 64
 
 /*****************************************************************************
  * Module descriptor
@@ -53,6 +58,15 @@ static void Close( vlc_object_t * );
 
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
+#define BATCH_TEXT N_("Receive batch")
+#define BATCH_LONGTEXT N_( \
+    "Maximum number of datagrams received per system call. " \
+    "Use 1 to receive datagrams one by one." )
+#define TIMESTAMPS_TEXT N_("Kernel receive timestamps")
+#define TIMESTAMPS_LONGTEXT N_( \
+    "Stamp each received datagram with the time it reached the kernel, " \
+    "rather than the time it was read. This only applies to batched " \
+    "reception, and is meant for jitter measurements." )
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -62,6 +76,12 @@ vlc_module_begin ()
 
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_integer( "udp-buffer", 0x400000, BUFFER_TEXT, BUFFER_LONGTEXT, true )
+#ifdef HAVE_RECVMMSG
+    add_integer_with_range( "udp-batch", 16, 1, BATCH_MAX, BATCH_TEXT,
+                            BATCH_LONGTEXT, true )
+    add_bool( "udp-timestamps", false, TIMESTAMPS_TEXT, TIMESTAMPS_LONGTEXT,
+              true )
+#endif
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -75,6 +95,8 @@ struct access_sys_t
     size_t fifo_size;
     block_fifo_t *fifo;
     vlc_thread_t thread;
+    unsigned batch;
+    bool timestamps;
 };
 
 /*****************************************************************************
@@ -83,6 +105,9 @@ struct access_sys_t
 static block_t *BlockUDP( access_t * );
 static int Control( access_t *, int, va_list );
 static void* ThreadRead( void *data );
+#ifdef HAVE_RECVMMSG
+static void* ThreadReadBatch( void *data );
+#endif
 
 /*****************************************************************************
  * Open: open the socket
@@ -168,7 +193,28 @@ static int Open( vlc_object_t *p_this )
 
     sys->fifo_size = var_InheritInteger( p_access, "udp-buffer");
 
-    if( vlc_clone( &sys->thread, ThreadRead, p_access,
+    void *(*entry)( void * ) = ThreadRead;
+#ifdef HAVE_RECVMMSG
+    /* The range is not enforced on values from the MRL or command line */
+    sys->batch = VLC_CLIP( var_InheritInteger( p_access, "udp-batch" ),
+                           1, BATCH_MAX );
+    sys->timestamps = var_InheritBool( p_access, "udp-timestamps" );
+    if( sys->timestamps
+     && setsockopt( sys->fd, SOL_SOCKET, SO_TIMESTAMPNS, &(int){ 1 },
+                    sizeof (int) ) )
+    {
+        msg_Warn( p_access, "cannot enable receive timestamps: %s",
+                  vlc_strerror_c(errno) );
+        sys->timestamps = false;
+    }
+    if( sys->batch > 1 || sys->timestamps )
+        entry = ThreadReadBatch;
+#else
+    sys->batch = 1;
+    sys->timestamps = false;
+#endif
+
+    if( vlc_clone( &sys->thread, entry, p_access,
                    VLC_THREAD_PRIORITY_INPUT ) )
     {
         block_FifoRelease( sys->fifo );
@@ -275,3 +321,139 @@ static void* ThreadRead( void *data )
     block_FifoWake( sys->fifo );
     return NULL;
 }
+
+#ifdef HAVE_RECVMMSG
+struct udp_batch
+{
+    block_t *pkts[BATCH_MAX];
+    struct mmsghdr msgs[BATCH_MAX];
+    struct iovec iov[BATCH_MAX];
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof (struct timespec))];
+    } ctl[BATCH_MAX];
+};
+
+static void BatchCleanup( void *data )
+{
+    struct udp_batch *b = data;
+
+    for( unsigned i = 0; i < BATCH_MAX; i++ )
+        if( b->pkts[i] != NULL )
+            block_Release( b->pkts[i] );
+    free( b );
+}
+
+/**
+ * Converts a kernel (real-time clock) receive timestamp to the mdate() clock.
+ */
+static mtime_t BatchTimestamp( const struct msghdr *msg, mtime_t offset )
+{
+    for( const struct cmsghdr *cmsg = CMSG_FIRSTHDR( msg );
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR( (struct msghdr *)msg, (struct cmsghdr *)cmsg ) )
+    {
+        if( cmsg->cmsg_level == SOL_SOCKET
+         && cmsg->cmsg_type == SCM_TIMESTAMPNS )
+        {
+            struct timespec ts;
+
+            memcpy( &ts, CMSG_DATA( cmsg ), sizeof (ts) );
+            return INT64_C(1000000) * ts.tv_sec + ts.tv_nsec / 1000 + offset;
+        }
+    }
+    return VLC_TS_INVALID;
+}
+
+/*****************************************************************************
+ * ThreadReadBatch: Pull several packets per system call with recvmmsg().
+ *****************************************************************************
+ * Buffers which did not receive a datagram are kept for the next call, so
+ * that only the consumed ones need to be allocated again.
+ *****************************************************************************/
+static void* ThreadReadBatch( void *data )
+{
+    access_t *access = data;
+    access_sys_t *sys = access->p_sys;
+    struct udp_batch *b = malloc( sizeof (*b) );
+    const unsigned n = sys->batch;
+
+    if( unlikely(b == NULL) )
+        goto out;
+
+    for( unsigned i = 0; i < BATCH_MAX; i++ )
+        b->pkts[i] = NULL;
+
+    vlc_cleanup_push( BatchCleanup, b );
+    for( ;; )
+    {
+        block_FifoPace( sys->fifo, SIZE_MAX, sys->fifo_size );
+
+        for( unsigned i = 0; i < n; i++ )
+        {
+            if( b->pkts[i] == NULL )
+            {
+                b->pkts[i] = block_Alloc( MTU );
+                if( unlikely(b->pkts[i] == NULL) )
+                    goto error;
+            }
+
+            struct msghdr *msg = &b->msgs[i].msg_hdr;
+
+            b->iov[i].iov_base = b->pkts[i]->p_buffer;
+            b->iov[i].iov_len = MTU;
+            msg->msg_name = NULL;
+            msg->msg_namelen = 0;
+            msg->msg_iov = &b->iov[i];
+            msg->msg_iovlen = 1;
+            msg->msg_control = sys->timestamps ? b->ctl[i].buf : NULL;
+            msg->msg_controllen = sys->timestamps ? sizeof (b->ctl[i]) : 0;
+            msg->msg_flags = 0;
+        }
+
+        /* Wait for at least one datagram, then take all that are queued */
+        struct pollfd ufd = { .fd = sys->fd, .events = POLLIN };
+
+        if( poll( &ufd, 1, -1 ) < 0 )
+            continue;
+
+        int val = recvmmsg( sys->fd, b->msgs, n, MSG_DONTWAIT, NULL );
+        if( val < 0 )
+        {
+            if( errno != EAGAIN && errno != EINTR )
+                msg_Err( access, "receive error: %s", vlc_strerror_c(errno) );
+            continue;
+        }
+
+        mtime_t offset = 0;
+        if( sys->timestamps )
+        {
+            struct timespec now;
+
+            clock_gettime( CLOCK_REALTIME, &now );
+            offset = mdate() - INT64_C(1000000) * now.tv_sec
+                   - now.tv_nsec / 1000;
+        }
+
+        block_t *chain = NULL, **pp = &chain;
+        for( int i = 0; i < val; i++ )
+        {
+            block_t *pkt = b->pkts[i];
+
+            pkt->i_buffer = b->msgs[i].msg_len;
+            if( sys->timestamps )
+                pkt->i_pts = BatchTimestamp( &b->msgs[i].msg_hdr, offset );
+            b->pkts[i] = NULL;
+            *pp = pkt;
+            pp = &pkt->p_next;
+        }
+        block_FifoPut( sys->fifo, chain );
+    }
+error:
+    vlc_cleanup_run();
+out:
+    block_FifoWake( sys->fifo );
+    return NULL;
+}
+#endif
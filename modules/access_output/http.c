@@ -61,6 +61,13 @@ static void Close( vlc_object_t * );
 #define METACUBE_TEXT N_("Metacube")
 #define METACUBE_LONGTEXT N_("Use the Metacube protocol. Needed for streaming " \
                              "to the Cubemap reflector.")
+#define INSTANT_TEXT N_("Instant start cache size (kB)")
+#define INSTANT_LONGTEXT N_("Keep the last group of pictures, up to this " \
+                            "size, and send it at once to new clients so " \
+                            "that they can start decoding immediately. " \
+                            "With MPEG-TS, enable the use-key-frames option " \
+                            "of the TS muxer so that PAT/PMT are sent first. " \
+                            "0 makes new clients wait for the next keyframe.")
 
 
 vlc_module_begin ()
@@ -78,6 +85,9 @@ vlc_module_begin ()
                 MIME_TEXT, MIME_LONGTEXT, true )
     add_bool( SOUT_CFG_PREFIX "metacube", false,
               METACUBE_TEXT, METACUBE_LONGTEXT, true )
+    add_integer( SOUT_CFG_PREFIX "instant-start", 0,
+                 INSTANT_TEXT, INSTANT_LONGTEXT, true )
+        change_integer_range( 0, 1 << 20 )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -86,7 +96,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "user", "pwd", "mime", "metacube", NULL
+    "user", "pwd", "mime", "metacube", "instant-start", NULL
 };
 
 static ssize_t Write( sout_access_out_t *, block_t * );
@@ -286,6 +296,10 @@ static int Open( vlc_object_t *p_this )
         }
     }
 
+    int64_t i_instant = var_GetInteger( p_access, SOUT_CFG_PREFIX "instant-start" );
+    if( i_instant > 0 )
+        httpd_StreamSetInstantStart( p_sys->p_httpd_stream, i_instant * 1024 );
+
     p_sys->i_header_allocated = 1024;
     p_sys->i_header_size      = 0;
     p_sys->p_header           = xmalloc( p_sys->i_header_allocated );
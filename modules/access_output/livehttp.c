@@ -43,6 +43,7 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_charset.h>
+#include <vlc_httpd.h>
 
 #include <gcrypt.h>
 #include <vlc_gcrypt.h>
@@ -57,6 +58,11 @@
 
 #define MAX_RENAME_RETRIES        10
 
+/* Longest wait of a blocking request, below the httpd inactivity timeout */
+#define BLOCK_TIMEOUT_MAX         (8 * CLOCK_FREQ)
+/* Segments kept in the index when served from memory, if not set */
+#define DEFAULT_MEMORY_SEGS       5
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -105,6 +111,18 @@ static void Close( vlc_object_t * );
 #define INTITIAL_SEG_TEXT N_("Number of first segment")
 #define INITIAL_SEG_LONGTEXT N_("The number of the first segment generated")
 
+#define HTTPD_TEXT N_("Serve from memory")
+#define HTTPD_LONGTEXT N_("Keep the segments and the index in memory and "\
+                          "serve them with the built-in HTTP server "\
+                          "(--http-host, --http-port) instead of writing "\
+                          "files. The destination and the index are then "\
+                          "URL paths.")
+
+#define PARTLEN_TEXT N_("Partial segment length (ms)")
+#define PARTLEN_LONGTEXT N_("Split the segments served from memory into "\
+                            "parts of this length, for low-latency players. "\
+                            "0 disables partial segments.")
+
 vlc_module_begin ()
     set_description( N_("HTTP Live streaming output") )
     set_shortname( N_("LiveHTTP" ))
@@ -135,6 +153,10 @@ vlc_module_begin ()
                 KEYFILE_TEXT, KEYFILE_LONGTEXT, true )
     add_loadfile( SOUT_CFG_PREFIX "key-loadfile", NULL,
                 KEYLOADFILE_TEXT, KEYLOADFILE_LONGTEXT, true )
+    add_bool( SOUT_CFG_PREFIX "httpd", false,
+              HTTPD_TEXT, HTTPD_LONGTEXT, false )
+    add_integer( SOUT_CFG_PREFIX "part-length", 0,
+                 PARTLEN_TEXT, PARTLEN_LONGTEXT, false )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -156,6 +178,8 @@ static const char *const ppsz_sout_options[] = {
     "key-loadfile",
     "generate-iv",
     "initial-segment-number",
+    "httpd",
+    "part-length",
     NULL
 };
 
@@ -163,6 +187,14 @@ static ssize_t Write( sout_access_out_t *, block_t * );
 static int Seek ( sout_access_out_t *, off_t  );
 static int Control( sout_access_out_t *, int, va_list );
 
+typedef struct output_part
+{
+    size_t i_offset;
+    size_t i_size;
+    mtime_t i_length;
+    bool b_independent;
+} output_part_t;
+
 typedef struct output_segment
 {
     char *psz_filename;
@@ -172,6 +204,17 @@ typedef struct output_segment
     float f_seglength;
     uint32_t i_segment_number;
     uint8_t aes_ivs[16];
+
+    /* Served from memory: the data and the parts are protected by the
+     * lock of the access, for the HTTP server threads */
+    sout_access_out_t *p_access;
+    httpd_url_t *p_url;
+    uint8_t *p_data;
+    size_t i_data;
+    size_t i_alloc;
+    output_part_t *p_parts;
+    unsigned i_parts;
+    bool b_complete;
 } output_segment_t;
 
 struct sout_access_out_sys_t
@@ -203,6 +246,22 @@ struct sout_access_out_sys_t
     uint8_t stuffing_bytes[16];
     ssize_t stuffing_size;
     vlc_array_t *segments_t;
+
+    /* Served from memory, instead of files */
+    httpd_host_t *p_host;
+    httpd_url_t *p_index_url;
+    uint32_t i_firstseg;        /* first segment of the index */
+    mtime_t i_partlen;
+    mtime_t i_part_opendts;
+    mtime_t i_part_lastdts;
+    bool b_part_independent;
+
+    /* protects the index and the segment data, read by the HTTP server */
+    vlc_mutex_t lock;
+    char *psz_index;
+    size_t i_index;
+    uint32_t i_index_segment;   /* last complete segment in the index */
+    unsigned i_index_parts;     /* parts of the next one in the index */
 };
 
 static int LoadCryptFile( sout_access_out_t *p_access);
@@ -210,6 +269,7 @@ static int CryptSetup( sout_access_out_t *p_access, char *keyfile );
 static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer );
 static ssize_t writeSegment( sout_access_out_t *p_access );
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static int StartServer( sout_access_out_t *p_access );
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -243,6 +303,8 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_caching = var_GetBool( p_access, SOUT_CFG_PREFIX "caching") ;
     p_sys->b_generate_iv = var_GetBool( p_access, SOUT_CFG_PREFIX "generate-iv") ;
     p_sys->b_segment_has_data = false;
+    p_sys->i_partlen = var_GetInteger( p_access, SOUT_CFG_PREFIX "part-length" ) * 1000;
+    bool b_httpd = var_GetBool( p_access, SOUT_CFG_PREFIX "httpd" );
 
     p_sys->segments_t = vlc_array_new();
 
@@ -259,12 +321,14 @@ static int Open( vlc_object_t *p_this )
         free( psz_idx );
         if ( !psz_tmp )
         {
+            vlc_array_destroy( p_sys->segments_t );
             free( p_sys );
             return VLC_ENOMEM;
         }
-        path_sanitize( psz_tmp );
+        if( !b_httpd )
+            path_sanitize( psz_tmp );
         p_sys->psz_indexPath = psz_tmp;
-        if( p_sys->i_initial_segment != 1 )
+        if( p_sys->i_initial_segment != 1 && !b_httpd )
             vlc_unlink( p_sys->psz_indexPath );
     }
 
@@ -278,6 +342,7 @@ static int Open( vlc_object_t *p_this )
     {
         free( p_sys->psz_indexUrl );
         free( p_sys->psz_indexPath );
+        vlc_array_destroy( p_sys->segments_t );
         free( p_sys );
         msg_Err( p_access, "Encryption init failed" );
         return VLC_EGENERIC;
@@ -286,13 +351,32 @@ static int Open( vlc_object_t *p_this )
     {
         free( p_sys->psz_indexUrl );
         free( p_sys->psz_indexPath );
+        vlc_array_destroy( p_sys->segments_t );
         free( p_sys );
         msg_Err( p_access, "Encryption init failed" );
         return VLC_EGENERIC;
     }
 
+    if( b_httpd && StartServer( p_access ) )
+    {
+        if( p_sys->key_uri )
+        {
+            gcry_cipher_close( p_sys->aes_ctx );
+            free( p_sys->key_uri );
+        }
+        free( p_sys->psz_keyfile );
+        free( p_sys->psz_indexUrl );
+        free( p_sys->psz_indexPath );
+        vlc_array_destroy( p_sys->segments_t );
+        free( p_sys );
+        msg_Err( p_access, "cannot start HTTP server" );
+        return VLC_EGENERIC;
+    }
+
     p_sys->i_handle = -1;
     p_sys->i_segment = p_sys->i_initial_segment-1;
+    p_sys->i_firstseg = p_sys->i_initial_segment;
+    p_sys->i_index_segment = p_sys->i_segment;
     p_sys->psz_cursegPath = NULL;
 
     p_access->pf_write = Write;
@@ -504,6 +588,10 @@ static char *formatSegmentPath( char *psz_path, uint32_t i_seg, bool b_sanitize
 
 static void destroySegment( output_segment_t *segment )
 {
+    if( segment->p_url )
+        httpd_UrlDelete( segment->p_url );
+    free( segment->p_data );
+    free( segment->p_parts );
     free( segment->psz_filename );
     free( segment->psz_duration );
     free( segment->psz_uri );
@@ -553,136 +641,265 @@ static bool isFirstItemRemovable( sout_access_out_sys_t *p_sys, uint32_t i_first
     return duration >= (first->f_seglength + (float)(p_sys->i_numsegs * p_sys->i_seglen));
 }
 
+/* Durations in seconds, whatever the locale */
+#define DURATION_FMT "%"PRId64".%03"PRId64
+#define DURATION_ARGS(d) (d) / CLOCK_FREQ, (d) % CLOCK_FREQ / 1000
+
 /************************************************************************
- * updateIndexAndDel: If necessary, update index file & delete old segments
+ * lastCompleteSegment: number of the last segment that can be listed
  ************************************************************************/
-static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+static uint32_t lastCompleteSegment( sout_access_out_sys_t *p_sys )
 {
+    return p_sys->i_handle >= 0 ? p_sys->i_segment - 1 : p_sys->i_segment;
+}
 
-    uint32_t i_firstseg;
-    unsigned i_index_offset = 0;
-
-    if ( p_sys->i_numsegs == 0 ||
-         p_sys->i_segment < ( p_sys->i_numsegs + p_sys->i_initial_segment ) )
+static int writeParts( FILE *fp, const output_segment_t *segment )
+{
+    for( unsigned i = 0; i < segment->i_parts; i++ )
     {
-        i_firstseg = p_sys->i_initial_segment;
+        const output_part_t *part = &segment->p_parts[i];
+
+        if( fprintf( fp, "#EXT-X-PART:DURATION="DURATION_FMT",URI=\"%s?part=%u\"%s\n",
+                     DURATION_ARGS(part->i_length), segment->psz_uri, i,
+                     part->b_independent ? ",INDEPENDENT=YES" : "" ) < 0 )
+            return -1;
     }
-    else
+    return 0;
+}
+
+/************************************************************************
+ * writeIndex: print the index, from segment p_sys->i_firstseg on
+ ************************************************************************/
+static int writeIndex( sout_access_out_sys_t *p_sys, FILE *fp, bool b_isend )
+{
+    uint32_t i_firstseg = p_sys->i_firstseg;
+    uint32_t i_lastseg = lastCompleteSegment( p_sys );
+    int i_count = vlc_array_count( p_sys->segments_t );
+    uint32_t i_base = i_firstseg;
+    output_segment_t *current = NULL;
+
+    if( i_count > 0 )
     {
-        unsigned numsegs = segmentAmountNeeded( p_sys );
-        i_firstseg = ( p_sys->i_segment - numsegs ) + 1;
-        i_index_offset = vlc_array_count( p_sys->segments_t ) - numsegs;
+        output_segment_t *first = vlc_array_item_at_index( p_sys->segments_t, 0 );
+        i_base = first->i_segment_number;
+        /* the segment being written is only listed by its parts */
+        if( p_sys->i_handle >= 0 )
+            current = vlc_array_item_at_index( p_sys->segments_t, i_count - 1 );
     }
 
-    // First update index
-    if ( p_sys->psz_indexPath )
-    {
-        int val;
-        FILE *fp;
-        char *psz_idxTmp;
-        if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
-            return -1;
+    /* The low latency tags (server control, parts and preload hints) need
+     * protocol version 9, which no longer has EXT-X-ALLOW-CACHE. */
+    const bool b_lowlatency = p_sys->p_host != NULL;
+
+    if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:%d%s%s"
+                      "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_seglen,
+                      b_lowlatency ? 9 : 3,
+                      b_lowlatency ? "" : "\n#EXT-X-ALLOW-CACHE:",
+                      b_lowlatency ? "" : p_sys->b_caching ? "YES" : "NO",
+                      p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
+                      i_firstseg, ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : ""
+                      ) < 0 )
+        return -1;
 
-        fp = vlc_fopen( psz_idxTmp, "wt");
-        if ( !fp )
+    if( b_lowlatency )
+    {
+        if( p_sys->i_partlen > 0 )
         {
-            msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
-            free( psz_idxTmp );
-            return -1;
+            if( fprintf( fp, "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,"
+                             "PART-HOLD-BACK="DURATION_FMT"\n"
+                             "#EXT-X-PART-INF:PART-TARGET="DURATION_FMT"\n",
+                         DURATION_ARGS(3 * p_sys->i_partlen),
+                         DURATION_ARGS(p_sys->i_partlen) ) < 0 )
+                return -1;
         }
-
-        if ( fprintf( fp, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n#EXT-X-VERSION:3\n#EXT-X-ALLOW-CACHE:%s"
-                          "%s\n#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n%s", p_sys->i_seglen,
-                          p_sys->b_caching ? "YES" : "NO",
-                          p_sys->i_numsegs > 0 ? "" : b_isend ? "\n#EXT-X-PLAYLIST-TYPE:VOD" : "\n#EXT-X-PLAYLIST-TYPE:EVENT",
-                          i_firstseg, ((p_sys->i_initial_segment > 1) && (p_sys->i_initial_segment == i_firstseg)) ? "#EXT-X-DISCONTINUITY\n" : ""
-                          ) < 0 )
-        {
-            free( psz_idxTmp );
-            fclose( fp );
+        else if( fputs( "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES\n", fp ) < 0 )
             return -1;
-        }
-        char *psz_current_uri=NULL;
+    }
 
+    char *psz_current_uri=NULL;
 
-        for ( uint32_t i = i_firstseg; i <= p_sys->i_segment; i++ )
+    for ( uint32_t i = i_firstseg; i <= i_lastseg; i++ )
+    {
+        output_segment_t *segment = (output_segment_t *)vlc_array_item_at_index( p_sys->segments_t, i - i_base );
+        if( p_sys->key_uri &&
+            ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
+          )
         {
-            //scale to i_index_offset..numsegs + i_index_offset
-            uint32_t index = i - i_firstseg + i_index_offset;
-
-            output_segment_t *segment = (output_segment_t *)vlc_array_item_at_index( p_sys->segments_t, index );
-            if( p_sys->key_uri &&
-                ( !psz_current_uri ||  strcmp( psz_current_uri, segment->psz_key_uri ) )
-              )
+            int ret = 0;
+            free( psz_current_uri );
+            psz_current_uri = strdup( segment->psz_key_uri );
+            if( p_sys->b_generate_iv )
             {
-                int ret = 0;
-                free( psz_current_uri );
-                psz_current_uri = strdup( segment->psz_key_uri );
-                if( p_sys->b_generate_iv )
+                unsigned long long iv_hi = segment->aes_ivs[0];
+                unsigned long long iv_lo = segment->aes_ivs[8];
+                for( unsigned short i = 1; i < 8; i++ )
                 {
-                    unsigned long long iv_hi = segment->aes_ivs[0];
-                    unsigned long long iv_lo = segment->aes_ivs[8];
-                    for( unsigned short i = 1; i < 8; i++ )
-                    {
-                        iv_hi <<= 8;
-                        iv_hi |= segment->aes_ivs[i] & 0xff;
-                        iv_lo <<= 8;
-                        iv_lo |= segment->aes_ivs[8+i] & 0xff;
-                    }
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
-                                   segment->psz_key_uri, iv_hi, iv_lo );
-
-                } else {
-                    ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
+                    iv_hi <<= 8;
+                    iv_hi |= segment->aes_ivs[i] & 0xff;
+                    iv_lo <<= 8;
+                    iv_lo |= segment->aes_ivs[8+i] & 0xff;
                 }
-                if( ret < 0 )
-                {
-                    free( psz_current_uri );
-                    free( psz_idxTmp );
-                    fclose( fp );
-                    return -1;
-                }
-            }
+                ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\",IV=0X%16.16llx%16.16llx\n",
+                               segment->psz_key_uri, iv_hi, iv_lo );
 
-            val = fprintf( fp, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri);
-            if ( val < 0 )
+            } else {
+                ret = fprintf( fp, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"\n", segment->psz_key_uri );
+            }
+            if( ret < 0 )
             {
                 free( psz_current_uri );
-                free( psz_idxTmp );
-                fclose( fp );
                 return -1;
             }
         }
-        free( psz_current_uri );
 
-        if ( b_isend )
+        /* The parts of the last segments, for players close to live */
+        if( ( i + 2 > i_lastseg && writeParts( fp, segment ) < 0 ) ||
+            fprintf( fp, "#EXTINF:%s,\n%s\n", segment->psz_duration, segment->psz_uri) < 0 )
         {
-            if ( fputs ( STR_ENDLIST, fp ) < 0)
-            {
-                free( psz_idxTmp );
-                fclose( fp ) ;
-                return -1;
-            }
+            free( psz_current_uri );
+            return -1;
+        }
+    }
+    free( psz_current_uri );
+
+    if( current != NULL && p_sys->i_partlen > 0 && !b_isend )
+    {
+        if( writeParts( fp, current ) < 0 ||
+            fprintf( fp, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s?part=%u\"\n",
+                     current->psz_uri, current->i_parts ) < 0 )
+            return -1;
+    }
 
+    if ( b_isend && fputs ( STR_ENDLIST, fp ) < 0 )
+        return -1;
+    return 0;
+}
+
+/************************************************************************
+ * publishIndex: write the index file, or swap the index served
+ ************************************************************************/
+static int publishIndex( sout_access_out_t *p_access, bool b_isend )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    int val;
+
+    if( p_sys->p_host != NULL )
+    {
+        char *psz_index;
+        size_t i_index;
+#ifdef HAVE_OPEN_MEMSTREAM
+        FILE *fp = open_memstream( &psz_index, &i_index );
+#else
+        FILE *fp = tmpfile();
+#endif
+        if( fp == NULL )
+            return -1;
+
+        val = writeIndex( p_sys, fp, b_isend );
+#ifdef HAVE_OPEN_MEMSTREAM
+        if( fclose( fp ) )
+            return -1;
+#else
+        long i_len = ftell( fp );
+        psz_index = NULL;
+        i_index = 0;
+        if( val == 0 && i_len >= 0 && ( psz_index = malloc( i_len + 1 ) ) )
+        {
+            rewind( fp );
+            i_index = fread( psz_index, 1, i_len, fp );
         }
         fclose( fp );
+        if( psz_index == NULL )
+            return -1;
+#endif
+        if( val < 0 )
+        {
+            free( psz_index );
+            return -1;
+        }
 
-        val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
-
-        if ( val < 0 )
+        vlc_mutex_lock( &p_sys->lock );
+        char *psz_old = p_sys->psz_index;
+        p_sys->psz_index = psz_index;
+        p_sys->i_index = i_index;
+        p_sys->i_index_segment = lastCompleteSegment( p_sys );
+        p_sys->i_index_parts = 0;
+        if( p_sys->i_handle >= 0 && vlc_array_count( p_sys->segments_t ) > 0 )
         {
-            vlc_unlink( psz_idxTmp );
-            msg_Err( p_access, "Error moving LiveHttp index file" );
+            output_segment_t *current = vlc_array_item_at_index( p_sys->segments_t,
+                                            vlc_array_count( p_sys->segments_t ) - 1 );
+            p_sys->i_index_parts = current->i_parts;
         }
-        else
-            msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+        vlc_mutex_unlock( &p_sys->lock );
+        free( psz_old );
+        return 0;
+    }
+
+    FILE *fp;
+    char *psz_idxTmp;
+    if ( asprintf( &psz_idxTmp, "%s.tmp", p_sys->psz_indexPath ) < 0)
+        return -1;
+
+    fp = vlc_fopen( psz_idxTmp, "wt");
+    if ( !fp )
+    {
+        msg_Err( p_access, "cannot open index file `%s'", psz_idxTmp );
+        free( psz_idxTmp );
+        return -1;
+    }
 
+    if( writeIndex( p_sys, fp, b_isend ) < 0 )
+    {
         free( psz_idxTmp );
+        fclose( fp );
+        return -1;
     }
+    fclose( fp );
+
+    val = vlc_rename ( psz_idxTmp, p_sys->psz_indexPath);
+
+    if ( val < 0 )
+    {
+        vlc_unlink( psz_idxTmp );
+        msg_Err( p_access, "Error moving LiveHttp index file" );
+    }
+    else
+        msg_Dbg( p_access, "LiveHttpIndexComplete: %s" , p_sys->psz_indexPath );
+
+    free( psz_idxTmp );
+    return 0;
+}
+
+/************************************************************************
+ * updateIndexAndDel: If necessary, update index file & delete old segments
+ ************************************************************************/
+static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
+{
+
+    uint32_t i_firstseg;
+    unsigned i_index_offset = 0;
+
+    if ( p_sys->i_numsegs == 0 ||
+         p_sys->i_segment < ( p_sys->i_numsegs + p_sys->i_initial_segment ) )
+    {
+        i_firstseg = p_sys->i_initial_segment;
+    }
+    else
+    {
+        unsigned numsegs = segmentAmountNeeded( p_sys );
+        i_firstseg = ( p_sys->i_segment - numsegs ) + 1;
+        i_index_offset = vlc_array_count( p_sys->segments_t ) - numsegs;
+    }
+    p_sys->i_firstseg = i_firstseg;
+
+    // First update index
+    if ( p_sys->psz_indexPath && publishIndex( p_access, b_isend ) < 0 )
+        return -1;
 
     // Then take care of deletion
     // Try to follow pantos draft 11 section 6.2.2
-    while( p_sys->b_delsegs && p_sys->i_numsegs &&
+    // Segments in memory have nowhere else to go
+    while( ( p_sys->b_delsegs || p_sys->p_host ) && p_sys->i_numsegs &&
            isFirstItemRemovable( p_sys, i_firstseg, i_index_offset )
          )
     {
@@ -690,7 +907,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
          msg_Dbg( p_access, "Removing segment number %d", segment->i_segment_number );
          vlc_array_remove( p_sys->segments_t, 0 );
 
-         if ( segment->psz_filename )
+         if ( segment->psz_filename && !p_sys->p_host )
          {
              vlc_unlink( segment->psz_filename );
          }
@@ -703,6 +920,313 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
     return 0;
 }
 
+/*****************************************************************************
+ * Serving from memory: the HTTP server threads read the index and the
+ * segments under the lock. A request for what is not there yet blocks,
+ * for low-latency players to get it as soon as it is written.
+ *****************************************************************************/
+static int64_t GetArg( const uint8_t *psz_args, const char *psz_name )
+{
+    const char *p = (const char *)psz_args;
+    size_t i_len = strlen( psz_name );
+
+    while( p != NULL )
+    {
+        if( !strncmp( p, psz_name, i_len ) && p[i_len] == '=' )
+            return strtoll( &p[i_len + 1], NULL, 10 );
+        p = strchr( p, '&' );
+        if( p != NULL )
+            p++;
+    }
+    return -1;
+}
+
+/* Returns true once the deadline of a blocking request, kept in the
+ * answer, has passed */
+static bool BlockExpired( sout_access_out_sys_t *p_sys,
+                          httpd_message_t *answer )
+{
+    mtime_t now = mdate();
+
+    if( answer->i_body_offset == 0 )
+        answer->i_body_offset = now + __MIN( 3 * p_sys->i_seglenm,
+                                             BLOCK_TIMEOUT_MAX );
+    return now >= answer->i_body_offset;
+}
+
+static void Answer( httpd_message_t *answer, const httpd_message_t *query,
+                    int i_status, const char *psz_mime,
+                    const uint8_t *p_data, size_t i_data )
+{
+    answer->i_proto  = HTTPD_PROTO_HTTP;
+    answer->i_version= 1;
+    answer->i_type   = HTTPD_MSG_ANSWER;
+    answer->i_status = i_status;
+    answer->i_body_offset = 0;
+
+    if( i_status == 200 )
+    {
+        if( query->i_type != HTTPD_MSG_HEAD && i_data > 0 )
+        {
+            answer->p_body = malloc( i_data );
+            if( likely(answer->p_body != NULL) )
+            {
+                memcpy( answer->p_body, p_data, i_data );
+                answer->i_body = i_data;
+            }
+            else
+                answer->i_status = 500;
+        }
+        httpd_MsgAdd( answer, "Content-Type", "%s", psz_mime );
+    }
+    httpd_MsgAdd( answer, "Cache-Control", "no-cache" );
+    httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
+}
+
+static int IndexCallback( httpd_callback_sys_t *p_cbsys, httpd_client_t *cl,
+                          httpd_message_t *answer,
+                          const httpd_message_t *query )
+{
+    sout_access_out_t *p_access = (sout_access_out_t *)p_cbsys;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    (void) cl;
+
+    if( !answer || !query )
+        return VLC_SUCCESS;
+
+    /* Blocking reload, until the index has the given segment or part */
+    int64_t i_msn = GetArg( query->psz_args, "_HLS_msn" );
+    int64_t i_part = GetArg( query->psz_args, "_HLS_part" );
+    int i_status = 200;
+
+    vlc_mutex_lock( &p_sys->lock );
+    int64_t i_last = p_sys->i_index_segment;
+
+    if( p_sys->psz_index == NULL )
+        i_status = 404;
+    else if( i_msn > i_last + 2 )
+        i_status = 400;
+    else if( i_msn > i_last && !( i_msn == i_last + 1 && i_part >= 0 &&
+                                  i_part < p_sys->i_index_parts ) )
+    {
+        if( !BlockExpired( p_sys, answer ) )
+        {
+            vlc_mutex_unlock( &p_sys->lock );
+            return VLC_SUCCESS; /* not yet */
+        }
+        i_status = 503;
+    }
+    Answer( answer, query, i_status, "application/vnd.apple.mpegurl",
+            (const uint8_t *)p_sys->psz_index, p_sys->i_index );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    return VLC_SUCCESS;
+}
+
+static int SegmentCallback( httpd_callback_sys_t *p_cbsys, httpd_client_t *cl,
+                            httpd_message_t *answer,
+                            const httpd_message_t *query )
+{
+    output_segment_t *segment = (output_segment_t *)p_cbsys;
+    sout_access_out_sys_t *p_sys = segment->p_access->p_sys;
+    (void) cl;
+
+    if( !answer || !query )
+        return VLC_SUCCESS;
+
+    int64_t i_part = GetArg( query->psz_args, "part" );
+    const uint8_t *p_data = NULL;
+    size_t i_data = 0;
+    int i_status = 200;
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( i_part < 0 && segment->b_complete )
+    {
+        p_data = segment->p_data;
+        i_data = segment->i_data;
+    }
+    else if( i_part >= 0 && i_part < segment->i_parts )
+    {
+        p_data = segment->p_data + segment->p_parts[i_part].i_offset;
+        i_data = segment->p_parts[i_part].i_size;
+    }
+    else if( segment->b_complete )
+        i_status = 404;
+    else if( !BlockExpired( p_sys, answer ) )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        return VLC_SUCCESS; /* not yet */
+    }
+    else
+        i_status = 503;
+
+    Answer( answer, query, i_status, "video/MP2T", p_data, i_data );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    return VLC_SUCCESS;
+}
+
+static int StartServer( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->i_numsegs == 0 )
+    {
+        msg_Dbg( p_access, "keeping %d segments in memory", DEFAULT_MEMORY_SEGS );
+        p_sys->i_numsegs = DEFAULT_MEMORY_SEGS;
+    }
+    if( p_sys->i_partlen > 0 && ( p_sys->key_uri || p_sys->psz_keyfile ) )
+    {
+        msg_Warn( p_access, "encrypted segments cannot be split in parts" );
+        p_sys->i_partlen = 0;
+    }
+
+    p_sys->p_host = vlc_http_HostNew( VLC_OBJECT(p_access) );
+    if( p_sys->p_host == NULL )
+        return VLC_EGENERIC;
+
+    vlc_mutex_init( &p_sys->lock );
+    if( p_sys->psz_indexPath )
+    {
+        p_sys->p_index_url = httpd_UrlNew( p_sys->p_host, p_sys->psz_indexPath,
+                                           NULL, NULL );
+        if( p_sys->p_index_url == NULL )
+        {
+            vlc_mutex_destroy( &p_sys->lock );
+            httpd_HostDelete( p_sys->p_host );
+            return VLC_EGENERIC;
+        }
+        httpd_UrlCatch( p_sys->p_index_url, HTTPD_MSG_GET, IndexCallback,
+                        (httpd_callback_sys_t *)p_access );
+        httpd_UrlCatch( p_sys->p_index_url, HTTPD_MSG_HEAD, IndexCallback,
+                        (httpd_callback_sys_t *)p_access );
+    }
+    msg_Dbg( p_access, "serving segments from memory, parts of %"PRId64" ms",
+             p_sys->i_partlen / 1000 );
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * segmentWrite: write to the segment file, or to its memory
+ *****************************************************************************/
+static ssize_t segmentWrite( sout_access_out_t *p_access,
+                             const uint8_t *p_data, size_t i_len )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->p_host == NULL )
+        return write( p_sys->i_handle, p_data, i_len );
+
+    output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t,
+                                    vlc_array_count( p_sys->segments_t ) - 1 );
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( segment->i_data + i_len > segment->i_alloc )
+    {
+        size_t i_alloc = __MAX( 2 * segment->i_alloc, segment->i_data + i_len );
+        uint8_t *p = realloc( segment->p_data, i_alloc );
+
+        if( unlikely(p == NULL) )
+        {
+            vlc_mutex_unlock( &p_sys->lock );
+            errno = ENOMEM;
+            return -1;
+        }
+        segment->p_data = p;
+        segment->i_alloc = i_alloc;
+    }
+    memcpy( segment->p_data + segment->i_data, p_data, i_len );
+    segment->i_data += i_len;
+    vlc_mutex_unlock( &p_sys->lock );
+
+    return i_len;
+}
+
+static size_t partsEnd( const output_segment_t *segment )
+{
+    if( segment->i_parts == 0 )
+        return 0;
+
+    const output_part_t *last = &segment->p_parts[segment->i_parts - 1];
+    return last->i_offset + last->i_size;
+}
+
+/* Lists the data written since the last part as a new part */
+static int appendPart( sout_access_out_t *p_access, output_segment_t *segment,
+                       mtime_t i_length )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    size_t i_offset = partsEnd( segment );
+
+    if( segment->i_data == i_offset )
+        return VLC_SUCCESS;
+
+    vlc_mutex_lock( &p_sys->lock );
+    output_part_t *p_parts = realloc( segment->p_parts,
+                                      ( segment->i_parts + 1 ) * sizeof( *p_parts ) );
+    if( unlikely(p_parts == NULL) )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        return VLC_ENOMEM;
+    }
+    p_parts[segment->i_parts++] = (output_part_t) {
+        .i_offset = i_offset,
+        .i_size = segment->i_data - i_offset,
+        .i_length = __MAX( i_length, 0 ),
+        .b_independent = p_sys->b_part_independent,
+    };
+    segment->p_parts = p_parts;
+    vlc_mutex_unlock( &p_sys->lock );
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * CheckPartChange: Close the current part if the next block would make it
+ * longer than the part length
+ *****************************************************************************/
+static void CheckPartChange( sout_access_out_t *p_access, const block_t *p_next )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t,
+                                    vlc_array_count( p_sys->segments_t ) - 1 );
+    const mtime_t i_dts = p_next->i_dts;
+
+    if( segment->i_data > partsEnd( segment ) &&
+        i_dts - p_sys->i_part_opendts + ( i_dts - p_sys->i_part_lastdts )
+            > p_sys->i_partlen &&
+        appendPart( p_access, segment, i_dts - p_sys->i_part_opendts ) == VLC_SUCCESS &&
+        p_sys->psz_indexPath )
+        publishIndex( p_access, false );
+
+    if( segment->i_data == partsEnd( segment ) )
+    {
+        p_sys->i_part_opendts = i_dts;
+        p_sys->b_part_independent = ( p_next->i_flags & BLOCK_FLAG_HEADER ) != 0;
+    }
+    p_sys->i_part_lastdts = i_dts;
+}
+
+/* The segment is complete, with its last part */
+static void completeSegment( sout_access_out_t *p_access,
+                             output_segment_t *segment )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( p_sys->i_partlen > 0 )
+    {
+        mtime_t i_length = p_sys->f_seglen * CLOCK_FREQ;
+
+        for( unsigned i = 0; i < segment->i_parts; i++ )
+            i_length -= segment->p_parts[i].i_length;
+        appendPart( p_access, segment, i_length );
+    }
+
+    vlc_mutex_lock( &p_sys->lock );
+    segment->b_complete = true;
+    vlc_mutex_unlock( &p_sys->lock );
+}
+
 /*****************************************************************************
  * closeCurrentSegment: Close the segment file
  *****************************************************************************/
@@ -721,7 +1245,7 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
             if( err ) {
                msg_Err( p_access, "Couldn't encrypt 16 bytes: %s", gpg_strerror(err) );
             } else {
-            int ret = write( p_sys->i_handle, p_sys->stuffing_bytes, 16 );
+            int ret = segmentWrite( p_access, p_sys->stuffing_bytes, 16 );
             if( ret != 16 )
                 msg_Err( p_access, "Couldn't write 16 bytes" );
             }
@@ -729,7 +1253,8 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
         }
 
 
-        close( p_sys->i_handle );
+        if( p_sys->p_host == NULL )
+            close( p_sys->i_handle );
         p_sys->i_handle = -1;
 
         if( ! ( us_asprintf( &segment->psz_duration, "%.2f", p_sys->f_seglen ) ) )
@@ -741,6 +1266,9 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
 
         segment->i_segment_number = p_sys->i_segment;
 
+        if( p_sys->p_host != NULL )
+            completeSegment( p_access, segment );
+
         if ( p_sys->psz_cursegPath )
         {
             msg_Dbg( p_access, "LiveHttpSegmentComplete: %s (%"PRIu32")" , p_sys->psz_cursegPath, p_sys->i_segment );
@@ -808,7 +1336,8 @@ static void Close( vlc_object_t * p_this )
     {
         output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, 0 );
         vlc_array_remove( p_sys->segments_t, 0 );
-        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename )
+        if( p_sys->b_delsegs && p_sys->i_numsegs && segment->psz_filename &&
+            !p_sys->p_host )
         {
             msg_Dbg( p_access, "Removing segment number %d name %s", segment->i_segment_number, segment->psz_filename );
             vlc_unlink( segment->psz_filename );
@@ -818,6 +1347,15 @@ static void Close( vlc_object_t * p_this )
     }
     vlc_array_destroy( p_sys->segments_t );
 
+    if( p_sys->p_host != NULL )
+    {
+        if( p_sys->p_index_url != NULL )
+            httpd_UrlDelete( p_sys->p_index_url );
+        httpd_HostDelete( p_sys->p_host );
+        vlc_mutex_destroy( &p_sys->lock );
+        free( p_sys->psz_index );
+    }
+
     free( p_sys->psz_indexUrl );
     free( p_sys->psz_indexPath );
     free( p_sys );
@@ -860,7 +1398,8 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
 
     segment->i_segment_number = i_newseg;
-    segment->psz_filename = formatSegmentPath( p_access->psz_path, i_newseg, true );
+    segment->psz_filename = formatSegmentPath( p_access->psz_path, i_newseg,
+                                               p_sys->p_host == NULL );
     char *psz_idxFormat = p_sys->psz_indexUrl ? p_sys->psz_indexUrl : p_access->psz_path;
     segment->psz_uri = formatSegmentPath( psz_idxFormat , i_newseg, false );
 
@@ -871,14 +1410,36 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
     }
 
-    fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
-                     O_TRUNC, 0666 );
-    if ( fd == -1 )
+    if( p_sys->p_host != NULL )
     {
-        msg_Err( p_access, "cannot open `%s' (%s)", segment->psz_filename,
-                 vlc_strerror_c(errno) );
-        destroySegment( segment );
-        return -1;
+        segment->p_access = p_access;
+        segment->p_url = httpd_UrlNew( p_sys->p_host, segment->psz_filename,
+                                       NULL, NULL );
+        if( segment->p_url == NULL )
+        {
+            msg_Err( p_access, "cannot serve `%s'", segment->psz_filename );
+            destroySegment( segment );
+            return -1;
+        }
+        httpd_UrlCatch( segment->p_url, HTTPD_MSG_GET, SegmentCallback,
+                        (httpd_callback_sys_t *)segment );
+        httpd_UrlCatch( segment->p_url, HTTPD_MSG_HEAD, SegmentCallback,
+                        (httpd_callback_sys_t *)segment );
+        fd = 0; /* no file, but the segment is open */
+        p_sys->i_part_opendts = p_sys->i_part_lastdts = p_sys->i_opendts;
+        p_sys->b_part_independent = false;
+    }
+    else
+    {
+        fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
+                         O_TRUNC, 0666 );
+        if ( fd == -1 )
+        {
+            msg_Err( p_access, "cannot open `%s' (%s)", segment->psz_filename,
+                     vlc_strerror_c(errno) );
+            destroySegment( segment );
+            return -1;
+        }
     }
 
     vlc_array_append( p_sys->segments_t, segment);
@@ -923,7 +1484,7 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
         msg_Dbg( p_access, "dts offset %"PRId64, p_sys->i_dts_offset );
     }
 
-    if( p_sys->i_handle > 0 && p_sys->b_segment_has_data &&
+    if( p_sys->i_handle >= 0 && p_sys->b_segment_has_data &&
        (( p_buffer->i_length + p_buffer->i_dts - p_sys->i_opendts +
           p_sys->i_dts_offset ) >= p_sys->i_seglenm ) )
     {
@@ -984,7 +1545,7 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
             crypted=true;
 
         }
-        ssize_t val = write( p_sys->i_handle, output->p_buffer, output->i_buffer );
+        ssize_t val = segmentWrite( p_access, output->p_buffer, output->i_buffer );
         if ( val == -1 )
         {
            if ( errno == EINTR )
@@ -1043,8 +1604,23 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 
         p_temp = p_buffer->p_next;
         p_buffer->p_next = NULL;
+        if( p_sys->p_host && p_sys->i_handle >= 0 && p_sys->i_partlen > 0 )
+            CheckPartChange( p_access, p_buffer );
         block_ChainAppend( &p_sys->block_buffer, p_buffer );
         p_buffer = p_temp;
+
+        /* From memory, the data is served as soon as it is written,
+         * not at the next header */
+        if( p_sys->p_host && p_sys->i_handle >= 0 )
+        {
+            ssize_t writevalue = writeSegment( p_access );
+            if( unlikely( writevalue < 0 ) )
+            {
+                block_ChainRelease ( p_buffer );
+                return -1;
+            }
+            i_write += writevalue;
+        }
     }
 
     return i_write;
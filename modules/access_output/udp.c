@@ -50,6 +50,15 @@
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
+#define BATCH_MAX 64
+/* Packets due within that delay are sent together */
+#define BATCH_WINDOW 1000
+/* Packets sent later than that are counted as late */
+#define LATE_DELAY 20000
+/* Packets due that much after the previous one follow a timestamp hole */
+#define HOLE_DELAY 2000000
+/* Interval between statistics reports */
+#define STATS_PERIOD (10 * CLOCK_FREQ)
 
 /*****************************************************************************
  * Module descriptor
@@ -70,6 +79,12 @@ static void Close( vlc_object_t * );
                           "of packets that will be sent at a time. It " \
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
+#define BATCH_TEXT N_("Batch size")
+#define BATCH_LONGTEXT N_( \
+    "Maximum number of packets sent per system call. Packets that are " \
+    "due within the same millisecond are sent together, within the " \
+    "limits of a token bucket running at the stream bitrate. " \
+    "Use 1 to send packets one by one." )
 
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
@@ -79,6 +94,11 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+#ifdef HAVE_SENDMMSG
+    add_integer( SOUT_CFG_PREFIX "batch", 1, BATCH_TEXT, BATCH_LONGTEXT,
+                 true )
+        change_integer_range( 1, BATCH_MAX )
+#endif
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +112,9 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+#ifdef HAVE_SENDMMSG
+    "batch",
+#endif
     NULL
 };
 
@@ -108,6 +131,9 @@ static int  Seek    ( sout_access_out_t *, off_t  );
 static int Control( sout_access_out_t *, int, va_list );
 
 static void* ThreadWrite( void * );
+#ifdef HAVE_SENDMMSG
+static void* ThreadWriteBatch( void * );
+#endif
 static block_t *NewUDPPacket( sout_access_out_t *, mtime_t );
 
 struct sout_access_out_sys_t
@@ -214,7 +240,13 @@ static int Open( vlc_object_t *p_this )
     p_sys->p_empty_blocks = block_FifoNew();
     p_sys->p_buffer = NULL;
 
-    if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
+    void *(*entry)( void * ) = ThreadWrite;
+#ifdef HAVE_SENDMMSG
+    if( var_GetInteger( p_access, SOUT_CFG_PREFIX "batch" ) > 1 )
+        entry = ThreadWriteBatch;
+#endif
+
+    if( vlc_clone( &p_sys->thread, entry, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
     {
         msg_Err( p_access, "cannot spawn sout access thread" );
@@ -413,7 +445,7 @@ static void* ThreadWrite( void *data )
         i_date = p_sys->i_caching + p_pk->i_dts;
         if( i_date_last > 0 )
         {
-            if( i_date - i_date_last > 2000000 )
+            if( i_date - i_date_last > HOLE_DELAY )
             {
                 if( !i_dropped_packets )
                     msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
@@ -465,3 +497,269 @@ static void* ThreadWrite( void *data )
     }
     return NULL;
 }
+
+#ifdef HAVE_SENDMMSG
+/*****************************************************************************
+ * Batched output with pacing
+ *****************************************************************************
+ * Packets are scheduled at their due date (DTS plus caching), like in
+ * ThreadWrite(). Instead of waking up for every packet, the thread sends all
+ * packets due within BATCH_WINDOW with a single sendmmsg() call. To keep the
+ * spacing smooth, a token bucket filled at the (estimated) stream bitrate
+ * limits how much data can be sent ahead of time in one burst.
+ *****************************************************************************/
+struct udp_pacer
+{
+    block_t *pkts[BATCH_MAX];
+    struct mmsghdr msgs[BATCH_MAX];
+    struct iovec iov[BATCH_MAX];
+    block_t *p_next;  /**< First packet of the next batch */
+    mtime_t i_next_date; /**< Due date of p_next */
+    unsigned i_batch;
+
+    /* Timestamp discontinuities */
+    mtime_t i_date_last; /**< Due date of the previous packet, or -1 */
+    mtime_t i_offset;    /**< Shift of the due dates since the first hole */
+    unsigned i_dropped;
+
+    /* Token bucket (bytes) */
+    int64_t i_tokens;
+    int64_t i_burst;
+    mtime_t i_refill;
+    /* Stream bitrate estimation (bytes per second) */
+    int64_t i_rate;
+    mtime_t i_rate_date;
+    int64_t i_rate_bytes;
+
+    /* Statistics */
+    uint64_t i_sent;
+    uint64_t i_late;
+    uint64_t i_calls;
+    size_t   i_max_depth;
+    mtime_t  i_report;
+};
+
+static void PacerCleanup( void *data )
+{
+    struct udp_pacer *pacer = data;
+
+    if( pacer->p_next != NULL )
+        block_Release( pacer->p_next );
+    free( pacer );
+}
+
+/** Updates the bitrate estimate with a packet due at a given date. */
+static void PacerEstimate( struct udp_pacer *pacer, const block_t *p_pk,
+                           mtime_t i_date )
+{
+    pacer->i_rate_bytes += p_pk->i_buffer;
+    if( pacer->i_rate_date <= 0 || i_date < pacer->i_rate_date )
+    {
+        pacer->i_rate_date = i_date;
+        pacer->i_rate_bytes = 0;
+        return;
+    }
+
+    mtime_t i_span = i_date - pacer->i_rate_date;
+    if( i_span >= CLOCK_FREQ / 10 )
+    {
+        int64_t i_rate = pacer->i_rate_bytes * CLOCK_FREQ / i_span;
+
+        /* Exponential moving average */
+        pacer->i_rate = pacer->i_rate ? (7 * pacer->i_rate + i_rate) / 8
+                                      : i_rate;
+        pacer->i_rate_date = i_date;
+        pacer->i_rate_bytes = 0;
+    }
+}
+
+/**
+ * Computes the due date of a packet into pacer->i_next_date.
+ *
+ * Timestamp holes are detected like in ThreadWrite(): the first packet
+ * more than HOLE_DELAY after the previous one is dropped, and packets in
+ * the past are reported. In addition, the due dates after a hole (forward,
+ * or backward by more than HOLE_DELAY) are shifted to follow the previous
+ * packet, so that the output neither stalls until a far future date nor
+ * bursts every packet dated in the past.
+ *
+ * @return false if the packet was dropped
+ */
+static bool PacerSchedule( sout_access_out_t *p_access,
+                           struct udp_pacer *pacer, block_t *p_pk )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    mtime_t i_date = p_sys->i_caching + p_pk->i_dts + pacer->i_offset;
+
+    if( pacer->i_date_last > 0 )
+    {
+        mtime_t i_diff = i_date - pacer->i_date_last;
+
+        if( i_diff > HOLE_DELAY )
+        {
+            if( !pacer->i_dropped )
+                msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
+                         i_diff );
+
+            block_FifoPut( p_sys->p_empty_blocks, p_pk );
+            pacer->i_offset -= i_diff;
+            pacer->i_dropped++;
+            return false;
+        }
+        else if( i_diff < -1000 )
+        {
+            if( !pacer->i_dropped )
+                msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
+                         -i_diff );
+            if( i_diff < -HOLE_DELAY )
+            {
+                pacer->i_offset -= i_diff;
+                i_date = pacer->i_date_last;
+            }
+        }
+    }
+
+    if( pacer->i_dropped )
+    {
+        msg_Dbg( p_access, "dropped %u packets", pacer->i_dropped );
+        pacer->i_dropped = 0;
+    }
+
+    pacer->p_next = p_pk;
+    pacer->i_next_date = i_date;
+    pacer->i_date_last = i_date;
+    return true;
+}
+
+/** Refills the token bucket. */
+static void PacerRefill( struct udp_pacer *pacer, mtime_t now )
+{
+    if( pacer->i_rate == 0 )
+        pacer->i_tokens = pacer->i_burst; /* no estimate yet: no limit */
+    else if( now > pacer->i_refill )
+    {   /* Allow some headroom to catch up after a late wake-up */
+        pacer->i_tokens += (pacer->i_rate + pacer->i_rate / 4)
+                         * (now - pacer->i_refill) / CLOCK_FREQ;
+        if( pacer->i_tokens > pacer->i_burst )
+            pacer->i_tokens = pacer->i_burst;
+    }
+    pacer->i_refill = now;
+}
+
+static void PacerReport( sout_access_out_t *p_access,
+                         struct udp_pacer *pacer, mtime_t now )
+{
+    msg_Dbg( p_access, "sent %"PRIu64" packets in %"PRIu64" calls, "
+             "%"PRIu64" late, queue depth up to %zu, rate %"PRId64" kb/s",
+             pacer->i_sent, pacer->i_calls, pacer->i_late,
+             pacer->i_max_depth, pacer->i_rate * 8 / 1000 );
+    pacer->i_max_depth = 0;
+    pacer->i_report = now + STATS_PERIOD;
+}
+
+/*****************************************************************************
+ * ThreadWriteBatch: Write packets on the network in paced batches.
+ *****************************************************************************/
+static void* ThreadWriteBatch( void *data )
+{
+    sout_access_out_t *p_access = data;
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+    struct udp_pacer *pacer = calloc( 1, sizeof (*pacer) );
+
+    if( unlikely(pacer == NULL) )
+        return NULL;
+
+    /* The sout chain does not enforce the range of the option */
+    pacer->i_batch = VLC_CLIP( var_GetInteger( p_access,
+                                               SOUT_CFG_PREFIX "batch" ),
+                               1, BATCH_MAX );
+    pacer->i_burst = pacer->i_batch * p_sys->i_mtu;
+    pacer->i_report = mdate() + STATS_PERIOD;
+    pacer->i_date_last = -1;
+
+    vlc_cleanup_push( PacerCleanup, pacer );
+    for( ;; )
+    {
+        while( pacer->p_next == NULL )
+        {
+            block_t *p_pk = block_FifoGet( p_sys->p_fifo );
+            int canc = vlc_savecancel();
+            PacerSchedule( p_access, pacer, p_pk );
+            vlc_restorecancel( canc );
+        }
+
+        size_t i_depth = block_FifoCount( p_sys->p_fifo ) + 1;
+        if( i_depth > pacer->i_max_depth )
+            pacer->i_max_depth = i_depth;
+
+        /* Wait for the first packet to be due */
+        mwait( pacer->i_next_date );
+
+        int canc = vlc_savecancel();
+        mtime_t now = mdate();
+        PacerRefill( pacer, now );
+
+        /* Gather packets that are due soon, as long as tokens remain.
+         * The first packet is always sent, since it is already due. */
+        unsigned n = 0;
+        do
+        {
+            block_t *p_pk = pacer->p_next;
+            mtime_t i_date = pacer->i_next_date;
+
+            pacer->p_next = NULL;
+            PacerEstimate( pacer, p_pk, i_date );
+            pacer->i_tokens -= p_pk->i_buffer;
+            if( i_date + LATE_DELAY < now )
+                pacer->i_late++;
+
+            pacer->pkts[n] = p_pk;
+            pacer->iov[n].iov_base = p_pk->p_buffer;
+            pacer->iov[n].iov_len = p_pk->i_buffer;
+            memset( &pacer->msgs[n], 0, sizeof (pacer->msgs[n]) );
+            pacer->msgs[n].msg_hdr.msg_iov = &pacer->iov[n];
+            pacer->msgs[n].msg_hdr.msg_iovlen = 1;
+            n++;
+
+            if( n >= pacer->i_batch || pacer->i_tokens <= 0 )
+                break;
+
+            while( pacer->p_next == NULL
+                && block_FifoCount( p_sys->p_fifo ) > 0 )
+                PacerSchedule( p_access, pacer,
+                               block_FifoGet( p_sys->p_fifo ) );
+            if( pacer->p_next == NULL )
+                break;
+        }
+        while( pacer->i_next_date <= now + BATCH_WINDOW
+            && pacer->i_tokens >= (int64_t)pacer->p_next->i_buffer );
+
+        /* Send the batch */
+        for( unsigned i = 0; i < n; )
+        {
+            int val = sendmmsg( p_sys->i_handle, pacer->msgs + i, n - i, 0 );
+
+            pacer->i_calls++;
+            if( val < 0 )
+            {
+                if( errno == EINTR )
+                    continue;
+                msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+                val = 1; /* drop that packet */
+            }
+            else
+                pacer->i_sent += val;
+            i += val;
+        }
+
+        for( unsigned i = 0; i < n; i++ )
+            block_FifoPut( p_sys->p_empty_blocks, pacer->pkts[i] );
+
+        if( now >= pacer->i_report )
+            PacerReport( p_access, pacer, now );
+        vlc_restorecancel( canc );
+    }
+    vlc_cleanup_pop();
+    return NULL;
+}
+#endif
@@ -1120,6 +1120,10 @@ static block_t *EncodeVideo( encoder_t *p_enc, picture_t *p_pict )
             }
         }
 
+        /* Keyframe requested by the sender */
+        if ( p_pict->b_keyframe )
+            frame->pict_type = AV_PICTURE_TYPE_I;
+
         if ( ( frame->pts != AV_NOPTS_VALUE ) && ( frame->pts != VLC_TS_INVALID ) )
         {
             if ( p_sys->i_last_pts == frame->pts )
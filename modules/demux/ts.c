@@ -42,8 +42,10 @@
 #include <vlc_epg.h>
 #include <vlc_charset.h>   /* FromCharset, for EIT */
 #include <vlc_bits.h>
+#include <vlc_fs.h>         /* vlc_stat, for the index */
 
 #include "../mux/mpeg/csa.h"
+#include "ts_index.h"
 
 /* Include dvbpsi headers */
 # include <dvbpsi/dvbpsi.h>
@@ -92,6 +94,9 @@ typedef enum arib_modes_e
     ARIBMODE_ENABLED = 1
 } arib_modes_e;
 
+/* Maximum number of TS packets read at once */
+#define TS_BATCH_MAX 256
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -141,6 +146,22 @@ static void Close ( vlc_object_t * );
     "Seek and position based on a percent byte position, not a PCR generated " \
     "time position. If seeking doesn't work property, turn on this option." )
 
+#define BATCH_TEXT N_("Packets read at once")
+#define BATCH_LONGTEXT N_( \
+    "Read and parse this many TS packets in one go. The scrambled packets " \
+    "of a batch are also descrambled together, which is much faster. " \
+    "Large values add latency on low bitrate live streams." )
+
+#define INDEX_TEXT N_("Seek index")
+#define INDEX_LONGTEXT N_( \
+    "Remember the positions of keyframes and PCRs while playing, so that " \
+    "seeking near them does not need to search the file." )
+
+#define INDEX_FILE_TEXT N_("Save the seek index")
+#define INDEX_FILE_LONGTEXT N_( \
+    "Keep the seek index in a .tsidx file next to the recording, and reuse " \
+    "it to open the recording without scanning it." )
+
 #define PCR_TEXT N_("Trust in-stream PCR")
 #define PCR_LONGTEXT N_("Use the stream PCR as a reference.")
 
@@ -176,6 +197,10 @@ vlc_module_begin ()
 
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
+    add_integer( "ts-batch", 1, BATCH_TEXT, BATCH_LONGTEXT, true )
+        change_integer_range( 1, TS_BATCH_MAX )
+    add_bool( "ts-seek-index", true, INDEX_TEXT, INDEX_LONGTEXT, true )
+    add_bool( "ts-seek-index-file", false, INDEX_FILE_TEXT, INDEX_FILE_LONGTEXT, true )
 
     add_integer( "ts-arib", ARIBMODE_AUTO, SUPPORT_ARIB_TEXT, SUPPORT_ARIB_LONGTEXT, false )
         change_integer_list( arib_mode_list, arib_mode_list_text )
@@ -330,6 +355,15 @@ struct demux_sys_t
     mtime_t     *p_pcrs;
     int64_t     *p_pos;
 
+    /* seek index (ts-seek-index) and its sidecar file */
+    bool        b_index;
+    ts_index_t  index;
+    char        *psz_index;
+    int64_t     i_index_size;
+    int64_t     i_index_mtime;
+    uint64_t    i_index_head;
+    bool        b_index_loaded;
+
     struct
     {
         arib_modes_e e_mode;
@@ -372,6 +406,13 @@ struct demux_sys_t
 
     /* */
     bool        b_start_record;
+
+    /* packets read ahead (ts-batch), still demuxed in stream order */
+    int         i_batch;
+    int         i_batch_count;
+    int         i_batch_pos;
+    block_t     *batch[TS_BATCH_MAX];
+    ts_pid_t    *batch_pid[TS_BATCH_MAX];
 };
 
 static int Demux    ( demux_t *p_demux );
@@ -401,11 +442,17 @@ static inline int PIDGet( block_t *p )
 static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static block_t* GetTSPacket( demux_t *p_demux, ts_pid_t **pp_pid );
+static void FlushTSBatch( demux_t *p_demux );
+static int64_t TellTS( demux_t *p_demux );
 static int Seek( demux_t *p_demux, double f_percent );
 static void GetFirstPCR( demux_t *p_demux );
 static void GetLastPCR( demux_t *p_demux );
 static void CheckPCR( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static bool IndexLoad( demux_t *p_demux );
+static void IndexSave( demux_t *p_demux );
+static void IndexPacket( demux_t *p_demux, const ts_pid_t *, const block_t * );
 
 static void              IODFree( iod_descriptor_t * );
 
@@ -794,6 +841,9 @@ static int Open( vlc_object_t *p_this )
     free( psz_string );
 
     p_sys->b_split_es = var_InheritBool( p_demux, "ts-split-es" );
+    p_sys->i_batch = var_InheritInteger( p_demux, "ts-batch" );
+    if( p_sys->i_batch < 1 || p_sys->i_batch > TS_BATCH_MAX )
+        p_sys->i_batch = 1;
 
     p_sys->b_canseek = false;
     p_sys->i_pid_ref_pcr = -1;
@@ -804,6 +854,8 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_pcrs_num = 10;
     p_sys->p_pcrs = (mtime_t *)calloc( p_sys->i_pcrs_num, sizeof( mtime_t ) );
     p_sys->p_pos = (int64_t *)calloc( p_sys->i_pcrs_num, sizeof( int64_t ) );
+    ts_index_Init( &p_sys->index );
+    p_sys->b_index = var_InheritBool( p_demux, "ts-seek-index" );
 
     p_sys->arib.e_mode = var_InheritInteger( p_demux, "ts-arib" );
 
@@ -818,7 +870,11 @@ static int Open( vlc_object_t *p_this )
     stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK, &b_can_fastseek );
     if ( p_sys->b_canseek )
     {
-        if( b_can_fastseek )
+        p_sys->i_index_size = stream_Size( p_sys->stream );
+        if( p_sys->b_index )
+            p_sys->b_index_loaded = IndexLoad( p_demux );
+
+        if( b_can_fastseek && !p_sys->b_index_loaded )
         {
             GetFirstPCR( p_demux );
             CheckPCR( p_demux );
@@ -904,6 +960,9 @@ static void Close( vlc_object_t *p_this )
             SetPIDFilter( p_demux, pid->i_pid, false );
     }
 
+    for( int i = p_sys->i_batch_pos; i < p_sys->i_batch_count; i++ )
+        block_Release( p_sys->batch[i] );
+
     vlc_mutex_lock( &p_sys->csa_lock );
     if( p_sys->csa )
     {
@@ -917,6 +976,10 @@ static void Close( vlc_object_t *p_this )
 
     free( p_sys->programs_list.p_values );
 
+    IndexSave( p_demux );
+    ts_index_Clean( &p_sys->index );
+    free( p_sys->psz_index );
+
     free( p_sys->p_pcrs );
     free( p_sys->p_pos );
 
@@ -970,12 +1033,15 @@ static int Demux( demux_t *p_demux )
     {
         bool         b_frame = false;
         block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        ts_pid_t    *p_pid;
+        if( !(p_pkt = GetTSPacket( p_demux, &p_pid )) )
         {
             return 0;
         }
 
-        if( p_sys->b_start_record )
+        /* Packets read ahead are not recorded: start with the next read */
+        if( p_sys->b_start_record &&
+            p_sys->i_batch_pos == p_sys->i_batch_count )
         {
             /* Enable recording once synchronized */
             stream_Control( p_sys->stream, STREAM_SET_RECORD_STATE, true, "ts" );
@@ -983,10 +1049,11 @@ static int Demux( demux_t *p_demux )
         }
 
         /* Parse the TS packet */
-        ts_pid_t *p_pid = &p_sys->pid[PIDGet( p_pkt )];
-
         if( p_pid->b_valid )
         {
+            if( p_sys->b_index && !p_pid->psi )
+                IndexPacket( p_demux, p_pid, p_pkt );
+
             if( p_pid->psi )
             {
                 if( p_pid->i_pid == 0 || ( p_sys->b_dvb_meta && ( p_pid->i_pid == 0x11 || p_pid->i_pid == 0x12 || p_pid->i_pid == 0x14 ) ) )
@@ -1079,7 +1146,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
                 *pf = (double)i_time/(double)i_length;
             else if( (i64 = stream_Size( p_sys->stream) ) > 0 )
             {
-                int64_t offset = stream_Tell( p_sys->stream );
+                int64_t offset = TellTS( p_demux );
 
                 *pf = (double)offset / (double)i64;
             }
@@ -1098,6 +1165,8 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
         if(!p_sys->b_canseek)
             return VLC_EGENERIC;
 
+        FlushTSBatch( p_demux );
+
         if( p_sys->b_force_seek_per_percent ||
             (p_sys->b_dvb_meta && p_sys->b_access_control) ||
             p_sys->i_last_pcr - p_sys->i_first_pcr <= 0 )
@@ -2067,6 +2136,139 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     return p_pkt;
 }
 
+/* Reads up to ts-batch packets at once. The sync bytes are checked and the
+ * PIDs looked up in one pass over the data, then the scrambled packets of
+ * the elementary streams are descrambled together. */
+static bool ReadTSBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const int i_size = p_sys->i_packet_size;
+    const uint8_t *p_peek;
+    int i_count = 0;
+
+    int i_peek = stream_Peek( p_sys->stream, &p_peek, i_size * p_sys->i_batch );
+    if( i_peek > 0 )
+    {
+        const uint8_t *p = &p_peek[p_sys->i_packet_header_size];
+
+        for( ; i_count < i_peek / i_size; i_count++, p += i_size )
+        {
+            if( p[0] != 0x47 )
+                break;
+            p_sys->batch_pid[i_count] = &p_sys->pid[( (p[1]&0x1f)<<8 )|p[2]];
+        }
+    }
+
+    if( i_count == 0 )
+    {
+        /* Lost synchro or end of stream */
+        block_t *p_pkt = ReadTSPacket( p_demux );
+        if( !p_pkt )
+            return false;
+        p_sys->batch[0] = p_pkt;
+        p_sys->batch_pid[0] = &p_sys->pid[PIDGet( p_pkt )];
+        i_count = 1;
+    }
+    else
+    {
+        for( int i = 0; i < i_count; i++ )
+        {
+            block_t *p_pkt = block_Alloc( i_size );
+            if( unlikely( !p_pkt ) )
+            {
+                i_count = i;
+                break;
+            }
+            memcpy( p_pkt->p_buffer, &p_peek[i * i_size], i_size );
+            /* Skip header (BluRay streams) */
+            p_pkt->p_buffer += p_sys->i_packet_header_size;
+            p_pkt->i_buffer -= p_sys->i_packet_header_size;
+            p_sys->batch[i] = p_pkt;
+        }
+        if( i_count == 0 )
+            return false;
+        stream_Read( p_sys->stream, NULL, i_count * i_size );
+    }
+
+    if( p_sys->csa )
+    {
+        uint8_t *pp_scrambled[TS_BATCH_MAX];
+        int i_scrambled = 0;
+
+        /* Only what GatherData() would descramble */
+        for( int i = 0; i < i_count; i++ )
+        {
+            const ts_pid_t *pid = p_sys->batch_pid[i];
+            uint8_t *p = p_sys->batch[i]->p_buffer;
+
+            if( pid->b_valid && !pid->psi && ( p[3]&0x80 ) )
+                pp_scrambled[i_scrambled++] = p;
+        }
+        if( i_scrambled > 0 )
+        {
+            vlc_mutex_lock( &p_sys->csa_lock );
+            csa_DecryptBatch( p_sys->csa, pp_scrambled, i_scrambled,
+                              p_sys->i_csa_pkt_size );
+            vlc_mutex_unlock( &p_sys->csa_lock );
+        }
+    }
+
+    p_sys->i_batch_count = i_count;
+    p_sys->i_batch_pos = 0;
+    return true;
+}
+
+/* Returns the next packet to demux and its PID */
+static block_t* GetTSPacket( demux_t *p_demux, ts_pid_t **pp_pid )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->i_batch_pos >= p_sys->i_batch_count )
+    {
+        p_sys->i_batch_pos = p_sys->i_batch_count = 0;
+
+        if( p_sys->i_batch <= 1 )
+        {
+            block_t *p_pkt = ReadTSPacket( p_demux );
+            if( p_pkt )
+                *pp_pid = &p_sys->pid[PIDGet( p_pkt )];
+            return p_pkt;
+        }
+        if( !ReadTSBatch( p_demux ) )
+            return NULL;
+    }
+
+    *pp_pid = p_sys->batch_pid[p_sys->i_batch_pos];
+    return p_sys->batch[p_sys->i_batch_pos++];
+}
+
+/* Drops the packets read ahead, and rewinds to the first of them */
+static void FlushTSBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->i_batch_pos >= p_sys->i_batch_count )
+        return;
+
+    const int64_t i_pos = TellTS( p_demux );
+
+    for( int i = p_sys->i_batch_pos; i < p_sys->i_batch_count; i++ )
+        block_Release( p_sys->batch[i] );
+    p_sys->i_batch_pos = p_sys->i_batch_count = 0;
+
+    stream_Seek( p_sys->stream, i_pos );
+}
+
+/* Position of the next packet to demux */
+static int64_t TellTS( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const int i_ahead = p_sys->i_batch_count - p_sys->i_batch_pos;
+
+    return stream_Tell( p_sys->stream ) -
+           (int64_t)i_ahead * p_sys->i_packet_size;
+}
+
 static mtime_t AdjustPCRWrapAround( demux_t *p_demux, mtime_t i_pcr )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
@@ -2075,7 +2277,7 @@ static mtime_t AdjustPCRWrapAround( demux_t *p_demux, mtime_t i_pcr )
      * So, need to add 0x1FFFFFFFF, for calculating duration or current position.
      */
     mtime_t i_adjust = 0;
-    int64_t i_pos = stream_Tell( p_sys->stream );
+    int64_t i_pos = TellTS( p_demux );
     int i;
     for( i = 1; i < p_sys->i_pcrs_num && p_sys->p_pos[i] <= i_pos; ++i )
     {
@@ -2181,6 +2383,30 @@ static int Seek( demux_t *p_demux, double f_percent )
         i_head_pos = p_sys->p_pos[i-1];
         i_tail_pos = ( i < p_sys->i_pcrs_num ) ?  p_sys->p_pos[i] : stream_Size( p_sys->stream );
     }
+
+    /* Resume from an indexed point close enough, or narrow the search */
+    const int i_index = ts_index_Find( &p_sys->index, i_target_pcr );
+    if( i_index >= 0 )
+    {
+        const ts_index_entry_t *p_entry = &p_sys->index.p_entries[i_index];
+
+        if( i_target_pcr - p_entry->i_pcr <= TS_INDEX_STEP &&
+            stream_Seek( p_sys->stream, p_entry->i_pos ) == VLC_SUCCESS )
+        {
+            msg_Dbg( p_demux, "Seek():indexed position %"PRId64, p_entry->i_pos );
+            p_sys->i_current_pcr = p_entry->i_pcr;
+            return VLC_SUCCESS;
+        }
+        if( p_entry->i_pos > i_head_pos && p_entry->i_pos < i_tail_pos )
+            i_head_pos = p_entry->i_pos;
+    }
+    if( i_index + 1 < p_sys->index.i_count )
+    {
+        const int64_t i_pos = p_sys->index.p_entries[i_index + 1].i_pos;
+        if( i_pos > i_head_pos && i_pos < i_tail_pos )
+            i_tail_pos = i_pos;
+    }
+
     msg_Dbg( p_demux, "Seek():i_head_pos:%"PRId64", i_tail_pos:%"PRId64, i_head_pos, i_tail_pos);
 
     bool b_found = false;
@@ -2194,6 +2420,10 @@ static int Seek( demux_t *p_demux, double f_percent )
         if( SeekToPCR( p_demux, i_pos ) )
             break;
         p_sys->i_current_pcr = AdjustPCRWrapAround( p_demux, p_sys->i_current_pcr );
+        if( p_sys->b_index )
+            ts_index_Add( &p_sys->index,
+                          stream_Tell( p_sys->stream ) - p_sys->i_packet_size,
+                          p_sys->i_current_pcr, false );
         int64_t i_diff_msec = (p_sys->i_current_pcr - i_target_pcr) * 100 / 9 / 1000;
         if( i_diff_msec > 500 )
         {
@@ -2353,7 +2583,13 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         return;
 
     if( p_sys->i_pid_ref_pcr == pid->i_pid )
+    {
         p_sys->i_current_pcr = AdjustPCRWrapAround( p_demux, i_pcr );
+        if( p_sys->b_index && p_sys->b_canseek )
+            ts_index_Add( &p_sys->index,
+                          TellTS( p_demux ) - p_sys->i_packet_size,
+                          p_sys->i_current_pcr, false );
+    }
 
     /* Search program and set the PCR */
     int i_group = -1;
@@ -2386,11 +2622,123 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     }
 }
 
+/* Indexes the random access points of the video streams, with the last PCR */
+static void IndexPacket( demux_t *p_demux, const ts_pid_t *pid,
+                         const block_t *p_pkt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const uint8_t *p = p_pkt->p_buffer;
+
+    if( !p_sys->b_canseek || p_sys->i_current_pcr < 0 )
+        return;
+
+    /* random_access_indicator */
+    if( ( p[3]&0x20 ) && p[4] > 0 && ( p[5]&0x40 ) &&
+        pid->es->fmt.i_cat == VIDEO_ES )
+        ts_index_Add( &p_sys->index, TellTS( p_demux ) - p_sys->i_packet_size,
+                      p_sys->i_current_pcr, true );
+}
+
+static void IndexInfo( demux_t *p_demux, ts_index_info_t *p_info )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    p_info->i_size = p_sys->i_index_size;
+    p_info->i_mtime = p_sys->i_index_mtime;
+    p_info->i_head = p_sys->i_index_head;
+    p_info->i_packet_size = p_sys->i_packet_size;
+    p_info->i_pid_ref_pcr = p_sys->i_pid_ref_pcr;
+    p_info->i_first_pcr = p_sys->i_first_pcr;
+    p_info->i_last_pcr = p_sys->i_last_pcr;
+    p_info->i_pcrs_num = p_sys->i_pcrs_num;
+    p_info->p_pcrs = p_sys->p_pcrs;
+    p_info->p_pos = p_sys->p_pos;
+}
+
+/* Loads the sidecar index. Returns true if it matches the file as a whole,
+ * so that the scans done at open can be skipped. */
+static bool IndexLoad( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_demux->psz_file ||
+        !var_InheritBool( p_demux, "ts-seek-index-file" ) )
+        return false;
+    if( asprintf( &p_sys->psz_index, "%s.tsidx", p_demux->psz_file ) < 0 )
+    {
+        p_sys->psz_index = NULL;
+        return false;
+    }
+
+    /* The version of the file the index is for */
+    struct stat st;
+    const uint8_t *p_peek;
+    ssize_t i_peek;
+
+    if( vlc_stat( p_demux->psz_file, &st ) )
+        memset( &st, 0, sizeof( st ) );
+    p_sys->i_index_mtime = st.st_mtime;
+    if( stream_Tell( p_sys->stream ) == 0 &&
+        ( i_peek = stream_Peek( p_sys->stream, &p_peek, TS_INDEX_HEAD ) ) > 0 )
+        p_sys->i_index_head = ts_index_Hash( p_peek, i_peek );
+
+    mtime_t pcrs[p_sys->i_pcrs_num];
+    int64_t pos[p_sys->i_pcrs_num];
+    ts_index_info_t info;
+
+    IndexInfo( p_demux, &info );
+    info.p_pcrs = pcrs;
+    info.p_pos = pos;
+    if( ts_index_Load( &p_sys->index, &info, p_sys->psz_index ) )
+        return false;
+
+    /* Rewritten, or modified other than by appending */
+    if( info.i_head != p_sys->i_index_head ||
+        info.i_size > p_sys->i_index_size ||
+        ( info.i_size == p_sys->i_index_size &&
+          info.i_mtime != p_sys->i_index_mtime ) )
+    {
+        msg_Dbg( p_demux, "ignoring stale index %s", p_sys->psz_index );
+        ts_index_Clean( &p_sys->index );
+        return false;
+    }
+    msg_Dbg( p_demux, "loaded %d index entries from %s",
+             p_sys->index.i_count, p_sys->psz_index );
+
+    /* A recording still growing keeps its entries, but must be scanned */
+    if( info.i_size != p_sys->i_index_size )
+        return false;
+
+    p_sys->i_pid_ref_pcr = info.i_pid_ref_pcr;
+    p_sys->i_first_pcr = info.i_first_pcr;
+    p_sys->i_current_pcr = info.i_first_pcr;
+    p_sys->i_last_pcr = info.i_last_pcr;
+    memcpy( p_sys->p_pcrs, pcrs, sizeof( pcrs ) );
+    memcpy( p_sys->p_pos, pos, sizeof( pos ) );
+    return true;
+}
+
+static void IndexSave( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_index_info_t info;
+
+    if( !p_sys->psz_index ||
+        ( p_sys->b_index_loaded && !p_sys->index.b_changed ) )
+        return;
+
+    IndexInfo( p_demux, &info );
+    if( ts_index_Save( &p_sys->index, &info, p_sys->psz_index ) )
+        msg_Warn( p_demux, "cannot save index to %s", p_sys->psz_index );
+    else
+        msg_Dbg( p_demux, "saved %d index entries to %s",
+                 p_sys->index.i_count, p_sys->psz_index );
+}
+
 static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
 {
     const uint8_t *p = p_bk->p_buffer;
     const bool b_unit_start = p[1]&0x40;
-    const bool b_scrambled  = p[3]&0x80;
     const bool b_adaptation = p[3]&0x20;
     const bool b_payload    = p[3]&0x10;
     const int  i_cc         = p[3]&0x0f; /* continuity counter */
@@ -2425,6 +2773,9 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
     }
 
+    /* Descrambled packets (here or in ReadTSBatch) are not scrambled any more */
+    const bool b_scrambled  = p[3]&0x80;
+
     if( !b_adaptation )
     {
         /* We don't have any adaptation_field, so payload starts
@@ -0,0 +1,303 @@
+/*****************************************************************************
+ * ts_index.c: sparse seek index for MPEG-TS files
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+
+#include "ts_index.h"
+
+/* Sidecar file layout, all little endian:
+ *  "VLCTSIX2", file size (64), file modification time (64),
+ *  hash of the first bytes (64), packet size (32), PCR PID (32),
+ *  first PCR (64), last PCR (64), PCR table size n (32),
+ *  n x { PCR (64), position (64) }, entry count m (32),
+ *  m x { position (64), PCR (64, random access flag in bit 63) } */
+#define TS_INDEX_MAGIC "VLCTSIX2"
+#define TS_INDEX_MAX   (1 << 22)
+#define TS_INDEX_RAP   UINT64_C(0x8000000000000000)
+
+void ts_index_Init( ts_index_t *p_index )
+{
+    p_index->p_entries = NULL;
+    p_index->i_count = 0;
+    p_index->i_alloc = 0;
+    p_index->b_changed = false;
+}
+
+void ts_index_Clean( ts_index_t *p_index )
+{
+    free( p_index->p_entries );
+    ts_index_Init( p_index );
+}
+
+int ts_index_Find( const ts_index_t *p_index, int64_t i_pcr )
+{
+    int i_low = 0, i_high = p_index->i_count;
+
+    while( i_low < i_high )
+    {
+        const int i_mid = (i_low + i_high) / 2;
+
+        if( p_index->p_entries[i_mid].i_pcr <= i_pcr )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low - 1;
+}
+
+void ts_index_Add( ts_index_t *p_index, int64_t i_pos, int64_t i_pcr,
+                   bool b_random_access )
+{
+    const int i_prev = ts_index_Find( p_index, i_pcr );
+    const int i_next = i_prev + 1;
+    ts_index_entry_t *p_entries = p_index->p_entries;
+
+    if( i_pos < 0 || i_pcr < 0 )
+        return;
+
+    /* Keep positions in the same order as PCRs (discontinuities) */
+    if( ( i_prev >= 0 && p_entries[i_prev].i_pos >= i_pos ) ||
+        ( i_next < p_index->i_count && p_entries[i_next].i_pos <= i_pos ) )
+        return;
+
+    if( i_prev >= 0 && i_pcr - p_entries[i_prev].i_pcr < TS_INDEX_STEP )
+    {
+        ts_index_entry_t *p_prev = &p_entries[i_prev];
+
+        if( b_random_access && !p_prev->b_random_access &&
+            ( i_prev == 0 ||
+              i_pcr - p_entries[i_prev - 1].i_pcr >= TS_INDEX_STEP ) )
+        {
+            p_prev->i_pos = i_pos;
+            p_prev->i_pcr = i_pcr;
+            p_prev->b_random_access = true;
+            p_index->b_changed = true;
+        }
+        return;
+    }
+    if( i_next < p_index->i_count &&
+        p_entries[i_next].i_pcr - i_pcr < TS_INDEX_STEP &&
+        ( p_entries[i_next].b_random_access || !b_random_access ) )
+        return;
+
+    if( p_index->i_count >= p_index->i_alloc )
+    {
+        if( p_index->i_alloc >= TS_INDEX_MAX )
+            return;
+
+        const int i_alloc = __MAX( 256, 2 * p_index->i_alloc );
+        p_entries = realloc( p_entries, i_alloc * sizeof( *p_entries ) );
+        if( unlikely( !p_entries ) )
+            return;
+        p_index->p_entries = p_entries;
+        p_index->i_alloc = i_alloc;
+    }
+
+    memmove( &p_entries[i_next + 1], &p_entries[i_next],
+             ( p_index->i_count - i_next ) * sizeof( *p_entries ) );
+    p_entries[i_next].i_pos = i_pos;
+    p_entries[i_next].i_pcr = i_pcr;
+    p_entries[i_next].b_random_access = b_random_access;
+    p_index->i_count++;
+    p_index->b_changed = true;
+}
+
+/* 64-bit FNV-1a */
+uint64_t ts_index_Hash( const uint8_t *p_data, size_t i_size )
+{
+    uint64_t i_hash = UINT64_C(0xcbf29ce484222325);
+
+    for( size_t i = 0; i < i_size; i++ )
+        i_hash = ( i_hash ^ p_data[i] ) * UINT64_C(0x100000001b3);
+    return i_hash;
+}
+
+static bool Read( FILE *p_file, void *p_buf, size_t i_size )
+{
+    return fread( p_buf, i_size, 1, p_file ) == 1;
+}
+
+static bool Read32( FILE *p_file, uint32_t *pi_value )
+{
+    uint8_t buf[4];
+
+    if( !Read( p_file, buf, 4 ) )
+        return false;
+    *pi_value = GetDWLE( buf );
+    return true;
+}
+
+static bool Read64( FILE *p_file, int64_t *pi_value )
+{
+    uint8_t buf[8];
+
+    if( !Read( p_file, buf, 8 ) )
+        return false;
+    *pi_value = GetQWLE( buf );
+    return true;
+}
+
+static bool Write32( FILE *p_file, uint32_t i_value )
+{
+    uint8_t buf[4];
+
+    SetDWLE( buf, i_value );
+    return fwrite( buf, 4, 1, p_file ) == 1;
+}
+
+static bool Write64( FILE *p_file, int64_t i_value )
+{
+    uint8_t buf[8];
+
+    SetQWLE( buf, i_value );
+    return fwrite( buf, 8, 1, p_file ) == 1;
+}
+
+int ts_index_Load( ts_index_t *p_index, ts_index_info_t *p_info,
+                   const char *psz_path )
+{
+    FILE *p_file = vlc_fopen( psz_path, "rb" );
+    if( !p_file )
+        return VLC_EGENERIC;
+
+    char psz_magic[8];
+    uint32_t i_packet_size, i_pid, i_pcrs_num, i_count;
+    int64_t i_head;
+    ts_index_info_t info = *p_info;
+
+    if( !Read( p_file, psz_magic, 8 ) ||
+        memcmp( psz_magic, TS_INDEX_MAGIC, 8 ) ||
+        !Read64( p_file, &info.i_size ) ||
+        !Read64( p_file, &info.i_mtime ) ||
+        !Read64( p_file, &i_head ) ||
+        !Read32( p_file, &i_packet_size ) || !Read32( p_file, &i_pid ) ||
+        !Read64( p_file, &info.i_first_pcr ) ||
+        !Read64( p_file, &info.i_last_pcr ) ||
+        !Read32( p_file, &i_pcrs_num ) ||
+        i_pcrs_num != (uint32_t)p_info->i_pcrs_num ||
+        i_packet_size != (uint32_t)p_info->i_packet_size )
+        goto error;
+
+    for( int i = 0; i < p_info->i_pcrs_num; i++ )
+        if( !Read64( p_file, &info.p_pcrs[i] ) ||
+            !Read64( p_file, &info.p_pos[i] ) )
+            goto error;
+
+    if( !Read32( p_file, &i_count ) || i_count > TS_INDEX_MAX )
+        goto error;
+
+    ts_index_entry_t *p_entries = malloc( __MAX( i_count, 1 ) *
+                                          sizeof( *p_entries ) );
+    if( !p_entries )
+        goto error;
+
+    for( uint32_t i = 0; i < i_count; i++ )
+    {
+        int64_t i_pcr;
+
+        if( !Read64( p_file, &p_entries[i].i_pos ) ||
+            !Read64( p_file, &i_pcr ) )
+        {
+            free( p_entries );
+            goto error;
+        }
+        p_entries[i].i_pcr = i_pcr & ~TS_INDEX_RAP;
+        p_entries[i].b_random_access = ( i_pcr & TS_INDEX_RAP ) != 0;
+
+        /* Reject anything out of order */
+        if( i > 0 && ( p_entries[i].i_pos <= p_entries[i-1].i_pos ||
+                       p_entries[i].i_pcr <= p_entries[i-1].i_pcr ) )
+        {
+            free( p_entries );
+            goto error;
+        }
+    }
+    fclose( p_file );
+
+    info.i_pid_ref_pcr = i_pid;
+    info.i_head = i_head;
+    *p_info = info;
+
+    free( p_index->p_entries );
+    p_index->p_entries = p_entries;
+    p_index->i_count = p_index->i_alloc = i_count;
+    p_index->b_changed = false;
+    return VLC_SUCCESS;
+
+error:
+    fclose( p_file );
+    return VLC_EGENERIC;
+}
+
+int ts_index_Save( const ts_index_t *p_index, const ts_index_info_t *p_info,
+                   const char *psz_path )
+{
+    char *psz_tmp;
+
+    if( asprintf( &psz_tmp, "%s.part", psz_path ) < 0 )
+        return VLC_ENOMEM;
+
+    FILE *p_file = vlc_fopen( psz_tmp, "wb" );
+    if( !p_file )
+    {
+        free( psz_tmp );
+        return VLC_EGENERIC;
+    }
+
+    bool b_ok = fwrite( TS_INDEX_MAGIC, 8, 1, p_file ) == 1 &&
+                Write64( p_file, p_info->i_size ) &&
+                Write64( p_file, p_info->i_mtime ) &&
+                Write64( p_file, p_info->i_head ) &&
+                Write32( p_file, p_info->i_packet_size ) &&
+                Write32( p_file, p_info->i_pid_ref_pcr ) &&
+                Write64( p_file, p_info->i_first_pcr ) &&
+                Write64( p_file, p_info->i_last_pcr ) &&
+                Write32( p_file, p_info->i_pcrs_num );
+
+    for( int i = 0; b_ok && i < p_info->i_pcrs_num; i++ )
+        b_ok = Write64( p_file, p_info->p_pcrs[i] ) &&
+               Write64( p_file, p_info->p_pos[i] );
+
+    b_ok = b_ok && Write32( p_file, p_index->i_count );
+    for( int i = 0; b_ok && i < p_index->i_count; i++ )
+    {
+        const ts_index_entry_t *p_entry = &p_index->p_entries[i];
+
+        b_ok = Write64( p_file, p_entry->i_pos ) &&
+               Write64( p_file, p_entry->i_pcr |
+                        ( p_entry->b_random_access ? TS_INDEX_RAP : 0 ) );
+    }
+
+    if( fclose( p_file ) )
+        b_ok = false;
+    if( b_ok )
+        b_ok = !vlc_rename( psz_tmp, psz_path );
+    if( !b_ok )
+        vlc_unlink( psz_tmp );
+    free( psz_tmp );
+    return b_ok ? VLC_SUCCESS : VLC_EGENERIC;
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * ts_index.h: sparse seek index for MPEG-TS files
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_TS_INDEX_H
+#define VLC_TS_INDEX_H 1
+
+/* At most one entry per step of PCR (90 kHz) */
+#define TS_INDEX_STEP (90000 / 2)
+
+typedef struct
+{
+    int64_t i_pos;          /* offset of the packet to resume from */
+    int64_t i_pcr;          /* PCR at that point, wrap-arounds included */
+    bool    b_random_access;
+} ts_index_entry_t;
+
+/* Entries are sorted by both position and PCR */
+typedef struct
+{
+    ts_index_entry_t *p_entries;
+    int               i_count;
+    int               i_alloc;
+    bool              b_changed;
+} ts_index_t;
+
+/* Bytes at the start of the file identifying it, with its size and date */
+#define TS_INDEX_HEAD (64 * 188)
+
+/* What the demuxer found by scanning the file at open, for a version of the
+ * file (size, modification time and first bytes) */
+typedef struct
+{
+    int64_t  i_size;
+    int64_t  i_mtime;
+    uint64_t i_head;        /* ts_index_Hash() of the first bytes */
+    int      i_packet_size;
+    int      i_pid_ref_pcr;
+    int64_t  i_first_pcr;
+    int64_t  i_last_pcr;
+    int      i_pcrs_num;
+    int64_t *p_pcrs;
+    int64_t *p_pos;
+} ts_index_info_t;
+
+void ts_index_Init( ts_index_t * );
+void ts_index_Clean( ts_index_t * );
+
+/**
+ * Records a point to resume from. Points closer than TS_INDEX_STEP to an
+ * existing one are dropped, unless they replace a point that is not a
+ * random access point.
+ */
+void ts_index_Add( ts_index_t *, int64_t i_pos, int64_t i_pcr,
+                   bool b_random_access );
+
+/**
+ * @return the last entry with a PCR lower or equal to i_pcr, -1 if none
+ */
+int  ts_index_Find( const ts_index_t *, int64_t i_pcr );
+
+/**
+ * @return the hash of the first bytes of a file, stored as i_head
+ */
+uint64_t ts_index_Hash( const uint8_t *p_data, size_t i_size );
+
+/**
+ * Loads an index saved by ts_index_Save(). p_info->i_packet_size,
+ * i_pcrs_num, p_pcrs and p_pos must be set up by the caller.
+ */
+int  ts_index_Load( ts_index_t *, ts_index_info_t *p_info, const char *psz_path );
+int  ts_index_Save( const ts_index_t *, const ts_index_info_t *p_info,
+                    const char *psz_path );
+
+#endif
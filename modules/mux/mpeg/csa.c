@@ -26,10 +26,21 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
+#include <vlc_cpu.h>
 
 #include "csa.h"
 
+/* Below this many packets, the bitsliced cypher is slower than the
+ * byte-oriented one */
+#define CSA_BATCH_MIN 8
+#define CSA_BATCH_MAX 256
+
+typedef void (*csa_stream_fn)( const uint8_t ck[8], uint8_t **pp_data,
+                               const int *pi_size, int i_count );
+
 struct csa_t
 {
     /* odd and even keys */
@@ -47,6 +58,14 @@ struct csa_t
     int     p, q, r;
 
     bool    use_odd;
+
+    /* bitsliced stream cyphers, by increasing batch size */
+    struct
+    {
+        csa_stream_fn pf_stream;
+        int           i_batch;
+    } bs[3];
+    int     i_bs;
 };
 
 static void csa_ComputeKey( uint8_t kk[57], uint8_t ck[8] );
@@ -56,12 +75,89 @@ static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, ui
 static void csa_BlockDecypher( uint8_t kk[57], uint8_t ib[8], uint8_t bd[8] );
 static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] );
 
+static void csa_BytesToPlanes( uint64_t *planes, const uint8_t (*bytes)[8],
+                               int i_lanes, int i_words );
+static void csa_PlanesToBytes( uint8_t (*bytes)[8], const uint64_t *planes,
+                               int i_lanes, int i_words );
+
+#define CSA_SELECT( c, a, b ) ( (b) ^ ( (c) & ( (a) ^ (b) ) ) )
+
+/* 64 packets per word, the generic case */
+#define CSA_WORD         uint64_t
+#define CSA_BATCH        64
+#define CSA_FUNC( name ) name##64
+#define CSA_TARGET
+#include "csa_bitslice.h"
+#undef CSA_TARGET
+#undef CSA_FUNC
+#undef CSA_BATCH
+#undef CSA_WORD
+
+#if defined(__GNUC__) || defined(__clang__)
+/* 128 packets per SSE2 or NEON register */
+# if defined(__x86_64__) || defined(__i386__)
+#  define CSA_HAVE_128() vlc_CPU_SSE2()
+#  define CSA_TARGET __attribute__ ((__target__ ("sse2")))
+# elif defined(__aarch64__) || defined(__ARM_NEON__)
+#  define CSA_HAVE_128() (1)
+#  define CSA_TARGET
+# endif
+#endif
+
+#ifdef CSA_HAVE_128
+typedef uint64_t csa_word128_t __attribute__ ((vector_size (16)));
+# define CSA_WORD         csa_word128_t
+# define CSA_BATCH        128
+# define CSA_FUNC( name ) name##128
+# include "csa_bitslice.h"
+# undef CSA_TARGET
+# undef CSA_FUNC
+# undef CSA_BATCH
+# undef CSA_WORD
+#endif
+
+#if defined(CSA_HAVE_128) && (defined(__x86_64__) || defined(__i386__)) && \
+    (VLC_GCC_VERSION(4, 7) || defined(__clang__))
+/* 256 packets per AVX2 register */
+# define CSA_HAVE_256() vlc_CPU_AVX2()
+typedef uint64_t csa_word256_t __attribute__ ((vector_size (32)));
+# define CSA_WORD         csa_word256_t
+# define CSA_BATCH        256
+# define CSA_FUNC( name ) name##256
+# define CSA_TARGET __attribute__ ((__target__ ("avx2")))
+# include "csa_bitslice.h"
+# undef CSA_TARGET
+# undef CSA_FUNC
+# undef CSA_BATCH
+# undef CSA_WORD
+#endif
+
 /*****************************************************************************
  * csa_New:
  *****************************************************************************/
 csa_t *csa_New( void )
 {
-    return calloc( 1, sizeof( csa_t ) );
+    csa_t *c = calloc( 1, sizeof( csa_t ) );
+    if( !c )
+        return NULL;
+
+    c->bs[c->i_bs].pf_stream = csa_BsStream64;
+    c->bs[c->i_bs++].i_batch = 64;
+#ifdef CSA_HAVE_128
+    if( CSA_HAVE_128() )
+    {
+        c->bs[c->i_bs].pf_stream = csa_BsStream128;
+        c->bs[c->i_bs++].i_batch = 128;
+    }
+#endif
+#ifdef CSA_HAVE_256
+    if( CSA_HAVE_256() )
+    {
+        c->bs[c->i_bs].pf_stream = csa_BsStream256;
+        c->bs[c->i_bs++].i_batch = 256;
+    }
+#endif
+    return c;
 }
 
 /*****************************************************************************
@@ -307,6 +403,170 @@ void csa_Encrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     }
 }
 
+/*****************************************************************************
+ * csa_DecryptBatch:
+ *****************************************************************************
+ * Same as calling csa_Decrypt on each packet. Scrambled packets are grouped
+ * by key, and the stream cypher runs bitsliced over each group.
+ *****************************************************************************/
+static void csa_BsRun( csa_t *c, const uint8_t *ck, uint8_t **pp_data,
+                       const int *pi_size, int i_count )
+{
+    int i;
+
+    /* the smallest batch holding all packets */
+    for( i = 0; i < c->i_bs - 1; i++ )
+        if( c->bs[i].i_batch >= i_count )
+            break;
+    assert( i_count <= c->bs[i].i_batch );
+    c->bs[i].pf_stream( ck, pp_data, pi_size, i_count );
+}
+
+static void csa_DecryptRun( csa_t *c, bool odd, uint8_t **pp_data,
+                            const int *pi_size, int i_count )
+{
+    uint8_t *kk = odd ? c->o_kk : c->e_kk;
+
+    csa_BsRun( c, odd ? c->o_ck : c->e_ck, pp_data, pi_size, i_count );
+
+    /* the block cypher chain, on blocks xored with the stream */
+    for( int l = 0; l < i_count; l++ )
+    {
+        uint8_t *p = pp_data[l];
+        const int n = pi_size[l] / 8;
+        uint8_t ib[8], block[8];
+
+        memcpy( ib, p, 8 );
+        for( int i = 1; i < n + 1; i++ )
+        {
+            csa_BlockDecypher( kk, ib, block );
+            if( i != n )
+                memcpy( ib, &p[8*i], 8 );
+            else
+                memset( ib, 0, 8 );
+            for( int j = 0; j < 8; j++ )
+                p[8*(i-1)+j] = ib[j] ^ block[j];
+        }
+    }
+}
+
+void csa_DecryptBatch( csa_t *c, uint8_t **pp_pkt, int i_count,
+                       int i_pkt_size )
+{
+    uint8_t *pp_data[2][CSA_BATCH_MAX];
+    int      pi_size[2][CSA_BATCH_MAX];
+    int      pi_run[2] = { 0, 0 };
+    const int i_max = c->bs[c->i_bs - 1].i_batch;
+
+    if( i_count < CSA_BATCH_MIN )
+    {
+        for( int i = 0; i < i_count; i++ )
+            csa_Decrypt( c, pp_pkt[i], i_pkt_size );
+        return;
+    }
+
+    for( int i = 0; i < i_count; i++ )
+    {
+        uint8_t *pkt = pp_pkt[i];
+        int i_hdr = 4;
+
+        /* transport scrambling control */
+        if( (pkt[3]&0x80) == 0 )
+            continue;
+        if( pkt[3]&0x20 )
+            i_hdr += pkt[4] + 1;
+        if( 188 - i_hdr < 8 || i_pkt_size - i_hdr < 8 )
+        {
+            csa_Decrypt( c, pkt, i_pkt_size );
+            continue;
+        }
+
+        const bool odd = pkt[3]&0x40;
+        const int  r = pi_run[odd]++;
+
+        /* clear transport scrambling control */
+        pkt[3] &= 0x3f;
+        pp_data[odd][r] = &pkt[i_hdr];
+        pi_size[odd][r] = i_pkt_size - i_hdr;
+        if( pi_run[odd] == i_max )
+        {
+            csa_DecryptRun( c, odd, pp_data[odd], pi_size[odd], i_max );
+            pi_run[odd] = 0;
+        }
+    }
+
+    for( int odd = 0; odd < 2; odd++ )
+        if( pi_run[odd] > 0 )
+            csa_DecryptRun( c, odd, pp_data[odd], pi_size[odd], pi_run[odd] );
+}
+
+/*****************************************************************************
+ * csa_EncryptBatch:
+ *****************************************************************************
+ * Same as calling csa_Encrypt on each packet.
+ *****************************************************************************/
+void csa_EncryptBatch( csa_t *c, uint8_t **pp_pkt, int i_count,
+                       int i_pkt_size )
+{
+    uint8_t *pp_data[CSA_BATCH_MAX];
+    int      pi_size[CSA_BATCH_MAX];
+    int      i_run = 0;
+    const int i_max = c->bs[c->i_bs - 1].i_batch;
+    uint8_t *ck = c->use_odd ? c->o_ck : c->e_ck;
+    uint8_t *kk = c->use_odd ? c->o_kk : c->e_kk;
+
+    if( i_count < CSA_BATCH_MIN )
+    {
+        for( int i = 0; i < i_count; i++ )
+            csa_Encrypt( c, pp_pkt[i], i_pkt_size );
+        return;
+    }
+
+    for( int i = 0; i < i_count; i++ )
+    {
+        uint8_t *pkt = pp_pkt[i];
+        int i_hdr = 4;
+
+        /* set transport scrambling control */
+        pkt[3] |= c->use_odd ? 0xc0 : 0x80;
+        if( pkt[3]&0x20 )
+            i_hdr += pkt[4] + 1;
+
+        const int n = (i_pkt_size - i_hdr) / 8;
+        if( n <= 0 )
+        {
+            pkt[3] &= 0x3f;
+            continue;
+        }
+
+        /* the block cypher chain runs backwards, in place: block i-1
+         * becomes ib[i] once ib[i+1] (stored in block i) is consumed */
+        uint8_t *p = &pkt[i_hdr];
+        uint8_t block[8];
+
+        for( int j = 0; j < 8; j++ )
+            block[j] = p[8*(n-1)+j];
+        csa_BlockCypher( kk, block, &p[8*(n-1)] );
+        for( int k = n - 1; k > 0; k-- )
+        {
+            for( int j = 0; j < 8; j++ )
+                block[j] = p[8*(k-1)+j] ^ p[8*k+j];
+            csa_BlockCypher( kk, block, &p[8*(k-1)] );
+        }
+
+        pp_data[i_run] = p;
+        pi_size[i_run] = i_pkt_size - i_hdr;
+        if( ++i_run == i_max )
+        {
+            csa_BsRun( c, ck, pp_data, pi_size, i_run );
+            i_run = 0;
+        }
+    }
+
+    if( i_run > 0 )
+        csa_BsRun( c, ck, pp_data, pi_size, i_run );
+}
+
 /*****************************************************************************
  * Divers
  *****************************************************************************/
@@ -610,3 +870,66 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+/*****************************************************************************
+ * Bit planes
+ *****************************************************************************
+ * The bitsliced cypher wants bit b of byte i of all packets in the same word
+ * (the lane of packet l is bit l%64 of the 64 bit word l/64). Both ways are
+ * done 8 packets at a time, with an 8x8 bit matrix transposition.
+ *****************************************************************************/
+static inline uint64_t csa_Transpose8x8( uint64_t x )
+{
+    uint64_t t;
+
+    t = ( x ^ ( x >> 7 ) ) & UINT64_C(0x00AA00AA00AA00AA);
+    x ^= t ^ ( t << 7 );
+    t = ( x ^ ( x >> 14 ) ) & UINT64_C(0x0000CCCC0000CCCC);
+    x ^= t ^ ( t << 14 );
+    t = ( x ^ ( x >> 28 ) ) & UINT64_C(0x00000000F0F0F0F0);
+    x ^= t ^ ( t << 28 );
+    return x;
+}
+
+static void csa_BytesToPlanes( uint64_t *planes, const uint8_t (*bytes)[8],
+                               int i_lanes, int i_words )
+{
+    memset( planes, 0, 64 * i_words * sizeof( *planes ) );
+
+    for( int l = 0; l < i_lanes; l += 8 )
+    {
+        const int i_shift = l % 64;
+
+        for( int i = 0; i < 8; i++ )
+        {
+            uint64_t x = 0;
+
+            for( int k = 0; k < 8 && l + k < i_lanes; k++ )
+                x |= (uint64_t)bytes[l+k][i] << (8*k);
+            x = csa_Transpose8x8( x );
+            for( int b = 0; b < 8; b++ )
+                planes[(8*i+b) * i_words + l / 64] |=
+                    ( ( x >> (8*b) ) & 0xff ) << i_shift;
+        }
+    }
+}
+
+static void csa_PlanesToBytes( uint8_t (*bytes)[8], const uint64_t *planes,
+                               int i_lanes, int i_words )
+{
+    for( int l = 0; l < i_lanes; l += 8 )
+    {
+        const int i_shift = l % 64;
+
+        for( int i = 0; i < 8; i++ )
+        {
+            uint64_t x = 0;
+
+            for( int b = 0; b < 8; b++ )
+                x |= ( ( planes[(8*i+b) * i_words + l / 64] >> i_shift )
+                       & 0xff ) << (8*b);
+            x = csa_Transpose8x8( x );
+            for( int k = 0; k < 8 && l + k < i_lanes; k++ )
+                bytes[l+k][i] = x >> (8*k);
+        }
+    }
+}
@@ -0,0 +1,440 @@
+/*****************************************************************************
+ * csa_bitslice.h: bitsliced CSA stream cypher
+ *****************************************************************************
+ * Copyright (C) 2004-2005 Laurent Aimar
+ * Copyright (C) the deCSA authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This file is included by csa.c once per word size. Each bit of a CSA_WORD
+ * belongs to a different packet, so that CSA_BATCH packets sharing the same
+ * key run through the stream cypher at once. The caller defines:
+ *  - CSA_WORD: a type of CSA_BATCH bits supporting &, ^ and ~,
+ *  - CSA_BATCH: its size in bits (a multiple of 64),
+ *  - CSA_FUNC(name): the name of each function of this instance,
+ *  - CSA_TARGET: the function attributes (instruction set) if any.
+ *
+ * The s-boxes are the algebraic normal form of the sbox1..sbox7 tables. */
+
+#define CSA_WORDS (CSA_BATCH / 64)
+
+static inline CSA_TARGET
+void CSA_FUNC(csa_BsSbox1)( const CSA_WORD x[5], CSA_WORD s[2] )
+{
+    const CSA_WORD x10 = x[1] & x[0];
+    const CSA_WORD x20 = x[2] & x[0];
+    const CSA_WORD x21 = x[2] & x[1];
+    const CSA_WORD x30 = x[3] & x[0];
+    const CSA_WORD x31 = x[3] & x[1];
+    const CSA_WORD x32 = x[3] & x[2];
+    const CSA_WORD x40 = x[4] & x[0];
+    const CSA_WORD x42 = x[4] & x[2];
+    const CSA_WORD x43 = x[4] & x[3];
+    const CSA_WORD x310 = x31 & x[0];
+    const CSA_WORD x320 = x32 & x[0];
+    const CSA_WORD x321 = x32 & x[1];
+    const CSA_WORD x41 = x[4] & x[1];
+    const CSA_WORD x410 = x41 & x[0];
+    const CSA_WORD x421 = x42 & x[1];
+    const CSA_WORD x431 = x43 & x[1];
+    const CSA_WORD x432 = x43 & x[2];
+    const CSA_WORD x4310 = x431 & x[0];
+    const CSA_WORD x4320 = x432 & x[0];
+    const CSA_WORD x4321 = x432 & x[1];
+    s[0] = x[1] ^ x20 ^ x[3] ^ x30 ^ x310 ^ x40 ^ x43 ^ x431 ^ x432 ^ x4320;
+    s[1] = ~(x[0] ^ x[1] ^ x10 ^ x20 ^ x21 ^ x30 ^ x31 ^ x32 ^ x320 ^ x321 ^
+           x[4] ^ x410 ^ x42 ^ x421 ^ x43 ^ x431 ^ x4310 ^ x432 ^ x4321);
+}
+
+static inline CSA_TARGET
+void CSA_FUNC(csa_BsSbox2)( const CSA_WORD x[5], CSA_WORD s[2] )
+{
+    const CSA_WORD x20 = x[2] & x[0];
+    const CSA_WORD x21 = x[2] & x[1];
+    const CSA_WORD x42 = x[4] & x[2];
+    const CSA_WORD x43 = x[4] & x[3];
+    const CSA_WORD x210 = x21 & x[0];
+    const CSA_WORD x31 = x[3] & x[1];
+    const CSA_WORD x310 = x31 & x[0];
+    const CSA_WORD x32 = x[3] & x[2];
+    const CSA_WORD x320 = x32 & x[0];
+    const CSA_WORD x41 = x[4] & x[1];
+    const CSA_WORD x410 = x41 & x[0];
+    const CSA_WORD x421 = x42 & x[1];
+    const CSA_WORD x430 = x43 & x[0];
+    const CSA_WORD x431 = x43 & x[1];
+    const CSA_WORD x432 = x43 & x[2];
+    const CSA_WORD x4310 = x431 & x[0];
+    const CSA_WORD x4320 = x432 & x[0];
+    s[0] = ~(x[1] ^ x[2] ^ x20 ^ x310 ^ x320 ^ x410 ^ x42 ^ x43 ^ x4310 ^
+           x4320);
+    s[1] = ~(x[0] ^ x[1] ^ x20 ^ x21 ^ x210 ^ x[3] ^ x421 ^ x430 ^ x431 ^
+           x4310 ^ x432);
+}
+
+static inline CSA_TARGET
+void CSA_FUNC(csa_BsSbox3)( const CSA_WORD x[5], CSA_WORD s[2] )
+{
+    const CSA_WORD x10 = x[1] & x[0];
+    const CSA_WORD x20 = x[2] & x[0];
+    const CSA_WORD x21 = x[2] & x[1];
+    const CSA_WORD x30 = x[3] & x[0];
+    const CSA_WORD x31 = x[3] & x[1];
+    const CSA_WORD x32 = x[3] & x[2];
+    const CSA_WORD x41 = x[4] & x[1];
+    const CSA_WORD x42 = x[4] & x[2];
+    const CSA_WORD x210 = x21 & x[0];
+    const CSA_WORD x310 = x31 & x[0];
+    const CSA_WORD x321 = x32 & x[1];
+    const CSA_WORD x410 = x41 & x[0];
+    const CSA_WORD x420 = x42 & x[0];
+    const CSA_WORD x421 = x42 & x[1];
+    const CSA_WORD x43 = x[4] & x[3];
+    const CSA_WORD x430 = x43 & x[0];
+    const CSA_WORD x432 = x43 & x[2];
+    const CSA_WORD x4210 = x421 & x[0];
+    const CSA_WORD x4321 = x432 & x[1];
+    s[0] = x[1] ^ x10 ^ x20 ^ x[3] ^ x[4];
+    s[1] = ~(x[0] ^ x[1] ^ x20 ^ x21 ^ x210 ^ x[3] ^ x30 ^ x31 ^ x310 ^ x32 ^
+           x321 ^ x[4] ^ x41 ^ x410 ^ x42 ^ x420 ^ x421 ^ x4210 ^ x430 ^ x432
+           ^ x4321);
+}
+
+static inline CSA_TARGET
+void CSA_FUNC(csa_BsSbox4)( const CSA_WORD x[5], CSA_WORD s[2] )
+{
+    const CSA_WORD x10 = x[1] & x[0];
+    const CSA_WORD x30 = x[3] & x[0];
+    const CSA_WORD x32 = x[3] & x[2];
+    const CSA_WORD x40 = x[4] & x[0];
+    const CSA_WORD x41 = x[4] & x[1];
+    const CSA_WORD x43 = x[4] & x[3];
+    const CSA_WORD x21 = x[2] & x[1];
+    const CSA_WORD x210 = x21 & x[0];
+    const CSA_WORD x31 = x[3] & x[1];
+    const CSA_WORD x310 = x31 & x[0];
+    const CSA_WORD x321 = x32 & x[1];
+    const CSA_WORD x430 = x43 & x[0];
+    const CSA_WORD x432 = x43 & x[2];
+    const CSA_WORD x42 = x[4] & x[2];
+    const CSA_WORD x421 = x42 & x[1];
+    const CSA_WORD x4210 = x421 & x[0];
+    const CSA_WORD x431 = x43 & x[1];
+    const CSA_WORD x4310 = x431 & x[0];
+    const CSA_WORD x4321 = x432 & x[1];
+    s[0] = ~(x[1] ^ x10 ^ x[2] ^ x30 ^ x310 ^ x32 ^ x40 ^ x41 ^ x4210 ^ x43 ^
+           x430 ^ x4310 ^ x432 ^ x4321);
+    s[1] = ~(x[0] ^ x10 ^ x[2] ^ x210 ^ x[3] ^ x321 ^ x[4] ^ x40 ^ x41 ^
+           x4210 ^ x43 ^ x430 ^ x4310 ^ x432 ^ x4321);
+}
+
+static inline CSA_TARGET
+void CSA_FUNC(csa_BsSbox5)( const CSA_WORD x[5], CSA_WORD s[2] )
+{
+    const CSA_WORD x10 = x[1] & x[0];
+    const CSA_WORD x20 = x[2] & x[0];
+    const CSA_WORD x21 = x[2] & x[1];
+    const CSA_WORD x30 = x[3] & x[0];
+    const CSA_WORD x31 = x[3] & x[1];
+    const CSA_WORD x40 = x[4] & x[0];
+    const CSA_WORD x41 = x[4] & x[1];
+    const CSA_WORD x42 = x[4] & x[2];
+    const CSA_WORD x43 = x[4] & x[3];
+    const CSA_WORD x210 = x21 & x[0];
+    const CSA_WORD x310 = x31 & x[0];
+    const CSA_WORD x32 = x[3] & x[2];
+    const CSA_WORD x320 = x32 & x[0];
+    const CSA_WORD x321 = x32 & x[1];
+    const CSA_WORD x420 = x42 & x[0];
+    const CSA_WORD x421 = x42 & x[1];
+    const CSA_WORD x430 = x43 & x[0];
+    const CSA_WORD x431 = x43 & x[1];
+    const CSA_WORD x4210 = x421 & x[0];
+    const CSA_WORD x4310 = x431 & x[0];
+    const CSA_WORD x432 = x43 & x[2];
+    const CSA_WORD x4320 = x432 & x[0];
+    const CSA_WORD x4321 = x432 & x[1];
+    s[0] = x10 ^ x[2] ^ x20 ^ x210 ^ x30 ^ x31 ^ x320 ^ x40 ^ x42 ^ x420 ^
+           x421 ^ x4210 ^ x43 ^ x430 ^ x431 ^ x4310;
+    s[1] = ~(x[0] ^ x[1] ^ x10 ^ x20 ^ x21 ^ x210 ^ x[3] ^ x30 ^ x310 ^ x320
+           ^ x321 ^ x40 ^ x41 ^ x42 ^ x421 ^ x4210 ^ x430 ^ x431 ^ x4320 ^
+           x4321);
+}
+
+static inline CSA_TARGET
+void CSA_FUNC(csa_BsSbox6)( const CSA_WORD x[5], CSA_WORD s[2] )
+{
+    const CSA_WORD x20 = x[2] & x[0];
+    const CSA_WORD x21 = x[2] & x[1];
+    const CSA_WORD x31 = x[3] & x[1];
+    const CSA_WORD x32 = x[3] & x[2];
+    const CSA_WORD x210 = x21 & x[0];
+    const CSA_WORD x310 = x31 & x[0];
+    const CSA_WORD x320 = x32 & x[0];
+    const CSA_WORD x321 = x32 & x[1];
+    const CSA_WORD x41 = x[4] & x[1];
+    const CSA_WORD x410 = x41 & x[0];
+    const CSA_WORD x42 = x[4] & x[2];
+    const CSA_WORD x421 = x42 & x[1];
+    const CSA_WORD x43 = x[4] & x[3];
+    const CSA_WORD x430 = x43 & x[0];
+    const CSA_WORD x4210 = x421 & x[0];
+    const CSA_WORD x431 = x43 & x[1];
+    const CSA_WORD x4310 = x431 & x[0];
+    const CSA_WORD x432 = x43 & x[2];
+    const CSA_WORD x4321 = x432 & x[1];
+    s[0] = x[0] ^ x[2] ^ x21 ^ x210 ^ x31 ^ x32 ^ x321 ^ x410 ^ x421 ^ x4210
+           ^ x4310 ^ x4321;
+    s[1] = x[1] ^ x20 ^ x310 ^ x32 ^ x320 ^ x[4] ^ x410 ^ x430;
+}
+
+static inline CSA_TARGET
+void CSA_FUNC(csa_BsSbox7)( const CSA_WORD x[5], CSA_WORD s[2] )
+{
+    const CSA_WORD x10 = x[1] & x[0];
+    const CSA_WORD x21 = x[2] & x[1];
+    const CSA_WORD x32 = x[3] & x[2];
+    const CSA_WORD x40 = x[4] & x[0];
+    const CSA_WORD x42 = x[4] & x[2];
+    const CSA_WORD x210 = x21 & x[0];
+    const CSA_WORD x31 = x[3] & x[1];
+    const CSA_WORD x310 = x31 & x[0];
+    const CSA_WORD x41 = x[4] & x[1];
+    const CSA_WORD x410 = x41 & x[0];
+    const CSA_WORD x421 = x42 & x[1];
+    const CSA_WORD x43 = x[4] & x[3];
+    const CSA_WORD x431 = x43 & x[1];
+    const CSA_WORD x4210 = x421 & x[0];
+    const CSA_WORD x4310 = x431 & x[0];
+    const CSA_WORD x432 = x43 & x[2];
+    const CSA_WORD x4321 = x432 & x[1];
+    s[0] = x[0] ^ x10 ^ x[2] ^ x21 ^ x210 ^ x[3] ^ x32 ^ x[4] ^ x431 ^ x4310;
+    s[1] = x[0] ^ x[1] ^ x10 ^ x[2] ^ x[3] ^ x310 ^ x40 ^ x410 ^ x42 ^ x421 ^
+           x4210 ^ x4310 ^ x4321;
+}
+
+
+/* A[1..10] and B[1..10] slide down a longer buffer instead of being shifted
+ * at every clock: register k lives at index i_pos + k - 1. */
+#define CSA_SLIDE 32
+
+typedef struct
+{
+    CSA_WORD A[CSA_SLIDE + 10][4];
+    CSA_WORD B[CSA_SLIDE + 10][4];
+    int      i_pos;
+    CSA_WORD X[4], Y[4], Z[4];
+    CSA_WORD D[4], E[4], F[4];
+    CSA_WORD p, q, r;
+} CSA_FUNC(csa_bs_t);
+
+#define CSA_A( k ) c->A[c->i_pos + (k) - 1]
+#define CSA_B( k ) c->B[c->i_pos + (k) - 1]
+
+/* Clocks the cypher once (2 output bits) */
+static inline CSA_TARGET
+void CSA_FUNC(csa_BsClock)( CSA_FUNC(csa_bs_t) *c, const CSA_WORD *in_a,
+                            const CSA_WORD *in_b, CSA_WORD op[2] )
+{
+    CSA_WORD x[5], s1[2], s2[2], s3[2], s4[2], s5[2], s6[2], s7[2];
+    CSA_WORD extra_B[4], next_A1[4], next_B1[4];
+    CSA_WORD carry;
+    int k;
+
+    x[4] = CSA_A(4)[0]; x[3] = CSA_A(1)[2]; x[2] = CSA_A(6)[1];
+    x[1] = CSA_A(7)[3]; x[0] = CSA_A(9)[0];
+    CSA_FUNC(csa_BsSbox1)( x, s1 );
+    x[4] = CSA_A(2)[1]; x[3] = CSA_A(3)[2]; x[2] = CSA_A(6)[3];
+    x[1] = CSA_A(7)[0]; x[0] = CSA_A(9)[1];
+    CSA_FUNC(csa_BsSbox2)( x, s2 );
+    x[4] = CSA_A(1)[3]; x[3] = CSA_A(2)[0]; x[2] = CSA_A(5)[1];
+    x[1] = CSA_A(5)[3]; x[0] = CSA_A(6)[2];
+    CSA_FUNC(csa_BsSbox3)( x, s3 );
+    x[4] = CSA_A(3)[3]; x[3] = CSA_A(1)[1]; x[2] = CSA_A(2)[3];
+    x[1] = CSA_A(4)[2]; x[0] = CSA_A(8)[0];
+    CSA_FUNC(csa_BsSbox4)( x, s4 );
+    x[4] = CSA_A(5)[2]; x[3] = CSA_A(4)[3]; x[2] = CSA_A(6)[0];
+    x[1] = CSA_A(8)[1]; x[0] = CSA_A(9)[2];
+    CSA_FUNC(csa_BsSbox5)( x, s5 );
+    x[4] = CSA_A(3)[1]; x[3] = CSA_A(4)[1]; x[2] = CSA_A(5)[0];
+    x[1] = CSA_A(7)[2]; x[0] = CSA_A(9)[3];
+    CSA_FUNC(csa_BsSbox6)( x, s6 );
+    x[4] = CSA_A(2)[2]; x[3] = CSA_A(3)[0]; x[2] = CSA_A(7)[1];
+    x[1] = CSA_A(8)[2]; x[0] = CSA_A(8)[3];
+    CSA_FUNC(csa_BsSbox7)( x, s7 );
+
+    /* use 4x4 xor to produce extra nibble for T3 */
+    extra_B[3] = CSA_B(3)[0] ^ CSA_B(6)[1] ^ CSA_B(7)[2] ^ CSA_B(9)[3];
+    extra_B[2] = CSA_B(6)[0] ^ CSA_B(8)[1] ^ CSA_B(3)[3] ^ CSA_B(4)[2];
+    extra_B[1] = CSA_B(5)[3] ^ CSA_B(8)[2] ^ CSA_B(4)[0] ^ CSA_B(5)[1];
+    extra_B[0] = CSA_B(9)[2] ^ CSA_B(6)[3] ^ CSA_B(3)[1] ^ CSA_B(8)[0];
+
+    for( k = 0; k < 4; k++ )
+    {
+        /* T1 and T2, the inputs are only used during initialisation */
+        next_A1[k] = CSA_A(10)[k] ^ c->X[k];
+        next_B1[k] = CSA_B(7)[k] ^ CSA_B(10)[k] ^ c->Y[k];
+        if( in_a != NULL )
+        {
+            next_A1[k] ^= c->D[k] ^ in_a[k];
+            next_B1[k] ^= in_b[k];
+        }
+    }
+
+    /* if p=1, rotate T2 left */
+    const CSA_WORD b3 = next_B1[3];
+    next_B1[3] = CSA_SELECT( c->p, next_B1[2], b3 );
+    next_B1[2] = CSA_SELECT( c->p, next_B1[1], next_B1[2] );
+    next_B1[1] = CSA_SELECT( c->p, next_B1[0], next_B1[1] );
+    next_B1[0] = CSA_SELECT( c->p, b3, next_B1[0] );
+
+    /* T3 and T4: if q=1, F = Z + E + r with r the carry */
+    carry = c->r;
+    for( k = 0; k < 4; k++ )
+    {
+        const CSA_WORD z = c->Z[k], e = c->E[k];
+        const CSA_WORD sum = z ^ e ^ carry;
+
+        carry = (z & e) | (carry & (z ^ e));
+        c->D[k] = e ^ z ^ extra_B[k];
+        c->E[k] = c->F[k];
+        c->F[k] = CSA_SELECT( c->q, sum, e );
+    }
+    c->r = CSA_SELECT( c->q, carry, c->r );
+
+    /* shift A and B */
+    if( c->i_pos == 0 )
+    {
+        memcpy( &c->A[CSA_SLIDE], &c->A[0], 10 * sizeof( c->A[0] ) );
+        memcpy( &c->B[CSA_SLIDE], &c->B[0], 10 * sizeof( c->B[0] ) );
+        c->i_pos = CSA_SLIDE;
+    }
+    c->i_pos--;
+    memcpy( CSA_A(1), next_A1, sizeof( next_A1 ) );
+    memcpy( CSA_B(1), next_B1, sizeof( next_B1 ) );
+
+    c->X[3] = s4[0]; c->X[2] = s3[0]; c->X[1] = s2[1]; c->X[0] = s1[1];
+    c->Y[3] = s6[0]; c->Y[2] = s5[0]; c->Y[1] = s4[1]; c->Y[0] = s3[1];
+    c->Z[3] = s2[0]; c->Z[2] = s1[0]; c->Z[1] = s6[1]; c->Z[0] = s5[1];
+    c->p = s7[1];
+    c->q = s7[0];
+
+    /* 2 output bits are a function of the 4 bits of D */
+    op[1] = c->D[2] ^ c->D[3];
+    op[0] = c->D[0] ^ c->D[1];
+}
+
+/* Loads the key in every lane and clocks in the first block (the IV) of each
+ * packet, given as 64 bit planes of CSA_WORDS words each */
+static CSA_TARGET
+void CSA_FUNC(csa_BsInit)( CSA_FUNC(csa_bs_t) *c, const uint8_t ck[8],
+                           const uint64_t *iv )
+{
+    const CSA_WORD zero = { 0 };
+    const CSA_WORD ones = ~zero;
+    int i, j, k;
+
+    memset( c, 0, sizeof( *c ) );
+    c->i_pos = CSA_SLIDE;
+
+    /* load first 32 bits of CK into A[1]..A[8]
+     * load last  32 bits of CK into B[1]..B[8] */
+    for( i = 0; i < 4; i++ )
+    {
+        for( k = 0; k < 4; k++ )
+        {
+            CSA_A(1+2*i+0)[k] = ( ck[i] >> (4+k) )&1 ? ones : zero;
+            CSA_A(1+2*i+1)[k] = ( ck[i] >> k )&1 ? ones : zero;
+            CSA_B(1+2*i+0)[k] = ( ck[4+i] >> (4+k) )&1 ? ones : zero;
+            CSA_B(1+2*i+1)[k] = ( ck[4+i] >> k )&1 ? ones : zero;
+        }
+    }
+
+    for( i = 0; i < 8; i++ )
+    {
+        CSA_WORD in[8];
+
+        memcpy( in, &iv[8 * CSA_WORDS * i], sizeof( in ) );
+        for( j = 0; j < 4; j++ )
+        {
+            CSA_WORD op[2];
+
+            /* in1 is the high nibble, in2 the low one */
+            if( j % 2 )
+                CSA_FUNC(csa_BsClock)( c, &in[0], &in[4], op );
+            else
+                CSA_FUNC(csa_BsClock)( c, &in[4], &in[0], op );
+        }
+    }
+}
+
+/* Generates the next 8 bytes of key stream, as 64 bit planes */
+static CSA_TARGET
+void CSA_FUNC(csa_BsGenerate)( CSA_FUNC(csa_bs_t) *c, uint64_t *ks )
+{
+    for( int i = 0; i < 8; i++ )
+    {
+        CSA_WORD op[8];
+
+        for( int j = 0; j < 4; j++ )
+            CSA_FUNC(csa_BsClock)( c, NULL, NULL, &op[6-2*j] );
+        memcpy( &ks[8 * CSA_WORDS * i], op, sizeof( op ) );
+    }
+}
+
+/* Applies the stream cypher to up to CSA_BATCH packets sharing a key: the
+ * first block of each packet is the IV, the following ones and the residue
+ * are xored with the key stream. */
+static CSA_TARGET
+void CSA_FUNC(csa_BsStream)( const uint8_t ck[8], uint8_t **pp_data,
+                             const int *pi_size, int i_count )
+{
+    CSA_FUNC(csa_bs_t) c;
+    uint64_t planes[64 * CSA_WORDS];
+    uint8_t  stream[CSA_BATCH][8];
+    int      i_stream = 0;
+
+    assert( i_count <= CSA_BATCH );
+
+    for( int l = 0; l < i_count; l++ )
+    {
+        memcpy( stream[l], pp_data[l], 8 );
+        /* blocks 1..n-1 and the residue */
+        i_stream = __MAX( i_stream, (pi_size[l] - 1) / 8 );
+    }
+    csa_BytesToPlanes( planes, stream, i_count, CSA_WORDS );
+    CSA_FUNC(csa_BsInit)( &c, ck, planes );
+
+    for( int i = 1; i <= i_stream; i++ )
+    {
+        CSA_FUNC(csa_BsGenerate)( &c, planes );
+        csa_PlanesToBytes( stream, planes, i_count, CSA_WORDS );
+
+        for( int l = 0; l < i_count; l++ )
+        {
+            const int i_end = __MIN( 8 * i + 8, pi_size[l] );
+            uint8_t *p = pp_data[l];
+
+            for( int j = 8 * i; j < i_end; j++ )
+                p[j] ^= stream[l][j - 8 * i];
+        }
+    }
+}
+
+#undef CSA_B
+#undef CSA_A
+#undef CSA_SLIDE
+#undef CSA_WORDS
@@ -21,6 +21,7 @@
 #include "Streams.hpp"
 #include "adaptationlogic/IAdaptationLogic.h"
 #include "adaptationlogic/AdaptationLogicFactory.h"
+#include "buffer/BlockBuffer.h"
 #include <vlc_stream.h>
 #include <vlc_demux.h>
 
@@ -44,12 +45,16 @@ void Stream::init(const Type type_, const Format format_)
     format = format_;
     output = NULL;
     currentChunk = NULL;
+    nextChunk = NULL;
     eof = false;
+    downloaded = 0;
+    firstPCR = VLC_TS_INVALID;
 }
 
 Stream::~Stream()
 {
     delete currentChunk;
+    delete nextChunk;
     delete adaptationLogic;
     delete output;
 }
@@ -127,7 +132,12 @@ bool Stream::operator ==(const Stream &stream) const
 
 Chunk * Stream::getChunk()
 {
-    if (currentChunk == NULL)
+    if (currentChunk == NULL && nextChunk != NULL)
+    {
+        currentChunk = nextChunk;
+        nextChunk = NULL;
+    }
+    else if (currentChunk == NULL)
     {
         currentChunk = adaptationLogic->getNextChunk(type);
         if (currentChunk == NULL)
@@ -149,6 +159,7 @@ size_t Stream::read(HTTPConnectionManager *connManager)
     }
 
     size_t readsize = 0;
+    const int bitrate = chunk->getBitrate();
 
     /* Because we don't know Chunk size at start, we need to get size
        from content length */
@@ -167,6 +178,14 @@ size_t Stream::read(HTTPConnectionManager *connManager)
     if (readsize > 128000)
         readsize = 32768;
 
+    /* Ask for the next chunk behind this one, on the same connection */
+    if(!nextChunk && !eof && connManager->canPipeline(chunk))
+    {
+        nextChunk = adaptationLogic->getNextChunk(type);
+        if(nextChunk)
+            connManager->pipelineChunk(nextChunk, chunk);
+    }
+
     block_t *block = block_Alloc(readsize);
     if(!block)
         return 0;
@@ -201,10 +220,34 @@ size_t Stream::read(HTTPConnectionManager *connManager)
     readsize = block->i_buffer;
 
     output->pushBlock(block);
+    updateBufferLevel(readsize, bitrate);
 
     return readsize;
 }
 
+/* The buffer is what was downloaded, in media time, and not yet
+ * consumed by the demuxer (as told by its PCR) */
+void Stream::updateBufferLevel(size_t size, int bitrate)
+{
+    if(bitrate > 1)
+        downloaded += (mtime_t) size * 8 * CLOCK_FREQ / bitrate;
+
+    mtime_t pcr = output->getPCR();
+    if(firstPCR == VLC_TS_INVALID && pcr > VLC_TS_0)
+        firstPCR = pcr;
+    mtime_t consumed = (firstPCR != VLC_TS_INVALID) ? pcr - firstPCR : 0;
+
+    mtime_t buffered = downloaded - consumed;
+    if(buffered < 0)
+    {
+        /* underrun */
+        downloaded = consumed;
+        buffered = 0;
+    }
+    adaptationLogic->bufferLevelChanged(buffered,
+                                        __MIN(100, buffered * 100 / DEFAULTBUFFERLENGTH));
+}
+
 AbstractStreamOutput::AbstractStreamOutput(demux_t *demux)
 {
     realdemux = demux;
@@ -56,12 +56,16 @@ namespace dash
             private:
                 http::Chunk *getChunk();
                 void init(const Type, const Format);
+                void updateBufferLevel(size_t, int);
                 Type type;
                 Format format;
                 AbstractStreamOutput *output;
                 logic::IAdaptationLogic *adaptationLogic;
                 http::Chunk *currentChunk;
+                http::Chunk *nextChunk; /* pipelined behind currentChunk */
                 bool eof;
+                mtime_t downloaded; /* media time, from the representation bitrate */
+                mtime_t firstPCR;
         };
 
         class AbstractStreamOutput
@@ -61,7 +61,12 @@ Chunk*  AbstractAdaptationLogic::getNextChunk(Streams::Type type)
     ISegment *first = segments.empty() ? NULL : segments.front();
 
     if (reinit && first && first->getClassId() == InitSegment::CLASSID_INITSEGMENT)
-        return first->toChunk(count, rep);
+    {
+        Chunk *chunk = first->toChunk(count, rep);
+        if(chunk)
+            chunk->setBitrate(rep->getBandwidth());
+        return chunk;
+    }
 
     bool b_templated = (first && !first->isSingleShot());
 
@@ -85,6 +90,8 @@ Chunk*  AbstractAdaptationLogic::getNextChunk(Streams::Type type)
     if(seg)
     {
         Chunk *chunk = seg->toChunk(count, rep);
+        if(chunk)
+            chunk->setBitrate(rep->getBandwidth());
         count++;
         seg->done();
         return chunk;
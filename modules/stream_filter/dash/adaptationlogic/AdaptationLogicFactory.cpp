@@ -29,6 +29,7 @@
 #include "adaptationlogic/AlwaysBestAdaptationLogic.h"
 #include "adaptationlogic/RateBasedAdaptationLogic.h"
 #include "adaptationlogic/AlwaysLowestAdaptationLogic.hpp"
+#include "adaptationlogic/NearOptimalAdaptationLogic.hpp"
 
 using namespace dash::logic;
 using namespace dash::mpd;
@@ -41,6 +42,7 @@ IAdaptationLogic* AdaptationLogicFactory::create ( IAdaptationLogic::LogicType l
         case IAdaptationLogic::AlwaysBest:      return new AlwaysBestAdaptationLogic    (mpd);
         case IAdaptationLogic::AlwaysLowest:    return new AlwaysLowestAdaptationLogic  (mpd);
         case IAdaptationLogic::FixedRate:       return new FixedRateAdaptationLogic     (mpd);
+        case IAdaptationLogic::NearOptimal:     return new NearOptimalAdaptationLogic   (mpd);
         case IAdaptationLogic::Default:
         case IAdaptationLogic::RateBased:       return new RateBasedAdaptationLogic     (mpd);
         default:
@@ -45,7 +45,8 @@ namespace dash
                     AlwaysBest,
                     AlwaysLowest,
                     RateBased,
-                    FixedRate
+                    FixedRate,
+                    NearOptimal
                 };
 
                 virtual dash::http::Chunk*                  getNextChunk            (Streams::Type) = 0;
@@ -0,0 +1,209 @@
+/*
+ * NearOptimalAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2014 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "NearOptimalAdaptationLogic.hpp"
+#include "Representationselectors.hpp"
+
+#include <vlc_common.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace dash::logic;
+using namespace dash::mpd;
+using namespace dash::http;
+
+#define SAMPLE_DURATION     (CLOCK_FREQ / 20)
+#define FAST_HALFLIFE       2.0 /* seconds of download */
+#define SLOW_HALFLIFE       5.0
+#define SAFETY_FACTOR       0.9
+
+#define MINIMUM_BUFFER      (10 * CLOCK_FREQ)
+#define BUFFER_PER_LEVEL    (2 * CLOCK_FREQ)
+#define LOW_BUFFER          (2 * CLOCK_FREQ)
+
+static bool compareBandwidth(const Representation *a, const Representation *b)
+{
+    return a->getBandwidth() < b->getBandwidth();
+}
+
+NearOptimalAdaptationLogic::NearOptimalAdaptationLogic(MPD *mpd) :
+    AbstractAdaptationLogic(mpd),
+    obj(mpd->getVLCObject()),
+    sampleBytes(0), sampleTime(0),
+    fastEstimate(0), slowEstimate(0), totalWeight(0),
+    bufferLevel(0),
+    switches(0), stalls(0), totalBytes(0), totalTime(0)
+{
+}
+
+NearOptimalAdaptationLogic::~NearOptimalAdaptationLogic()
+{
+    msg_Dbg(obj, "adaptation: %u switches, %u stalls, "
+            "average throughput %" PRIu64 " bps, estimate %" PRIu64 " bps",
+            switches, stalls,
+            totalBytes * 8 * CLOCK_FREQ / __MAX(1, totalTime),
+            getThroughput());
+}
+
+std::vector<Representation *> NearOptimalAdaptationLogic::getRepresentations(Streams::Type type) const
+{
+    std::vector<Representation *> reps;
+    std::vector<AdaptationSet *> adaptSets = currentPeriod->getAdaptationSets(type);
+    std::vector<AdaptationSet *>::const_iterator adaptIt;
+    for(adaptIt=adaptSets.begin(); adaptIt!=adaptSets.end(); adaptIt++)
+    {
+        std::vector<Representation *> setReps = (*adaptIt)->getRepresentations();
+        reps.insert(reps.end(), setReps.begin(), setReps.end());
+    }
+    std::stable_sort(reps.begin(), reps.end(), compareBandwidth);
+    return reps;
+}
+
+Representation *NearOptimalAdaptationLogic::getCurrentRepresentation(Streams::Type type) const
+{
+    if(currentPeriod == NULL)
+        return NULL;
+
+    std::vector<Representation *> reps = getRepresentations(type);
+    const uint64_t throughput = getThroughput();
+    if(reps.empty())
+    {
+        RepresentationSelector selector;
+        return selector.select(currentPeriod, type);
+    }
+    /* Nothing measured yet: start low */
+    if(reps.size() == 1 || throughput == 0)
+        return reps.front();
+
+    /* BOLA: maximize (V * (utility + gp) - buffer) / bitrate, with
+     * utility = ln(bitrate / lowest bitrate) + 1 */
+    const size_t n = reps.size();
+    const double lowest = __MAX(1, reps.front()->getBandwidth());
+    const double target = __MAX(MINIMUM_BUFFER + BUFFER_PER_LEVEL * n,
+                                3 * MINIMUM_BUFFER) / (double) CLOCK_FREQ;
+    const double minimum = MINIMUM_BUFFER / (double) CLOCK_FREQ;
+    const double gp = log(__MAX(1, reps.back()->getBandwidth()) / lowest) /
+                      (target / minimum - 1);
+    const double V = minimum / __MAX(gp, 1e-6);
+    const double buffer = bufferLevel / (double) CLOCK_FREQ;
+
+    size_t bola = 0, safe = 0;
+    double bestScore = -HUGE_VAL;
+    ssize_t current = -1;
+    for(size_t i = 0; i < n; i++)
+    {
+        const double bitrate = __MAX(1, reps[i]->getBandwidth());
+        const double score = (V * (log(bitrate / lowest) + 1 + gp) - buffer) / bitrate;
+        if(score > bestScore)
+        {
+            bestScore = score;
+            bola = i;
+        }
+        if(bitrate <= throughput * SAFETY_FACTOR)
+            safe = i;
+        if(reps[i] == prevRepresentation)
+            current = i;
+    }
+
+    size_t choice = bola;
+    if(bufferLevel < LOW_BUFFER)
+    {
+        /* Stalled or about to: only what the network surely sustains */
+        choice = std::min(bola, safe);
+        if(current >= 0)
+            choice = std::min(choice, (size_t) current);
+    }
+    else if(current >= 0 && bola > (size_t) current)
+    {
+        /* Up one step at a time, and only if the throughput allows */
+        choice = (safe > (size_t) current) ? current + 1 : current;
+    }
+    return reps[choice];
+}
+
+Chunk * NearOptimalAdaptationLogic::getNextChunk(Streams::Type type)
+{
+    const Representation *prev = prevRepresentation;
+    Chunk *chunk = AbstractAdaptationLogic::getNextChunk(type);
+
+    if(prev && prevRepresentation && prev != prevRepresentation)
+    {
+        switches++;
+        msg_Dbg(obj, "adaptation: %s %s (%" PRIu64 " bps) -> %s (%" PRIu64 " bps), "
+                "throughput %" PRIu64 " bps, buffer %" PRId64 " ms",
+                (prevRepresentation->getBandwidth() > prev->getBandwidth()) ? "up" : "down",
+                prev->getId().c_str(), prev->getBandwidth(),
+                prevRepresentation->getId().c_str(), prevRepresentation->getBandwidth(),
+                getThroughput(), bufferLevel / 1000);
+    }
+    return chunk;
+}
+
+void NearOptimalAdaptationLogic::updateDownloadRate(size_t size, mtime_t time)
+{
+    totalBytes += size;
+    totalTime += time;
+
+    sampleBytes += size;
+    sampleTime += time;
+    if(sampleTime < SAMPLE_DURATION)
+        return;
+
+    /* Moving averages weighted by the sample duration */
+    const double duration = sampleTime / (double) CLOCK_FREQ;
+    const double bps = sampleBytes * 8 / duration;
+    const double fast = pow(0.5, duration / FAST_HALFLIFE);
+    const double slow = pow(0.5, duration / SLOW_HALFLIFE);
+
+    fastEstimate = fast * fastEstimate + (1 - fast) * bps;
+    slowEstimate = slow * slowEstimate + (1 - slow) * bps;
+    totalWeight += duration;
+
+    sampleBytes = 0;
+    sampleTime = 0;
+}
+
+uint64_t NearOptimalAdaptationLogic::getThroughput() const
+{
+    if(totalWeight == 0)
+        return 0;
+
+    /* Correct the bias towards the zero initial value */
+    const double fast = fastEstimate / (1 - pow(0.5, totalWeight / FAST_HALFLIFE));
+    const double slow = slowEstimate / (1 - pow(0.5, totalWeight / SLOW_HALFLIFE));
+    return std::min(fast, slow);
+}
+
+void NearOptimalAdaptationLogic::bufferLevelChanged(mtime_t bufferedMicroSec, int bufferedPercent)
+{
+    AbstractAdaptationLogic::bufferLevelChanged(bufferedMicroSec, bufferedPercent);
+
+    if(bufferedMicroSec == 0 && bufferLevel > 0)
+    {
+        stalls++;
+        msg_Dbg(obj, "adaptation: buffer underrun, throughput %" PRIu64 " bps",
+                getThroughput());
+    }
+    bufferLevel = bufferedMicroSec;
+}
@@ -0,0 +1,70 @@
+/*
+ * NearOptimalAdaptationLogic.hpp
+ *****************************************************************************
+ * Copyright (C) 2014 - VideoLAN authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef NEAROPTIMALADAPTATIONLOGIC_HPP
+#define NEAROPTIMALADAPTATIONLOGIC_HPP
+
+#include "AbstractAdaptationLogic.h"
+
+#include <vector>
+
+namespace dash
+{
+    namespace logic
+    {
+        /* Buffer based selection (BOLA), bounded by a throughput estimate:
+         * drops at once when the buffer runs low, climbs one step at a time
+         * and never above what the network delivers. */
+        class NearOptimalAdaptationLogic : public AbstractAdaptationLogic
+        {
+            public:
+                NearOptimalAdaptationLogic(mpd::MPD *mpd);
+                virtual ~NearOptimalAdaptationLogic();
+
+                virtual dash::http::Chunk *getNextChunk(Streams::Type);
+                dash::mpd::Representation *getCurrentRepresentation(Streams::Type) const;
+                virtual void updateDownloadRate(size_t, mtime_t);
+                virtual void bufferLevelChanged(mtime_t bufferedMicroSec, int bufferedPercent);
+
+            private:
+                uint64_t getThroughput() const;
+                std::vector<dash::mpd::Representation *> getRepresentations(Streams::Type) const;
+
+                vlc_object_t           *obj;
+
+                /* throughput: samples of at least SAMPLE_DURATION feed a
+                 * fast and a slow moving average, the lowest one wins */
+                size_t                  sampleBytes;
+                mtime_t                 sampleTime;
+                double                  fastEstimate;
+                double                  slowEstimate;
+                double                  totalWeight;
+
+                mtime_t                 bufferLevel;
+
+                /* stats */
+                unsigned                switches;
+                unsigned                stalls;
+                uint64_t                totalBytes;
+                mtime_t                 totalTime;
+        };
+    }
+}
+
+#endif // NEAROPTIMALADAPTATIONLOGIC_HPP
@@ -61,11 +61,13 @@ static void Close   (vlc_object_t *);
 #define DASH_LOGIC_TEXT N_("Adaptation Logic")
 
 static const int pi_logics[] = {dash::logic::IAdaptationLogic::RateBased,
+                                dash::logic::IAdaptationLogic::NearOptimal,
                                 dash::logic::IAdaptationLogic::FixedRate,
                                 dash::logic::IAdaptationLogic::AlwaysLowest,
                                 dash::logic::IAdaptationLogic::AlwaysBest};
 
 static const char *const ppsz_logics[] = { N_("Bandwidth Adaptive"),
+                                           N_("Buffer and Bandwidth Adaptive"),
                                            N_("Fixed Bandwidth"),
                                            N_("Lowest Bandwidth/Quality"),
                                            N_("Highest Bandwith/Quality")};
@@ -78,6 +78,11 @@ void HTTPConnection::onHeader(const std::string &key,
 }
 
 std::string HTTPConnection::extraRequestHeaders() const
+{
+    return rangeRequestHeader(chunk);
+}
+
+std::string HTTPConnection::rangeRequestHeader(const Chunk *chunk) const
 {
     std::stringstream ss;
     if(chunk->usesByteRange())
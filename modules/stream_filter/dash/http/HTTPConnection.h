@@ -50,6 +50,7 @@ namespace dash
                 size_t toRead;
                 Chunk *chunk;
                 virtual std::string extraRequestHeaders() const;
+                std::string         rangeRequestHeader(const Chunk *) const;
                 virtual std::string buildRequestHeader(const std::string &path) const;
         };
     }
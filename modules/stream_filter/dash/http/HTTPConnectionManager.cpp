@@ -56,12 +56,24 @@ void HTTPConnectionManager::releaseAllConnections()
         (*it)->releaseChunk();
 }
 
-PersistentConnection * HTTPConnectionManager::getConnectionForHost(const std::string &hostname)
+PersistentConnection * HTTPConnectionManager::getConnectionForHost(const std::string &hostname, int port)
 {
     std::vector<PersistentConnection *>::const_iterator it;
     for(it = connectionPool.begin(); it != connectionPool.end(); it++)
     {
-        if(!(*it)->getHostname().compare(hostname) && (*it)->isAvailable())
+        if(!(*it)->getHostname().compare(hostname) && (*it)->getPort() == port &&
+           (*it)->isAvailable())
+            return *it;
+    }
+    return NULL;
+}
+
+PersistentConnection * HTTPConnectionManager::getConnectionForChunk(const Chunk *chunk) const
+{
+    std::vector<PersistentConnection *>::const_iterator it;
+    for(it = connectionPool.begin(); it != connectionPool.end(); it++)
+    {
+        if(*it == chunk->getConnection())
             return *it;
     }
     return NULL;
@@ -76,7 +88,7 @@ bool HTTPConnectionManager::connectChunk(Chunk *chunk)
 
     msg_Dbg(stream, "Retrieving %s", chunk->getUrl().c_str());
 
-    PersistentConnection *conn = getConnectionForHost(chunk->getHostname());
+    PersistentConnection *conn = getConnectionForHost(chunk->getHostname(), chunk->getPort());
     if(!conn)
     {
         conn = new PersistentConnection(stream, chunk);
@@ -94,3 +106,25 @@ bool HTTPConnectionManager::connectChunk(Chunk *chunk)
 
     return true;
 }
+
+bool HTTPConnectionManager::canPipeline(const Chunk *after) const
+{
+    PersistentConnection *conn = getConnectionForChunk(after);
+    return conn && conn->canPipeline();
+}
+
+/* Requests the chunk on the connection of the one before, so that its reply
+ * follows without waiting for a new request or connection */
+bool HTTPConnectionManager::pipelineChunk(Chunk *chunk, const Chunk *after)
+{
+    PersistentConnection *conn = getConnectionForChunk(after);
+    if(!conn || !conn->pipeline(chunk))
+        return false;
+
+    msg_Dbg(stream, "Pipelining %s", chunk->getUrl().c_str());
+
+    if(chunk->getBitrate() <= 0)
+        chunk->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
+
+    return true;
+}
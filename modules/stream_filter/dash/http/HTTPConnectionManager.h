@@ -48,6 +48,8 @@ namespace dash
                 void    closeAllConnections ();
                 void    releaseAllConnections ();
                 bool    connectChunk        (Chunk *chunk);
+                bool    canPipeline         (const Chunk *after) const;
+                bool    pipelineChunk       (Chunk *chunk, const Chunk *after);
 
             private:
                 Chunk                                               *currentChunk;
@@ -56,7 +58,8 @@ namespace dash
 
                 static const uint64_t   CHUNKDEFAULTBITRATE;
 
-                PersistentConnection *                  getConnectionForHost    (const std::string &hostname);
+                PersistentConnection *                  getConnectionForHost    (const std::string &hostname, int port);
+                PersistentConnection *                  getConnectionForChunk   (const Chunk *chunk) const;
         };
     }
 }
@@ -34,6 +34,10 @@ IHTTPConnection::IHTTPConnection(stream_t *stream_)
 {
     stream = stream_;
     httpSocket = -1;
+    port = 80;
+    latency = 0;
+    statBytes = 0;
+    statTime = 0;
     psz_useragent = var_InheritString(stream, "http-user-agent");
 }
 
@@ -47,6 +51,7 @@ bool IHTTPConnection::connect(const std::string &hostname, int port)
 {
     httpSocket = net_ConnectTCP(stream, hostname.c_str(), port);
     this->hostname = hostname;
+    this->port = port;
 
     if(httpSocket == -1)
         return false;
@@ -72,18 +77,40 @@ bool IHTTPConnection::query(const std::string &path)
 {
     std::string header = buildRequestHeader(path);
     header.append("\r\n");
+    mtime_t start = mdate();
     if (!send( header ) || !parseReply())
         return false;
+    latency = mdate() - start;
     return true;
 }
 
 ssize_t IHTTPConnection::read(void *p_buffer, size_t len)
 {
+    mtime_t start = mdate();
     ssize_t size = net_Read(stream, httpSocket, NULL, p_buffer, len, true);
     if(size <= 0)
         return -1;
-    else
-        return size;
+
+    statBytes += size;
+    statTime += mdate() - start;
+    if(statTime > 2 * CLOCK_FREQ)
+    {
+        statBytes /= 2;
+        statTime /= 2;
+    }
+    return size;
+}
+
+uint64_t IHTTPConnection::getThroughput() const
+{
+    if(statTime == 0)
+        return 0;
+    return statBytes * 8 * CLOCK_FREQ / statTime;
+}
+
+mtime_t IHTTPConnection::getLatency() const
+{
+    return latency;
 }
 
 bool IHTTPConnection::send(const std::string &data)
@@ -125,7 +152,7 @@ bool IHTTPConnection::parseReply()
     if (replycode != 200 && replycode != 206)
         return false;
 
-    readLine();
+    line = readLine();
 
     while(!line.empty() && line.compare("\r\n"))
     {
@@ -164,11 +191,20 @@ std::string IHTTPConnection::readLine()
 }
 
 std::string IHTTPConnection::buildRequestHeader(const std::string &path) const
+{
+    return buildRequest(path, extraRequestHeaders());
+}
+
+std::string IHTTPConnection::buildRequest(const std::string &path,
+                                          const std::string &extraHeaders) const
 {
     std::stringstream req;
     req << "GET " << path << " HTTP/1.1\r\n" <<
-           "Host: " << hostname << "\r\n" <<
+           "Host: " << hostname;
+    if(port != 80)
+        req << ":" << port;
+    req << "\r\n" <<
            "User-Agent: " << std::string(psz_useragent) << "\r\n";
-    req << extraRequestHeaders();
+    req << extraHeaders;
     return req.str();
 }
@@ -50,21 +50,31 @@ namespace dash
                 virtual void    disconnect  ();
                 virtual bool    send        (const std::string &data);
 
+                uint64_t        getThroughput   () const;
+                mtime_t         getLatency      () const;
+
             protected:
 
                 virtual void    onHeader    (const std::string &key,
                                              const std::string &value) = 0;
                 virtual std::string extraRequestHeaders() const = 0;
                 virtual std::string buildRequestHeader(const std::string &path) const;
+                std::string buildRequest(const std::string &path,
+                                         const std::string &extraHeaders) const;
 
                 bool parseReply();
                 std::string readLine();
                 std::string hostname;
+                int         port;
                 char * psz_useragent;
                 stream_t   *stream;
+                mtime_t     latency; /* from request to reply */
 
             private:
                 int         httpSocket;
+                /* throughput, with the older samples fading away */
+                uint64_t    statBytes;
+                mtime_t     statTime;
         };
     }
 }
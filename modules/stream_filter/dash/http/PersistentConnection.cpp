@@ -30,15 +30,19 @@
 
 #include <vlc_network.h>
 
+#include <cassert>
+
 using namespace dash::http;
 
 PersistentConnection::PersistentConnection  (stream_t *stream, Chunk *chunk) :
                       HTTPConnection        (stream, chunk)
 {
     queryOk = false;
+    requested = false;
+    keepAlive = true;
     retries = 0;
 }
-#include <cassert>
+
 ssize_t PersistentConnection::read(void *p_buffer, size_t len)
 {
     if(!chunk)
@@ -75,17 +79,35 @@ ssize_t PersistentConnection::read(void *p_buffer, size_t len)
 
     retries = 0;
     chunk->setBytesRead(chunk->getBytesRead() + ret);
+    toRead -= ret;
 
     return ret;
 }
 
 bool PersistentConnection::query(const std::string &path)
 {
+    keepAlive = true;
+    if(requested)
+    {
+        /* Pipelined, the request went out behind the previous reply */
+        queryOk = parseReply();
+        if(!queryOk)
+        {
+            /* The server may have closed after the previous reply */
+            disconnect();
+            return query(path);
+        }
+        return true;
+    }
+
     if(!connected() &&
        !connect(chunk->getHostname(), chunk->getPort()))
         return false;
 
+    requested = true;
     queryOk = IHTTPConnection::query(path);
+    if(!queryOk)
+        disconnect();
     return queryOk;
 }
 
@@ -96,26 +118,89 @@ bool PersistentConnection::connect(const std::string &hostname, int port)
     return IHTTPConnection::connect(hostname, port);
 }
 
+/* A request can go out behind the reply being read once what is left of
+ * that reply takes about a round trip: the next reply then follows without
+ * a gap, and the next chunk is chosen as late as possible. */
+bool PersistentConnection::canPipeline() const
+{
+    if(!chunk || !queryOk || !keepAlive || !connected() ||
+       pipelined.size() >= maxPipelined)
+        return false;
+
+    uint64_t threshold = 2 * getThroughput() * getLatency() / 8 / CLOCK_FREQ;
+    if(threshold < pipelineMinBytes)
+        threshold = pipelineMinBytes;
+    return toRead <= threshold;
+}
+
+bool PersistentConnection::pipeline(Chunk *next)
+{
+    if(next->getConnection() || !canPipeline() ||
+       next->getHostname() != hostname || next->getPort() != port)
+        return false;
+
+    std::string header = buildRequest(next->getPath(), rangeRequestHeader(next));
+    header.append("\r\n");
+    if(!send(header))
+        return false;
+
+    next->setConnection(this);
+    pipelined.push_back(next);
+    return true;
+}
+
 void PersistentConnection::releaseChunk()
 {
     if(!chunk)
         return;
-    if(toRead > 0 && connected()) /* We can't resend request if we haven't finished reading */
+    /* We can't resend request if we haven't finished reading */
+    if(connected() && (!keepAlive || (requested && (!queryOk || toRead > 0))))
         disconnect();
     HTTPConnection::releaseChunk();
+    queryOk = false;
+    requested = false;
+
+    if(!pipelined.empty())
+    {
+        bindChunk(pipelined.front());
+        pipelined.pop_front();
+        requested = true;
+    }
 }
 
 void PersistentConnection::disconnect()
 {
+    /* Pipelined requests are lost with the connection */
+    while(!pipelined.empty())
+    {
+        pipelined.front()->setConnection(NULL);
+        pipelined.pop_front();
+    }
     queryOk = false;
+    requested = false;
+    toRead = 0;
     IHTTPConnection::disconnect();
 }
 
+void PersistentConnection::onHeader(const std::string &key,
+                                    const std::string &value)
+{
+    if(!strcasecmp(key.c_str(), "Connection") &&
+       !strncasecmp(value.c_str(), "close", 5))
+        keepAlive = false;
+    HTTPConnection::onHeader(key, value);
+}
+
 const std::string& PersistentConnection::getHostname() const
 {
     return hostname;
 }
 
+int PersistentConnection::getPort() const
+{
+    return port;
+}
+
 std::string PersistentConnection::buildRequestHeader(const std::string &path) const
 {
     return IHTTPConnection::buildRequestHeader(path);
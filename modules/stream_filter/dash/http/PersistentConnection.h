@@ -43,14 +43,25 @@ namespace dash
                 virtual void        disconnect  ();
                 virtual void        releaseChunk();
 
+                bool                canPipeline () const;
+                bool                pipeline    (Chunk *chunk);
                 const std::string&  getHostname () const;
+                int                 getPort     () const;
 
             private:
                 bool                queryOk;
+                bool                requested;  /* for the bound chunk */
+                bool                keepAlive;
                 int                 retries;
+                /* requested after the bound chunk, replies still to come */
+                std::deque<Chunk *> pipelined;
 
             protected:
                 static const int    retryCount = 5;
+                static const size_t maxPipelined = 1;
+                static const size_t pipelineMinBytes = 65536;
+                virtual void        onHeader    (const std::string &key,
+                                                 const std::string &value);
                 virtual std::string buildRequestHeader(const std::string &path) const;
         };
     }
@@ -49,11 +49,22 @@
 static int  Open (vlc_object_t *);
 static void Close(vlc_object_t *);
 
+#define PARALLEL_TEXT N_("Parallel segment downloads")
+#define PARALLEL_LONGTEXT N_("Number of segments downloaded at the same " \
+    "time. Several downloads in flight hide the latency of the server.")
+#define BUFFER_TEXT N_("Download buffer size (kB)")
+#define BUFFER_LONGTEXT N_("Maximum amount of downloaded data waiting " \
+    "to be played.")
+
 vlc_module_begin()
     set_category(CAT_INPUT)
     set_subcategory(SUBCAT_INPUT_STREAM_FILTER)
     set_description(N_("Http Live Streaming stream filter"))
     set_capability("stream_filter", 20)
+    add_integer_with_range("hls-parallel-downloads", 3, 1, 16,
+                           PARALLEL_TEXT, PARALLEL_LONGTEXT, true)
+    add_integer_with_range("hls-buffer-size", 32768, 1024, 1 << 20,
+                           BUFFER_TEXT, BUFFER_LONGTEXT, true)
     set_callbacks(Open, Close)
 vlc_module_end()
 
@@ -61,6 +72,8 @@ vlc_module_end()
  *
  *****************************************************************************/
 #define AES_BLOCK_SIZE 16 /* Only support AES-128 */
+#define HLS_CHUNK_SIZE 65536 /* read (and decrypt) size while downloading */
+#define HLS_WINDOW     6     /* segments downloaded ahead of playback (VOD) */
 typedef struct segment_s
 {
     int         sequence;   /* unique sequence number */
@@ -102,13 +115,15 @@ struct stream_sys_t
 {
     char         *m3u8;         /* M3U8 url */
     vlc_thread_t  reload;       /* HLS m3u8 reload thread */
-    vlc_thread_t  thread;       /* HLS segment download thread */
+    vlc_thread_t *threads;      /* HLS segment download threads */
+    int           i_threads;
 
     block_t      *peeked;
 
     /* */
     vlc_array_t  *hls_stream;   /* bandwidth adaptation */
-    uint64_t      bandwidth;    /* measured bandwidth (bits per second) */
+    uint64_t      bandwidth;    /* measured bandwidth (bits per second),
+                                   protected by download.lock_wait */
 
     /* Download */
     struct hls_download_s
@@ -116,8 +131,13 @@ struct stream_sys_t
         int         stream;     /* current hls_stream  */
         int         segment;    /* current segment for downloading */
         int         seek;       /* segment requested by seek (default -1) */
+        int         waited;     /* segment a seek waits for (default -1) */
+        int         active;     /* segments being downloaded */
+        int64_t     buffered;   /* bytes downloaded (or reserved) ahead of playback */
+        int64_t     budget;     /* maximum for buffered */
         vlc_mutex_t lock_wait;  /* protect segment download counter */
         vlc_cond_t  wait;       /* some condition to wait on */
+        vlc_mutex_t lock_key;   /* serializes AES key downloads */
     } download;
 
     /* Playback */
@@ -166,7 +186,8 @@ static ssize_t read_M3U8_from_stream(stream_t *s, uint8_t **buffer);
 static ssize_t read_M3U8_from_url(stream_t *s, const char *psz_url, uint8_t **buffer);
 static char *ReadLine(uint8_t *buffer, uint8_t **pos, size_t len);
 
-static int hls_Download(stream_t *s, segment_t *segment);
+static int hls_Download(stream_t *s, const char *url, const uint8_t *key,
+                        const uint8_t *iv, block_t **pp_data);
 
 static void* hls_Thread(void *);
 static void* hls_Reload(void *);
@@ -338,9 +359,12 @@ static hls_stream_t *hls_Find(vlc_array_t *hls_stream, hls_stream_t *hls_new)
         hls_stream_t *hls = hls_Get(hls_stream, n);
         if (hls)
         {
-            /* compare */
-            if ((hls->id == hls_new->id) &&
-                ((hls->bandwidth == hls_new->bandwidth)||(hls_new->bandwidth==0)))
+            /* compare (the download threads may estimate the bandwidth) */
+            vlc_mutex_lock(&hls->lock);
+            bool b_match = (hls->id == hls_new->id) &&
+                ((hls->bandwidth == hls_new->bandwidth)||(hls_new->bandwidth==0));
+            vlc_mutex_unlock(&hls->lock);
+            if (b_match)
                 return hls;
         }
     }
@@ -1241,76 +1265,100 @@ static int hls_ManageSegmentKeys(stream_t *s, hls_stream_t *hls)
     return VLC_SUCCESS;
 }
 
-static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segment)
+/* AES-128 decryption of a segment, done as the data is being downloaded */
+typedef struct
 {
-    /* Did the segment need to be decoded ? */
-    if (segment->psz_key_path == NULL)
-        return VLC_SUCCESS;
+    gcry_cipher_hd_t aes_ctx;
+    size_t           done;      /* bytes decrypted so far */
+} hls_cipher_t;
 
-    /* Do we have loaded the key ? */
-    if (!segment->b_key_loaded)
+static void hls_SegmentIV(hls_stream_t *hls, int sequence, uint8_t iv[AES_BLOCK_SIZE])
+{
+    if (hls->b_iv_loaded)
     {
-        /* No ? try to download it now */
-        if (hls_ManageSegmentKeys(s, hls) != VLC_SUCCESS)
-            return VLC_EGENERIC;
+        memcpy(iv, hls->psz_AES_IV, AES_BLOCK_SIZE);
+        return;
     }
 
+    /* No IV given in the playlist: use the sequence number */
+    memset(iv, 0, AES_BLOCK_SIZE);
+    iv[15] = sequence & 0xff;
+    iv[14] = (sequence >> 8)& 0xff;
+    iv[13] = (sequence >> 16)& 0xff;
+    iv[12] = (sequence >> 24)& 0xff;
+}
+
+static int hls_CipherOpen(stream_t *s, hls_cipher_t *cipher,
+                          const uint8_t *key, const uint8_t *iv)
+{
     /* For now, we only decode AES-128 data */
     gcry_error_t i_gcrypt_err;
-    gcry_cipher_hd_t aes_ctx;
     /* Setup AES */
-    i_gcrypt_err = gcry_cipher_open(&aes_ctx, GCRY_CIPHER_AES,
+    i_gcrypt_err = gcry_cipher_open(&cipher->aes_ctx, GCRY_CIPHER_AES,
                                      GCRY_CIPHER_MODE_CBC, 0);
     if (i_gcrypt_err)
     {
         msg_Err(s, "gcry_cipher_open failed: %s", gpg_strerror(i_gcrypt_err));
-        gcry_cipher_close(aes_ctx);
         return VLC_EGENERIC;
     }
 
     /* Set key */
-    i_gcrypt_err = gcry_cipher_setkey(aes_ctx, segment->aes_key,
-                                       sizeof(segment->aes_key));
+    i_gcrypt_err = gcry_cipher_setkey(cipher->aes_ctx, key, AES_BLOCK_SIZE);
     if (i_gcrypt_err)
     {
         msg_Err(s, "gcry_cipher_setkey failed: %s", gpg_strerror(i_gcrypt_err));
-        gcry_cipher_close(aes_ctx);
+        gcry_cipher_close(cipher->aes_ctx);
         return VLC_EGENERIC;
     }
 
-    if (hls->b_iv_loaded == false)
+    i_gcrypt_err = gcry_cipher_setiv(cipher->aes_ctx, iv, AES_BLOCK_SIZE);
+    if (i_gcrypt_err)
     {
-        memset(hls->psz_AES_IV, 0, AES_BLOCK_SIZE);
-        hls->psz_AES_IV[15] = segment->sequence & 0xff;
-        hls->psz_AES_IV[14] = (segment->sequence >> 8)& 0xff;
-        hls->psz_AES_IV[13] = (segment->sequence >> 16)& 0xff;
-        hls->psz_AES_IV[12] = (segment->sequence >> 24)& 0xff;
+        msg_Err(s, "gcry_cipher_setiv failed: %s", gpg_strerror(i_gcrypt_err));
+        gcry_cipher_close(cipher->aes_ctx);
+        return VLC_EGENERIC;
     }
 
-    i_gcrypt_err = gcry_cipher_setiv(aes_ctx, hls->psz_AES_IV,
-                                      sizeof(hls->psz_AES_IV));
+    cipher->done = 0;
+    return VLC_SUCCESS;
+}
+
+/* Decrypts the whole AES blocks received since the last call. CBC chaining
+ * is kept by the cipher handle from one call to the next. */
+static int hls_CipherUpdate(stream_t *s, hls_cipher_t *cipher,
+                            uint8_t *p_buffer, size_t i_buffer)
+{
+    size_t len = (i_buffer - cipher->done) & ~(size_t)(AES_BLOCK_SIZE - 1);
+    if (len == 0)
+        return VLC_SUCCESS;
 
+    gcry_error_t i_gcrypt_err = gcry_cipher_decrypt(cipher->aes_ctx,
+                                                    p_buffer + cipher->done, /* out */
+                                                    len,
+                                                    NULL, /* in */
+                                                    0);
     if (i_gcrypt_err)
     {
-        msg_Err(s, "gcry_cipher_setiv failed: %s", gpg_strerror(i_gcrypt_err));
-        gcry_cipher_close(aes_ctx);
+        msg_Err(s, "gcry_cipher_decrypt failed:  %s/%s\n", gcry_strsource(i_gcrypt_err), gcry_strerror(i_gcrypt_err));
         return VLC_EGENERIC;
     }
+    cipher->done += len;
+    return VLC_SUCCESS;
+}
 
-    i_gcrypt_err = gcry_cipher_decrypt(aes_ctx,
-                                       segment->data->p_buffer, /* out */
-                                       segment->data->i_buffer,
-                                       NULL, /* in */
-                                       0);
-    if (i_gcrypt_err)
+/* Checks that the whole segment was decrypted and removes the padding */
+static int hls_CipherFinish(stream_t *s, hls_cipher_t *cipher,
+                            const uint8_t *p_buffer, size_t *pi_buffer)
+{
+    if (*pi_buffer == 0 || cipher->done != *pi_buffer)
     {
-        msg_Err(s, "gcry_cipher_decrypt failed:  %s/%s\n", gcry_strsource(i_gcrypt_err), gcry_strerror(i_gcrypt_err));
-        gcry_cipher_close(aes_ctx);
+        msg_Err(s, "Bad segment size (%zu), not a multiple of the AES block size",
+                *pi_buffer);
         return VLC_EGENERIC;
     }
-    gcry_cipher_close(aes_ctx);
+
     /* remove the PKCS#7 padding from the buffer */
-    int pad = segment->data->p_buffer[segment->data->i_buffer-1];
+    int pad = p_buffer[*pi_buffer-1];
     if (pad <= 0 || pad > AES_BLOCK_SIZE)
     {
         msg_Err(s, "Bad padding character (0x%x), perhaps we failed to decrypt the segment with the correct key", pad);
@@ -1319,7 +1367,7 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
     int count = pad;
     while (count--)
     {
-        if (segment->data->p_buffer[segment->data->i_buffer-1-count] != pad)
+        if (p_buffer[*pi_buffer-1-count] != pad)
         {
                 msg_Err(s, "Bad ending buffer, perhaps we failed to decrypt the segment with the correct key");
                 return VLC_EGENERIC;
@@ -1327,7 +1375,7 @@ static int hls_DecodeSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segm
     }
 
     /* not all the data is readable because of padding */
-    segment->data->i_buffer -= pad;
+    *pi_buffer -= pad;
 
     return VLC_SUCCESS;
 }
@@ -1519,7 +1567,7 @@ static int hls_ReloadPlaylist(stream_t *s)
     if (stream_appended == true)
     {
         vlc_mutex_lock(&p_sys->download.lock_wait);
-        vlc_cond_signal(&p_sys->download.wait);
+        vlc_cond_broadcast(&p_sys->download.wait);
         vlc_mutex_unlock(&p_sys->download.lock_wait);
     }
 
@@ -1546,11 +1594,15 @@ static int BandwidthAdaptation(stream_t *s, int progid, uint64_t *bandwidth)
         /* only consider streams with the same PROGRAM-ID */
         if (hls->id == progid)
         {
-            if ((bw >= hls->bandwidth) && (bw_candidate < hls->bandwidth))
+            vlc_mutex_lock(&hls->lock);
+            const uint64_t hls_bw = hls->bandwidth;
+            vlc_mutex_unlock(&hls->lock);
+
+            if ((bw >= hls_bw) && (bw_candidate < hls_bw))
             {
                 msg_Dbg(s, "candidate %d bandwidth (bits/s) %"PRIu64" >= %"PRIu64,
-                         n, bw, hls->bandwidth); /* bits / s */
-                bw_candidate = hls->bandwidth;
+                         n, bw, hls_bw); /* bits / s */
+                bw_candidate = hls_bw;
                 candidate = n; /* possible candidate */
             }
         }
@@ -1562,6 +1614,7 @@ static int BandwidthAdaptation(stream_t *s, int progid, uint64_t *bandwidth)
 static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *segment, int *cur_stream)
 {
     stream_sys_t *p_sys = s->p_sys;
+    uint8_t key[AES_BLOCK_SIZE], iv[AES_BLOCK_SIZE];
 
     assert(hls);
     assert(segment);
@@ -1573,49 +1626,100 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
         vlc_mutex_unlock(&segment->lock);
         return VLC_SUCCESS;
     }
+    bool b_key_needed = segment->psz_key_path != NULL && !segment->b_key_loaded;
+    vlc_mutex_unlock(&segment->lock);
+
+    /* Do we have loaded the key ? No ? try to download it now */
+    if (b_key_needed)
+    {
+        vlc_mutex_lock(&p_sys->download.lock_key);
+        int ret = hls_ManageSegmentKeys(s, hls);
+        vlc_mutex_unlock(&p_sys->download.lock_key);
+        if (ret != VLC_SUCCESS)
+            return VLC_EGENERIC;
+    }
+
+    /* The segment is not locked during the download, so that playback of
+     * the segments already downloaded goes on */
+    vlc_mutex_lock(&segment->lock);
+    char *url = strdup(segment->url);
+    const int sequence = segment->sequence;
+    const int seg_duration = segment->duration;
+    const bool b_encrypted = segment->psz_key_path != NULL;
+    if (b_encrypted)
+        memcpy(key, segment->aes_key, AES_BLOCK_SIZE);
+    vlc_mutex_unlock(&segment->lock);
+    if (url == NULL)
+        return VLC_ENOMEM;
+
+    /* Did the segment need to be decoded ? */
+    if (b_encrypted)
+        hls_SegmentIV(hls, sequence, iv);
+
+    /* The download threads update both bandwidths */
+    vlc_mutex_lock(&hls->lock);
+    uint64_t hls_bw = hls->bandwidth;
+    vlc_mutex_unlock(&hls->lock);
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    const uint64_t link_bw = p_sys->bandwidth;
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
 
     /* sanity check - can we download this segment on time? */
-    if ((p_sys->bandwidth > 0) && (hls->bandwidth > 0))
+    if ((link_bw > 0) && (hls_bw > 0))
     {
-        uint64_t size = (segment->duration * hls->bandwidth); /* bits */
-        int estimated = (int)(size / p_sys->bandwidth);
-        if (estimated > segment->duration)
+        uint64_t size = (seg_duration * hls_bw); /* bits */
+        int estimated = (int)(size / link_bw);
+        if (estimated > seg_duration)
         {
             msg_Warn(s,"downloading segment %d predicted to take %ds, which exceeds its length (%ds)",
-                        segment->sequence, estimated, segment->duration);
+                        sequence, estimated, seg_duration);
         }
     }
 
+    block_t *data;
     mtime_t start = mdate();
-    if (hls_Download(s, segment) != VLC_SUCCESS)
+    int ret = hls_Download(s, url, b_encrypted ? key : NULL, iv, &data);
+    free(url);
+    if (ret != VLC_SUCCESS)
     {
         msg_Err(s, "downloading segment %d from stream %d failed",
-                    segment->sequence, *cur_stream);
-        vlc_mutex_unlock(&segment->lock);
+                    sequence, *cur_stream);
         return VLC_EGENERIC;
     }
     mtime_t duration = mdate() - start;
-    if (hls->bandwidth == 0 && segment->duration > 0)
+    uint64_t size = data->i_buffer;
+
+    vlc_mutex_lock(&segment->lock);
+    if (segment->data == NULL)
     {
-        /* Try to estimate the bandwidth for this stream */
-        hls->bandwidth = (uint64_t)(((double)segment->size * 8) / ((double)segment->duration));
+        segment->data = data;
+        segment->size = size;
     }
+    else /* downloaded twice around a seek */
+        block_Release(data);
+    vlc_mutex_unlock(&segment->lock);
 
-    /* If the segment is encrypted, decode it */
-    if (hls_DecodeSegmentData(s, hls, segment) != VLC_SUCCESS)
+    vlc_mutex_lock(&hls->lock);
+    if (hls->bandwidth == 0 && seg_duration > 0)
     {
-        vlc_mutex_unlock(&segment->lock);
-        return VLC_EGENERIC;
+        /* Try to estimate the bandwidth for this stream */
+        hls->bandwidth = (uint64_t)(((double)size * 8) / ((double)seg_duration));
     }
-
-    vlc_mutex_unlock(&segment->lock);
+    hls_bw = hls->bandwidth;
+    vlc_mutex_unlock(&hls->lock);
 
     msg_Dbg(s, "downloaded segment %d from stream %d",
-                segment->sequence, *cur_stream);
+                sequence, *cur_stream);
+
+    uint64_t bw = size * 8 * 1000000 / __MAX(1, duration); /* bits / s */
 
-    uint64_t bw = segment->size * 8 * 1000000 / __MAX(1, duration); /* bits / s */
+    /* The other downloads in flight share the link */
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    bw *= __MAX(1, p_sys->download.active);
     p_sys->bandwidth = bw;
-    if (p_sys->b_meta && (hls->bandwidth != bw))
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+
+    if (p_sys->b_meta && (hls_bw != bw))
     {
         int newstream = BandwidthAdaptation(s, hls->id, &bw);
 
@@ -1623,86 +1727,128 @@ static int hls_DownloadSegmentData(stream_t *s, hls_stream_t *hls, segment_t *se
         if ((newstream >= 0) && (newstream != *cur_stream))
         {
             msg_Dbg(s, "detected %s bandwidth (%"PRIu64") stream",
-                     (bw >= hls->bandwidth) ? "faster" : "lower", bw);
+                     (bw >= hls_bw) ? "faster" : "lower", bw);
             *cur_stream = newstream;
         }
     }
     return VLC_SUCCESS;
 }
 
-static void* hls_Thread(void *p_this)
+/* Hands the next segment to download out to a download thread, once the
+ * playback window and the memory budget allow it. Returns NULL when the
+ * stream is being closed. */
+static segment_t *hls_NextSegment(stream_t *s, hls_stream_t **pp_hls,
+                                  int *cur_stream, int *index,
+                                  int64_t *reserved)
 {
-    stream_t *s = (stream_t *)p_this;
     stream_sys_t *p_sys = s->p_sys;
+    segment_t *segment = NULL;
 
-    int canc = vlc_savecancel();
-
-    while (vlc_object_alive(s))
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    while (vlc_object_alive(s) && !p_sys->b_error)
     {
-        hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->download.stream);
+        if (p_sys->download.seek >= 0)
+        {
+            p_sys->download.segment = p_sys->download.seek;
+            p_sys->download.seek = -1;
+            p_sys->download.buffered = 0;
+            vlc_cond_broadcast(&p_sys->download.wait);
+        }
+
+        const int stream = p_sys->download.stream;
+        const int wanted = p_sys->download.segment;
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
+
+        hls_stream_t *hls = hls_Get(p_sys->hls_stream, stream);
         assert(hls);
 
-        /* Sliding window (~60 seconds worth of movie) */
         vlc_mutex_lock(&hls->lock);
-        int count = vlc_array_count(hls->segments);
+        segment = segment_GetSegment(hls, wanted);
+        int64_t estimated = (segment != NULL) ?
+                            segment->duration * (hls->bandwidth / 8) : 0;
         vlc_mutex_unlock(&hls->lock);
 
-        /* Is there a new segment to process? */
-        if ((!p_sys->b_live && (p_sys->playback.segment < (count - 6))) ||
-            (p_sys->download.segment >= count))
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        if (p_sys->download.seek >= 0 || p_sys->download.stream != stream ||
+            p_sys->download.segment != wanted)
+            continue; /* changed meanwhile */
+
+        /* Is there a new segment to process?
+         * Sliding window (~60 seconds worth of movie) */
+        if (segment != NULL &&
+            (p_sys->b_live || (wanted - p_sys->playback.segment <= HLS_WINDOW)) &&
+            (p_sys->download.buffered < p_sys->download.budget ||
+             wanted <= p_sys->playback.segment))
         {
-            /* wait */
-            vlc_mutex_lock(&p_sys->download.lock_wait);
-            while (((p_sys->download.segment - p_sys->playback.segment > 6) ||
-                    (p_sys->download.segment >= count)) &&
-                   (p_sys->download.seek == -1))
-            {
-                vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
-                if (p_sys->b_live /*&& (mdate() >= p_sys->playlist.wakeup)*/)
-                    break;
-                if (!vlc_object_alive(s))
-                    break;
-            }
-            /* */
-            if (p_sys->download.seek >= 0)
-            {
-                p_sys->download.segment = p_sys->download.seek;
-                p_sys->download.seek = -1;
-            }
-            vlc_mutex_unlock(&p_sys->download.lock_wait);
+            p_sys->download.segment++;
+            p_sys->download.active++;
+            p_sys->download.buffered += estimated;
+            *pp_hls = hls;
+            *cur_stream = stream;
+            *index = wanted;
+            *reserved = estimated;
+            break;
         }
+        segment = NULL;
+        vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
+    }
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+    return segment;
+}
 
-        if (!vlc_object_alive(s)) break;
+static void* hls_Thread(void *p_this)
+{
+    stream_t *s = (stream_t *)p_this;
+    stream_sys_t *p_sys = s->p_sys;
 
-        vlc_mutex_lock(&hls->lock);
-        segment_t *segment = segment_GetSegment(hls, p_sys->download.segment);
-        vlc_mutex_unlock(&hls->lock);
+    int canc = vlc_savecancel();
+
+    while (vlc_object_alive(s))
+    {
+        hls_stream_t *hls = NULL;
+        int stream, from = -1, index = -1;
+        int64_t reserved = 0;
+
+        segment_t *segment = hls_NextSegment(s, &hls, &from, &index, &reserved);
+        if (segment == NULL)
+            break;
+
+        stream = from;
+        int ret = hls_DownloadSegmentData(s, hls, segment, &stream);
+
+        /* Account for what was actually downloaded */
+        vlc_mutex_lock(&segment->lock);
+        int64_t size = (segment->data != NULL) ? (int64_t)segment->size : 0;
+        vlc_mutex_unlock(&segment->lock);
+
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        p_sys->download.active--;
+        p_sys->download.buffered = __MAX(0, p_sys->download.buffered - reserved + size);
+        /* download succeeded: adapt bandwidth? Only if this download
+         * chose another stream, and no other thread switched meanwhile. */
+        if (ret == VLC_SUCCESS && stream != from
+         && p_sys->download.stream == from)
+            p_sys->download.stream = stream;
+        /* Done with the segment a seek waits for, successfully or not */
+        if (index == p_sys->download.waited)
+            p_sys->download.waited = -1;
+        vlc_cond_broadcast(&p_sys->download.wait);
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
 
-        if ((segment != NULL) &&
-            (hls_DownloadSegmentData(s, hls, segment, &p_sys->download.stream) != VLC_SUCCESS))
+        if (ret != VLC_SUCCESS)
         {
             if (!vlc_object_alive(s)) break;
 
             if (!p_sys->b_live)
             {
                 p_sys->b_error = true;
+                vlc_mutex_lock(&p_sys->download.lock_wait);
+                vlc_cond_broadcast(&p_sys->download.wait);
+                vlc_mutex_unlock(&p_sys->download.lock_wait);
                 break;
             }
         }
 
-        /* download succeeded */
-        /* determine next segment to download */
-        vlc_mutex_lock(&p_sys->download.lock_wait);
-        if (p_sys->download.seek >= 0)
-        {
-            p_sys->download.segment = p_sys->download.seek;
-            p_sys->download.seek = -1;
-        }
-        else if (p_sys->download.segment < count)
-            p_sys->download.segment++;
-        vlc_cond_signal(&p_sys->download.wait);
-        vlc_mutex_unlock(&p_sys->download.lock_wait);
-
         // In case of a successful download signal the read thread that data is available
         vlc_mutex_lock(&p_sys->read.lock_wait);
         vlc_cond_signal(&p_sys->read.wait);
@@ -1785,8 +1931,12 @@ static int Prefetch(stream_t *s, int *current)
     else if (vlc_array_count(hls->segments) == 1 && p_sys->b_live)
         msg_Warn(s, "Only 1 segment available to prefetch in live stream; may stall");
 
-    /* Download ~10s worth of segments of this HLS stream if they exist */
+    /* Download ~10s worth of segments of this HLS stream if they exist.
+     * With parallel downloads, only the first one: it gives the bandwidth
+     * and the download threads fetch the rest together. */
     unsigned segment_amount = (0.5f + 10/hls->duration);
+    if (p_sys->i_threads > 1)
+        segment_amount = 1;
     for (int i = 0; i < __MIN(vlc_array_count(hls->segments), segment_amount); i++)
     {
         segment_t *segment = segment_GetSegment(hls, p_sys->download.segment);
@@ -1823,92 +1973,107 @@ static int Prefetch(stream_t *s, int *current)
 /****************************************************************************
  *
  ****************************************************************************/
-static int hls_Download(stream_t *s, segment_t *segment)
+static int hls_Download(stream_t *s, const char *url, const uint8_t *key,
+                        const uint8_t *iv, block_t **pp_data)
 {
     stream_sys_t *p_sys = s->p_sys;
-    assert(segment);
+    hls_cipher_t cipher;
 
     vlc_mutex_lock(&p_sys->lock);
     while (p_sys->paused)
         vlc_cond_wait(&p_sys->wait, &p_sys->lock);
     vlc_mutex_unlock(&p_sys->lock);
 
-    stream_t *p_ts = stream_UrlNew(s, segment->url);
+    stream_t *p_ts = stream_UrlNew(s, url);
     if (p_ts == NULL)
         return VLC_EGENERIC;
 
-    segment->size = stream_Size(p_ts);
-
-    if (segment->size == 0) {
-        int chunk_size = 65536;
-        segment->data = block_Alloc(chunk_size);
-        if (!segment->data)
-            goto nomem;
-        do {
-            if (segment->data->i_buffer - segment->size < chunk_size) {
-                chunk_size *= 2;
-                block_t *p_block = block_Realloc(segment->data, 0, segment->data->i_buffer + chunk_size);
-                if (!p_block) {
-                    block_Release(segment->data);
-                    segment->data = NULL;
-                    goto nomem;
-                }
-                segment->data = p_block;
-            }
-
-            ssize_t length = stream_Read(p_ts, segment->data->p_buffer + segment->size, chunk_size);
-            if (length <= 0) {
-                segment->data->i_buffer = segment->size;
-                break;
-            }
-            segment->size += length;
-        } while (vlc_object_alive(s));
-
+    if (key != NULL && hls_CipherOpen(s, &cipher, key, iv) != VLC_SUCCESS)
+    {
         stream_Delete(p_ts);
-        return VLC_SUCCESS;
+        return VLC_EGENERIC;
     }
 
-    segment->data = block_Alloc(segment->size);
-    if (segment->data == NULL)
-        goto nomem;
+    int ret = VLC_ENOMEM;
+    uint64_t size = stream_Size(p_ts);
+    const bool b_sized = size > 0;
+    block_t *data = block_Alloc(b_sized ? size : HLS_CHUNK_SIZE);
+    if (data == NULL)
+        goto error;
 
-    assert(segment->data->i_buffer == segment->size);
-
-    ssize_t curlen = 0;
-    do
+    size_t len = 0;
+    while (vlc_object_alive(s))
     {
+        size_t i_size = data->i_buffer;
+
         /* NOTE: Beware the size reported for a segment by the HLS server may not
          * be correct, when downloading the segment data. Therefore check the size
          * and enlarge the segment data block if necessary.
          */
-        uint64_t size = stream_Size(p_ts);
-        if (size > segment->size)
+        if (b_sized)
+        {
+            size = stream_Size(p_ts);
+            if (size > i_size)
+            {
+                msg_Dbg(s, "size changed %"PRIu64, size);
+                i_size = size;
+            }
+            else if (len == i_size)
+                break;
+        }
+        else if (len == i_size)
+            i_size *= 2;
+
+        if (i_size != data->i_buffer)
         {
-            msg_Dbg(s, "size changed %"PRIu64, segment->size);
-            block_t *p_block = block_Realloc(segment->data, 0, size);
+            block_t *p_block = block_Realloc(data, 0, i_size);
             if (p_block == NULL)
             {
-                block_Release(segment->data);
-                segment->data = NULL;
-                goto nomem;
+                data = NULL;
+                goto error;
             }
-            segment->data = p_block;
-            segment->size = size;
-            assert(segment->data->i_buffer == segment->size);
-            p_block = NULL;
+            data = p_block;
         }
-        ssize_t length = stream_Read(p_ts, segment->data->p_buffer + curlen, segment->size - curlen);
+
+        ssize_t length = stream_Read(p_ts, data->p_buffer + len,
+                                     __MIN(data->i_buffer - len, HLS_CHUNK_SIZE));
         if (length <= 0)
             break;
-        curlen += length;
-    } while (vlc_object_alive(s));
+        len += length;
+
+        /* Decrypt what has arrived while the rest is on its way */
+        if (key != NULL &&
+            hls_CipherUpdate(s, &cipher, data->p_buffer, len) != VLC_SUCCESS)
+        {
+            ret = VLC_EGENERIC;
+            goto error;
+        }
+    }
+
+    if (key != NULL)
+    {
+        ret = hls_CipherFinish(s, &cipher, data->p_buffer, &len);
+        gcry_cipher_close(cipher.aes_ctx);
+        if (ret != VLC_SUCCESS)
+        {
+            block_Release(data);
+            stream_Delete(p_ts);
+            return ret;
+        }
+    }
 
     stream_Delete(p_ts);
+    data->i_buffer = len;
+    *pp_data = data;
     return VLC_SUCCESS;
 
-nomem:
+error:
+    if (data != NULL)
+        block_Release(data);
+    if (key != NULL)
+        gcry_cipher_close(cipher.aes_ctx);
     stream_Delete(p_ts);
-    return VLC_ENOMEM;
+    return ret;
 }
 
 /* Read M3U8 file */
@@ -2087,6 +2252,19 @@ static int Open(vlc_object_t *p_this)
     qsort( p_sys->hls_stream->pp_elems, p_sys->hls_stream->i_count,
            sizeof( hls_stream_t* ), &hls_CompareStreams );
 
+    p_sys->i_threads = var_InheritInteger(s, "hls-parallel-downloads");
+    p_sys->download.budget = var_InheritInteger(s, "hls-buffer-size") * INT64_C(1024);
+    p_sys->threads = malloc(p_sys->i_threads * sizeof(*p_sys->threads));
+    if (p_sys->threads == NULL)
+        goto fail;
+
+    vlc_mutex_init(&p_sys->download.lock_wait);
+    vlc_cond_init(&p_sys->download.wait);
+    vlc_mutex_init(&p_sys->download.lock_key);
+
+    vlc_mutex_init(&p_sys->read.lock_wait);
+    vlc_cond_init(&p_sys->read.wait);
+
     /* Choose first HLS stream to start with */
     int current = p_sys->playback.stream = p_sys->hls_stream->i_count-1;
     p_sys->playback.segment = p_sys->download.segment = ChooseSegment(s, current);
@@ -2097,18 +2275,13 @@ static int Open(vlc_object_t *p_this)
     if (Prefetch(s, &current) != VLC_SUCCESS)
     {
         msg_Err(s, "fetching first segment failed.");
-        goto fail;
+        goto fail_thread;
     }
 
     p_sys->download.stream = current;
     p_sys->playback.stream = current;
     p_sys->download.seek = -1;
-
-    vlc_mutex_init(&p_sys->download.lock_wait);
-    vlc_cond_init(&p_sys->download.wait);
-
-    vlc_mutex_init(&p_sys->read.lock_wait);
-    vlc_cond_init(&p_sys->read.wait);
+    p_sys->download.waited = -1;
 
     /* Initialize HLS live stream */
     if (p_sys->b_live)
@@ -2124,11 +2297,20 @@ static int Open(vlc_object_t *p_this)
         }
     }
 
-    if (vlc_clone(&p_sys->thread, hls_Thread, s, VLC_THREAD_PRIORITY_INPUT))
+    for (int i = 0; i < p_sys->i_threads; i++)
     {
-        if (p_sys->b_live)
-            vlc_join(p_sys->reload, NULL);
-        goto fail_thread;
+        if (vlc_clone(&p_sys->threads[i], hls_Thread, s, VLC_THREAD_PRIORITY_INPUT))
+        {
+            if (i == 0)
+            {
+                if (p_sys->b_live)
+                    vlc_join(p_sys->reload, NULL);
+                goto fail_thread;
+            }
+            msg_Warn(s, "only %d download threads", i);
+            p_sys->i_threads = i;
+            break;
+        }
     }
 
     return VLC_SUCCESS;
@@ -2136,6 +2318,7 @@ static int Open(vlc_object_t *p_this)
 fail_thread:
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
+    vlc_mutex_destroy(&p_sys->download.lock_key);
 
     vlc_mutex_destroy(&p_sys->read.lock_wait);
     vlc_cond_destroy(&p_sys->read.wait);
@@ -2153,6 +2336,7 @@ fail:
     vlc_cond_destroy(&p_sys->wait);
 
     /* */
+    free(p_sys->threads);
     free(p_sys->m3u8);
     free(p_sys);
     return VLC_EGENERIC;
@@ -2178,15 +2362,18 @@ static void Close(vlc_object_t *p_this)
     /* negate the condition variable's predicate */
     p_sys->download.segment = p_sys->playback.segment = 0;
     p_sys->download.seek = 0; /* better safe than sorry */
-    vlc_cond_signal(&p_sys->download.wait);
+    vlc_cond_broadcast(&p_sys->download.wait);
     vlc_mutex_unlock(&p_sys->download.lock_wait);
 
     /* */
     if (p_sys->b_live)
         vlc_join(p_sys->reload, NULL);
-    vlc_join(p_sys->thread, NULL);
+    for (int i = 0; i < p_sys->i_threads; i++)
+        vlc_join(p_sys->threads[i], NULL);
+    free(p_sys->threads);
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
+    vlc_mutex_destroy(&p_sys->download.lock_key);
 
     vlc_mutex_destroy(&p_sys->read.lock_wait);
     vlc_cond_destroy(&p_sys->read.wait);
@@ -2332,6 +2519,8 @@ static ssize_t hls_Read(stream_t *s, uint8_t *p_read, unsigned int i_read)
         vlc_mutex_lock(&segment->lock);
         if (segment->data->i_buffer == 0)
         {
+            int64_t size = segment->size;
+
             if (!p_sys->b_cache || p_sys->b_live)
             {
                 block_Release(segment->data);
@@ -2342,10 +2531,11 @@ static ssize_t hls_Read(stream_t *s, uint8_t *p_read, unsigned int i_read)
 
             vlc_mutex_unlock(&segment->lock);
 
-            /* signal download thread */
+            /* signal download threads */
             vlc_mutex_lock(&p_sys->download.lock_wait);
             p_sys->playback.segment++;
-            vlc_cond_signal(&p_sys->download.wait);
+            p_sys->download.buffered = __MAX(0, p_sys->download.buffered - size);
+            vlc_cond_broadcast(&p_sys->download.wait);
             vlc_mutex_unlock(&p_sys->download.lock_wait);
             continue;
         }
@@ -2656,17 +2846,18 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
         /* Wake up download thread */
         vlc_mutex_lock(&p_sys->download.lock_wait);
         p_sys->download.seek = p_sys->playback.segment;
-        vlc_cond_signal(&p_sys->download.wait);
+        p_sys->download.waited = p_sys->playback.segment;
+        vlc_cond_broadcast(&p_sys->download.wait);
 
-        /* Wait for download to be finished */
+        /* Wait for the download of the segment to be finished: segments are
+         * handed out to the download threads before being downloaded */
         msg_Dbg(s, "seek to segment %d", p_sys->playback.segment);
-        while ((p_sys->download.seek != -1) ||
-           ((p_sys->download.segment - p_sys->playback.segment < 3) &&
-                (p_sys->download.segment < count)))
+        while (p_sys->download.waited != -1)
         {
             vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
-            if (!vlc_object_alive(s) || s->b_error) break;
+            if (!vlc_object_alive(s) || s->b_error || p_sys->b_error) break;
         }
+        p_sys->download.waited = -1;
         vlc_mutex_unlock(&p_sys->download.lock_wait);
 
         return VLC_SUCCESS;
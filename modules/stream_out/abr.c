@@ -0,0 +1,825 @@
+/*****************************************************************************
+ * abr.c: adaptive bitrate ladder stream output module
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <math.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_sout.h>
+#include <vlc_codec.h>
+#include <vlc_filter.h>
+#include <vlc_block.h>
+#include <vlc_modules.h>
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+#define VENC_TEXT N_("Video encoder")
+#define VENC_LONGTEXT N_( \
+    "This is the video encoder module that will be used (and its associated "\
+    "options) for every rendition.")
+#define VCODEC_TEXT N_("Destination video codec")
+#define VCODEC_LONGTEXT N_( \
+    "This is the video codec that will be used.")
+#define RENDITIONS_TEXT N_("Renditions")
+#define RENDITIONS_LONGTEXT N_( \
+    "Comma separated list of [width]x[height]@kbps renditions. A missing " \
+    "dimension follows the aspect ratio of the source. Rendition N (from 0) " \
+    "gets the ES id of the source plus 1000 * N, so that it can be picked " \
+    "with the select option of the duplicate module.")
+#define GOP_TEXT N_("GOP duration (ms)")
+#define GOP_LONGTEXT N_( \
+    "All the renditions start a GOP on the same pictures, at this interval " \
+    "of the source timestamps, so that they can be segmented at the same " \
+    "positions (set the segment length of livehttp to a multiple of it). " \
+    "The keyint, min-keyint and scenecut options of the encoder are set " \
+    "so that it adds no keyframe of its own. " \
+    "0 lets each encoder place its own keyframes.")
+
+static int  Open ( vlc_object_t * );
+static void Close( vlc_object_t * );
+
+#define SOUT_CFG_PREFIX "sout-abr-"
+
+vlc_module_begin ()
+    set_shortname( N_("ABR") )
+    set_description( N_("Adaptive bitrate ladder stream output") )
+    set_capability( "sout stream", 50 )
+    add_shortcut( "abr" )
+    set_callbacks( Open, Close )
+    set_category( CAT_SOUT )
+    set_subcategory( SUBCAT_SOUT_STREAM )
+    add_module( SOUT_CFG_PREFIX "venc", "encoder", NULL, VENC_TEXT,
+                VENC_LONGTEXT, false )
+    add_string( SOUT_CFG_PREFIX "vcodec", "h264", VCODEC_TEXT,
+                VCODEC_LONGTEXT, false )
+    add_string( SOUT_CFG_PREFIX "renditions",
+                "1280x720@3000,854x480@1500,640x360@800",
+                RENDITIONS_TEXT, RENDITIONS_LONGTEXT, false )
+    add_integer( SOUT_CFG_PREFIX "gop", 2000, GOP_TEXT, GOP_LONGTEXT, false )
+        change_integer_range( 0, 60000 )
+vlc_module_end ()
+
+static const char *const ppsz_sout_options[] = {
+    "venc", "vcodec", "renditions", "gop", NULL
+};
+
+/*****************************************************************************
+ * Exported prototypes
+ *****************************************************************************/
+static sout_stream_id_sys_t *Add ( sout_stream_t *, es_format_t * );
+static int               Del ( sout_stream_t *, sout_stream_id_sys_t * );
+static int               Send( sout_stream_t *, sout_stream_id_sys_t *, block_t* );
+
+#define ENC_FRAMERATE (25 * 1000)
+#define ENC_FRAMERATE_BASE 1000
+
+/* Decoded pictures waiting for each encoder */
+#define QUEUE_MAX   8
+#define ID_STEP     1000
+
+typedef struct
+{
+    unsigned    i_width;
+    unsigned    i_height;
+    int         i_bitrate;
+} rendition_cfg_t;
+
+/* One encoder of the ladder, running on its own thread */
+typedef struct
+{
+    sout_stream_t   *p_stream;
+    encoder_t       *p_encoder;
+    config_chain_t  *p_cfg;   /**< encoder options, with the GOP settings */
+    filter_chain_t  *p_chain; /**< scaling and chroma conversion */
+    void            *id;
+
+    vlc_thread_t    thread;
+    bool            b_thread;
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait;
+    vlc_cond_t      done;
+    picture_t       *pp_queue[QUEUE_MAX];
+    unsigned        i_first;
+    unsigned        i_count;
+    bool            b_busy;
+    bool            b_abort;
+    block_t         *p_out;
+} rendition_t;
+
+struct sout_stream_sys_t
+{
+    char            *psz_venc;
+    config_chain_t  *p_venc_cfg;
+    vlc_fourcc_t    i_vcodec;
+    mtime_t         i_gop;
+
+    int             i_renditions;
+    rendition_cfg_t *p_renditions;
+};
+
+struct sout_stream_id_sys_t
+{
+    /* pass through */
+    void            *id;
+
+    /* video: one decoder for all the renditions */
+    decoder_t       *p_decoder;
+    video_format_t  fmt_input;
+    rendition_t     *p_renditions;
+    int             i_renditions;
+    mtime_t         i_next_key;
+    unsigned        i_keyframes;
+    bool            b_error;
+};
+
+static int ParseRenditions( sout_stream_t *p_stream, const char *psz )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    while( *psz )
+    {
+        rendition_cfg_t cfg;
+        char *end;
+
+        cfg.i_width = strtoul( psz, &end, 10 );
+        if( *end != 'x' )
+            goto error;
+        cfg.i_height = strtoul( end + 1, &end, 10 );
+        if( *end != '@' )
+            goto error;
+        cfg.i_bitrate = strtoul( end + 1, &end, 10 ) * 1000;
+        if( ( *end != ',' && *end != '\0' ) || cfg.i_bitrate <= 0 )
+            goto error;
+        psz = ( *end == ',' ) ? end + 1 : end;
+
+        TAB_APPEND_CAST( (rendition_cfg_t *), p_sys->i_renditions,
+                         p_sys->p_renditions, cfg );
+    }
+    if( p_sys->i_renditions > 0 )
+        return VLC_SUCCESS;
+error:
+    msg_Err( p_stream, "invalid renditions near \"%s\"", psz );
+    return VLC_EGENERIC;
+}
+
+/*****************************************************************************
+ * Open:
+ *****************************************************************************/
+static int Open( vlc_object_t *p_this )
+{
+    sout_stream_t     *p_stream = (sout_stream_t*)p_this;
+    sout_stream_sys_t *p_sys;
+    char              *psz_string;
+
+    if( !p_stream->p_next )
+    {
+        msg_Err( p_stream, "cannot create chain" );
+        return VLC_EGENERIC;
+    }
+    p_sys = calloc( 1, sizeof( *p_sys ) );
+    if( !p_sys )
+        return VLC_ENOMEM;
+    p_stream->p_sys = p_sys;
+
+    config_ChainParse( p_stream, SOUT_CFG_PREFIX, ppsz_sout_options,
+                       p_stream->p_cfg );
+
+    psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "venc" );
+    if( psz_string && *psz_string )
+    {
+        char *psz_next;
+        psz_next = config_ChainCreate( &p_sys->psz_venc, &p_sys->p_venc_cfg,
+                                       psz_string );
+        free( psz_next );
+    }
+    free( psz_string );
+
+    psz_string = var_GetString( p_stream, SOUT_CFG_PREFIX "vcodec" );
+    if( psz_string && *psz_string )
+    {
+        char fcc[5] = "    \0";
+        memcpy( fcc, psz_string, __MIN( strlen( psz_string ), 4 ) );
+        p_sys->i_vcodec = vlc_fourcc_GetCodecFromString( VIDEO_ES, fcc );
+    }
+    free( psz_string );
+    if( !p_sys->i_vcodec )
+    {
+        msg_Err( p_stream, "no destination video codec" );
+        goto error;
+    }
+
+    psz_string = var_GetNonEmptyString( p_stream, SOUT_CFG_PREFIX "renditions" );
+    if( !psz_string || ParseRenditions( p_stream, psz_string ) )
+    {
+        free( psz_string );
+        goto error;
+    }
+    free( psz_string );
+
+    p_sys->i_gop = var_GetInteger( p_stream, SOUT_CFG_PREFIX "gop" ) * 1000;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+        msg_Dbg( p_stream, "rendition %d: %ux%u %d kb/s", i,
+                 p_sys->p_renditions[i].i_width,
+                 p_sys->p_renditions[i].i_height,
+                 p_sys->p_renditions[i].i_bitrate / 1000 );
+
+    p_stream->pf_add    = Add;
+    p_stream->pf_del    = Del;
+    p_stream->pf_send   = Send;
+    return VLC_SUCCESS;
+
+error:
+    Close( p_this );
+    return VLC_EGENERIC;
+}
+
+/*****************************************************************************
+ * Close:
+ *****************************************************************************/
+static void Close( vlc_object_t * p_this )
+{
+    sout_stream_t     *p_stream = (sout_stream_t*)p_this;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    config_ChainDestroy( p_sys->p_venc_cfg );
+    free( p_sys->psz_venc );
+    free( p_sys->p_renditions );
+    free( p_sys );
+}
+
+/*****************************************************************************
+ * Renditions
+ *****************************************************************************/
+static int video_update_format_decoder( decoder_t *p_dec )
+{
+    p_dec->fmt_out.video.i_chroma = p_dec->fmt_out.i_codec;
+    return 0;
+}
+
+static picture_t *video_new_buffer_decoder( decoder_t *p_dec )
+{
+    return picture_NewFromFormat( &p_dec->fmt_out.video );
+}
+
+static picture_t *video_new_buffer_filter( filter_t *p_filter )
+{
+    p_filter->fmt_out.video.i_chroma = p_filter->fmt_out.i_codec;
+    return picture_NewFromFormat( &p_filter->fmt_out.video );
+}
+
+static block_t *EncodePicture( rendition_t *r, picture_t *p_pic )
+{
+    const bool b_keyframe = p_pic->b_keyframe;
+    block_t *p_block;
+
+    /* The source picture is shared with the other renditions: the
+     * filters only read it, and so does the encoder if there is none */
+    p_pic = filter_chain_VideoFilter( r->p_chain, p_pic );
+    if( !p_pic )
+        return NULL;
+    if( p_pic->b_keyframe != b_keyframe ) /* new picture from the filters */
+        p_pic->b_keyframe = b_keyframe;
+
+    p_block = r->p_encoder->pf_encode_video( r->p_encoder, p_pic );
+    picture_Release( p_pic );
+    return p_block;
+}
+
+static void *EncoderThread( void *data )
+{
+    rendition_t *r = data;
+    block_t *p_block;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &r->lock );
+    for( ;; )
+    {
+        while( r->i_count == 0 && !r->b_abort )
+            vlc_cond_wait( &r->wait, &r->lock );
+        /* Encode what is queued before leaving */
+        if( r->i_count == 0 )
+            break;
+
+        picture_t *p_pic = r->pp_queue[r->i_first];
+        r->i_first = ( r->i_first + 1 ) % QUEUE_MAX;
+        r->i_count--;
+        r->b_busy = true;
+        vlc_mutex_unlock( &r->lock );
+
+        p_block = EncodePicture( r, p_pic );
+
+        vlc_mutex_lock( &r->lock );
+        block_ChainAppend( &r->p_out, p_block );
+        r->b_busy = false;
+        vlc_cond_signal( &r->done );
+    }
+    vlc_mutex_unlock( &r->lock );
+
+    /* Nobody else looks at the output until the thread is joined */
+    do {
+        p_block = r->p_encoder->pf_encode_video( r->p_encoder, NULL );
+        block_ChainAppend( &r->p_out, p_block );
+    } while( p_block );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static void RenditionPush( rendition_t *r, picture_t *p_pic )
+{
+    vlc_mutex_lock( &r->lock );
+    while( r->i_count >= QUEUE_MAX )
+        vlc_cond_wait( &r->done, &r->lock );
+    r->pp_queue[( r->i_first + r->i_count ) % QUEUE_MAX] = picture_Hold( p_pic );
+    r->i_count++;
+    vlc_cond_signal( &r->wait );
+    vlc_mutex_unlock( &r->lock );
+}
+
+static void RenditionDrain( rendition_t *r )
+{
+    vlc_mutex_lock( &r->lock );
+    while( r->i_count > 0 || r->b_busy )
+        vlc_cond_wait( &r->done, &r->lock );
+    vlc_mutex_unlock( &r->lock );
+}
+
+static void RenditionOutput( sout_stream_t *p_stream, rendition_t *r )
+{
+    block_t *p_out;
+
+    vlc_mutex_lock( &r->lock );
+    p_out = r->p_out;
+    r->p_out = NULL;
+    vlc_mutex_unlock( &r->lock );
+
+    if( p_out )
+        sout_StreamIdSend( p_stream->p_next, r->id, p_out );
+}
+
+/* Take care of the scaling and chroma conversion */
+static int RenditionChain( sout_stream_t *p_stream, decoder_t *p_dec,
+                           rendition_t *r )
+{
+    filter_owner_t owner = {
+        .sys = p_stream->p_sys,
+        .video = {
+            .buffer_new = video_new_buffer_filter,
+        },
+    };
+    const es_format_t *p_fmt_in = &p_dec->fmt_out;
+    const es_format_t *p_fmt_out = &r->p_encoder->fmt_in;
+
+    if( r->p_chain )
+        filter_chain_Delete( r->p_chain );
+    r->p_chain = filter_chain_NewVideo( p_stream, false, &owner );
+    if( !r->p_chain )
+        return VLC_ENOMEM;
+    filter_chain_Reset( r->p_chain, p_fmt_in, p_fmt_out );
+
+    if( ( p_fmt_in->video.i_chroma != p_fmt_out->video.i_chroma ) ||
+        ( p_fmt_in->video.i_width != p_fmt_out->video.i_width ) ||
+        ( p_fmt_in->video.i_height != p_fmt_out->video.i_height ) )
+    {
+        if( !filter_chain_AppendFilter( r->p_chain, NULL, NULL,
+                                        p_fmt_in, p_fmt_out ) )
+        {
+            msg_Err( p_stream, "cannot convert %4.4s %ux%u to %4.4s %ux%u",
+                     (char *)&p_fmt_in->video.i_chroma,
+                     p_fmt_in->video.i_width, p_fmt_in->video.i_height,
+                     (char *)&p_fmt_out->video.i_chroma,
+                     p_fmt_out->video.i_width, p_fmt_out->video.i_height );
+            return VLC_EGENERIC;
+        }
+    }
+    return VLC_SUCCESS;
+}
+
+static void RenditionSetup( sout_stream_t *p_stream,
+                            sout_stream_id_sys_t *id, encoder_t *p_enc,
+                            const rendition_cfg_t *cfg, int i_index )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    const video_format_t *src = &id->p_decoder->fmt_out.video;
+    video_format_t *in = &p_enc->fmt_in.video;
+    video_format_t *out = &p_enc->fmt_out.video;
+
+    es_format_Init( &p_enc->fmt_in, VIDEO_ES, src->i_chroma );
+    es_format_Init( &p_enc->fmt_out, VIDEO_ES, p_sys->i_vcodec );
+    p_enc->fmt_out.i_id = id->p_decoder->fmt_in.i_id + ID_STEP * i_index;
+    p_enc->fmt_out.i_group = id->p_decoder->fmt_in.i_group;
+    p_enc->fmt_out.i_bitrate = cfg->i_bitrate;
+    if( id->p_decoder->fmt_in.psz_language )
+        p_enc->fmt_out.psz_language =
+            strdup( id->p_decoder->fmt_in.psz_language );
+
+    /* Scale the visible area, keeping the pixel aspect when only one
+     * dimension is given */
+    float f_scale_width = 1, f_scale_height = 1;
+    if( cfg->i_width )
+        f_scale_width = (float)cfg->i_width / src->i_visible_width;
+    if( cfg->i_height )
+        f_scale_height = (float)cfg->i_height / src->i_visible_height;
+    if( !cfg->i_width )
+        f_scale_width = cfg->i_height ? f_scale_height : 1;
+    if( !cfg->i_height )
+        f_scale_height = f_scale_width;
+
+    out->i_visible_width  = 2 * lroundf( f_scale_width * src->i_visible_width / 2 );
+    out->i_visible_height = 2 * lroundf( f_scale_height * src->i_visible_height / 2 );
+    out->i_width  = 2 * lroundf( f_scale_width * src->i_width / 2 );
+    out->i_height = 2 * lroundf( f_scale_height * src->i_height / 2 );
+
+    vlc_ureduce( &out->i_sar_num, &out->i_sar_den,
+                 (uint64_t)src->i_sar_num * src->i_visible_width * out->i_visible_height,
+                 (uint64_t)src->i_sar_den * src->i_visible_height * out->i_visible_width,
+                 0 );
+    if( src->i_frame_rate && src->i_frame_rate_base )
+    {
+        out->i_frame_rate = src->i_frame_rate;
+        out->i_frame_rate_base = src->i_frame_rate_base;
+    }
+    else
+    {
+        out->i_frame_rate = ENC_FRAMERATE;
+        out->i_frame_rate_base = ENC_FRAMERATE_BASE;
+    }
+    out->orientation = src->orientation;
+
+    in->i_chroma = src->i_chroma;
+    in->i_width = out->i_width;
+    in->i_height = out->i_height;
+    in->i_visible_width = out->i_visible_width;
+    in->i_visible_height = out->i_visible_height;
+    in->i_sar_num = out->i_sar_num;
+    in->i_sar_den = out->i_sar_den;
+    in->i_frame_rate = out->i_frame_rate;
+    in->i_frame_rate_base = out->i_frame_rate_base;
+    in->orientation = out->orientation;
+}
+
+static int ConfigAppend( config_chain_t **pp_cfg, const char *psz_name,
+                         const char *psz_fmt, ... )
+{
+    config_chain_t *p = malloc( sizeof( *p ) );
+    if( !p )
+        return VLC_ENOMEM;
+
+    va_list ap;
+    va_start( ap, psz_fmt );
+    if( vasprintf( &p->psz_value, psz_fmt, ap ) == -1 )
+        p->psz_value = NULL;
+    va_end( ap );
+    p->psz_name = strdup( psz_name );
+    if( !p->psz_name || !p->psz_value )
+    {
+        free( p->psz_name );
+        free( p->psz_value );
+        free( p );
+        return VLC_ENOMEM;
+    }
+    p->p_next = NULL;
+    while( *pp_cfg != NULL )
+        pp_cfg = &(*pp_cfg)->p_next;
+    *pp_cfg = p;
+    return VLC_SUCCESS;
+}
+
+/* The encoder options of a rendition: with aligned GOPs, the encoder must
+ * not add keyframes of its own (scene cuts, maximum interval), or the
+ * segmenter would cut the renditions at different positions. The options
+ * are set in order, so the last occurrence wins: appended, these override
+ * the venc options. */
+static config_chain_t *RenditionConfig( sout_stream_t *p_stream,
+                                        const video_format_t *fmt )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    config_chain_t *p_cfg = config_ChainDuplicate( p_sys->p_venc_cfg );
+
+    if( p_sys->i_gop <= 0 )
+        return p_cfg;
+
+    /* One picture of slack, so that a forced keyframe landing a picture
+     * late on the grid is never preceded by one from the encoder */
+    unsigned i_keyint = 1 + ( p_sys->i_gop * fmt->i_frame_rate
+                              + CLOCK_FREQ * fmt->i_frame_rate_base - 1 )
+                            / ( CLOCK_FREQ * fmt->i_frame_rate_base );
+
+    if( ConfigAppend( &p_cfg, "keyint", "%u", i_keyint ) ||
+        ConfigAppend( &p_cfg, "min-keyint", "%u", i_keyint ) ||
+        ConfigAppend( &p_cfg, "scenecut", "0" ) )
+        msg_Warn( p_stream, "cannot disable the encoder keyframes" );
+    return p_cfg;
+}
+
+static int RenditionOpen( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                          rendition_t *r, int i_index )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    const rendition_cfg_t *cfg = &p_sys->p_renditions[i_index];
+    encoder_t *p_enc;
+
+    r->p_encoder = p_enc = sout_EncoderCreate( p_stream );
+    if( !p_enc )
+        return VLC_ENOMEM;
+
+    RenditionSetup( p_stream, id, p_enc, cfg, i_index );
+    r->p_cfg = RenditionConfig( p_stream, &p_enc->fmt_in.video );
+    p_enc->p_cfg = r->p_cfg;
+    p_enc->p_module = module_need( p_enc, "encoder", p_sys->psz_venc, true );
+    if( !p_enc->p_module )
+    {
+        msg_Err( p_stream, "cannot find video encoder (module:%s fourcc:%4.4s)",
+                 p_sys->psz_venc ? p_sys->psz_venc : "any",
+                 (char *)&p_sys->i_vcodec );
+        return VLC_EGENERIC;
+    }
+    p_enc->fmt_in.video.i_chroma = p_enc->fmt_in.i_codec;
+    p_enc->fmt_out.i_codec =
+        vlc_fourcc_GetCodec( VIDEO_ES, p_enc->fmt_out.i_codec );
+
+    if( RenditionChain( p_stream, id->p_decoder, r ) )
+        return VLC_EGENERIC;
+
+    r->id = sout_StreamIdAdd( p_stream->p_next, &p_enc->fmt_out );
+    if( !r->id )
+    {
+        msg_Err( p_stream, "cannot add this stream" );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_stream, "rendition %d: %ux%u %d kb/s, es %d", i_index,
+             p_enc->fmt_out.video.i_visible_width,
+             p_enc->fmt_out.video.i_visible_height,
+             p_enc->fmt_out.i_bitrate / 1000, p_enc->fmt_out.i_id );
+
+    if( vlc_clone( &r->thread, EncoderThread, r, VLC_THREAD_PRIORITY_VIDEO ) )
+    {
+        msg_Err( p_stream, "cannot spawn encoder thread" );
+        return VLC_EGENERIC;
+    }
+    r->b_thread = true;
+    return VLC_SUCCESS;
+}
+
+static void RenditionClose( sout_stream_t *p_stream, rendition_t *r )
+{
+    if( r->b_thread )
+    {
+        vlc_mutex_lock( &r->lock );
+        r->b_abort = true;
+        vlc_cond_signal( &r->wait );
+        vlc_mutex_unlock( &r->lock );
+        vlc_join( r->thread, NULL );
+    }
+
+    if( r->id )
+    {
+        RenditionOutput( p_stream, r );
+        sout_StreamIdDel( p_stream->p_next, r->id );
+    }
+    block_ChainRelease( r->p_out );
+
+    if( r->p_chain )
+        filter_chain_Delete( r->p_chain );
+
+    if( r->p_encoder )
+    {
+        if( r->p_encoder->p_module )
+            module_unneed( r->p_encoder, r->p_encoder->p_module );
+        es_format_Clean( &r->p_encoder->fmt_in );
+        es_format_Clean( &r->p_encoder->fmt_out );
+        vlc_object_release( r->p_encoder );
+    }
+    config_ChainDestroy( r->p_cfg );
+
+    vlc_cond_destroy( &r->done );
+    vlc_cond_destroy( &r->wait );
+    vlc_mutex_destroy( &r->lock );
+}
+
+static int StartRenditions( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+
+    id->p_renditions = calloc( p_sys->i_renditions, sizeof( rendition_t ) );
+    if( !id->p_renditions )
+        return VLC_ENOMEM;
+
+    for( int i = 0; i < p_sys->i_renditions; i++ )
+    {
+        rendition_t *r = &id->p_renditions[id->i_renditions++];
+
+        r->p_stream = p_stream;
+        vlc_mutex_init( &r->lock );
+        vlc_cond_init( &r->wait );
+        vlc_cond_init( &r->done );
+        if( RenditionOpen( p_stream, id, r, i ) )
+            return VLC_EGENERIC;
+    }
+    id->fmt_input = id->p_decoder->fmt_out.video;
+    return VLC_SUCCESS;
+}
+
+static void StopRenditions( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    for( int i = 0; i < id->i_renditions; i++ )
+        RenditionClose( p_stream, &id->p_renditions[i] );
+    free( id->p_renditions );
+    id->p_renditions = NULL;
+    id->i_renditions = 0;
+}
+
+/*****************************************************************************
+ * Add/Del/Send:
+ *****************************************************************************/
+static sout_stream_id_sys_t *Add( sout_stream_t *p_stream, es_format_t *p_fmt )
+{
+    sout_stream_id_sys_t *id;
+    decoder_t *p_dec;
+
+    id = calloc( 1, sizeof( *id ) );
+    if( !id )
+        return NULL;
+
+    if( p_fmt->i_cat != VIDEO_ES )
+    {
+        id->id = sout_StreamIdAdd( p_stream->p_next, p_fmt );
+        if( !id->id )
+        {
+            free( id );
+            return NULL;
+        }
+        return id;
+    }
+
+    msg_Dbg( p_stream, "creating ladder from fcc=`%4.4s' to fcc=`%4.4s'",
+             (char*)&p_fmt->i_codec, (char*)&p_stream->p_sys->i_vcodec );
+
+    id->p_decoder = p_dec = vlc_object_create( p_stream, sizeof( decoder_t ) );
+    if( !p_dec )
+    {
+        free( id );
+        return NULL;
+    }
+    es_format_Copy( &p_dec->fmt_in, p_fmt );
+    es_format_Copy( &p_dec->fmt_out, p_fmt );
+    free( p_dec->fmt_out.p_extra );
+    p_dec->fmt_out.p_extra = NULL;
+    p_dec->fmt_out.i_extra = 0;
+    p_dec->b_pace_control = true;
+    p_dec->pf_vout_format_update = video_update_format_decoder;
+    p_dec->pf_vout_buffer_new = video_new_buffer_decoder;
+
+    p_dec->p_module = module_need( p_dec, "decoder", "$codec", false );
+    if( !p_dec->p_module )
+    {
+        msg_Err( p_stream, "cannot find video decoder" );
+        es_format_Clean( &p_dec->fmt_in );
+        es_format_Clean( &p_dec->fmt_out );
+        vlc_object_release( p_dec );
+        free( id );
+        return NULL;
+    }
+
+    /* The encoders are opened with the first picture, once the
+     * characteristics of the decoded stream are known */
+    id->i_next_key = VLC_TS_INVALID;
+    return id;
+}
+
+static int Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
+{
+    if( id->p_decoder )
+    {
+        decoder_t *p_dec = id->p_decoder;
+
+        msg_Dbg( p_stream, "%u aligned keyframes forced", id->i_keyframes );
+        StopRenditions( p_stream, id );
+
+        module_unneed( p_dec, p_dec->p_module );
+        es_format_Clean( &p_dec->fmt_in );
+        es_format_Clean( &p_dec->fmt_out );
+        vlc_object_release( p_dec );
+    }
+
+    if( id->id )
+        sout_StreamIdDel( p_stream->p_next, id->id );
+    free( id );
+    return VLC_SUCCESS;
+}
+
+static int ProcessPicture( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                           picture_t *p_pic )
+{
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    video_format_t *src = &id->p_decoder->fmt_out.video;
+
+    if( !src->i_visible_width )
+        src->i_visible_width = src->i_width;
+    if( !src->i_visible_height )
+        src->i_visible_height = src->i_height;
+    if( !src->i_sar_num || !src->i_sar_den )
+        src->i_sar_num = src->i_sar_den = 1;
+
+    if( unlikely( !id->p_renditions ) )
+    {
+        if( StartRenditions( p_stream, id ) )
+        {
+            StopRenditions( p_stream, id );
+            return VLC_EGENERIC;
+        }
+    }
+    else if( unlikely( !video_format_IsSimilar( &id->fmt_input, src ) ) )
+    {
+        /* Keep the output formats, only the conversions change */
+        msg_Info( p_stream, "input format changed, resetting conversions" );
+        for( int i = 0; i < id->i_renditions; i++ )
+        {
+            rendition_t *r = &id->p_renditions[i];
+
+            RenditionDrain( r );
+            if( RenditionChain( p_stream, id->p_decoder, r ) )
+                return VLC_EGENERIC;
+        }
+        id->fmt_input = *src;
+    }
+
+    /* Shared GOP boundaries, on a grid of the source timestamps */
+    p_pic->b_keyframe = false;
+    if( p_sys->i_gop > 0 && p_pic->date > VLC_TS_INVALID )
+    {
+        if( id->i_next_key == VLC_TS_INVALID ||
+            p_pic->date < id->i_next_key - 2 * p_sys->i_gop )
+            id->i_next_key = p_pic->date;
+        if( p_pic->date >= id->i_next_key )
+        {
+            p_pic->b_keyframe = true;
+            id->i_keyframes++;
+            while( id->i_next_key <= p_pic->date )
+                id->i_next_key += p_sys->i_gop;
+        }
+    }
+
+    for( int i = 0; i < id->i_renditions; i++ )
+        RenditionPush( &id->p_renditions[i], p_pic );
+    return VLC_SUCCESS;
+}
+
+static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
+                 block_t *p_buffer )
+{
+    picture_t *p_pic;
+    int i_ret = VLC_SUCCESS;
+
+    if( !id->p_decoder )
+        return sout_StreamIdSend( p_stream->p_next, id->id, p_buffer );
+
+    while( (p_pic = id->p_decoder->pf_decode_video( id->p_decoder,
+                                                     &p_buffer )) )
+    {
+        i_ret = id->b_error ? VLC_EGENERIC
+                            : ProcessPicture( p_stream, id, p_pic );
+
+        picture_Release( p_pic );
+        if( i_ret != VLC_SUCCESS )
+        {
+            id->b_error = true;
+            /* The decoder may not have taken the whole block */
+            if( p_buffer )
+                block_Release( p_buffer );
+            break;
+        }
+    }
+
+    /* What was encoded before the error still goes out */
+    for( int i = 0; i < id->i_renditions; i++ )
+        RenditionOutput( p_stream, &id->p_renditions[i] );
+    return i_ret;
+}
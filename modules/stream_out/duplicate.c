@@ -33,6 +33,10 @@
 #include <vlc_plugin.h>
 #include <vlc_sout.h>
 #include <vlc_block.h>
+#include <vlc_codec.h>
+#include <vlc_modules.h>
+
+#include "shared_decoder.h"
 
 /*****************************************************************************
  * Module descriptor
@@ -74,9 +78,15 @@ struct sout_stream_id_sys_t
 {
     int                 i_nb_ids;
     void                **pp_ids;
+
+    sout_shared_decoder_t *p_shared;
 };
 
 static bool ESSelected( es_format_t *fmt, char *psz_select );
+static bool IsTranscode( sout_stream_t * );
+static sout_shared_decoder_t *SharedDecoderNew( sout_stream_t *,
+                                                const es_format_t * );
+static void SharedDecoderDelete( sout_shared_decoder_t * );
 
 /*****************************************************************************
  * Open:
@@ -194,10 +204,24 @@ static sout_stream_id_sys_t * Add( sout_stream_t *p_stream, es_format_t *p_fmt )
         return NULL;
 
     TAB_INIT( id->i_nb_ids, id->pp_ids );
+    id->p_shared = NULL;
 
     msg_Dbg( p_stream, "duplicated a new stream codec=%4.4s (es=%d group=%d)",
              (char*)&p_fmt->i_codec, p_fmt->i_id, p_fmt->i_group );
 
+    /* Decode the video once for all the outputs that transcode it */
+    if( p_fmt->i_cat == VIDEO_ES )
+    {
+        int i_transcode = 0;
+
+        for( i_stream = 0; i_stream < p_sys->i_nb_streams; i_stream++ )
+            if( IsTranscode( p_sys->pp_streams[i_stream] ) &&
+                ESSelected( p_fmt, p_sys->ppsz_select[i_stream] ) )
+                i_transcode++;
+        if( i_transcode >= 2 )
+            id->p_shared = SharedDecoderNew( p_stream, p_fmt );
+    }
+
     for( i_stream = 0; i_stream < p_sys->i_nb_streams; i_stream++ )
     {
         void *id_new = NULL;
@@ -205,8 +229,16 @@ static sout_stream_id_sys_t * Add( sout_stream_t *p_stream, es_format_t *p_fmt )
         if( ESSelected( p_fmt, p_sys->ppsz_select[i_stream] ) )
         {
             sout_stream_t *out = p_sys->pp_streams[i_stream];
+            bool b_shared = id->p_shared && IsTranscode( out );
 
+            if( b_shared )
+            {
+                var_Create( out, SOUT_SHARED_DECODER_VAR, VLC_VAR_ADDRESS );
+                var_SetAddress( out, SOUT_SHARED_DECODER_VAR, id->p_shared );
+            }
             id_new = (void*)sout_StreamIdAdd( out, p_fmt );
+            if( b_shared )
+                var_Destroy( out, SOUT_SHARED_DECODER_VAR );
             if( id_new )
             {
                 msg_Dbg( p_stream, "    - added for output %d", i_stream );
@@ -227,6 +259,17 @@ static sout_stream_id_sys_t * Add( sout_stream_t *p_stream, es_format_t *p_fmt )
         TAB_APPEND( id->i_nb_ids, id->pp_ids, id_new );
     }
 
+    if( id->p_shared )
+    {
+        msg_Dbg( p_stream, "decoder shared by %u outputs",
+                 id->p_shared->i_users );
+        if( id->p_shared->i_users == 0 )
+        {
+            SharedDecoderDelete( id->p_shared );
+            id->p_shared = NULL;
+        }
+    }
+
     if( i_valid_streams <= 0 )
     {
         Del( p_stream, id );
@@ -253,6 +296,9 @@ static int Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
         }
     }
 
+    if( id->p_shared )
+        SharedDecoderDelete( id->p_shared );
+
     free( id->pp_ids );
     free( id );
     return VLC_SUCCESS;
@@ -275,6 +321,19 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
 
         p_buffer->p_next = NULL;
 
+        if( id->p_shared )
+        {
+            /* The outputs sharing the decoder only look at the pictures */
+            decoder_t *p_dec = id->p_shared->p_decoder;
+            block_t *p_dup = block_Duplicate( p_buffer );
+            picture_t *p_pic;
+
+            if( p_dup )
+                while( (p_pic = p_dec->pf_decode_video( p_dec, &p_dup )) )
+                    TAB_APPEND( id->p_shared->i_pics, id->p_shared->pp_pics,
+                                p_pic );
+        }
+
         for( i_stream = 0; i_stream < p_sys->i_nb_streams - 1; i_stream++ )
         {
             p_dup_stream = p_sys->pp_streams[i_stream];
@@ -298,11 +357,84 @@ static int Send( sout_stream_t *p_stream, sout_stream_id_sys_t *id,
             block_Release( p_buffer );
         }
 
+        if( id->p_shared )
+        {
+            for( int i = 0; i < id->p_shared->i_pics; i++ )
+                picture_Release( id->p_shared->pp_pics[i] );
+            TAB_CLEAN( id->p_shared->i_pics, id->p_shared->pp_pics );
+        }
+
         p_buffer = p_next;
     }
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * Shared decoder
+ *****************************************************************************/
+static bool IsTranscode( sout_stream_t *p_stream )
+{
+    return !strcmp( p_stream->psz_name, "transcode" );
+}
+
+static int video_update_format_decoder( decoder_t *p_dec )
+{
+    p_dec->fmt_out.video.i_chroma = p_dec->fmt_out.i_codec;
+    return 0;
+}
+
+static picture_t *video_new_buffer_decoder( decoder_t *p_dec )
+{
+    return picture_NewFromFormat( &p_dec->fmt_out.video );
+}
+
+static sout_shared_decoder_t *SharedDecoderNew( sout_stream_t *p_stream,
+                                                const es_format_t *p_fmt )
+{
+    sout_shared_decoder_t *p_shared = calloc( 1, sizeof( *p_shared ) );
+    decoder_t *p_dec;
+
+    if( !p_shared )
+        return NULL;
+
+    p_shared->p_decoder = p_dec =
+        vlc_object_create( p_stream, sizeof( decoder_t ) );
+    if( !p_dec )
+    {
+        free( p_shared );
+        return NULL;
+    }
+    es_format_Copy( &p_dec->fmt_in, p_fmt );
+    es_format_Copy( &p_dec->fmt_out, p_fmt );
+    free( p_dec->fmt_out.p_extra );
+    p_dec->fmt_out.p_extra = NULL;
+    p_dec->fmt_out.i_extra = 0;
+    p_dec->b_pace_control = true;
+    p_dec->pf_vout_format_update = video_update_format_decoder;
+    p_dec->pf_vout_buffer_new = video_new_buffer_decoder;
+
+    p_dec->p_module = module_need( p_dec, "decoder", "$codec", false );
+    if( !p_dec->p_module )
+    {
+        msg_Dbg( p_stream, "cannot share a video decoder" );
+        SharedDecoderDelete( p_shared );
+        return NULL;
+    }
+    return p_shared;
+}
+
+static void SharedDecoderDelete( sout_shared_decoder_t *p_shared )
+{
+    decoder_t *p_dec = p_shared->p_decoder;
+
+    if( p_dec->p_module )
+        module_unneed( p_dec, p_dec->p_module );
+    es_format_Clean( &p_dec->fmt_in );
+    es_format_Clean( &p_dec->fmt_out );
+    vlc_object_release( p_dec );
+    free( p_shared );
+}
+
 /*****************************************************************************
  * Divers
  *****************************************************************************/
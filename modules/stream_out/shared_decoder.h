@@ -0,0 +1,38 @@
+/*****************************************************************************
+ * shared_decoder.h: video decoder shared by several transcode outputs
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * When several outputs of duplicate start with transcode, duplicate decodes
+ * the video ES once and publishes the decoder in this variable of each
+ * transcode stream while adding the ES to it. A transcode stream that uses
+ * it increments i_users, then takes its pictures from pp_pics instead of
+ * decoding the blocks it is sent: duplicate decodes each block right before
+ * sending it to the outputs. The pictures are shared, and must not be
+ * modified in place.
+ */
+#define SOUT_SHARED_DECODER_VAR "sout-shared-decoder"
+
+typedef struct
+{
+    decoder_t   *p_decoder;
+    picture_t   **pp_pics;  /**< decoded from the block being sent */
+    int         i_pics;
+    unsigned    i_users;
+} sout_shared_decoder_t;
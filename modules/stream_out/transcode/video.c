@@ -35,12 +35,16 @@
 #include <vlc_spu.h>
 #include <vlc_modules.h>
 
+#include "../shared_decoder.h"
+
 #define ENC_FRAMERATE (25 * 1000)
 #define ENC_FRAMERATE_BASE 1000
 
 struct decoder_owner_sys_t
 {
     sout_stream_sys_t *p_sys;
+    sout_shared_decoder_t *p_shared;
+    int i_shared_pic;
 };
 
 static int video_update_format_decoder( decoder_t *p_dec )
@@ -54,6 +58,26 @@ static picture_t *video_new_buffer_decoder( decoder_t *p_dec )
     return picture_NewFromFormat( &p_dec->fmt_out.video );
 }
 
+/* Hands out the pictures the shared decoder got from the current block */
+static picture_t *video_decode_shared( decoder_t *p_dec, block_t **pp_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    sout_shared_decoder_t *p_shared = p_owner->p_shared;
+
+    if( pp_block && *pp_block )
+    {
+        block_Release( *pp_block );
+        *pp_block = NULL;
+        p_owner->i_shared_pic = 0;
+    }
+    if( p_owner->i_shared_pic >= p_shared->i_pics )
+        return NULL;
+
+    p_dec->fmt_out.i_codec = p_shared->p_decoder->fmt_out.i_codec;
+    p_dec->fmt_out.video = p_shared->p_decoder->fmt_out.video;
+    return picture_Hold( p_shared->pp_pics[p_owner->i_shared_pic++] );
+}
+
 static picture_t *video_new_buffer_encoder( encoder_t *p_enc )
 {
     p_enc->fmt_in.video.i_chroma = p_enc->fmt_in.i_codec;
@@ -136,6 +160,7 @@ static void* EncoderThread( void *obj )
 int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
 {
     sout_stream_sys_t *p_sys = p_stream->p_sys;
+    sout_shared_decoder_t *p_shared;
 
     /* Open decoder
      * Initialization of decoder structures
@@ -153,16 +178,37 @@ int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
         return VLC_EGENERIC;
 
     id->p_decoder->p_owner->p_sys = p_sys;
+    id->p_decoder->p_owner->i_shared_pic = 0;
     /* id->p_decoder->p_cfg = p_sys->p_video_cfg; */
 
-    id->p_decoder->p_module =
-        module_need( id->p_decoder, "decoder", "$codec", false );
+    /* Use the pictures decoded by duplicate if there is no filter that
+     * could modify them in place */
+    p_shared = var_GetAddress( p_stream, SOUT_SHARED_DECODER_VAR );
+    if( p_shared && ( p_sys->psz_vf2 || p_sys->b_deinterlace ||
+                      p_sys->b_master_sync ) )
+    {
+        msg_Dbg( p_stream, "not sharing the decoder because of filters" );
+        p_shared = NULL;
+    }
+    id->p_decoder->p_owner->p_shared = p_shared;
 
-    if( !id->p_decoder->p_module )
+    if( p_shared )
     {
-        msg_Err( p_stream, "cannot find video decoder" );
-        free( id->p_decoder->p_owner );
-        return VLC_EGENERIC;
+        id->p_decoder->fmt_out.i_codec = p_shared->p_decoder->fmt_out.i_codec;
+        id->p_decoder->fmt_out.video = p_shared->p_decoder->fmt_out.video;
+        id->p_decoder->pf_decode_video = video_decode_shared;
+    }
+    else
+    {
+        id->p_decoder->p_module =
+            module_need( id->p_decoder, "decoder", "$codec", false );
+
+        if( !id->p_decoder->p_module )
+        {
+            msg_Err( p_stream, "cannot find video decoder" );
+            free( id->p_decoder->p_owner );
+            return VLC_EGENERIC;
+        }
     }
 
     /*
@@ -210,7 +256,8 @@ int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
         msg_Err( p_stream, "cannot find video encoder (module:%s fourcc:%4.4s). Take a look few lines earlier to see possible reason.",
                  p_sys->psz_venc ? p_sys->psz_venc : "any",
                  (char *)&p_sys->i_vcodec );
-        module_unneed( id->p_decoder, id->p_decoder->p_module );
+        if( id->p_decoder->p_module )
+            module_unneed( id->p_decoder, id->p_decoder->p_module );
         id->p_decoder->p_module = 0;
         free( id->p_decoder->p_owner );
         return VLC_EGENERIC;
@@ -240,7 +287,8 @@ int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
             msg_Err( p_stream, "cannot create picture fifo" );
             vlc_mutex_destroy( &p_sys->lock_out );
             vlc_cond_destroy( &p_sys->cond );
-            module_unneed( id->p_decoder, id->p_decoder->p_module );
+            if( id->p_decoder->p_module )
+                module_unneed( id->p_decoder, id->p_decoder->p_module );
             id->p_decoder->p_module = NULL;
             free( id->p_decoder->p_owner );
             return VLC_ENOMEM;
@@ -253,12 +301,18 @@ int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
             vlc_mutex_destroy( &p_sys->lock_out );
             vlc_cond_destroy( &p_sys->cond );
             picture_fifo_Delete( p_sys->pp_pics );
-            module_unneed( id->p_decoder, id->p_decoder->p_module );
+            if( id->p_decoder->p_module )
+                module_unneed( id->p_decoder, id->p_decoder->p_module );
             id->p_decoder->p_module = NULL;
             free( id->p_decoder->p_owner );
             return VLC_EGENERIC;
         }
     }
+    if( p_shared )
+    {
+        msg_Dbg( p_stream, "using the decoder shared by duplicate" );
+        p_shared->i_users++;
+    }
     return VLC_SUCCESS;
 }
 
@@ -683,6 +737,19 @@ static void OutputFrame( sout_stream_t *p_stream, picture_t *p_pic, sout_stream_
         block_ChainAppend( out, p_block );
     }
 
+    if( p_sys->i_threads && id->p_decoder->p_owner->p_shared &&
+        picture_IsReferenced( p_pic ) )
+    {
+        /* The fifo links the pictures: it can't hold a shared one */
+        picture_t *p_tmp = video_new_buffer_encoder( id->p_encoder );
+        if( likely( p_tmp ) )
+            picture_Copy( p_tmp, p_pic );
+        picture_Release( p_pic );
+        p_pic = p_tmp;
+        if( unlikely( !p_pic ) )
+            return;
+    }
+
     if( p_sys->i_threads )
     {
         vlc_mutex_lock( &p_sys->lock_out );
@@ -55,6 +55,10 @@ static void Destroy   ( vlc_object_t * );
 
 static picture_t *FilterPlanar( filter_t *, picture_t * );
 static picture_t *FilterPacked( filter_t *, picture_t * );
+static const void *PreparePlanar( filter_t *, picture_t * );
+static const void *PreparePacked( filter_t *, picture_t * );
+static void AdjustPlanar( filter_t *, picture_t *, picture_t *, const void * );
+static void AdjustPacked( filter_t *, picture_t *, picture_t *, const void * );
 static int AdjustCallback( vlc_object_t *p_this, char const *psz_var,
                            vlc_value_t oldval, vlc_value_t newval,
                            void *p_data );
@@ -113,6 +117,15 @@ static const char *const ppsz_filter_options[] = {
     "brightness-threshold", NULL
 };
 
+/* Settings of the picture being processed, shared by all its bands */
+typedef struct
+{
+    int pi_luma[256];
+    int i_sat;
+    int i_sin, i_cos;
+    int i_x, i_y;
+} adjust_job_t;
+
 /*****************************************************************************
  * filter_sys_t: adjust filter method descriptor
  *****************************************************************************/
@@ -129,6 +142,7 @@ struct filter_sys_t
                                int, int );
     int (*pf_process_sat_hue_clip)( picture_t *, picture_t *, int, int,
                                     int, int, int );
+    adjust_job_t job;
 };
 
 /*****************************************************************************
@@ -171,6 +185,8 @@ static int Create( vlc_object_t *p_this )
         CASE_PLANAR_YUV
             /* Planar YUV */
             p_filter->pf_video_filter = FilterPlanar;
+            p_filter->pf_video_slice = AdjustPlanar;
+            p_filter->pf_video_slice_prepare = PreparePlanar;
             p_sys->pf_process_sat_hue_clip = planar_sat_hue_clip_C;
             p_sys->pf_process_sat_hue = planar_sat_hue_C;
             break;
@@ -178,6 +194,8 @@ static int Create( vlc_object_t *p_this )
         CASE_PACKED_YUV_422
             /* Packed YUV 4:2:2 */
             p_filter->pf_video_filter = FilterPacked;
+            p_filter->pf_video_slice = AdjustPacked;
+            p_filter->pf_video_slice_prepare = PreparePacked;
             p_sys->pf_process_sat_hue_clip = packed_sat_hue_clip_C;
             p_sys->pf_process_sat_hue = packed_sat_hue_C;
             break;
@@ -225,14 +243,7 @@ static void Destroy( vlc_object_t *p_this )
  *****************************************************************************/
 static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
 {
-    int pi_luma[256];
-    int pi_gamma[256];
-
     picture_t *p_outpic;
-    uint8_t *p_in, *p_in_end, *p_line_end;
-    uint8_t *p_out;
-
-    filter_sys_t *p_sys = p_filter->p_sys;
 
     if( !p_pic ) return NULL;
 
@@ -243,6 +254,23 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
         return NULL;
     }
 
+    AdjustPlanar( p_filter, p_pic, p_outpic,
+                  PreparePlanar( p_filter, p_pic ) );
+
+    return CopyInfoAndRelease( p_outpic, p_pic );
+}
+
+/* Reads the settings and fills the tables, once per picture */
+static const void *PreparePlanar( filter_t *p_filter, picture_t *p_pic )
+{
+    int pi_gamma[256];
+
+    filter_sys_t *p_sys = p_filter->p_sys;
+    adjust_job_t *p_job = &p_sys->job;
+    int *pi_luma = p_job->pi_luma;
+
+    VLC_UNUSED(p_pic);
+
     /* Get variables */
     vlc_mutex_lock( &p_sys->lock );
     int32_t i_cont = lroundf( p_sys->f_contrast * 255.f );
@@ -292,6 +320,28 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
         i_sat = 0;
     }
 
+    p_job->i_sat = i_sat;
+    p_job->i_sin = sinf(f_hue) * 256.f;
+    p_job->i_cos = cosf(f_hue) * 256.f;
+
+    p_job->i_x = ( cosf(f_hue) + sinf(f_hue) ) * 32768.f;
+    p_job->i_y = ( cosf(f_hue) - sinf(f_hue) ) * 32768.f;
+
+    return p_job;
+}
+
+/* Also called by the filter chain on bands of the picture */
+static void AdjustPlanar( filter_t *p_filter, picture_t *p_pic,
+                          picture_t *p_outpic, const void *p_data )
+{
+    const adjust_job_t *p_job = p_data;
+    const int *pi_luma = p_job->pi_luma;
+
+    uint8_t *p_in, *p_in_end, *p_line_end;
+    uint8_t *p_out;
+
+    filter_sys_t *p_sys = p_filter->p_sys;
+
     /*
      * Do the Y plane
      */
@@ -332,28 +382,22 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
      * Do the U and V planes
      */
 
-    int i_sin = sinf(f_hue) * 256.f;
-    int i_cos = cosf(f_hue) * 256.f;
-
-    int i_x = ( cosf(f_hue) + sinf(f_hue) ) * 32768.f;
-    int i_y = ( cosf(f_hue) - sinf(f_hue) ) * 32768.f;
-
-    if ( i_sat > 256 )
+    if ( p_job->i_sat > 256 )
     {
         /* Currently no errors are implemented in the function, if any are added
          * check them here */
-        p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
+        p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, p_job->i_sin,
+                                        p_job->i_cos, p_job->i_sat,
+                                        p_job->i_x, p_job->i_y );
     }
     else
     {
         /* Currently no errors are implemented in the function, if any are added
          * check them here */
-        p_sys->pf_process_sat_hue( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y );
+        p_sys->pf_process_sat_hue( p_pic, p_outpic, p_job->i_sin,
+                                   p_job->i_cos, p_job->i_sat,
+                                   p_job->i_x, p_job->i_y );
     }
-
-    return CopyInfoAndRelease( p_outpic, p_pic );
 }
 
 /*****************************************************************************
@@ -361,30 +405,11 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
  *****************************************************************************/
 static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
 {
-    int pi_luma[256];
-    int pi_gamma[256];
-
     picture_t *p_outpic;
-    uint8_t *p_in, *p_in_end, *p_line_end;
-    uint8_t *p_out;
     int i_y_offset, i_u_offset, i_v_offset;
 
-    int i_pitch, i_visible_pitch;
-
-    bool b_thres;
-    double  f_hue;
-    double  f_gamma;
-    int32_t i_cont, i_lum;
-    int i_sat, i_sin, i_cos, i_x, i_y;
-    int i;
-
-    filter_sys_t *p_sys = p_filter->p_sys;
-
     if( !p_pic ) return NULL;
 
-    i_pitch = p_pic->p->i_pitch;
-    i_visible_pitch = p_pic->p->i_visible_pitch;
-
     if( GetPackedYuvOffsets( p_pic->format.i_chroma, &i_y_offset,
                              &i_u_offset, &i_v_offset ) != VLC_SUCCESS )
     {
@@ -404,6 +429,30 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
         return NULL;
     }
 
+    AdjustPacked( p_filter, p_pic, p_outpic,
+                  PreparePacked( p_filter, p_pic ) );
+
+    return CopyInfoAndRelease( p_outpic, p_pic );
+}
+
+/* Reads the settings and fills the tables, once per picture */
+static const void *PreparePacked( filter_t *p_filter, picture_t *p_pic )
+{
+    int pi_gamma[256];
+
+    bool b_thres;
+    double  f_hue;
+    double  f_gamma;
+    int32_t i_cont, i_lum;
+    int i_sat;
+    int i;
+
+    filter_sys_t *p_sys = p_filter->p_sys;
+    adjust_job_t *p_job = &p_sys->job;
+    int *pi_luma = p_job->pi_luma;
+
+    VLC_UNUSED(p_pic);
+
     /* Get variables */
     vlc_mutex_lock( &p_sys->lock );
     i_cont = (int)( p_sys->f_contrast * 255 );
@@ -453,6 +502,39 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
         i_sat = 0;
     }
 
+    p_job->i_sat = i_sat;
+    p_job->i_sin = sin(f_hue) * 256;
+    p_job->i_cos = cos(f_hue) * 256;
+
+    p_job->i_x = ( cos(f_hue) + sin(f_hue) ) * 32768;
+    p_job->i_y = ( cos(f_hue) - sin(f_hue) ) * 32768;
+
+    return p_job;
+}
+
+/* Also called by the filter chain on bands of the picture */
+static void AdjustPacked( filter_t *p_filter, picture_t *p_pic,
+                          picture_t *p_outpic, const void *p_data )
+{
+    const adjust_job_t *p_job = p_data;
+    const int *pi_luma = p_job->pi_luma;
+
+    uint8_t *p_in, *p_in_end, *p_line_end;
+    uint8_t *p_out;
+    int i_y_offset, i_u_offset, i_v_offset;
+
+    int i_pitch, i_visible_pitch;
+
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    i_pitch = p_pic->p->i_pitch;
+    i_visible_pitch = p_pic->p->i_visible_pitch;
+
+    /* Checked by FilterPacked() and Create() */
+    if( GetPackedYuvOffsets( p_pic->format.i_chroma, &i_y_offset,
+                             &i_u_offset, &i_v_offset ) != VLC_SUCCESS )
+        return;
+
     /*
      * Do the Y plane
      */
@@ -494,40 +576,20 @@ static picture_t *FilterPacked( filter_t *p_filter, picture_t *p_pic )
      * Do the U and V planes
      */
 
-    i_sin = sin(f_hue) * 256;
-    i_cos = cos(f_hue) * 256;
-
-    i_x = ( cos(f_hue) + sin(f_hue) ) * 32768;
-    i_y = ( cos(f_hue) - sin(f_hue) ) * 32768;
-
-    if ( i_sat > 256 )
+    if ( p_job->i_sat > 256 )
     {
-        if ( p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                             i_x, i_y ) != VLC_SUCCESS )
-        {
-            /* Currently only one error can happen in the function, but if there
-             * will be more of them, this message must go away */
-            msg_Warn( p_filter, "Unsupported input chroma (%4.4s)",
-                      (char*)&(p_pic->format.i_chroma) );
-            picture_Release( p_pic );
-            return NULL;
-        }
+        /* The only error of the function, an unsupported chroma, was
+         * checked by FilterPacked() */
+        p_sys->pf_process_sat_hue_clip( p_pic, p_outpic, p_job->i_sin,
+                                        p_job->i_cos, p_job->i_sat,
+                                        p_job->i_x, p_job->i_y );
     }
     else
     {
-        if ( p_sys->pf_process_sat_hue( p_pic, p_outpic, i_sin, i_cos, i_sat,
-                                        i_x, i_y ) != VLC_SUCCESS )
-        {
-            /* Currently only one error can happen in the function, but if there
-             * will be more of them, this message must go away */
-            msg_Warn( p_filter, "Unsupported input chroma (%4.4s)",
-                      (char*)&(p_pic->format.i_chroma) );
-            picture_Release( p_pic );
-            return NULL;
-        }
+        p_sys->pf_process_sat_hue( p_pic, p_outpic, p_job->i_sin,
+                                   p_job->i_cos, p_job->i_sat,
+                                   p_job->i_x, p_job->i_y );
     }
-
-    return CopyInfoAndRelease( p_outpic, p_pic );
 }
 
 static int AdjustCallback( vlc_object_t *p_this, char const *psz_var,
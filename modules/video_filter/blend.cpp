@@ -32,6 +32,7 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
 /*****************************************************************************
@@ -615,11 +616,243 @@ static const struct {
 #undef YUV
 };
 
+/*****************************************************************************
+ * Vector blending
+ *****************************************************************************
+ * Subtitles and OSD are blended from YUVA or RGBA onto I420, NV12 or RV32
+ * pictures a row at a time, by the kernels of blend_simd.h.
+ *****************************************************************************/
+struct blend_kernels_t {
+    void (*plane)(uint8_t *, const uint8_t *, const uint8_t *,
+                  unsigned, unsigned);
+    void (*plane_half)(uint8_t *, const uint8_t *, const uint8_t *,
+                       unsigned, unsigned);
+    void (*plane_interleaved)(uint8_t *, const uint8_t *, const uint8_t *,
+                              const uint8_t *, unsigned, unsigned);
+    void (*rgbx)(uint8_t *, const uint8_t *, unsigned, unsigned,
+                 const unsigned[3]);
+};
+
+#if (VLC_GCC_VERSION(9, 0) || defined(__clang__))
+# if defined(__x86_64__) || defined(__i386__)
+#  define BLEND_VECTOR 16
+#  define BLEND_FUNC(name) name##SSE4_1
+#  define BLEND_TARGET __attribute__ ((__target__ ("sse4.1")))
+#  include "blend_simd.h"
+#  undef BLEND_TARGET
+#  undef BLEND_FUNC
+#  undef BLEND_VECTOR
+#  define BLEND_VECTOR 32
+#  define BLEND_FUNC(name) name##AVX2
+#  define BLEND_TARGET __attribute__ ((__target__ ("avx2")))
+#  include "blend_simd.h"
+#  undef BLEND_TARGET
+#  undef BLEND_FUNC
+#  undef BLEND_VECTOR
+#  define BLEND_HAVE_SSE4_1
+#  define BLEND_HAVE_AVX2
+# elif defined(__aarch64__) || defined(__ARM_NEON__)
+#  define BLEND_VECTOR 16
+#  define BLEND_FUNC(name) name##NEON
+#  define BLEND_TARGET
+#  include "blend_simd.h"
+#  undef BLEND_TARGET
+#  undef BLEND_FUNC
+#  undef BLEND_VECTOR
+#  define BLEND_HAVE_NEON
+# endif
+#endif
+
+static const blend_kernels_t *GetKernels(void)
+{
+#ifdef BLEND_HAVE_AVX2
+    if (vlc_CPU_AVX2())
+        return &kernelsAVX2;
+#endif
+#ifdef BLEND_HAVE_SSE4_1
+    if (vlc_CPU_SSE4_1())
+        return &kernelsSSE4_1;
+#endif
+#ifdef BLEND_HAVE_NEON
+    return &kernelsNEON;
+#endif
+    return NULL;
+}
+
+/* Rows of a YUVA or RGBA picture, as YUVA planes */
+template <bool from_rgba>
+class CRowsYUVA {
+public:
+    CRowsYUVA(const picture_t *picture, unsigned x, unsigned y, unsigned width)
+        : picture(picture), x(x), y(y), width(width), buffer(NULL)
+    {
+        if (from_rgba)
+            buffer = (uint8_t *)malloc(4 * width);
+    }
+    ~CRowsYUVA()
+    {
+        free(buffer);
+    }
+    bool isValid() const
+    {
+        return !from_rgba || buffer != NULL;
+    }
+    void get(const uint8_t *row[4])
+    {
+        if (!from_rgba) {
+            for (unsigned i = 0; i < 4; i++)
+                row[i] = &picture->p[i].p_pixels[y * picture->p[i].i_pitch + x];
+            return;
+        }
+        const uint8_t *src = &picture->p[0].p_pixels[y * picture->p[0].i_pitch + 4 * x];
+        for (unsigned i = 0; i < 4; i++)
+            row[i] = &buffer[i * width];
+        for (unsigned i = 0; i < width; i++) {
+            rgb_to_yuv(&buffer[i], &buffer[width + i], &buffer[2 * width + i],
+                       src[4 * i + 0], src[4 * i + 1], src[4 * i + 2]);
+            buffer[3 * width + i] = src[4 * i + 3];
+        }
+    }
+    void nextLine()
+    {
+        y++;
+    }
+private:
+    const picture_t *picture;
+    unsigned x;
+    unsigned y;
+    unsigned width;
+    uint8_t *buffer;
+};
+
+typedef bool (*blend_vector_t)(const blend_kernels_t *,
+                               picture_t *dst, const video_format_t *dst_fmt,
+                               unsigned x, unsigned y,
+                               const picture_t *src, unsigned src_x, unsigned src_y,
+                               unsigned width, unsigned height, unsigned alpha);
+
+/* 4:2:0, planar or with interleaved chroma */
+template <bool from_rgba, bool semiplanar, bool swap_uv>
+static bool BlendVector420(const blend_kernels_t *kernels,
+                           picture_t *dst, const video_format_t *,
+                           unsigned x, unsigned y,
+                           const picture_t *src, unsigned src_x, unsigned src_y,
+                           unsigned width, unsigned height, unsigned alpha)
+{
+    CRowsYUVA<from_rgba> rows(src, src_x, src_y, width);
+    if (!rows.isValid())
+        return false;
+
+    /* Chroma is blended from the pixels at even coordinates */
+    const unsigned cx = (x + 1) / 2;
+    const unsigned offset = 2 * cx - x;
+    const unsigned count = width > offset ? (width - offset + 1) / 2 : 0;
+
+    for (unsigned j = 0; j < height; j++, rows.nextLine()) {
+        const uint8_t *row[4];
+        const unsigned dy = y + j;
+
+        rows.get(row);
+        kernels->plane(&dst->p[0].p_pixels[dy * dst->p[0].i_pitch + x],
+                       row[0], row[3], width, alpha);
+        if (dy % 2 != 0 || count == 0)
+            continue;
+
+        const uint8_t *u = row[swap_uv ? 2 : 1] + offset;
+        const uint8_t *v = row[swap_uv ? 1 : 2] + offset;
+        const uint8_t *a = row[3] + offset;
+        if (semiplanar) {
+            kernels->plane_interleaved(&dst->p[1].p_pixels[dy / 2 * dst->p[1].i_pitch + 2 * cx],
+                                       u, v, a, count, alpha);
+        } else {
+            kernels->plane_half(&dst->p[1].p_pixels[dy / 2 * dst->p[1].i_pitch + cx],
+                                u, a, count, alpha);
+            kernels->plane_half(&dst->p[2].p_pixels[dy / 2 * dst->p[2].i_pitch + cx],
+                                v, a, count, alpha);
+        }
+    }
+    return true;
+}
+
+/* RGB with 4 bytes per pixel, without alpha */
+template <bool from_yuva>
+static bool BlendVectorRGB32(const blend_kernels_t *kernels,
+                             picture_t *dst, const video_format_t *dst_fmt,
+                             unsigned x, unsigned y,
+                             const picture_t *src, unsigned src_x, unsigned src_y,
+                             unsigned width, unsigned height, unsigned alpha)
+{
+    unsigned offset[3];
+#ifdef WORDS_BIGENDIAN
+    offset[0] = (32 - dst_fmt->i_lrshift) / 8;
+    offset[1] = (32 - dst_fmt->i_lgshift) / 8;
+    offset[2] = (32 - dst_fmt->i_lbshift) / 8;
+#else
+    offset[0] = dst_fmt->i_lrshift / 8;
+    offset[1] = dst_fmt->i_lgshift / 8;
+    offset[2] = dst_fmt->i_lbshift / 8;
+#endif
+
+    uint8_t *buffer = NULL;
+    if (from_yuva) {
+        buffer = (uint8_t *)malloc(4 * width);
+        if (!buffer)
+            return false;
+    }
+
+    for (unsigned j = 0; j < height; j++) {
+        const uint8_t *rgba;
+
+        if (from_yuva) {
+            const uint8_t *p[4];
+            for (unsigned i = 0; i < 4; i++)
+                p[i] = &src->p[i].p_pixels[(src_y + j) * src->p[i].i_pitch + src_x];
+            for (unsigned i = 0; i < width; i++) {
+                int r, g, b;
+                yuv_to_rgb(&r, &g, &b, p[0][i], p[1][i], p[2][i]);
+                buffer[4 * i + 0] = r;
+                buffer[4 * i + 1] = g;
+                buffer[4 * i + 2] = b;
+                buffer[4 * i + 3] = p[3][i];
+            }
+            rgba = buffer;
+        } else
+            rgba = &src->p[0].p_pixels[(src_y + j) * src->p[0].i_pitch + 4 * src_x];
+
+        kernels->rgbx(&dst->p[0].p_pixels[(y + j) * dst->p[0].i_pitch + 4 * x],
+                      rgba, width, alpha, offset);
+    }
+    free(buffer);
+    return true;
+}
+
+static const struct {
+    vlc_fourcc_t   dst;
+    vlc_fourcc_t   src;
+    blend_vector_t blend;
+} vector_blends[] = {
+#define YUV420(csp, semiplanar, swap_uv) \
+    { csp, VLC_CODEC_YUVA, BlendVector420<false, semiplanar, swap_uv> }, \
+    { csp, VLC_CODEC_RGBA, BlendVector420<true,  semiplanar, swap_uv> }
+
+    YUV420(VLC_CODEC_I420, false, false),
+    YUV420(VLC_CODEC_J420, false, false),
+    YUV420(VLC_CODEC_YV12, false, true),
+    YUV420(VLC_CODEC_NV12, true,  false),
+    YUV420(VLC_CODEC_NV21, true,  true),
+    { VLC_CODEC_RGB32, VLC_CODEC_YUVA, BlendVectorRGB32<true> },
+    { VLC_CODEC_RGB32, VLC_CODEC_RGBA, BlendVectorRGB32<false> },
+
+#undef YUV420
+};
+
 struct filter_sys_t {
-    filter_sys_t() : blend(NULL)
+    filter_sys_t() : blend(NULL), vector(NULL), kernels(NULL)
     {
     }
     blend_function_t blend;
+    blend_vector_t vector;
+    const blend_kernels_t *kernels;
 };
 
 /**
@@ -647,6 +880,15 @@ static void Blend(filter_t *filter,
     video_format_FixRgb(&filter->fmt_out.video);
     video_format_FixRgb(&filter->fmt_in.video);
 
+    if (sys->vector &&
+        sys->vector(sys->kernels, dst, &filter->fmt_out.video,
+                    filter->fmt_out.video.i_x_offset + x_offset,
+                    filter->fmt_out.video.i_y_offset + y_offset,
+                    src, filter->fmt_in.video.i_x_offset,
+                    filter->fmt_in.video.i_y_offset,
+                    width, height, alpha))
+        return;
+
     sys->blend(CPicture(dst, &filter->fmt_out.video,
                         filter->fmt_out.video.i_x_offset + x_offset,
                         filter->fmt_out.video.i_y_offset + y_offset),
@@ -668,6 +910,12 @@ static int Open(vlc_object_t *object)
             sys->blend = blends[i].blend;
     }
 
+    sys->kernels = GetKernels();
+    for (size_t i = 0; sys->kernels && i < sizeof(vector_blends) / sizeof(*vector_blends); i++) {
+        if (vector_blends[i].src == src && vector_blends[i].dst == dst)
+            sys->vector = vector_blends[i].blend;
+    }
+
     if (!sys->blend) {
        msg_Err(filter, "no matching alpha blending routine (chroma: %4.4s -> %4.4s)",
                (char *)&src, (char *)&dst);
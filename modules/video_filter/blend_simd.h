@@ -0,0 +1,207 @@
+/*****************************************************************************
+ * blend_simd.h: vector row kernels of the blend filter
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This file is included by blend.cpp once per instruction set. The caller
+ * defines:
+ *  - BLEND_VECTOR: the size in bytes of the vector registers,
+ *  - BLEND_FUNC(name): the name of each function of this instance,
+ *  - BLEND_TARGET: the function attributes (instruction set) if any.
+ *
+ * Each kernel blends one row, with the same rounding as merge(), so that
+ * the results are identical to those of the generic code. */
+
+#define BLEND_N (BLEND_VECTOR / 2) /* 16-bit lanes */
+
+typedef uint8_t  BLEND_FUNC(u8v)  __attribute__ ((vector_size (BLEND_N)));
+typedef uint16_t BLEND_FUNC(u16v) __attribute__ ((vector_size (BLEND_VECTOR)));
+typedef uint32_t BLEND_FUNC(u32v) __attribute__ ((vector_size (BLEND_VECTOR)));
+#define u8v  BLEND_FUNC(u8v)
+#define u16v BLEND_FUNC(u16v)
+#define u32v BLEND_FUNC(u32v)
+
+/* BLEND_N bytes, widened to 16 bits */
+static inline BLEND_TARGET
+u16v BLEND_FUNC(Load8)(const uint8_t *p)
+{
+    u8v v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_convertvector(v, u16v);
+}
+
+static inline BLEND_TARGET
+void BLEND_FUNC(Store8)(uint8_t *p, u16v v)
+{
+    const u8v n = __builtin_convertvector(v, u8v);
+    memcpy(p, &n, sizeof(n));
+}
+
+/* BLEND_N pairs of bytes, the first one of each pair being the low byte */
+static inline BLEND_TARGET
+u16v BLEND_FUNC(Load16)(const uint8_t *p)
+{
+    u16v v;
+    memcpy(&v, p, sizeof(v));
+#ifdef WORDS_BIGENDIAN
+    v = (v >> 8) | (v << 8);
+#endif
+    return v;
+}
+
+static inline BLEND_TARGET
+void BLEND_FUNC(Store16)(uint8_t *p, u16v v)
+{
+#ifdef WORDS_BIGENDIAN
+    v = (v >> 8) | (v << 8);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline BLEND_TARGET
+u16v BLEND_FUNC(Div255)(u16v v)
+{
+    return ((v >> 8) + v + 1) >> 8;
+}
+
+static inline BLEND_TARGET
+u16v BLEND_FUNC(Merge)(u16v dst, u16v src, u16v a)
+{
+    return BLEND_FUNC(Div255)((255 - a) * dst + src * a);
+}
+
+static inline BLEND_TARGET
+u32v BLEND_FUNC(Div255x32)(u32v v)
+{
+    return ((v >> 8) + v + 1) >> 8;
+}
+
+/* dst[i] blended with src[i], of alpha a[i] */
+static BLEND_TARGET
+void BLEND_FUNC(BlendPlane)(uint8_t *dst, const uint8_t *src,
+                            const uint8_t *a, unsigned n, unsigned alpha)
+{
+    unsigned i = 0;
+
+    for (; i + BLEND_N <= n; i += BLEND_N) {
+        const u16v va = BLEND_FUNC(Div255)(BLEND_FUNC(Load8)(&a[i]) * (uint16_t)alpha);
+        BLEND_FUNC(Store8)(&dst[i],
+                           BLEND_FUNC(Merge)(BLEND_FUNC(Load8)(&dst[i]),
+                                             BLEND_FUNC(Load8)(&src[i]), va));
+    }
+    for (; i < n; i++)
+        merge(&dst[i], src[i], div255(alpha * a[i]));
+}
+
+/* dst[i] blended with src[2 * i], of alpha a[2 * i] */
+static BLEND_TARGET
+void BLEND_FUNC(BlendPlaneHalf)(uint8_t *dst, const uint8_t *src,
+                                const uint8_t *a, unsigned n, unsigned alpha)
+{
+    unsigned i = 0;
+
+    /* The last pair of bytes read must not go past src[2 * (n - 1)] */
+    for (; i + BLEND_N < n; i += BLEND_N) {
+        const u16v va = BLEND_FUNC(Div255)((BLEND_FUNC(Load16)(&a[2 * i]) & 0xff) * (uint16_t)alpha);
+        const u16v vs = BLEND_FUNC(Load16)(&src[2 * i]) & 0xff;
+        BLEND_FUNC(Store8)(&dst[i],
+                           BLEND_FUNC(Merge)(BLEND_FUNC(Load8)(&dst[i]), vs, va));
+    }
+    for (; i < n; i++)
+        merge(&dst[i], src[2 * i], div255(alpha * a[2 * i]));
+}
+
+/* Interleaved dst[2 * i] and dst[2 * i + 1] blended with u[2 * i] and
+ * v[2 * i], of alpha a[2 * i] */
+static BLEND_TARGET
+void BLEND_FUNC(BlendPlaneInterleaved)(uint8_t *dst, const uint8_t *u,
+                                       const uint8_t *v, const uint8_t *a,
+                                       unsigned n, unsigned alpha)
+{
+    unsigned i = 0;
+
+    for (; i + BLEND_N < n; i += BLEND_N) {
+        const u16v va = BLEND_FUNC(Div255)((BLEND_FUNC(Load16)(&a[2 * i]) & 0xff) * (uint16_t)alpha);
+        const u16v vu = BLEND_FUNC(Load16)(&u[2 * i]) & 0xff;
+        const u16v vv = BLEND_FUNC(Load16)(&v[2 * i]) & 0xff;
+        const u16v vd = BLEND_FUNC(Load16)(&dst[2 * i]);
+
+        const u16v ru = BLEND_FUNC(Merge)(vd & 0xff, vu, va);
+        const u16v rv = BLEND_FUNC(Merge)(vd >> 8, vv, va);
+        BLEND_FUNC(Store16)(&dst[2 * i], ru | (rv << 8));
+    }
+    for (; i < n; i++) {
+        const unsigned f = div255(alpha * a[2 * i]);
+        merge(&dst[2 * i + 0], u[2 * i], f);
+        merge(&dst[2 * i + 1], v[2 * i], f);
+    }
+}
+
+/* 4 bytes pixels of dst blended with RGBA pixels, the red, green and blue
+ * bytes of dst being at the given offsets */
+static BLEND_TARGET
+void BLEND_FUNC(BlendRGBX)(uint8_t *dst, const uint8_t *rgba,
+                           unsigned n, unsigned alpha,
+                           const unsigned offset[3])
+{
+    unsigned i = 0;
+    unsigned shift[3];
+
+    for (unsigned c = 0; c < 3; c++)
+#ifdef WORDS_BIGENDIAN
+        shift[c] = 8 * (3 - offset[c]);
+#else
+        shift[c] = 8 * offset[c];
+#endif
+
+    for (; i + BLEND_VECTOR / 4 <= n; i += BLEND_VECTOR / 4) {
+        u32v s, d;
+        memcpy(&s, &rgba[4 * i], sizeof(s));
+        memcpy(&d, &dst[4 * i], sizeof(d));
+#ifdef WORDS_BIGENDIAN
+        s = (s >> 24) | ((s >> 8) & 0xff00) | ((s << 8) & 0xff0000) | (s << 24);
+#endif
+        const u32v a = BLEND_FUNC(Div255x32)((s >> 24) * alpha);
+
+        for (unsigned c = 0; c < 3; c++) {
+            const u32v sc = (s >> (8 * c)) & 0xff;
+            const u32v dc = (d >> shift[c]) & 0xff;
+            const u32v rc = BLEND_FUNC(Div255x32)((255 - a) * dc + sc * a);
+            d = (d & ~(0xffu << shift[c])) | (rc << shift[c]);
+        }
+        memcpy(&dst[4 * i], &d, sizeof(d));
+    }
+    for (; i < n; i++) {
+        const uint8_t *s = &rgba[4 * i];
+        const unsigned f = div255(alpha * s[3]);
+        for (unsigned c = 0; c < 3; c++)
+            merge(&dst[4 * i + offset[c]], s[c], f);
+    }
+}
+
+static const blend_kernels_t BLEND_FUNC(kernels) = {
+    BLEND_FUNC(BlendPlane),
+    BLEND_FUNC(BlendPlaneHalf),
+    BLEND_FUNC(BlendPlaneInterleaved),
+    BLEND_FUNC(BlendRGBX),
+};
+
+#undef u32v
+#undef u16v
+#undef u8v
+#undef BLEND_N
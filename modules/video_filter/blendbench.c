@@ -55,6 +55,21 @@ static picture_t *Filter( filter_t *, picture_t * );
 #define ALPHA_TEXT N_("Alpha of the blended image")
 #define ALPHA_LONGTEXT N_("Alpha with which the blend image is blended")
 
+#define MIN_SPEED_TEXT N_("Minimum speed")
+#define MIN_SPEED_LONGTEXT N_("The blend fails the benchmark if it is slower " \
+                              "than this number of millions of pixels per " \
+                              "second (0 to disable).")
+
+#define WIDTH_TEXT N_("Width of generated images")
+#define WIDTH_LONGTEXT N_("Width of the images generated when no file is " \
+                          "given. The generated images are always the same, " \
+                          "so that results can be compared between runs.")
+
+#define HEIGHT_TEXT N_("Height of generated images")
+#define HEIGHT_LONGTEXT N_("Height of the base image generated when no file " \
+                           "is given. The generated blend image covers its " \
+                           "bottom third, like subtitles.")
+
 #define BASE_IMAGE_TEXT N_("Image to be blended onto")
 #define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto")
 
@@ -82,6 +97,12 @@ vlc_module_begin ()
               LOOPS_LONGTEXT, false )
     add_integer_with_range( CFG_PREFIX "alpha", 128, 0, 255, ALPHA_TEXT,
               ALPHA_LONGTEXT, false )
+    add_float( CFG_PREFIX "min-speed", 0., MIN_SPEED_TEXT,
+               MIN_SPEED_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "width", 1920, 16, 8192, WIDTH_TEXT,
+              WIDTH_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "height", 1080, 16, 8192, HEIGHT_TEXT,
+              HEIGHT_LONGTEXT, false )
 
     set_section( N_("Base image"), NULL )
     add_loadfile( CFG_PREFIX "base-image", NULL, BASE_IMAGE_TEXT,
@@ -99,8 +120,8 @@ vlc_module_begin ()
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
-    "loops", "alpha", "base-image", "base-chroma", "blend-image",
-    "blend-chroma", NULL
+    "loops", "alpha", "min-speed", "width", "height", "base-image",
+    "base-chroma", "blend-image", "blend-chroma", NULL
 };
 
 /*****************************************************************************
@@ -110,6 +131,7 @@ struct filter_sys_t
 {
     bool b_done;
     int i_loops, i_alpha;
+    float f_min_speed;
 
     picture_t *p_base_image;
     picture_t *p_blend_image;
@@ -118,12 +140,44 @@ struct filter_sys_t
     vlc_fourcc_t i_blend_chroma;
 };
 
+/* Fills all the planes with the same fixed pattern, whatever the chroma, so
+ * that the alpha of the blend image goes through all the values */
+static picture_t *blendbench_GenerateImage( vlc_fourcc_t i_chroma,
+                                            unsigned i_width,
+                                            unsigned i_height )
+{
+    picture_t *p_pic = picture_New( i_chroma, i_width, i_height, 1, 1 );
+    if( p_pic == NULL )
+        return NULL;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        plane_t *p = &p_pic->p[i];
+
+        for( int y = 0; y < p->i_lines; y++ )
+            for( int x = 0; x < p->i_pitch; x++ )
+                p->p_pixels[y * p->i_pitch + x] = x * 7 + y * 13 + i * 61;
+    }
+    return p_pic;
+}
+
 static int blendbench_LoadImage( vlc_object_t *p_this, picture_t **pp_pic,
-                                 vlc_fourcc_t i_chroma, char *psz_file, const char *psz_name )
+                                 vlc_fourcc_t i_chroma, char *psz_file, const char *psz_name,
+                                 unsigned i_width, unsigned i_height )
 {
     image_handler_t *p_image;
     video_format_t fmt_in, fmt_out;
 
+    if( EMPTY_STR( psz_file ) )
+    {
+        *pp_pic = blendbench_GenerateImage( i_chroma, i_width, i_height );
+        if( *pp_pic == NULL )
+            return VLC_ENOMEM;
+        msg_Dbg( p_this, "%s image generated with dim %u x %u", psz_name,
+                 i_width, i_height );
+        return VLC_SUCCESS;
+    }
+
     memset( &fmt_in, 0, sizeof(video_format_t) );
     memset( &fmt_out, 0, sizeof(video_format_t) );
 
@@ -153,6 +207,7 @@ static int Create( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t *)p_this;
     filter_sys_t *p_sys;
     char *psz_temp, *psz_cmd;
+    unsigned i_width, i_height;
     int i_ret;
 
     /* Allocate structure */
@@ -174,13 +229,18 @@ static int Create( vlc_object_t *p_this )
                                                   CFG_PREFIX "loops" );
     p_sys->i_alpha = var_CreateGetIntegerCommand( p_filter,
                                                   CFG_PREFIX "alpha" );
+    p_sys->f_min_speed = var_CreateGetFloatCommand( p_filter,
+                                                    CFG_PREFIX "min-speed" );
+    i_width = var_CreateGetIntegerCommand( p_filter, CFG_PREFIX "width" );
+    i_height = var_CreateGetIntegerCommand( p_filter, CFG_PREFIX "height" );
 
     psz_temp = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-chroma" );
     p_sys->i_base_chroma = VLC_FOURCC( psz_temp[0], psz_temp[1],
                                        psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-image" );
     i_ret = blendbench_LoadImage( p_this, &p_sys->p_base_image,
-                                  p_sys->i_base_chroma, psz_cmd, "Base" );
+                                  p_sys->i_base_chroma, psz_cmd, "Base",
+                                  i_width, i_height );
     free( psz_temp );
     free( psz_cmd );
     if( i_ret != VLC_SUCCESS )
@@ -194,10 +254,17 @@ static int Create( vlc_object_t *p_this )
     p_sys->i_blend_chroma = VLC_FOURCC( psz_temp[0], psz_temp[1],
                                         psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "blend-image" );
-    blendbench_LoadImage( p_this, &p_sys->p_blend_image, p_sys->i_blend_chroma,
-                          psz_cmd, "Blend" );
+    i_ret = blendbench_LoadImage( p_this, &p_sys->p_blend_image,
+                                  p_sys->i_blend_chroma, psz_cmd, "Blend",
+                                  i_width, i_height / 3 );
     free( psz_temp );
     free( psz_cmd );
+    if( i_ret != VLC_SUCCESS )
+    {
+        picture_Release( p_sys->p_base_image );
+        free( p_sys );
+        return i_ret;
+    }
 
     return VLC_SUCCESS;
 }
@@ -212,6 +279,26 @@ static void Destroy( vlc_object_t *p_this )
 
     picture_Release( p_sys->p_base_image );
     picture_Release( p_sys->p_blend_image );
+    free( p_sys );
+}
+
+/* Adler-32 of the visible lines, to check that the result does not change */
+static uint32_t blendbench_Checksum( const picture_t *p_pic )
+{
+    uint32_t a = 1, b = 0;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        const plane_t *p = &p_pic->p[i];
+
+        for( int y = 0; y < p->i_visible_lines; y++ )
+            for( int x = 0; x < p->i_visible_pitch; x++ )
+            {
+                a = (a + p->p_pixels[y * p->i_pitch + x]) % 65521;
+                b = (b + a) % 65521;
+            }
+    }
+    return (b << 16) | a;
 }
 
 /*****************************************************************************
@@ -231,6 +318,13 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         picture_Release( p_pic );
         return NULL;
     }
+    /* The blend image is placed at the bottom, like subtitles */
+    const video_format_t *p_base = &p_sys->p_base_image->format;
+    const video_format_t *p_fmt = &p_sys->p_blend_image->format;
+    int i_y = 0;
+    if( p_base->i_visible_height > p_fmt->i_visible_height )
+        i_y = p_base->i_visible_height - p_fmt->i_visible_height;
+
     p_blend->fmt_out.video = p_sys->p_base_image->format;
     p_blend->fmt_in.video = p_sys->p_blend_image->format;
     p_blend->p_module = module_need( p_blend, "video blending", NULL, false );
@@ -246,17 +340,31 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
     {
         p_blend->pf_video_blend( p_blend,
                                  p_sys->p_base_image, p_sys->p_blend_image,
-                                 0, 0, p_sys->i_alpha );
+                                 0, i_y, p_sys->i_alpha );
     }
     time = mdate() - time;
+    if( time <= 0 )
+        time = 1;
+
+    const float f_speed = (float) p_sys->i_loops / time *
+                          p_fmt->i_visible_width * p_fmt->i_visible_height;
 
     msg_Info( p_filter, "Blended %d images in %f sec", p_sys->i_loops,
               time / 1000000.0f );
     msg_Info( p_filter, "Speed is: %f images/second, %f pixels/second",
               (float) p_sys->i_loops / time * 1000000,
-              (float) p_sys->i_loops / time * 1000000 *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_pitch *
-                  p_sys->p_blend_image->p[Y_PLANE].i_visible_lines );
+              f_speed * 1000000 );
+    msg_Info( p_filter, "Result checksum: %08"PRIx32,
+              blendbench_Checksum( p_sys->p_base_image ) );
+    if( p_sys->f_min_speed > 0. )
+    {
+        if( f_speed >= p_sys->f_min_speed )
+            msg_Info( p_filter, "PASS: %.1f Mpixels/s (minimum %.1f)",
+                      f_speed, p_sys->f_min_speed );
+        else
+            msg_Err( p_filter, "FAIL: %.1f Mpixels/s (minimum %.1f)",
+                     f_speed, p_sys->f_min_speed );
+    }
 
     module_unneed( p_blend, p_blend->p_module );
 
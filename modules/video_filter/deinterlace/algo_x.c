@@ -34,8 +34,11 @@
 #include <vlc_common.h>
 #include <vlc_cpu.h>
 #include <vlc_picture.h>
+#include <vlc_filter.h>
+#include <vlc_slices.h>
 
 #include "deinterlace.h" /* filter_sys_t */
+#include "common.h"      /* SliceRange() */
 
 #include "algo_x.h"
 
@@ -533,12 +536,18 @@ static inline void XDeintBand8x8MMXEXT( uint8_t *dst, int i_dst,
 }
 #endif
 
-/*****************************************************************************
- * Public functions
- *****************************************************************************/
+typedef struct
+{
+    picture_t *p_outpic;
+    picture_t *p_pic;
+} x_job_t;
 
-void RenderX( picture_t *p_outpic, picture_t *p_pic )
+/* Renders the band i_slice of the rows of blocks of each plane */
+static void RenderXSlice( void *p_data, unsigned i_slice, unsigned i_slices )
 {
+    const x_job_t *p_job = p_data;
+    picture_t *p_outpic = p_job->p_outpic;
+    picture_t *p_pic = p_job->p_pic;
     int i_plane;
 #if defined (CAN_COMPILE_MMXEXT)
     const bool mmxext = vlc_CPU_MMXEXT();
@@ -556,9 +565,10 @@ void RenderX( picture_t *p_outpic, picture_t *p_pic )
         const int i_dst = p_outpic->p[i_plane].i_pitch;
         const int i_src = p_pic->p[i_plane].i_pitch;
 
-        int y, x;
+        int y, x, i_start, i_end;
 
-        for( y = 0; y < i_mby; y++ )
+        SliceRange( 0, i_mby, i_slice, i_slices, &i_start, &i_end );
+        for( y = i_start; y < i_end; y++ )
         {
             uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*y*i_dst];
             uint8_t *src = &p_pic->p[i_plane].p_pixels[8*y*i_src];
@@ -571,9 +581,10 @@ void RenderX( picture_t *p_outpic, picture_t *p_pic )
                 XDeintBand8x8C( dst, i_dst, src, i_src, i_mbx, i_modx );
         }
 
-        /* Last line (C only)*/
-        if( i_mody )
+        /* Last line (C only), with the last band */
+        if( i_mody && i_slice == i_slices - 1 )
         {
+            y = i_mby;
             uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*y*i_dst];
             uint8_t *src = &p_pic->p[i_plane].p_pixels[8*y*i_src];
 
@@ -595,3 +606,16 @@ void RenderX( picture_t *p_outpic, picture_t *p_pic )
         emms();
 #endif
 }
+
+/*****************************************************************************
+ * Public functions
+ *****************************************************************************/
+
+void RenderX( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
+{
+    x_job_t job = { .p_outpic = p_outpic, .p_pic = p_pic };
+
+    VLC_UNUSED(p_filter);
+    vlc_slices_run( RenderXSlice, &job,
+                    p_outpic->p[0].i_visible_lines / SLICES_MIN_LINES );
+}
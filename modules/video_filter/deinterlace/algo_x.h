@@ -25,6 +25,7 @@
 #define VLC_DEINTERLACE_ALGO_X_H 1
 
 /* Forward declarations */
+struct filter_t;
 struct picture_t;
 
 /*****************************************************************************
@@ -35,7 +36,8 @@ struct picture_t;
  * Interpolating deinterlace filter "X".
  *
  * The algorithm works on a 8x8 block basic, it copies the top field
- * and applies a process to recreate the bottom field.
+ * and applies a process to recreate the bottom field. The rows of blocks
+ * are shared between the worker threads of the filter.
  *
  * If a 8x8 block is classified as :
  *   - progressive: it applies a small blend (1,6,1)
@@ -46,10 +48,11 @@ struct picture_t;
  *    * otherwise: it recreates the bottom field by an edge oriented
  *      interpolation.
  *
- * @param[in] p_pic Input frame.
+ * @param p_filter The filter instance.
  * @param[out] p_outpic Output frame. Must be allocated by caller.
+ * @param[in] p_pic Input frame.
  * @see Deinterlace()
  */
-void RenderX( picture_t *p_outpic, picture_t *p_pic );
+void RenderX( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic );
 
 #endif
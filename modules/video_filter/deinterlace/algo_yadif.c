@@ -33,9 +33,10 @@
 #include <vlc_cpu.h>
 #include <vlc_picture.h>
 #include <vlc_filter.h>
+#include <vlc_slices.h>
 
 #include "deinterlace.h" /* filter_sys_t  */
-#include "common.h"      /* FFMIN3 et al. */
+#include "common.h"      /* FFMIN3 et al., SliceRange() */
 
 #include "algo_yadif.h"
 
@@ -47,6 +48,72 @@
    Necessary preprocessor macros are defined in common.h. */
 #include "yadif.h"
 
+typedef struct
+{
+    void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
+                   int w, int prefs, int mrefs, int parity, int mode);
+    picture_t *p_dst;
+    picture_t *p_prev, *p_cur, *p_next;
+    int i_field;
+    int yadif_parity;
+} yadif_job_t;
+
+/* Renders the band i_slice of the lines of each plane */
+static void RenderYadifSlice( void *p_data, unsigned i_slice,
+                              unsigned i_slices )
+{
+    const yadif_job_t *p_job = p_data;
+    const int i_field = p_job->i_field;
+    const int yadif_parity = p_job->yadif_parity;
+
+    for( int n = 0; n < p_job->p_dst->i_planes; n++ )
+    {
+        const plane_t *prevp = &p_job->p_prev->p[n];
+        const plane_t *curp  = &p_job->p_cur->p[n];
+        const plane_t *nextp = &p_job->p_next->p[n];
+        plane_t *dstp        = &p_job->p_dst->p[n];
+        int i_start, i_end;
+
+        SliceRange( 1, dstp->i_visible_lines - 1, i_slice, i_slices,
+                    &i_start, &i_end );
+        for( int y = i_start; y < i_end; y++ )
+        {
+            if( (y % 2) == i_field  ||  yadif_parity == 2 )
+            {
+                memcpy( &dstp->p_pixels[y * dstp->i_pitch],
+                            &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
+            }
+            else
+            {
+                int mode;
+                /* Spatial checks only when enough data */
+                mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
+
+                assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
+                p_job->filter( &dstp->p_pixels[y * dstp->i_pitch],
+                               &prevp->p_pixels[y * prevp->i_pitch],
+                               &curp->p_pixels[y * curp->i_pitch],
+                               &nextp->p_pixels[y * nextp->i_pitch],
+                               dstp->i_visible_pitch,
+                               y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
+                               y  - 1  ?  -curp->i_pitch : curp->i_pitch,
+                               yadif_parity,
+                               mode );
+            }
+
+            /* We duplicate the first and last lines */
+            if( y == 1 )
+                memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+            else if( y == dstp->i_visible_lines - 2 )
+                memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
+                           &dstp->p_pixels[ y    * dstp->i_pitch],
+                           dstp->i_pitch);
+        }
+    }
+}
+
 int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  int i_order, int i_field )
 {
@@ -105,72 +172,44 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
     if( p_prev && p_cur && p_next )
     {
         /* */
-        void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
-                       int w, int prefs, int mrefs, int parity, int mode);
-
+        yadif_job_t job = {
+            .p_dst = p_dst,
+            .p_prev = p_prev, .p_cur = p_cur, .p_next = p_next,
+            .i_field = i_field,
+            .yadif_parity = yadif_parity,
+        };
+
+#if defined(HAVE_YADIF_AVX2)
+        if( vlc_CPU_AVX2() )
+            job.filter = yadif_filter_line_avx2;
+        else
+#endif
 #if defined(HAVE_YADIF_SSSE3)
         if( vlc_CPU_SSSE3() )
-            filter = yadif_filter_line_ssse3;
+            job.filter = yadif_filter_line_ssse3;
         else
 #endif
 #if defined(HAVE_YADIF_SSE2)
         if( vlc_CPU_SSE2() )
-            filter = yadif_filter_line_sse2;
+            job.filter = yadif_filter_line_sse2;
         else
 #endif
 #if defined(HAVE_YADIF_MMX)
         if( vlc_CPU_MMX() )
-            filter = yadif_filter_line_mmx;
+            job.filter = yadif_filter_line_mmx;
         else
 #endif
-            filter = yadif_filter_line_c;
+#if defined(HAVE_YADIF_NEON)
+            job.filter = yadif_filter_line_neon;
+#else
+            job.filter = yadif_filter_line_c;
+#endif
 
         if( p_sys->chroma->pixel_size == 2 )
-            filter = yadif_filter_line_c_16bit;
-
-        for( int n = 0; n < p_dst->i_planes; n++ )
-        {
-            const plane_t *prevp = &p_prev->p[n];
-            const plane_t *curp  = &p_cur->p[n];
-            const plane_t *nextp = &p_next->p[n];
-            plane_t *dstp        = &p_dst->p[n];
+            job.filter = yadif_filter_line_c_16bit;
 
-            for( int y = 1; y < dstp->i_visible_lines - 1; y++ )
-            {
-                if( (y % 2) == i_field  ||  yadif_parity == 2 )
-                {
-                    memcpy( &dstp->p_pixels[y * dstp->i_pitch],
-                                &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
-                }
-                else
-                {
-                    int mode;
-                    /* Spatial checks only when enough data */
-                    mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
-
-                    assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
-                    filter( &dstp->p_pixels[y * dstp->i_pitch],
-                            &prevp->p_pixels[y * prevp->i_pitch],
-                            &curp->p_pixels[y * curp->i_pitch],
-                            &nextp->p_pixels[y * nextp->i_pitch],
-                            dstp->i_visible_pitch,
-                            y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
-                            y  - 1  ?  -curp->i_pitch : curp->i_pitch,
-                            yadif_parity,
-                            mode );
-                }
-
-                /* We duplicate the first and last lines */
-                if( y == 1 )
-                    memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-                else if( y == dstp->i_visible_lines - 2 )
-                    memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-            }
-        }
+        vlc_slices_run( RenderYadifSlice, &job,
+                        p_dst->p[0].i_visible_lines / SLICES_MIN_LINES );
 
         p_sys->i_frame_offset = 1; /* p_cur will be rendered at next frame, too */
 
@@ -182,7 +221,7 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  as set by Open() or SetFilterMethod(). It is always 0. */
 
         /* FIXME not good as it does not use i_order/i_field */
-        RenderX( p_dst, p_next );
+        RenderX( p_filter, p_dst, p_next );
         return VLC_SUCCESS;
     }
     else
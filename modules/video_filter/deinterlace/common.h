@@ -35,4 +35,22 @@
 #define FFMIN(a,b)      __MIN(a,b)
 #define FFMIN3(a,b,c)   FFMIN(FFMIN(a,b),c)
 
+/** Minimum number of lines of the first plane in a band, for the
+ * algorithms run on the worker threads (X, Yadif) */
+#define SLICES_MIN_LINES (128)
+
+/**
+ * Computes the range [*pi_start, *pi_end[ of the band i_slice out of
+ * i_slices of [i_first, i_last[.
+ */
+static inline void SliceRange( int i_first, int i_last,
+                               unsigned i_slice, unsigned i_slices,
+                               int *pi_start, int *pi_end )
+{
+    const int i_count = i_last - i_first;
+
+    *pi_start = i_first + (int64_t)i_count * i_slice / i_slices;
+    *pi_end   = i_first + (int64_t)i_count * (i_slice + 1) / i_slices;
+}
+
 #endif
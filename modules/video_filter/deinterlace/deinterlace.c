@@ -41,6 +41,7 @@
 #include <vlc_filter.h>
 #include <vlc_cpu.h>
 #include <vlc_mouse.h>
+#include <vlc_slices.h>
 
 #include "deinterlace.h"
 #include "helpers.h"
@@ -469,7 +470,7 @@ picture_t *Deinterlace( filter_t *p_filter, picture_t *p_pic )
             break;
 
         case DEINTERLACE_X:
-            RenderX( p_dst[0], p_pic );
+            RenderX( p_filter, p_dst[0], p_pic );
             break;
 
         case DEINTERLACE_YADIF:
@@ -650,6 +651,12 @@ notsupp:
     SetFilterMethod( p_filter, psz_mode, packed );
     free( psz_mode );
 
+    p_sys->b_slices = p_sys->i_mode == DEINTERLACE_X ||
+                      p_sys->i_mode == DEINTERLACE_YADIF ||
+                      p_sys->i_mode == DEINTERLACE_YADIF2X;
+    if( p_sys->b_slices )
+        vlc_slices_hold();
+
     for( int i = 0; i < METADATA_SIZE; i++ )
     {
         p_sys->meta.pi_date[i] = VLC_TS_INVALID;
@@ -774,5 +781,7 @@ void Close( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t*)p_this;
 
     Flush( p_filter );
+    if( p_filter->p_sys->b_slices )
+        vlc_slices_release();
     free( p_filter->p_sys );
 }
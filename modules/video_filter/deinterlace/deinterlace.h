@@ -118,6 +118,10 @@ struct filter_sys_t
     /** Input frame history buffer for algorithms with temporal filtering. */
     picture_t *pp_history[HISTORY_SIZE];
 
+    /** Holds the worker threads, for the algorithms working on bands
+        (X, Yadif). */
+    bool b_slices;
+
     /* Algorithm-specific substructures */
     phosphor_sys_t phosphor; /**< Phosphor algorithm state. */
     ivtc_sys_t ivtc;         /**< IVTC algorithm state. */
@@ -145,3 +145,27 @@ static void yadif_filter_line_c_16bit(uint16_t *dst, uint16_t *prev, uint16_t *c
     prefs /= 2;
     FILTER
 }
+
+#if VLC_GCC_VERSION(9, 0) || defined(__clang__)
+#if defined(__x86_64__) || defined(__i386__)
+// ================ AVX2 =================
+#define HAVE_YADIF_AVX2
+#define YADIF_VECTOR 32
+#define VLC_TARGET __attribute__ ((__target__ ("avx2")))
+#define RENAME(a) a ## _avx2
+#include "yadif_simd.h"
+#undef YADIF_VECTOR
+#undef VLC_TARGET
+#undef RENAME
+#elif defined(__aarch64__) || defined(__ARM_NEON__)
+// ================ NEON =================
+#define HAVE_YADIF_NEON
+#define YADIF_VECTOR 16
+#define VLC_TARGET
+#define RENAME(a) a ## _neon
+#include "yadif_simd.h"
+#undef YADIF_VECTOR
+#undef VLC_TARGET
+#undef RENAME
+#endif
+#endif
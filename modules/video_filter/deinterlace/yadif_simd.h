@@ -0,0 +1,180 @@
+/*****************************************************************************
+ * yadif_simd.h: vector line filter of Yadif
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *****************************************************************************/
+
+/* This file is included by yadif.h once per instruction set. The caller
+ * defines:
+ *  - YADIF_VECTOR: the size in bytes of the vector registers,
+ *  - RENAME(name): the name of each function of this instance,
+ *  - VLC_TARGET: the function attributes (instruction set) if any.
+ *
+ * It computes the same as the FILTER macro of yadif.h, so that the results
+ * are identical to those of yadif_filter_line_c(). Each iteration handles
+ * YADIF_VECTOR pixels, loaded as 16-bit lanes: the even pixels are in the
+ * low bytes and the odd ones in the high bytes, which avoids widening and
+ * narrowing the pixels. */
+
+#define YADIF_N (YADIF_VECTOR / 2) /* 16-bit lanes */
+
+typedef uint16_t RENAME(u16v) __attribute__ ((vector_size (YADIF_VECTOR)));
+typedef int16_t  RENAME(i16v) __attribute__ ((vector_size (YADIF_VECTOR)));
+#define u16v RENAME(u16v)
+#define i16v RENAME(i16v)
+
+/* The even (odd = false) or odd pixels from p */
+static inline VLC_TARGET
+i16v RENAME(Load)(const uint8_t *p, bool odd)
+{
+    u16v v;
+    memcpy(&v, p, sizeof(v));
+#ifdef WORDS_BIGENDIAN
+    odd = !odd;
+#endif
+    return (i16v)(odd ? v >> 8 : v & 0xff);
+}
+
+static inline VLC_TARGET
+void RENAME(Store)(uint8_t *p, i16v even, i16v odd)
+{
+#ifdef WORDS_BIGENDIAN
+    const u16v v = (u16v)odd | ((u16v)even << 8);
+#else
+    const u16v v = (u16v)even | ((u16v)odd << 8);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+/* Comparisons give all bits set in the lanes where they are true */
+static inline VLC_TARGET
+i16v RENAME(Select)(i16v mask, i16v a, i16v b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+static inline VLC_TARGET
+i16v RENAME(Abs)(i16v v)
+{
+    const i16v sign = v >> 15;
+    return (v ^ sign) - sign;
+}
+
+static inline VLC_TARGET
+i16v RENAME(Max)(i16v a, i16v b)
+{
+    return RENAME(Select)(a > b, a, b);
+}
+
+static inline VLC_TARGET
+i16v RENAME(Min)(i16v a, i16v b)
+{
+    return RENAME(Select)(a < b, a, b);
+}
+
+#define LOAD(p) RENAME(Load)(p, odd)
+#define ABS(v) RENAME(Abs)(v)
+#define SCORE(j) \
+    (ABS(LOAD(&cur[mrefs - 1 + (j)]) - LOAD(&cur[prefs - 1 - (j)])) + \
+     ABS(LOAD(&cur[mrefs     + (j)]) - LOAD(&cur[prefs     - (j)])) + \
+     ABS(LOAD(&cur[mrefs + 1 + (j)]) - LOAD(&cur[prefs + 1 - (j)])))
+#define PRED(j) \
+    ((LOAD(&cur[mrefs + (j)]) + LOAD(&cur[prefs - (j)])) >> 1)
+
+/* The even or odd pixels of YADIF_VECTOR pixels */
+static inline VLC_TARGET
+i16v RENAME(Filter)(const uint8_t *prev, const uint8_t *cur,
+                    const uint8_t *next, const uint8_t *prev2,
+                    const uint8_t *next2, int prefs, int mrefs, int mode,
+                    bool odd)
+{
+    const i16v c = LOAD(&cur[mrefs]);
+    const i16v d = (LOAD(prev2) + LOAD(next2)) >> 1;
+    const i16v e = LOAD(&cur[prefs]);
+    const i16v temporal_diff0 = ABS(LOAD(prev2) - LOAD(next2));
+    const i16v temporal_diff1 = (ABS(LOAD(&prev[mrefs]) - c) +
+                                 ABS(LOAD(&prev[prefs]) - e)) >> 1;
+    const i16v temporal_diff2 = (ABS(LOAD(&next[mrefs]) - c) +
+                                 ABS(LOAD(&next[prefs]) - e)) >> 1;
+    i16v diff = RENAME(Max)(RENAME(Max)(temporal_diff0 >> 1, temporal_diff1),
+                            temporal_diff2);
+    i16v spatial_pred = (c + e) >> 1;
+    i16v spatial_score = ABS(LOAD(&cur[mrefs - 1]) - LOAD(&cur[prefs - 1])) +
+                         ABS(c - e) +
+                         ABS(LOAD(&cur[mrefs + 1]) - LOAD(&cur[prefs + 1])) - 1;
+
+    /* The second check of each direction only applies where the first one
+     * improved the score */
+    for (int j = -1; j <= 1; j += 2) {
+        i16v score = SCORE(j);
+        i16v mask = score < spatial_score;
+        spatial_score = RENAME(Select)(mask, score, spatial_score);
+        spatial_pred = RENAME(Select)(mask, PRED(j), spatial_pred);
+
+        score = SCORE(2 * j);
+        mask &= score < spatial_score;
+        spatial_score = RENAME(Select)(mask, score, spatial_score);
+        spatial_pred = RENAME(Select)(mask, PRED(2 * j), spatial_pred);
+    }
+
+    if (mode < 2) {
+        const i16v b = (LOAD(&prev2[2 * mrefs]) + LOAD(&next2[2 * mrefs])) >> 1;
+        const i16v f = (LOAD(&prev2[2 * prefs]) + LOAD(&next2[2 * prefs])) >> 1;
+        const i16v max = RENAME(Max)(RENAME(Max)(d - e, d - c),
+                                     RENAME(Min)(b - c, f - e));
+        const i16v min = RENAME(Min)(RENAME(Min)(d - e, d - c),
+                                     RENAME(Max)(b - c, f - e));
+
+        diff = RENAME(Max)(RENAME(Max)(diff, min), -max);
+    }
+
+    return RENAME(Select)(spatial_pred > d + diff, d + diff,
+           RENAME(Select)(spatial_pred < d - diff, d - diff, spatial_pred));
+}
+
+VLC_TARGET
+static void RENAME(yadif_filter_line)(uint8_t *dst, uint8_t *prev,
+                                      uint8_t *cur, uint8_t *next, int w,
+                                      int prefs, int mrefs, int parity,
+                                      int mode)
+{
+    uint8_t *prev2 = parity ? prev : cur ;
+    uint8_t *next2 = parity ? cur  : next;
+    int x;
+
+    for (x = 0; x + YADIF_VECTOR <= w; x += YADIF_VECTOR) {
+        const i16v even = RENAME(Filter)(&prev[x], &cur[x], &next[x],
+                                         &prev2[x], &next2[x],
+                                         prefs, mrefs, mode, false);
+        const i16v odd = RENAME(Filter)(&prev[x], &cur[x], &next[x],
+                                        &prev2[x], &next2[x],
+                                        prefs, mrefs, mode, true);
+        RENAME(Store)(&dst[x], even, odd);
+    }
+
+    if (x < w)
+        yadif_filter_line_c(&dst[x], &prev[x], &cur[x], &next[x], w - x,
+                            prefs, mrefs, parity, mode);
+}
+
+#undef PRED
+#undef SCORE
+#undef ABS
+#undef LOAD
+#undef i16v
+#undef u16v
+#undef YADIF_N
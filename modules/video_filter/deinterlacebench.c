@@ -0,0 +1,340 @@
+/*****************************************************************************
+ * deinterlacebench.c : deinterlacing benchmark plugin for vlc
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_modules.h>
+
+#include <vlc_filter.h>
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+static int Create( vlc_object_t * );
+static void Destroy( vlc_object_t * );
+
+static picture_t *Filter( filter_t *, picture_t * );
+
+/*****************************************************************************
+ * Module descriptor
+ *****************************************************************************/
+
+#define LOOPS_TEXT N_("Number of frames")
+#define LOOPS_LONGTEXT N_("The number of frames deinterlaced with each mode")
+
+#define MODE_TEXT N_("Deinterlace mode")
+#define MODE_LONGTEXT N_("Deinterlace mode to benchmark. All the modes of " \
+                         "the deinterlace filter are benchmarked if empty.")
+
+#define CHROMA_TEXT N_("Chroma of the frames")
+#define CHROMA_LONGTEXT N_("Chroma in which the frames are generated")
+
+#define WIDTH_TEXT N_("Width of the frames")
+#define WIDTH_LONGTEXT N_("Width of the generated frames. The generated " \
+                          "frames are always the same, so that results can " \
+                          "be compared between runs.")
+
+#define HEIGHT_TEXT N_("Height of the frames")
+#define HEIGHT_LONGTEXT N_("Height of the generated frames")
+
+#define CFG_PREFIX "deinterlacebench-"
+
+vlc_module_begin ()
+    set_description( N_("Deinterlacing benchmark filter") )
+    set_shortname( N_("Deinterlacebench" ))
+    set_category( CAT_VIDEO )
+    set_subcategory( SUBCAT_VIDEO_VFILTER )
+    set_capability( "video filter2", 0 )
+
+    set_section( N_("Benchmarking"), NULL )
+    add_integer( CFG_PREFIX "loops", 200, LOOPS_TEXT,
+              LOOPS_LONGTEXT, false )
+    add_string( CFG_PREFIX "mode", "", MODE_TEXT,
+              MODE_LONGTEXT, false )
+
+    set_section( N_("Frames"), NULL )
+    add_string( CFG_PREFIX "chroma", "I420", CHROMA_TEXT,
+              CHROMA_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "width", 1920, 16, 8192, WIDTH_TEXT,
+              WIDTH_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "height", 1080, 16, 8192, HEIGHT_TEXT,
+              HEIGHT_LONGTEXT, false )
+
+    set_callbacks( Create, Destroy )
+vlc_module_end ()
+
+static const char *const ppsz_filter_options[] = {
+    "loops", "mode", "chroma", "width", "height", NULL
+};
+
+/* The modes of the deinterlace filter */
+static const char *const ppsz_modes[] = {
+    "discard", "blend", "mean", "bob", "linear", "x",
+    "yadif", "yadif2x", "phosphor", "ivtc", NULL
+};
+
+/* Number of different generated frames, more than the deinterlace filter
+ * keeps in its history */
+#define FRAMES 8
+
+/*****************************************************************************
+ * filter_sys_t: filter method descriptor
+ *****************************************************************************/
+struct filter_sys_t
+{
+    bool b_done;
+    int i_loops;
+    char *psz_mode;
+
+    picture_t *pp_frames[FRAMES];
+};
+
+/* Fills the planes with a fixed pattern, whose fields move differently from
+ * one frame to the next, so that there is combing to remove */
+static picture_t *deinterlacebench_GenerateFrame( vlc_fourcc_t i_chroma,
+                                                  unsigned i_width,
+                                                  unsigned i_height,
+                                                  int i_frame )
+{
+    picture_t *p_pic = picture_New( i_chroma, i_width, i_height, 1, 1 );
+    if( p_pic == NULL )
+        return NULL;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        plane_t *p = &p_pic->p[i];
+
+        for( int y = 0; y < p->i_lines; y++ )
+            for( int x = 0; x < p->i_pitch; x++ )
+                p->p_pixels[y * p->i_pitch + x] =
+                    x * 7 + y * 13 + i * 61 + i_frame * ( y & 1 ? 23 : 5 );
+    }
+    p_pic->b_progressive = false;
+    p_pic->b_top_field_first = true;
+    p_pic->i_nb_fields = 2;
+    return p_pic;
+}
+
+/*****************************************************************************
+ * Create: allocates video thread output method
+ *****************************************************************************/
+static int Create( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys;
+    char *psz_temp;
+    unsigned i_width, i_height;
+    vlc_fourcc_t i_chroma;
+
+    /* Allocate structure */
+    p_filter->p_sys = malloc( sizeof( filter_sys_t ) );
+    if( p_filter->p_sys == NULL )
+        return VLC_ENOMEM;
+
+    p_sys = p_filter->p_sys;
+    p_sys->b_done = false;
+
+    p_filter->pf_video_filter = Filter;
+
+    /* options given as deinterlacebench{loops=...,mode=...} */
+    config_ChainParse( p_filter, CFG_PREFIX, ppsz_filter_options,
+                       p_filter->p_cfg );
+
+    p_sys->i_loops = var_CreateGetIntegerCommand( p_filter,
+                                                  CFG_PREFIX "loops" );
+    p_sys->psz_mode = var_CreateGetStringCommand( p_filter,
+                                                  CFG_PREFIX "mode" );
+    i_width = var_CreateGetIntegerCommand( p_filter, CFG_PREFIX "width" );
+    i_height = var_CreateGetIntegerCommand( p_filter, CFG_PREFIX "height" );
+
+    psz_temp = var_CreateGetStringCommand( p_filter, CFG_PREFIX "chroma" );
+    i_chroma = vlc_fourcc_GetCodecFromString( VIDEO_ES, psz_temp );
+    free( psz_temp );
+
+    for( int i = 0; i < FRAMES; i++ )
+    {
+        p_sys->pp_frames[i] = deinterlacebench_GenerateFrame( i_chroma,
+                                                              i_width,
+                                                              i_height, i );
+        if( p_sys->pp_frames[i] == NULL )
+        {
+            msg_Err( p_filter, "Unable to generate %4.4s frames",
+                     (const char *)&i_chroma );
+            while( i-- > 0 )
+                picture_Release( p_sys->pp_frames[i] );
+            free( p_sys->psz_mode );
+            free( p_sys );
+            return VLC_EGENERIC;
+        }
+    }
+    msg_Dbg( p_filter, "frames generated with dim %u x %u", i_width,
+             i_height );
+
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Destroy: destroy video thread output method
+ *****************************************************************************/
+static void Destroy( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    for( int i = 0; i < FRAMES; i++ )
+        picture_Release( p_sys->pp_frames[i] );
+    free( p_sys->psz_mode );
+    free( p_sys );
+}
+
+static picture_t *deinterlacebench_NewPicture( filter_t *p_deinterlace )
+{
+    return picture_NewFromFormat( &p_deinterlace->fmt_out.video );
+}
+
+/* Adler-32 of the visible lines, to check that the result does not change */
+static void deinterlacebench_Checksum( const picture_t *p_pic,
+                                       uint32_t *pi_a, uint32_t *pi_b )
+{
+    uint32_t a = *pi_a, b = *pi_b;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        const plane_t *p = &p_pic->p[i];
+
+        for( int y = 0; y < p->i_visible_lines; y++ )
+            for( int x = 0; x < p->i_visible_pitch; x++ )
+            {
+                a = (a + p->p_pixels[y * p->i_pitch + x]) % 65521;
+                b = (b + a) % 65521;
+            }
+    }
+    *pi_a = a;
+    *pi_b = b;
+}
+
+/* Runs the deinterlace filter with the given mode on the generated frames */
+static void deinterlacebench_Run( filter_t *p_filter, const char *psz_mode )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const video_format_t *p_fmt = &p_sys->pp_frames[0]->format;
+    filter_t *p_deinterlace;
+
+    p_deinterlace = vlc_object_create( p_filter, sizeof(filter_t) );
+    if( !p_deinterlace )
+        return;
+
+    config_chain_t cfg = {
+        .p_next = NULL,
+        .psz_name = (char *)"mode",
+        .psz_value = (char *)psz_mode,
+    };
+
+    es_format_Init( &p_deinterlace->fmt_in, VIDEO_ES, p_fmt->i_chroma );
+    p_deinterlace->fmt_in.video = *p_fmt;
+    p_deinterlace->fmt_in.video.i_frame_rate = 25;
+    p_deinterlace->fmt_in.video.i_frame_rate_base = 1;
+    es_format_Copy( &p_deinterlace->fmt_out, &p_deinterlace->fmt_in );
+    /* Phosphor changes the chroma of 4:2:0 pictures */
+    p_deinterlace->b_allow_fmt_out_change = true;
+    p_deinterlace->p_cfg = &cfg;
+    p_deinterlace->owner.video.buffer_new = deinterlacebench_NewPicture;
+
+    p_deinterlace->p_module = module_need( p_deinterlace, "video filter2",
+                                           "deinterlace", true );
+    if( !p_deinterlace->p_module )
+    {
+        msg_Err( p_filter, "Unable to deinterlace with mode %s", psz_mode );
+        vlc_object_release( p_deinterlace );
+        return;
+    }
+
+    uint32_t a = 1, b = 0;
+    int i_out = 0;
+    mtime_t time = 0;
+    for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
+    {
+        picture_t *p_pic = picture_Hold( p_sys->pp_frames[i_iter % FRAMES] );
+        p_pic->date = VLC_TS_0 + i_iter * CLOCK_FREQ / 25;
+
+        mtime_t start = mdate();
+        picture_t *p_out = p_deinterlace->pf_video_filter( p_deinterlace,
+                                                           p_pic );
+        time += mdate() - start;
+
+        while( p_out != NULL )
+        {
+            picture_t *p_next = p_out->p_next;
+
+            deinterlacebench_Checksum( p_out, &a, &b );
+            picture_Release( p_out );
+            p_out = p_next;
+            i_out++;
+        }
+    }
+    if( time <= 0 )
+        time = 1;
+
+    msg_Info( p_filter, "Mode %s: deinterlaced %d frames into %d in %f sec",
+              psz_mode, p_sys->i_loops, i_out, time / 1000000.0f );
+    msg_Info( p_filter, "Mode %s: %f frames/second, %f output pixels/second",
+              psz_mode, (float) p_sys->i_loops / time * 1000000,
+              (float) i_out / time * 1000000 *
+              p_deinterlace->fmt_out.video.i_visible_width *
+              p_deinterlace->fmt_out.video.i_visible_height );
+    msg_Info( p_filter, "Mode %s: result checksum: %08"PRIx32,
+              psz_mode, (b << 16) | a );
+
+    module_unneed( p_deinterlace, p_deinterlace->p_module );
+    es_format_Clean( &p_deinterlace->fmt_out );
+    es_format_Clean( &p_deinterlace->fmt_in );
+    vlc_object_release( p_deinterlace );
+}
+
+/*****************************************************************************
+ * Filter: runs the benchmark once, on the first picture, which is passed
+ * through unchanged
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->b_done )
+        return p_pic;
+
+    if( EMPTY_STR( p_sys->psz_mode ) )
+    {
+        for( int i = 0; ppsz_modes[i] != NULL; i++ )
+            deinterlacebench_Run( p_filter, ppsz_modes[i] );
+    }
+    else
+        deinterlacebench_Run( p_filter, p_sys->psz_mode );
+
+    p_sys->b_done = true;
+    return p_pic;
+}
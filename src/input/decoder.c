@@ -750,8 +750,11 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     p_owner->b_packetizer = b_packetizer;
     es_format_Init( &p_owner->fmt, UNKNOWN_ES, 0 );
 
-    /* decoder fifo */
-    p_owner->p_fifo = block_FifoNew();
+    /* decoder fifo: the input thread is the only writer */
+    if( var_InheritBool( p_dec, "decoder-fifo-lockless" ) )
+        p_owner->p_fifo = block_FifoNewSPSC( 1024 );
+    else
+        p_owner->p_fifo = block_FifoNew();
     if( unlikely(p_owner->p_fifo == NULL) )
     {
         free( p_owner );
@@ -832,6 +832,8 @@ static void InitStatistics( input_thread_t * p_input )
         INIT_COUNTER( demux_bitrate, DERIVATIVE );
         INIT_COUNTER( demux_corrupted, COUNTER );
         INIT_COUNTER( demux_discontinuity, COUNTER );
+        INIT_COUNTER( prefetch_level, COUNTER );
+        INIT_COUNTER( prefetch_underruns, COUNTER );
         INIT_COUNTER( played_abuffers, COUNTER );
         INIT_COUNTER( lost_abuffers, COUNTER );
         INIT_COUNTER( displayed_pictures, COUNTER );
@@ -1305,6 +1307,8 @@ error:
         EXIT_COUNTER( demux_bitrate );
         EXIT_COUNTER( demux_corrupted );
         EXIT_COUNTER( demux_discontinuity );
+        EXIT_COUNTER( prefetch_level );
+        EXIT_COUNTER( prefetch_underruns );
         EXIT_COUNTER( played_abuffers );
         EXIT_COUNTER( lost_abuffers );
         EXIT_COUNTER( displayed_pictures );
@@ -1376,6 +1380,8 @@ static void End( input_thread_t * p_input )
             CL_CO( demux_bitrate );
             CL_CO( demux_corrupted );
             CL_CO( demux_discontinuity );
+            CL_CO( prefetch_level );
+            CL_CO( prefetch_underruns );
             CL_CO( played_abuffers );
             CL_CO( lost_abuffers );
             CL_CO( displayed_pictures );
@@ -94,6 +94,8 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->f_demux_bitrate = stats_GetRate(input->p->counters.p_demux_bitrate);
     st->i_demux_corrupted = stats_GetTotal(input->p->counters.p_demux_corrupted);
     st->i_demux_discontinuity = stats_GetTotal(input->p->counters.p_demux_discontinuity);
+    st->i_prefetch_level = stats_GetTotal(input->p->counters.p_prefetch_level);
+    st->i_prefetch_underruns = stats_GetTotal(input->p->counters.p_prefetch_underruns);
 
     /* Decoders */
     st->i_decoded_video = stats_GetTotal(input->p->counters.p_decoded_video);
@@ -127,6 +129,7 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     p_stats->i_demux_read_packets = p_stats->i_demux_read_bytes =
     p_stats->f_demux_bitrate = p_stats->f_average_demux_bitrate =
     p_stats->i_demux_corrupted = p_stats->i_demux_discontinuity =
+    p_stats->i_prefetch_level = p_stats->i_prefetch_underruns =
     p_stats->i_displayed_pictures = p_stats->i_lost_pictures =
     p_stats->i_played_abuffers = p_stats->i_lost_abuffers =
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
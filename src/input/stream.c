@@ -31,6 +31,7 @@
 #include <vlc_common.h>
 #include <vlc_strings.h>
 #include <vlc_memory.h>
+#include <vlc_fs.h>
 
 #include <libvlc.h>
 
@@ -74,6 +75,10 @@
  * efficient demux probing */
 #define STREAM_CACHE_PREBUFFER_SIZE (128)
 
+/* Time between the prefetch thread read retries when the access gave no
+ * data, without reaching the end of the stream */
+#define STREAM_DATA_WAIT (40000)
+
 /* Method1: Simple, for pf_block.
  *  We get blocks and put them in the linked list.
  *  We release blocks once the total size is bigger than CACHE_BLOCK_SIZE
@@ -157,6 +162,39 @@ struct stream_sys_t
 
     } stream;
 
+    /* Segment cache, for the stream method */
+    struct
+    {
+        stream_cache_t *p_cache;
+        uint64_t i_pos;      /* position of the next read */
+        uint64_t i_access;   /* position of the access */
+    } cache;
+
+    /* Prefetching: a thread reads the access ahead of either method */
+    struct
+    {
+        bool         b_enabled;
+        vlc_thread_t thread;
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait_data;   /* data or EOF queued */
+        vlc_cond_t   wait_space;  /* fill level below i_low, or stop */
+        vlc_mutex_t  access_lock; /* serializes access calls with the thread */
+
+        block_t     *p_first;     /* queued data, starting at i_pos */
+        block_t    **pp_last;
+        uint64_t     i_pos;
+        size_t       i_size;      /* bytes queued */
+        size_t       i_high;      /* stop reading above this fill level */
+        size_t       i_low;       /* resume reading below this fill level */
+        size_t       i_read_size; /* read size for pf_read accesses */
+        int64_t      i_reported;  /* fill level reported in the stats */
+
+        bool         b_full;
+        bool         b_eof;
+        bool         b_stop;
+        bool         b_underrun;
+    } prefetch;
+
     /* Peek temporary buffer */
     unsigned int i_peek;
     uint8_t *p_peek;
@@ -201,11 +239,17 @@ static int  AReadStream( stream_t *s, void *p_read, unsigned int i_read );
 /* ReadDir */
 static int  AStreamReadDir( stream_t *s, input_item_node_t *p_node );
 
+/* Prefetching */
+static int  PrefetchStart( stream_t *s );
+static void PrefetchStop( stream_t *s );
+
 /* Common */
 static int  AStreamGenericError( ) { return VLC_EGENERIC; }
 static int AStreamControl( stream_t *s, int i_query, va_list );
 static void AStreamDestroy( stream_t *s );
 static int  ASeek( stream_t *s, uint64_t i_pos );
+static int  AControl( stream_t *s, int i_query, ... );
+static int  AvaControl( stream_t *s, int i_query, va_list );
 
 /****************************************************************************
  * stream_CommonNew: create an empty stream structure
@@ -307,6 +351,8 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         p_sys->method = STREAM_METHOD_READDIR;
 
     p_sys->i_pos = p_access->info.i_pos;
+    p_sys->prefetch.b_enabled = false;
+    p_sys->cache.p_cache = NULL;
 
     /* Stats */
     access_Control( p_access, ACCESS_CAN_FASTSEEK, &p_sys->stat.b_fastseek );
@@ -371,6 +417,41 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
     p_sys->i_peek = 0;
     p_sys->p_peek = NULL;
 
+    /* Prefetch */
+    if( p_sys->method != STREAM_METHOD_READDIR &&
+        var_InheritBool( s, "stream-prefetch" ) )
+    {
+        vlc_mutex_init( &p_sys->prefetch.lock );
+        vlc_cond_init( &p_sys->prefetch.wait_data );
+        vlc_cond_init( &p_sys->prefetch.wait_space );
+        vlc_mutex_init( &p_sys->prefetch.access_lock );
+        p_sys->prefetch.p_first = NULL;
+        p_sys->prefetch.pp_last = &p_sys->prefetch.p_first;
+        p_sys->prefetch.i_pos = p_sys->i_pos;
+        p_sys->prefetch.i_size = 0;
+        p_sys->prefetch.i_high =
+            var_InheritInteger( s, "stream-prefetch-buffer-size" ) << 10;
+        p_sys->prefetch.i_low = p_sys->prefetch.i_high *
+            var_InheritInteger( s, "stream-prefetch-resume" ) / 100;
+        p_sys->prefetch.i_read_size =
+            var_InheritInteger( s, "stream-prefetch-read-size" ) << 10;
+        p_sys->prefetch.i_reported = 0;
+
+        if( PrefetchStart( s ) == VLC_SUCCESS )
+        {
+            p_sys->prefetch.b_enabled = true;
+            msg_Dbg( s, "prefetching up to %zu bytes, resuming below %zu",
+                     p_sys->prefetch.i_high, p_sys->prefetch.i_low );
+        }
+        else
+        {
+            vlc_mutex_destroy( &p_sys->prefetch.lock );
+            vlc_cond_destroy( &p_sys->prefetch.wait_data );
+            vlc_cond_destroy( &p_sys->prefetch.wait_space );
+            vlc_mutex_destroy( &p_sys->prefetch.access_lock );
+        }
+    }
+
     if( p_sys->method == STREAM_METHOD_BLOCK )
     {
         msg_Dbg( s, "Using block method for AStream*" );
@@ -400,6 +481,34 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
 
         msg_Dbg( s, "Using stream method for AStream*" );
 
+        /* Seeking back is costly without fast seek, keep what was read */
+        bool b_seek;
+        size_t i_cache = var_InheritInteger( s, "stream-cache-size" ) << 10;
+        AControl( s, ACCESS_CAN_SEEK, &b_seek );
+        if( b_seek && !p_sys->stat.b_fastseek && i_cache > 0 )
+        {
+            size_t i_segment =
+                var_InheritInteger( s, "stream-cache-segment-size" ) << 10;
+            uint64_t i_disk = (uint64_t)
+                var_InheritInteger( s, "stream-cache-disk-size" ) << 20;
+            char *psz_dir = NULL;
+
+            if( i_disk > 0 )
+            {
+                psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+                if( psz_dir != NULL )
+                    vlc_mkdir( psz_dir, 0700 );
+            }
+            p_sys->cache.p_cache = stream_CacheNew( __MAX(i_cache, i_segment),
+                                                    i_segment, i_disk,
+                                                    psz_dir );
+            free( psz_dir );
+            p_sys->cache.i_pos = p_sys->cache.i_access = p_sys->i_pos;
+            if( p_sys->cache.p_cache != NULL )
+                msg_Dbg( s, "caching up to %zu bytes in memory, %"PRIu64
+                         " bytes on disk", i_cache, i_disk );
+        }
+
         s->pf_read = AStreamReadStream;
         s->pf_peek = AStreamPeekStream;
 
@@ -444,6 +553,14 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
     return s;
 
 error:
+    if( p_sys->prefetch.b_enabled )
+    {
+        PrefetchStop( s );
+        vlc_mutex_destroy( &p_sys->prefetch.lock );
+        vlc_cond_destroy( &p_sys->prefetch.wait_data );
+        vlc_cond_destroy( &p_sys->prefetch.wait_space );
+        vlc_mutex_destroy( &p_sys->prefetch.access_lock );
+    }
     if( p_sys->method == STREAM_METHOD_BLOCK )
     {
         /* Nothing yet */
@@ -451,6 +568,8 @@ error:
     else if( p_sys->method == STREAM_METHOD_STREAM )
     {
         free( p_sys->stream.p_buffer );
+        if( p_sys->cache.p_cache != NULL )
+            stream_CacheDelete( p_sys->cache.p_cache );
     }
     while( p_sys->i_list > 0 )
         free( p_sys->list[--(p_sys->i_list)] );
@@ -468,11 +587,31 @@ static void AStreamDestroy( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
 
+    if( p_sys->prefetch.b_enabled )
+    {
+        PrefetchStop( s );
+        vlc_mutex_destroy( &p_sys->prefetch.lock );
+        vlc_cond_destroy( &p_sys->prefetch.wait_data );
+        vlc_cond_destroy( &p_sys->prefetch.wait_space );
+        vlc_mutex_destroy( &p_sys->prefetch.access_lock );
+    }
+
     if( p_sys->method == STREAM_METHOD_BLOCK )
         block_ChainRelease( p_sys->block.p_first );
     else if( p_sys->method == STREAM_METHOD_STREAM )
         free( p_sys->stream.p_buffer );
 
+    if( p_sys->cache.p_cache != NULL )
+    {
+        stream_cache_stats_t stats;
+
+        stream_CacheGetStats( p_sys->cache.p_cache, &stats );
+        msg_Dbg( s, "cache: %"PRIu64" bytes hit (%"PRIu64" from disk), "
+                 "%"PRIu64" bytes missed", stats.i_hits, stats.i_disk_hits,
+                 stats.i_misses );
+        stream_CacheDelete( p_sys->cache.p_cache );
+    }
+
     free( p_sys->p_peek );
 
     if( p_sys->p_list_access && p_sys->p_list_access != p_sys->p_access )
@@ -493,11 +632,11 @@ static void AStreamDestroy( stream_t *s )
 /****************************************************************************
  * AStreamControlReset:
  ****************************************************************************/
-static void AStreamControlReset( stream_t *s )
+static void AStreamControlReset( stream_t *s, uint64_t i_pos )
 {
     stream_sys_t *p_sys = s->p_sys;
 
-    p_sys->i_pos = p_sys->p_access->info.i_pos;
+    p_sys->i_pos = i_pos;
 
     if( p_sys->method == STREAM_METHOD_BLOCK )
     {
@@ -544,6 +683,14 @@ static void AStreamControlUpdate( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
 
+    if( p_sys->prefetch.b_enabled )
+    {   /* The access is ahead of us by whatever is queued */
+        vlc_mutex_lock( &p_sys->prefetch.lock );
+        p_sys->i_pos = p_sys->prefetch.i_pos;
+        vlc_mutex_unlock( &p_sys->prefetch.lock );
+        return;
+    }
+
     p_sys->i_pos = p_sys->p_access->info.i_pos;
 
     if( p_sys->i_list )
@@ -602,7 +749,7 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
         case STREAM_SET_PRIVATE_ID_STATE:
         case STREAM_SET_PRIVATE_ID_CA:
         case STREAM_GET_PRIVATE_ID_STATE:
-            return access_vaControl( p_access, i_query, args );
+            return AvaControl( s, i_query, args );
 
         case STREAM_GET_SIZE:
         {
@@ -615,7 +762,8 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
                     *pi_64 += s->p_sys->list[i]->i_size;
                 break;
             }
-            *pi_64 = access_GetSize( p_access );
+            if( AControl( s, ACCESS_GET_SIZE, pi_64 ) )
+                *pi_64 = 0;
             break;
         }
 
@@ -642,12 +790,34 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
             AStreamControlUpdate( s );
             return VLC_SUCCESS;
 
+        case STREAM_GET_CACHE_STATS:
+            if( p_sys->cache.p_cache == NULL )
+                return VLC_EGENERIC;
+            stream_CacheGetStats( p_sys->cache.p_cache,
+                                  va_arg( args, stream_cache_stats_t * ) );
+            return VLC_SUCCESS;
+
         case STREAM_SET_TITLE:
         case STREAM_SET_SEEKPOINT:
         {
+            if( p_sys->prefetch.b_enabled )
+                PrefetchStop( s );
             int ret = access_vaControl( p_access, i_query, args );
+            /* The prefetch thread moves the access as soon as it starts */
+            const uint64_t i_pos = p_access->info.i_pos;
+            if( p_sys->prefetch.b_enabled )
+            {
+                p_sys->prefetch.i_pos = i_pos;
+                if( PrefetchStart( s ) )
+                    p_sys->prefetch.b_enabled = false;
+            }
+            if( p_sys->cache.p_cache != NULL )
+            {   /* Offsets now refer to another title */
+                stream_CacheReset( p_sys->cache.p_cache );
+                p_sys->cache.i_pos = p_sys->cache.i_access = i_pos;
+            }
             if( ret == VLC_SUCCESS )
-                AStreamControlReset( s );
+                AStreamControlReset( s, i_pos );
             return ret;
         }
 
@@ -748,10 +918,9 @@ static int AStreamReadBlock( stream_t *s, void *p_read, unsigned int i_read )
     if( p_data == NULL )
     {
         /* seek within this stream if possible, else use plain old read and discard */
-        access_t *p_access = p_sys->p_access;
         bool b_aseek;
 
-        access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
+        AControl( s, ACCESS_CAN_SEEK, &b_aseek );
         if( b_aseek )
             return AStreamSeekBlock( s, p_sys->i_pos + i_read ) ? 0 : i_read;
     }
@@ -860,7 +1029,6 @@ static int AStreamPeekBlock( stream_t *s, const uint8_t **pp_peek, unsigned int
 static int AStreamSeekBlock( stream_t *s, uint64_t i_pos )
 {
     stream_sys_t *p_sys = s->p_sys;
-    access_t   *p_access = p_sys->p_access;
     int64_t    i_offset = i_pos - p_sys->block.i_start;
     bool b_seek;
 
@@ -888,7 +1056,7 @@ static int AStreamSeekBlock( stream_t *s, uint64_t i_pos )
     if( i_offset < 0 )
     {
         bool b_aseek;
-        access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
+        AControl( s, ACCESS_CAN_SEEK, &b_aseek );
 
         if( !b_aseek )
         {
@@ -902,8 +1070,8 @@ static int AStreamSeekBlock( stream_t *s, uint64_t i_pos )
     {
         bool b_aseek, b_aseekfast;
 
-        access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
-        access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_aseekfast );
+        AControl( s, ACCESS_CAN_SEEK, &b_aseek );
+        AControl( s, ACCESS_CAN_FASTSEEK, &b_aseekfast );
 
         if( !b_aseek )
         {
@@ -1144,7 +1312,6 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     stream_sys_t *p_sys = s->p_sys;
 
     stream_track_t *p_current = &p_sys->stream.tk[p_sys->stream.i_tk];
-    access_t *p_access = p_sys->p_access;
 
     if( p_current->i_start >= p_current->i_end  && i_pos >= p_current->i_end )
         return 0; /* EOF */
@@ -1159,7 +1326,7 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
 #endif
 
     bool   b_aseek;
-    access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
+    AControl( s, ACCESS_CAN_SEEK, &b_aseek );
     if( !b_aseek && i_pos < p_current->i_start )
     {
         msg_Warn( s, "AStreamSeekStream: can't seek" );
@@ -1167,7 +1334,7 @@ static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
     }
 
     bool   b_afastseek;
-    access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_afastseek );
+    AControl( s, ACCESS_CAN_FASTSEEK, &b_afastseek );
 
     /* FIXME compute seek cost (instead of static 'stupid' value) */
     uint64_t i_skip_threshold;
@@ -1675,7 +1842,7 @@ error:
 /****************************************************************************
  * Access reading/seeking wrappers to handle concatenated streams.
  ****************************************************************************/
-static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
+static int AccessReadStream( stream_t *s, void *p_read, unsigned int i_read )
 {
     stream_sys_t *p_sys = s->p_sys;
     access_t *p_access = p_sys->p_access;
@@ -1719,7 +1886,7 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
         p_sys->p_list_access = p_list_access;
 
         /* We have to read some data */
-        return AReadStream( s, p_read, i_read_orig );
+        return AccessReadStream( s, p_read, i_read_orig );
     }
 
     /* Update read bytes in input */
@@ -1736,7 +1903,7 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
     return i_read;
 }
 
-static block_t *AReadBlock( stream_t *s, bool *pb_eof )
+static block_t *AccessReadBlock( stream_t *s, bool *pb_eof )
 {
     stream_sys_t *p_sys = s->p_sys;
     access_t *p_access = p_sys->p_access;
@@ -1785,7 +1952,7 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
         p_sys->p_list_access = p_list_access;
 
         /* We have to read some data */
-        return AReadBlock( s, pb_eof );
+        return AccessReadBlock( s, pb_eof );
     }
     if( p_block )
     {
@@ -1804,7 +1971,7 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
     return p_block;
 }
 
-static int ASeek( stream_t *s, uint64_t i_pos )
+static int AccessSeek( stream_t *s, uint64_t i_pos )
 {
     stream_sys_t *p_sys = s->p_sys;
     access_t *p_access = p_sys->p_access;
@@ -1853,6 +2020,431 @@ static int ASeek( stream_t *s, uint64_t i_pos )
     return p_access->pf_seek( p_access, i_pos );
 }
 
+/****************************************************************************
+ * Prefetching:
+ *  The thread reads the access ahead of the demuxer until i_high bytes are
+ *  queued, then waits for the queue to drain below i_low.
+ ****************************************************************************/
+static void PrefetchStats( stream_t *s, bool b_underrun )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    input_thread_t *p_input = s->p_input;
+    const int64_t i_delta = p_sys->prefetch.i_size - p_sys->prefetch.i_reported;
+
+    if( !p_input || ( i_delta == 0 && !b_underrun ) )
+        return;
+
+    /* The counter holds the current fill level */
+    p_sys->prefetch.i_reported = p_sys->prefetch.i_size;
+    vlc_mutex_lock( &p_input->p->counters.counters_lock );
+    stats_Update( p_input->p->counters.p_prefetch_level, i_delta, NULL );
+    if( b_underrun )
+        stats_Update( p_input->p->counters.p_prefetch_underruns, 1, NULL );
+    vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+}
+
+static void *PrefetchThread( void *data )
+{
+    stream_t *s = data;
+    stream_sys_t *p_sys = s->p_sys;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    for( ;; )
+    {
+        while( !p_sys->prefetch.b_stop &&
+               ( p_sys->prefetch.b_full || p_sys->prefetch.b_eof ) )
+            vlc_cond_wait( &p_sys->prefetch.wait_space, &p_sys->prefetch.lock );
+        if( p_sys->prefetch.b_stop )
+            break;
+        vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+        /* Read without holding the queue lock */
+        block_t *b;
+        bool b_eof = false;
+
+        vlc_mutex_lock( &p_sys->prefetch.access_lock );
+        if( p_sys->method == STREAM_METHOD_BLOCK )
+            b = AccessReadBlock( s, &b_eof );
+        else if( ( b = block_Alloc( p_sys->prefetch.i_read_size ) ) != NULL )
+        {
+            int i_read = AccessReadStream( s, b->p_buffer, b->i_buffer );
+            if( i_read <= 0 )
+            {
+                b_eof = i_read == 0;
+                block_Release( b );
+                b = NULL;
+            }
+            else
+                b->i_buffer = i_read;
+        }
+        else
+            b_eof = true;
+        vlc_mutex_unlock( &p_sys->prefetch.access_lock );
+
+        if( !vlc_object_alive( s ) )
+            b_eof = true;
+
+        /* Error, or no data yet: do not retry at once */
+        const bool b_retry = b == NULL && !b_eof;
+
+        vlc_mutex_lock( &p_sys->prefetch.lock );
+        while( b != NULL )
+        {
+            block_t *p_next = b->p_next;
+
+            b->p_next = NULL;
+            p_sys->prefetch.i_size += b->i_buffer;
+            *p_sys->prefetch.pp_last = b;
+            p_sys->prefetch.pp_last = &b->p_next;
+            b = p_next;
+        }
+        if( p_sys->prefetch.i_size >= p_sys->prefetch.i_high )
+            p_sys->prefetch.b_full = true;
+        p_sys->prefetch.b_eof = b_eof;
+        vlc_cond_signal( &p_sys->prefetch.wait_data );
+        PrefetchStats( s, false );
+
+        if( b_retry && !p_sys->prefetch.b_stop )
+            vlc_cond_timedwait( &p_sys->prefetch.wait_space,
+                                &p_sys->prefetch.lock,
+                                mdate() + STREAM_DATA_WAIT );
+    }
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static int PrefetchStart( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    /* The queue may be kept across a failed seek */
+    p_sys->prefetch.b_full = p_sys->prefetch.i_size >= p_sys->prefetch.i_high;
+    p_sys->prefetch.b_eof = false;
+    p_sys->prefetch.b_stop = false;
+    /* Waiting for the first data is not an underrun */
+    p_sys->prefetch.b_underrun = true;
+
+    if( vlc_clone( &p_sys->prefetch.thread, PrefetchThread, s,
+                   VLC_THREAD_PRIORITY_INPUT ) )
+    {
+        msg_Err( s, "cannot start prefetching" );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+/**
+ * Stops the thread, keeping the queued data. This waits for the ongoing
+ * access read, if any, to complete.
+ */
+static void PrefetchJoin( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    p_sys->prefetch.b_stop = true;
+    vlc_cond_signal( &p_sys->prefetch.wait_space );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+    vlc_join( p_sys->prefetch.thread, NULL );
+}
+
+/**
+ * Drops the queued data, with the thread stopped.
+ */
+static void PrefetchFlush( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    block_ChainRelease( p_sys->prefetch.p_first );
+    p_sys->prefetch.p_first = NULL;
+    p_sys->prefetch.pp_last = &p_sys->prefetch.p_first;
+    p_sys->prefetch.i_size = 0;
+    PrefetchStats( s, false );
+}
+
+/**
+ * Stops the thread and drops the queued data.
+ */
+static void PrefetchStop( stream_t *s )
+{
+    PrefetchJoin( s );
+    PrefetchFlush( s );
+}
+
+/**
+ * Waits for queued data, with the queue lock held.
+ * @return the first queued block, or NULL on EOF or if nothing came yet.
+ */
+static block_t *PrefetchWait( stream_t *s, bool *pb_eof )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    while( p_sys->prefetch.p_first == NULL && !p_sys->prefetch.b_eof )
+    {
+        if( !p_sys->prefetch.b_underrun )
+        {
+            p_sys->prefetch.b_underrun = true;
+            PrefetchStats( s, true );
+        }
+        if( !vlc_object_alive( s ) )
+            break;
+        /* Check for object death periodically */
+        if( vlc_cond_timedwait( &p_sys->prefetch.wait_data,
+                                &p_sys->prefetch.lock,
+                                mdate() + CLOCK_FREQ / 10 ) )
+            break;
+    }
+    *pb_eof = p_sys->prefetch.p_first == NULL && p_sys->prefetch.b_eof;
+    if( *pb_eof )
+    {   /* Report EOF once, and try again next time like the access would */
+        p_sys->prefetch.b_eof = false;
+        vlc_cond_signal( &p_sys->prefetch.wait_space );
+    }
+    return p_sys->prefetch.p_first;
+}
+
+/**
+ * Updates the state once data was taken from the queue, with the lock held.
+ */
+static void PrefetchDrained( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->prefetch.p_first == NULL )
+    {
+        assert( p_sys->prefetch.i_size == 0 );
+        p_sys->prefetch.pp_last = &p_sys->prefetch.p_first;
+    }
+
+    p_sys->prefetch.b_underrun = false;
+    if( p_sys->prefetch.b_full &&
+        p_sys->prefetch.i_size <= p_sys->prefetch.i_low )
+    {
+        p_sys->prefetch.b_full = false;
+        vlc_cond_signal( &p_sys->prefetch.wait_space );
+    }
+    PrefetchStats( s, false );
+}
+
+/**
+ * Removes i_size bytes from the head of the queue, with the lock held.
+ */
+static void PrefetchConsume( stream_t *s, size_t i_size )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    assert( i_size <= p_sys->prefetch.i_size );
+    p_sys->prefetch.i_pos += i_size;
+    p_sys->prefetch.i_size -= i_size;
+    while( i_size > 0 )
+    {
+        block_t *b = p_sys->prefetch.p_first;
+        size_t i_skip = __MIN( i_size, b->i_buffer );
+
+        b->p_buffer += i_skip;
+        b->i_buffer -= i_skip;
+        i_size -= i_skip;
+        if( b->i_buffer == 0 )
+        {
+            p_sys->prefetch.p_first = b->p_next;
+            block_Release( b );
+        }
+    }
+    PrefetchDrained( s );
+}
+
+static int PrefetchReadStream( stream_t *s, void *p_read, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( !p_sys->prefetch.b_enabled )
+        return AccessReadStream( s, p_read, i_read );
+
+    uint8_t *p_data = p_read;
+    unsigned i_data = 0;
+    bool b_eof;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    block_t *b = PrefetchWait( s, &b_eof );
+
+    /* Do not wait for more data, as a synchronous read would not either */
+    for( ; b != NULL && i_data < i_read; b = b->p_next )
+    {
+        size_t i_copy = __MIN( b->i_buffer, i_read - i_data );
+
+        if( p_data != NULL )
+        {
+            memcpy( p_data, b->p_buffer, i_copy );
+            p_data += i_copy;
+        }
+        i_data += i_copy;
+    }
+    if( i_data > 0 )
+        PrefetchConsume( s, i_data );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    if( i_data == 0 && !b_eof )
+        return -1;
+    return i_data;
+}
+
+static block_t *AReadBlock( stream_t *s, bool *pb_eof )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( !p_sys->prefetch.b_enabled )
+        return AccessReadBlock( s, pb_eof );
+
+    bool b_eof;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    block_t *b = PrefetchWait( s, &b_eof );
+    if( b != NULL )
+    {   /* Hand out the queued block itself */
+        p_sys->prefetch.p_first = b->p_next;
+        b->p_next = NULL;
+        p_sys->prefetch.i_pos += b->i_buffer;
+        p_sys->prefetch.i_size -= b->i_buffer;
+        PrefetchDrained( s );
+    }
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    if( pb_eof )
+        *pb_eof = b_eof;
+    return b;
+}
+static int PrefetchSeek( stream_t *s, uint64_t i_pos )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( !p_sys->prefetch.b_enabled )
+        return AccessSeek( s, i_pos );
+
+    /* Skip forward within the queue if possible */
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    if( i_pos >= p_sys->prefetch.i_pos &&
+        i_pos - p_sys->prefetch.i_pos <= p_sys->prefetch.i_size )
+    {
+        PrefetchConsume( s, i_pos - p_sys->prefetch.i_pos );
+        vlc_mutex_unlock( &p_sys->prefetch.lock );
+        return VLC_SUCCESS;
+    }
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    /* Otherwise cancel prefetching, and restart from the new position */
+    PrefetchJoin( s );
+
+    /* Where the access was, past the queued data */
+    const uint64_t i_end = p_sys->prefetch.i_pos + p_sys->prefetch.i_size;
+    int i_ret = AccessSeek( s, i_pos );
+    if( i_ret == VLC_SUCCESS )
+    {
+        PrefetchFlush( s );
+        p_sys->prefetch.i_pos = i_pos;
+    }
+    else if( p_sys->p_access->info.i_pos != i_end &&
+             AccessSeek( s, i_end ) )
+    {   /* Neither here nor there: go on from wherever the access is */
+        PrefetchFlush( s );
+        p_sys->prefetch.i_pos = p_sys->p_access->info.i_pos;
+    }
+    /* else the queue still follows the old position */
+
+    if( PrefetchStart( s ) )
+    {   /* Read synchronously from now, without the queue */
+        if( p_sys->prefetch.i_size > 0 )
+        {
+            PrefetchFlush( s );
+            AccessSeek( s, p_sys->prefetch.i_pos );
+        }
+        p_sys->prefetch.b_enabled = false;
+    }
+    return i_ret;
+}
+
+/****************************************************************************
+ * Segment cache:
+ *  Data read by the stream method is kept in the cache, and read back from
+ *  it instead of the access when seeking back. The access is only seeked
+ *  once the cached data runs out.
+ ****************************************************************************/
+static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    stream_cache_t *p_cache = p_sys->cache.p_cache;
+
+    if( p_cache == NULL )
+        return PrefetchReadStream( s, p_read, i_read );
+
+    assert( p_read != NULL );
+    size_t i_cached = stream_CacheRead( p_cache, p_sys->cache.i_pos,
+                                        p_read, i_read );
+    if( i_cached > 0 )
+    {
+        p_sys->cache.i_pos += i_cached;
+        return i_cached;
+    }
+
+    if( p_sys->cache.i_access != p_sys->cache.i_pos )
+    {
+        if( PrefetchSeek( s, p_sys->cache.i_pos ) )
+        {
+            msg_Err( s, "cannot seek to %"PRIu64, p_sys->cache.i_pos );
+            return 0;
+        }
+        p_sys->cache.i_access = p_sys->cache.i_pos;
+    }
+
+    int i_ret = PrefetchReadStream( s, p_read, i_read );
+    if( i_ret > 0 )
+    {
+        stream_CacheWrite( p_cache, p_sys->cache.i_pos, p_read, i_ret );
+        p_sys->cache.i_pos += i_ret;
+        p_sys->cache.i_access += i_ret;
+    }
+    return i_ret;
+}
+
+static int ASeek( stream_t *s, uint64_t i_pos )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->cache.p_cache == NULL )
+        return PrefetchSeek( s, i_pos );
+
+    /* Deferred to the next read, which may not need the access */
+    p_sys->cache.i_pos = i_pos;
+    return VLC_SUCCESS;
+}
+
+static int AvaControl( stream_t *s, int i_query, va_list args )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    int i_ret;
+
+    if( !p_sys->prefetch.b_enabled )
+        return access_vaControl( p_sys->p_access, i_query, args );
+
+    vlc_mutex_lock( &p_sys->prefetch.access_lock );
+    i_ret = access_vaControl( p_sys->p_access, i_query, args );
+    vlc_mutex_unlock( &p_sys->prefetch.access_lock );
+    return i_ret;
+}
+
+static int AControl( stream_t *s, int i_query, ... )
+{
+    va_list args;
+    int i_ret;
+
+    va_start( args, i_query );
+    i_ret = AvaControl( s, i_query, args );
+    va_end( args );
+    return i_ret;
+}
+
 static int AStreamReadDir( stream_t *s, input_item_node_t *p_node )
 {
     access_t *p_access = s->p_sys->p_access;
@@ -73,4 +73,30 @@ stream_t *stream_FilterNew( stream_t *p_source,
 stream_t *stream_FilterChainNew( stream_t *p_source,
                                  const char *psz_chain,
                                  bool b_record );
+
+/**
+ * Cache of the data read from an access, by segments of i_segment bytes.
+ * Up to i_memory bytes are kept in memory, and the least recently used
+ * segments then go to a temporary file of up to i_disk bytes in psz_dir
+ * (if not NULL).
+ */
+typedef struct stream_cache_t stream_cache_t;
+
+stream_cache_t *stream_CacheNew( size_t i_memory, size_t i_segment,
+                                 uint64_t i_disk, const char *psz_dir );
+void stream_CacheDelete( stream_cache_t * );
+void stream_CacheReset( stream_cache_t * );
+
+/**
+ * Copies the data cached contiguously from i_pos, up to i_len bytes.
+ * \return the number of bytes copied
+ */
+size_t stream_CacheRead( stream_cache_t *, uint64_t i_pos,
+                         void *p_buf, size_t i_len );
+/**
+ * Stores data just read from the access at i_pos.
+ */
+void stream_CacheWrite( stream_cache_t *, uint64_t i_pos,
+                        const void *p_buf, size_t i_len );
+void stream_CacheGetStats( const stream_cache_t *, stream_cache_stats_t * );
 #endif
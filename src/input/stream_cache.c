@@ -0,0 +1,460 @@
+/*****************************************************************************
+ * stream_cache.c: segment cache for the access stream
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+
+#include "stream.h"
+
+/* The stream is split in segments of i_segment bytes. Each cached segment
+ * holds one contiguous range of its bytes, either in memory or in a slot of
+ * the disk file. The least recently used segment is moved from memory to
+ * the disk, and dropped from the disk. */
+typedef struct
+{
+    uint64_t i_index;     /* segment number */
+    size_t   i_begin;     /* valid range within the segment */
+    size_t   i_end;
+    uint8_t *p_data;      /* in memory, or NULL */
+    int      i_slot;      /* on disk, or -1 */
+    uint64_t i_used;      /* last use date, for LRU */
+} stream_segment_t;
+
+struct stream_cache_t
+{
+    size_t   i_segment;
+
+    /* Segments sorted by index */
+    stream_segment_t *p_segs;
+    unsigned i_count;
+
+    unsigned i_memory;    /* segments in memory */
+    unsigned i_memory_max;
+
+    int      fd;          /* disk tier, -1 if none */
+    char    *psz_path;
+    unsigned i_disk;      /* segments on disk */
+    unsigned i_disk_max;
+    bool    *pb_slots;    /* used disk slots */
+
+    uint64_t i_clock;
+    stream_cache_stats_t stats;
+};
+
+stream_cache_t *stream_CacheNew( size_t i_memory, size_t i_segment,
+                                 uint64_t i_disk, const char *psz_dir )
+{
+    if( i_segment == 0 || i_memory < i_segment )
+        return NULL;
+
+    stream_cache_t *p_cache = malloc( sizeof( *p_cache ) );
+    if( unlikely(p_cache == NULL) )
+        return NULL;
+
+    p_cache->i_segment = i_segment;
+    p_cache->i_memory = 0;
+    p_cache->i_memory_max = i_memory / i_segment;
+    p_cache->fd = -1;
+    p_cache->psz_path = NULL;
+    p_cache->i_disk = 0;
+    p_cache->i_disk_max = 0;
+    p_cache->pb_slots = NULL;
+    p_cache->i_clock = 0;
+    memset( &p_cache->stats, 0, sizeof( p_cache->stats ) );
+
+    if( psz_dir != NULL && i_disk >= i_segment &&
+        asprintf( &p_cache->psz_path, "%s"DIR_SEP"stream-XXXXXX",
+                  psz_dir ) >= 0 )
+    {
+        p_cache->fd = vlc_mkstemp( p_cache->psz_path );
+        p_cache->i_disk_max = __MIN( i_disk / i_segment, INT_MAX );
+        p_cache->pb_slots = calloc( p_cache->i_disk_max, sizeof( bool ) );
+        if( p_cache->fd == -1 || p_cache->pb_slots == NULL )
+        {
+            if( p_cache->fd != -1 )
+            {
+                close( p_cache->fd );
+                vlc_unlink( p_cache->psz_path );
+                p_cache->fd = -1;
+            }
+            free( p_cache->pb_slots );
+            p_cache->pb_slots = NULL;
+            p_cache->i_disk_max = 0;
+        }
+    }
+
+    p_cache->p_segs = malloc( ( p_cache->i_memory_max + p_cache->i_disk_max )
+                              * sizeof( *p_cache->p_segs ) );
+    if( unlikely(p_cache->p_segs == NULL) )
+    {
+        stream_CacheDelete( p_cache );
+        return NULL;
+    }
+    p_cache->i_count = 0;
+    return p_cache;
+}
+
+void stream_CacheDelete( stream_cache_t *p_cache )
+{
+    stream_CacheReset( p_cache );
+    if( p_cache->fd != -1 )
+    {
+        close( p_cache->fd );
+        vlc_unlink( p_cache->psz_path );
+    }
+    free( p_cache->psz_path );
+    free( p_cache->pb_slots );
+    free( p_cache->p_segs );
+    free( p_cache );
+}
+
+void stream_CacheReset( stream_cache_t *p_cache )
+{
+    if( p_cache->p_segs != NULL )
+        for( unsigned i = 0; i < p_cache->i_count; i++ )
+            free( p_cache->p_segs[i].p_data );
+    p_cache->i_count = 0;
+    p_cache->i_memory = 0;
+    p_cache->i_disk = 0;
+    if( p_cache->pb_slots != NULL )
+        memset( p_cache->pb_slots, 0, p_cache->i_disk_max * sizeof( bool ) );
+    p_cache->stats.i_memory = 0;
+    p_cache->stats.i_disk = 0;
+}
+
+void stream_CacheGetStats( const stream_cache_t *p_cache,
+                           stream_cache_stats_t *p_stats )
+{
+    *p_stats = p_cache->stats;
+}
+
+/* Returns the position of the segment, or where to insert it */
+static unsigned Find( const stream_cache_t *p_cache, uint64_t i_index,
+                      bool *pb_found )
+{
+    unsigned i_low = 0, i_high = p_cache->i_count;
+
+    while( i_low < i_high )
+    {
+        const unsigned i_mid = (i_low + i_high) / 2;
+
+        if( p_cache->p_segs[i_mid].i_index < i_index )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    *pb_found = i_low < p_cache->i_count &&
+                p_cache->p_segs[i_low].i_index == i_index;
+    return i_low;
+}
+
+static bool DiskIO( stream_cache_t *p_cache, int i_slot, uint8_t *p_data,
+                    size_t i_size, bool b_write )
+{
+    const off_t i_offset = (off_t)i_slot * p_cache->i_segment;
+
+    if( lseek( p_cache->fd, i_offset, SEEK_SET ) != i_offset )
+        return false;
+
+    while( i_size > 0 )
+    {
+        ssize_t i_ret = b_write ? write( p_cache->fd, p_data, i_size )
+                                : read( p_cache->fd, p_data, i_size );
+        if( i_ret <= 0 )
+        {
+            if( i_ret < 0 && errno == EINTR )
+                continue;
+            return false;
+        }
+        p_data += i_ret;
+        i_size -= i_ret;
+    }
+    return true;
+}
+
+static void Unlink( stream_cache_t *p_cache, unsigned i )
+{
+    stream_segment_t *p_seg = &p_cache->p_segs[i];
+
+    memmove( p_seg, p_seg + 1,
+             ( --p_cache->i_count - i ) * sizeof( *p_seg ) );
+}
+
+static void Remove( stream_cache_t *p_cache, unsigned i )
+{
+    stream_segment_t *p_seg = &p_cache->p_segs[i];
+    const size_t i_size = p_seg->i_end - p_seg->i_begin;
+
+    if( p_seg->p_data != NULL )
+    {
+        free( p_seg->p_data );
+        p_cache->i_memory--;
+        p_cache->stats.i_memory -= i_size;
+    }
+    if( p_seg->i_slot >= 0 )
+    {
+        p_cache->pb_slots[p_seg->i_slot] = false;
+        p_cache->i_disk--;
+        p_cache->stats.i_disk -= i_size;
+    }
+    Unlink( p_cache, i );
+}
+
+/* Returns the least recently used segment in memory, or on disk */
+static unsigned FindLRU( const stream_cache_t *p_cache, bool b_memory )
+{
+    unsigned i_lru = p_cache->i_count;
+
+    for( unsigned i = 0; i < p_cache->i_count; i++ )
+    {
+        const stream_segment_t *p_seg = &p_cache->p_segs[i];
+        const bool b_in = b_memory ? p_seg->p_data != NULL
+                                   : p_seg->i_slot >= 0;
+
+        if( b_in && ( i_lru == p_cache->i_count ||
+                      p_seg->i_used < p_cache->p_segs[i_lru].i_used ) )
+            i_lru = i;
+    }
+    assert( i_lru < p_cache->i_count );
+    return i_lru;
+}
+
+/**
+ * Moves a segment from memory to the disk, or drops it.
+ * @return its memory buffer, now unused
+ */
+static uint8_t *Demote( stream_cache_t *p_cache, unsigned i )
+{
+    stream_segment_t *p_seg = &p_cache->p_segs[i];
+    uint8_t *p_data = p_seg->p_data;
+    const size_t i_size = p_seg->i_end - p_seg->i_begin;
+    const uint64_t i_index = p_seg->i_index;
+    int i_slot;
+
+    p_seg->p_data = NULL;
+    p_cache->i_memory--;
+    p_cache->stats.i_memory -= i_size;
+
+    if( p_cache->i_disk_max == 0 )
+    {
+        Unlink( p_cache, i );
+        return p_data;
+    }
+
+    if( p_cache->i_disk >= p_cache->i_disk_max )
+    {   /* Drop the oldest segment from the disk */
+        const unsigned i_lru = FindLRU( p_cache, false );
+
+        i_slot = p_cache->p_segs[i_lru].i_slot;
+        Remove( p_cache, i_lru );
+
+        bool b_found;
+        i = Find( p_cache, i_index, &b_found );
+        assert( b_found );
+        p_seg = &p_cache->p_segs[i];
+    }
+    else
+        for( i_slot = 0; p_cache->pb_slots[i_slot]; i_slot++ );
+
+    if( !DiskIO( p_cache, i_slot, p_data, p_cache->i_segment, true ) )
+    {
+        Unlink( p_cache, i );
+        return p_data;
+    }
+
+    p_cache->pb_slots[i_slot] = true;
+    p_seg->i_slot = i_slot;
+    p_cache->i_disk++;
+    p_cache->stats.i_disk += i_size;
+    return p_data;
+}
+
+/**
+ * Gets a memory buffer for a segment, making room if needed. This may move
+ * the other segments around.
+ */
+static uint8_t *Allocate( stream_cache_t *p_cache )
+{
+    uint8_t *p_data;
+
+    if( p_cache->i_memory < p_cache->i_memory_max )
+        p_data = malloc( p_cache->i_segment );
+    else
+        p_data = Demote( p_cache, FindLRU( p_cache, true ) );
+
+    if( p_data != NULL )
+        p_cache->i_memory++;
+    return p_data;
+}
+
+/**
+ * Loads a segment from the disk back to memory. If memory is full, the
+ * least recently used segment there takes its place on disk.
+ * @return false if the segment was lost in the process
+ */
+static bool Promote( stream_cache_t *p_cache, unsigned i )
+{
+    stream_segment_t *p_seg = &p_cache->p_segs[i];
+    const uint64_t i_index = p_seg->i_index;
+    const size_t i_size = p_seg->i_end - p_seg->i_begin;
+    uint8_t *p_data = malloc( p_cache->i_segment );
+
+    if( unlikely(p_data == NULL) )
+        return false;
+    if( !DiskIO( p_cache, p_seg->i_slot, p_data, p_cache->i_segment, false ) )
+    {
+        free( p_data );
+        Remove( p_cache, i );
+        return false;
+    }
+    p_cache->pb_slots[p_seg->i_slot] = false;
+    p_cache->i_disk--;
+    p_cache->stats.i_disk -= i_size;
+    p_seg->i_slot = -1;
+
+    if( p_cache->i_memory >= p_cache->i_memory_max )
+    {
+        bool b_found;
+
+        free( Demote( p_cache, FindLRU( p_cache, true ) ) );
+        i = Find( p_cache, i_index, &b_found );
+        assert( b_found );
+        p_seg = &p_cache->p_segs[i];
+    }
+    p_seg->p_data = p_data;
+    p_cache->i_memory++;
+    p_cache->stats.i_memory += i_size;
+    return true;
+}
+
+size_t stream_CacheRead( stream_cache_t *p_cache, uint64_t i_pos,
+                         void *p_buf, size_t i_len )
+{
+    uint8_t *p_out = p_buf;
+    size_t i_done = 0;
+
+    while( i_done < i_len )
+    {
+        const uint64_t i_index = i_pos / p_cache->i_segment;
+        const size_t i_offset = i_pos % p_cache->i_segment;
+        bool b_found;
+        unsigned i = Find( p_cache, i_index, &b_found );
+
+        if( !b_found )
+            break;
+
+        stream_segment_t *p_seg = &p_cache->p_segs[i];
+        if( i_offset < p_seg->i_begin || i_offset >= p_seg->i_end )
+            break;
+
+        const bool b_disk = p_seg->p_data == NULL;
+        p_seg->i_used = ++p_cache->i_clock;
+        if( b_disk )
+        {
+            if( !Promote( p_cache, i ) )
+                break;
+            i = Find( p_cache, i_index, &b_found );
+            p_seg = &p_cache->p_segs[i];
+        }
+
+        const size_t i_copy = __MIN( p_seg->i_end - i_offset, i_len - i_done );
+        memcpy( p_out, p_seg->p_data + i_offset, i_copy );
+        if( b_disk )
+            p_cache->stats.i_disk_hits += i_copy;
+        p_out += i_copy;
+        i_pos += i_copy;
+        i_done += i_copy;
+    }
+
+    p_cache->stats.i_hits += i_done;
+    return i_done;
+}
+
+void stream_CacheWrite( stream_cache_t *p_cache, uint64_t i_pos,
+                        const void *p_buf, size_t i_len )
+{
+    const uint8_t *p_in = p_buf;
+
+    p_cache->stats.i_misses += i_len;
+
+    while( i_len > 0 )
+    {
+        const uint64_t i_index = i_pos / p_cache->i_segment;
+        const size_t i_offset = i_pos % p_cache->i_segment;
+        const size_t i_copy = __MIN( p_cache->i_segment - i_offset, i_len );
+        bool b_found;
+        unsigned i = Find( p_cache, i_index, &b_found );
+
+        if( b_found && p_cache->p_segs[i].p_data == NULL )
+        {   /* Copy on disk, drop it rather than reading it back */
+            Remove( p_cache, i );
+            b_found = false;
+        }
+        if( !b_found )
+        {
+            uint8_t *p_data = Allocate( p_cache );
+            if( p_data == NULL )
+                return;
+            i = Find( p_cache, i_index, &b_found );
+            assert( !b_found );
+
+            stream_segment_t *p_seg = &p_cache->p_segs[i];
+            memmove( p_seg + 1, p_seg,
+                     ( p_cache->i_count++ - i ) * sizeof( *p_seg ) );
+            p_seg->i_index = i_index;
+            p_seg->i_begin = p_seg->i_end = i_offset;
+            p_seg->p_data = p_data;
+            p_seg->i_slot = -1;
+        }
+
+        stream_segment_t *p_seg = &p_cache->p_segs[i];
+        const size_t i_size = p_seg->i_end - p_seg->i_begin;
+
+        if( i_offset > p_seg->i_end || i_offset + i_copy < p_seg->i_begin )
+        {   /* Not contiguous with what we have: keep the new data */
+            p_seg->i_begin = i_offset;
+            p_seg->i_end = i_offset + i_copy;
+        }
+        else
+        {
+            p_seg->i_begin = __MIN( p_seg->i_begin, i_offset );
+            p_seg->i_end = __MAX( p_seg->i_end, i_offset + i_copy );
+        }
+        p_cache->stats.i_memory += p_seg->i_end - p_seg->i_begin;
+        p_cache->stats.i_memory -= i_size;
+
+        memcpy( p_seg->p_data + i_offset, p_in, i_copy );
+        p_seg->i_used = ++p_cache->i_clock;
+        p_in += i_copy;
+        i_pos += i_copy;
+        i_len -= i_copy;
+    }
+}
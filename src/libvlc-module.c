@@ -528,6 +528,12 @@ static const char *const ppsz_pos_descriptions[] =
     "This defines the maximum input delay jitter that the synchronization " \
     "algorithms should try to compensate (in milliseconds)." )
 
+#define DEC_FIFO_LOCKLESS_TEXT N_("Lock-less decoder FIFO")
+#define DEC_FIFO_LOCKLESS_LONGTEXT N_( \
+    "Exchange packets between the input and the decoder threads through " \
+    "a lock-less ring buffer. This reduces locking overhead when many " \
+    "elementary streams are demultiplexed at once." )
+
 #define NETSYNC_TEXT N_("Network synchronisation" )
 #define NETSYNC_LONGTEXT N_( "This allows you to remotely " \
         "synchronise clocks for server and client. The detailed settings " \
@@ -827,6 +833,12 @@ static const char *const ppsz_prefres[] = {
     "However allocation of port numbers below 1025 is usually restricted " \
     "by the operating system." )
 
+#define HTTP_THREADS_TEXT N_( "HTTP server threads" )
+#define HTTP_THREADS_LONGTEXT N_( \
+    "Number of threads serving the clients of each HTTP and RTSP server. " \
+    "Clients are spread evenly across the threads. More than one thread " \
+    "is only used on systems supporting epoll." )
+
 #define HTTP_CERT_TEXT N_("HTTP/TLS server certificate")
 #define CERT_LONGTEXT N_( \
    "This X.509 certicate file (PEM format) is used for server-side TLS. " \
@@ -990,6 +1002,40 @@ static const char *const ppsz_prefres[] = {
 #define STREAM_FILTER_LONGTEXT N_( \
     "Stream filters are used to modify the stream that is being read. " )
 
+#define STREAM_CACHE_SIZE_TEXT N_("Stream cache size (kB)")
+#define STREAM_CACHE_SIZE_LONGTEXT N_( \
+    "Amount of memory used to keep data read from inputs that are slow " \
+    "to seek, such as network streams, so that seeking back within it " \
+    "does not need the input anymore. 0 disables the cache." )
+
+#define STREAM_CACHE_SEGMENT_TEXT N_("Stream cache segment size (kB)")
+#define STREAM_CACHE_SEGMENT_LONGTEXT N_( \
+    "Granularity of the stream cache: data is kept or dropped by " \
+    "segments of this size." )
+
+#define STREAM_CACHE_DISK_TEXT N_("Stream disk cache size (MB)")
+#define STREAM_CACHE_DISK_LONGTEXT N_( \
+    "Amount of disk space used to keep data dropped from the memory " \
+    "cache. 0 disables the disk cache." )
+
+#define STREAM_PREFETCH_TEXT N_("Prefetch input data")
+#define STREAM_PREFETCH_LONGTEXT N_( \
+    "Read input data from a background thread, ahead of the demuxer. " \
+    "This hides access stalls, for instance on slow network file systems." )
+
+#define STREAM_PREFETCH_SIZE_TEXT N_("Prefetch buffer size (kB)")
+#define STREAM_PREFETCH_SIZE_LONGTEXT N_( \
+    "Maximum amount of data read ahead of the demuxer." )
+
+#define STREAM_PREFETCH_RESUME_TEXT N_("Prefetch resume level (%)")
+#define STREAM_PREFETCH_RESUME_LONGTEXT N_( \
+    "Once the prefetch buffer is full, reading resumes when the buffer " \
+    "falls below this percentage of its size." )
+
+#define STREAM_PREFETCH_READ_TEXT N_("Prefetch read size (kB)")
+#define STREAM_PREFETCH_READ_LONGTEXT N_( \
+    "Amount of data requested from the access at once when prefetching." )
+
 #define DEMUX_TEXT N_("Demux module")
 #define DEMUX_LONGTEXT N_( \
     "Demultiplexers are used to separate the \"elementary\" streams " \
@@ -1733,6 +1779,9 @@ vlc_module_begin ()
     add_string( "rtsp-host", NULL, RTSP_HOST_TEXT, RTSP_HOST_LONGTEXT, true )
     add_integer( "rtsp-port", 554, RTSP_PORT_TEXT, RTSP_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
+    add_integer( "http-threads", 1, HTTP_THREADS_TEXT,
+                 HTTP_THREADS_LONGTEXT, true )
+        change_integer_range( 1, 64 )
     add_loadfile( "http-cert", NULL, HTTP_CERT_TEXT, CERT_LONGTEXT, true )
     add_obsolete_string( "sout-http-cert" ) /* since 2.0.0 */
     add_loadfile( "http-key", NULL, HTTP_KEY_TEXT, KEY_LONGTEXT, true )
@@ -1833,6 +1882,8 @@ vlc_module_begin ()
     add_integer( "clock-jitter", 5 * CLOCK_FREQ/1000, CLOCK_JITTER_TEXT,
               CLOCK_JITTER_LONGTEXT, true )
         change_safe()
+    add_bool( "decoder-fifo-lockless", false, DEC_FIFO_LOCKLESS_TEXT,
+              DEC_FIFO_LOCKLESS_LONGTEXT, true )
 
     add_bool( "network-synchronisation", false, NETSYNC_TEXT,
               NETSYNC_LONGTEXT, true )
@@ -1870,6 +1921,27 @@ vlc_module_begin ()
     set_subcategory( SUBCAT_INPUT_STREAM_FILTER )
     add_module_list( "stream-filter", "stream_filter", NULL,
                      STREAM_FILTER_TEXT, STREAM_FILTER_LONGTEXT, false )
+    add_integer( "stream-cache-size", 16384, STREAM_CACHE_SIZE_TEXT,
+                 STREAM_CACHE_SIZE_LONGTEXT, true )
+        change_integer_range( 0, 1 << 22 )
+    add_integer( "stream-cache-segment-size", 256, STREAM_CACHE_SEGMENT_TEXT,
+                 STREAM_CACHE_SEGMENT_LONGTEXT, true )
+        change_integer_range( 4, 1 << 16 )
+    add_integer( "stream-cache-disk-size", 0, STREAM_CACHE_DISK_TEXT,
+                 STREAM_CACHE_DISK_LONGTEXT, true )
+        change_integer_range( 0, 1 << 20 )
+    add_bool( "stream-prefetch", false, STREAM_PREFETCH_TEXT,
+              STREAM_PREFETCH_LONGTEXT, true )
+    add_integer( "stream-prefetch-buffer-size", 4096,
+                 STREAM_PREFETCH_SIZE_TEXT, STREAM_PREFETCH_SIZE_LONGTEXT,
+                 true )
+        change_integer_range( 16, 1 << 20 )
+    add_integer( "stream-prefetch-resume", 50, STREAM_PREFETCH_RESUME_TEXT,
+                 STREAM_PREFETCH_RESUME_LONGTEXT, true )
+        change_integer_range( 0, 99 )
+    add_integer( "stream-prefetch-read-size", 16, STREAM_PREFETCH_READ_TEXT,
+                 STREAM_PREFETCH_READ_LONGTEXT, true )
+        change_integer_range( 1, 1024 )
 
 
 /* Stream output options */
@@ -39,6 +39,7 @@
 #include <vlc_common.h>
 #include "../lib/libvlc_internal.h"
 #include <vlc_input.h>
+#include <vlc_block.h>
 
 #include "modules/modules.h"
 #include "config/configuration.h"
@@ -551,6 +552,12 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     if( !var_InheritBool( p_libvlc, "ignore-config" ) )
         config_AutoSaveConfigFile( VLC_OBJECT(p_libvlc) );
 
+    uint64_t hits, misses;
+    block_CacheStats( &hits, &misses );
+    msg_Dbg( p_libvlc, "block cache: %"PRIu64" hits, %"PRIu64" misses",
+             hits, misses );
+    block_CacheCleanup();
+
     /* Free module bank. It is refcounted, so we call this each time  */
     module_EndBank (true);
     vlc_LogDeinit (p_libvlc);
@@ -79,6 +79,11 @@ void vlc_assert_locked (vlc_mutex_t *);
 void vlc_LogInit(libvlc_int_t *);
 void vlc_LogDeinit(libvlc_int_t *);
 
+/*
+ * Block allocation cache
+ */
+void block_CacheCleanup(void);
+
 /*
  * LibVLC exit event handling
  */
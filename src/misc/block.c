@@ -31,12 +31,15 @@
 #include <sys/stat.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include <fcntl.h>
 
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+#include "../libvlc.h"
 
 /**
  * @section Block handling functions.
@@ -97,13 +100,6 @@ void block_Init( block_t *restrict b, void *buf, size_t size )
 #endif
 }
 
-static void block_generic_Release (block_t *block)
-{
-    /* That is always true for blocks allocated with block_Alloc(). */
-    assert (block->p_start == (unsigned char *)(block + 1));
-    block_Invalidate (block);
-    free (block);
-}
 
 static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 {
@@ -126,15 +122,327 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /* Maximum size of reserved footer before shrinking with realloc(). */
 #define BLOCK_WASTE_SIZE   2048
 
-block_t *block_Alloc (size_t size)
+/**
+ * @section Block allocation cache
+ *
+ * Small and medium block_Alloc() allocations are rounded up to a power of
+ * two size class, and recycled by block_generic_Release() instead of being
+ * freed. Each thread keeps a small stack of free blocks per class, so that
+ * the common case needs neither malloc() nor any lock. Blocks are often
+ * allocated in one thread (e.g. the demuxer) and released in another one
+ * (e.g. a decoder), so full per-thread stacks are flushed to a global depot
+ * in batches, and empty ones are refilled from it.
+ */
+
+/** Smallest size class (log2): small payloads only. With the block header
+ * and padding, a 188-byte TS packet (about 370 bytes) is in the next one. */
+#define BLOCK_CLASS_MIN    8
+/** Number of size classes, i.e. up to 32 KiB */
+#define BLOCK_CLASSES      8
+/** Per-thread cache size limit per class (bytes) */
+#define BLOCK_CACHE_SIZE   (256 << 10)
+/** Maximum per-thread cache depth per class (blocks) */
+#define BLOCK_CACHE_DEPTH  64
+/** Global depot size limit per class (bytes) */
+#define BLOCK_DEPOT_SIZE   (4 << 20)
+
+typedef struct
+{
+    block_t *list[BLOCK_CLASSES];
+    unsigned count[BLOCK_CLASSES];
+    uint64_t hits;
+    uint64_t misses;
+} block_cache_t;
+
+static struct
+{
+    vlc_mutex_t lock;
+    block_t *list[BLOCK_CLASSES];
+    unsigned count[BLOCK_CLASSES];
+    uint64_t hits;
+    uint64_t misses;
+} block_depot = { VLC_STATIC_MUTEX, { NULL }, { 0 }, 0, 0 };
+
+static vlc_threadvar_t block_cache_key;
+static atomic_uint block_cache_state = ATOMIC_VAR_INIT(0); /* 1: usable,
+                                                               2: failed */
+
+static unsigned block_CacheDepth (unsigned c)
+{
+    unsigned depth = BLOCK_CACHE_SIZE >> (BLOCK_CLASS_MIN + c);
+    return (depth < BLOCK_CACHE_DEPTH) ? depth : BLOCK_CACHE_DEPTH;
+}
+
+/**
+ * Finds the size class of an allocation.
+ * @return the class index, or BLOCK_CLASSES if too large to be cached.
+ */
+static unsigned block_SizeClass (size_t alloc)
+{
+    unsigned c = 0;
+
+    while ((((size_t)1) << (BLOCK_CLASS_MIN + c)) < alloc)
+        if (++c >= BLOCK_CLASSES)
+            break;
+    return c;
+}
+
+/** Moves up to n blocks from a list to another one. */
+static unsigned block_ListMove (block_t **restrict dst, block_t **restrict src,
+                                unsigned n)
+{
+    unsigned moved = 0;
+
+    while (moved < n && *src != NULL)
+    {
+        block_t *b = *src;
+
+        *src = b->p_next;
+        b->p_next = *dst;
+        *dst = b;
+        moved++;
+    }
+    return moved;
+}
+
+static void block_CacheDestroy (void *data)
+{
+    block_cache_t *cache = data;
+    block_t *garbage = NULL;
+
+    vlc_mutex_lock (&block_depot.lock);
+    for (unsigned c = 0; c < BLOCK_CLASSES; c++)
+    {
+        unsigned max = (unsigned)BLOCK_DEPOT_SIZE >> (BLOCK_CLASS_MIN + c);
+        unsigned room = (block_depot.count[c] < max)
+                      ? (max - block_depot.count[c]) : 0;
+
+        block_depot.count[c] += block_ListMove (&block_depot.list[c],
+                                                &cache->list[c], room);
+        block_ListMove (&garbage, &cache->list[c], UINT_MAX);
+    }
+    block_depot.hits += cache->hits;
+    block_depot.misses += cache->misses;
+    vlc_mutex_unlock (&block_depot.lock);
+
+    while (garbage != NULL)
+    {
+        block_t *b = garbage;
+
+        garbage = b->p_next;
+        free (b);
+    }
+    free (cache);
+}
+
+/**
+ * Gets the allocation cache of the calling thread.
+ * @return the cache, or NULL if it could not be allocated.
+ */
+static block_cache_t *block_CacheSelf (void)
+{
+    static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+    unsigned val = atomic_load_explicit (&block_cache_state,
+                                         memory_order_acquire);
+    block_cache_t *cache;
+
+    if (unlikely(val == 0))
+    {
+        vlc_mutex_lock (&lock);
+        val = atomic_load_explicit (&block_cache_state, memory_order_relaxed);
+        if (val == 0)
+        {
+            val = vlc_threadvar_create (&block_cache_key, block_CacheDestroy)
+                ? 2 : 1;
+            atomic_store_explicit (&block_cache_state, val,
+                                   memory_order_release);
+        }
+        vlc_mutex_unlock (&lock);
+    }
+    if (unlikely(val != 1))
+        return NULL;
+
+    cache = vlc_threadvar_get (block_cache_key);
+    if (unlikely(cache == NULL))
+    {
+        cache = calloc (1, sizeof (*cache));
+        if (cache != NULL && vlc_threadvar_set (block_cache_key, cache))
+        {
+            free (cache);
+            cache = NULL;
+        }
+    }
+    return cache;
+}
+
+static block_t *block_CacheGet (unsigned c)
+{
+    block_cache_t *cache = block_CacheSelf ();
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    if (cache->count[c] == 0)
+    {   /* Refill half of the cache from the depot */
+        vlc_mutex_lock (&block_depot.lock);
+        cache->count[c] = block_ListMove (&cache->list[c],
+                                          &block_depot.list[c],
+                                          block_CacheDepth (c) / 2);
+        block_depot.count[c] -= cache->count[c];
+        vlc_mutex_unlock (&block_depot.lock);
+
+        if (cache->count[c] == 0)
+        {
+            cache->misses++;
+            return NULL;
+        }
+    }
+
+    block_t *b = cache->list[c];
+    cache->list[c] = b->p_next;
+    cache->count[c]--;
+    cache->hits++;
+    return b;
+}
+
+static bool block_CachePut (block_t *b, unsigned c)
+{
+    block_cache_t *cache = block_CacheSelf ();
+    if (unlikely(cache == NULL))
+        return false;
+
+    if (cache->count[c] >= block_CacheDepth (c))
+    {   /* Flush half of the cache to the depot, if it has room */
+        unsigned n = cache->count[c] / 2;
+        block_t *garbage = NULL;
+
+        vlc_mutex_lock (&block_depot.lock);
+        if (block_depot.count[c] + n
+                     <= (unsigned)(BLOCK_DEPOT_SIZE >> (BLOCK_CLASS_MIN + c)))
+            block_depot.count[c] += block_ListMove (&block_depot.list[c],
+                                                    &cache->list[c], n);
+        else
+            block_ListMove (&garbage, &cache->list[c], n);
+        block_depot.hits += cache->hits;
+        block_depot.misses += cache->misses;
+        vlc_mutex_unlock (&block_depot.lock);
+
+        cache->count[c] -= n;
+        cache->hits = cache->misses = 0;
+
+        while (garbage != NULL)
+        {
+            block_t *next = garbage->p_next;
+
+            free (garbage);
+            garbage = next;
+        }
+    }
+
+    b->p_next = cache->list[c];
+    cache->list[c] = b;
+    cache->count[c]++;
+    return true;
+}
+
+/**
+ * Reports block allocation cache statistics.
+ * Counters of running threads are only accounted for periodically.
+ *
+ * @param hits number of allocations served from the cache [OUT]
+ * @param misses number of cacheable allocations that required malloc() [OUT]
+ */
+void block_CacheStats (uint64_t *restrict hits, uint64_t *restrict misses)
+{
+    vlc_mutex_lock (&block_depot.lock);
+    *hits = block_depot.hits;
+    *misses = block_depot.misses;
+    vlc_mutex_unlock (&block_depot.lock);
+}
+
+/**
+ * Frees the cached blocks of the global depot and of the calling thread.
+ * Other threads free their own cache when they exit. The cache is refilled
+ * on demand, so this is safe (only slower) if blocks are still allocated.
+ */
+void block_CacheCleanup (void)
+{
+    block_t *garbage = NULL;
+
+    /* The calling (e.g. main) thread may never run its cache destructor */
+    if (atomic_load_explicit (&block_cache_state, memory_order_acquire) == 1)
+    {
+        block_cache_t *cache = vlc_threadvar_get (block_cache_key);
+        if (cache != NULL)
+        {
+            vlc_threadvar_set (block_cache_key, NULL);
+            for (unsigned c = 0; c < BLOCK_CLASSES; c++)
+                block_ListMove (&garbage, &cache->list[c], UINT_MAX);
+            free (cache);
+        }
+    }
+
+    vlc_mutex_lock (&block_depot.lock);
+    for (unsigned c = 0; c < BLOCK_CLASSES; c++)
+    {
+        block_ListMove (&garbage, &block_depot.list[c], UINT_MAX);
+        block_depot.count[c] = 0;
+    }
+    vlc_mutex_unlock (&block_depot.lock);
+
+    while (garbage != NULL)
+    {
+        block_t *next = garbage->p_next;
+
+        free (garbage);
+        garbage = next;
+    }
+}
+
+static void block_generic_Release (block_t *block)
+{
+    /* That is always true for blocks allocated with block_Alloc(). */
+    assert (block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate (block);
+
+    /* Allocations in the cacheable range are always rounded to a class */
+    size_t alloc = sizeof (*block) + block->i_size;
+    unsigned c = block_SizeClass (alloc);
+
+    if (c < BLOCK_CLASSES && (((size_t)1) << (BLOCK_CLASS_MIN + c)) == alloc
+     && block_CachePut (block, c))
+        return;
+    free (block);
+}
+
+/**
+ * Computes the actual allocation size for a given block payload size.
+ * @return the size, or 0 on integer overflow
+ */
+static size_t block_AllocSize (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING) + size;
     if (unlikely(alloc <= size))
+        return 0;
+
+    unsigned c = block_SizeClass (alloc);
+    if (c < BLOCK_CLASSES)
+        alloc = ((size_t)1) << (BLOCK_CLASS_MIN + c);
+    return alloc;
+}
+
+block_t *block_Alloc (size_t size)
+{
+    const size_t alloc = block_AllocSize (size);
+    if (unlikely(alloc == 0))
         return NULL;
 
-    block_t *b = malloc (alloc);
+    block_t *b = NULL;
+    unsigned c = block_SizeClass (alloc);
+    if (c < BLOCK_CLASSES)
+        b = block_CacheGet (c);
+    if (b == NULL)
+        b = malloc (alloc);
     if (unlikely(b == NULL))
         return NULL;
 
@@ -227,7 +535,8 @@ block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
     else
     /* We have a very large reserved footer now? Release some of it.
      * XXX it might not preserve the alignment of p_buffer */
-    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE )
+    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE
+     && block_AllocSize( requested ) < sizeof (block_t) + p_block->i_size )
     {
         block_t *p_rea = block_Alloc( requested );
         if( p_rea )
@@ -520,6 +829,22 @@ struct block_fifo_t
     size_t              i_depth;
     size_t              i_size;
     bool          b_force_wake;
+
+    /* Lock-less single producer/single consumer mode (see block_FifoNewSPSC).
+     * In that mode, p_first/pp_last only hold the overflow list, used when
+     * the ring is full; the mutex protects it and the sleeping threads. */
+    block_t           **pp_ring;    /**< Ring buffer (NULL if locked mode) */
+    size_t              i_ring_mask;
+    atomic_size_t       i_ring_head; /**< Next slot to read */
+    atomic_size_t       i_ring_tail; /**< Next slot to write */
+    atomic_size_t       i_ring_depth;
+    atomic_size_t       i_ring_size;
+    atomic_bool         b_ring_overflow; /**< Overflow list is not empty */
+    atomic_bool         b_ring_wait;  /**< Reader is (about to be) sleeping */
+    atomic_bool         b_ring_wait_room; /**< Writer is (about to be) pacing */
+    atomic_size_t       i_ring_pace_depth; /**< Pacing target depth */
+    atomic_size_t       i_ring_pace_size; /**< Pacing target size */
+    atomic_bool         b_ring_wake;
 };
 
 block_fifo_t *block_FifoNew( void )
@@ -535,13 +860,159 @@ block_fifo_t *block_FifoNew( void )
     p_fifo->pp_last = &p_fifo->p_first;
     p_fifo->i_depth = p_fifo->i_size = 0;
     p_fifo->b_force_wake = false;
+    p_fifo->pp_ring = NULL;
+    p_fifo->i_ring_mask = 0;
 
     return p_fifo;
 }
 
+/**
+ * Creates a lock-less block queue for exactly one writing thread.
+ *
+ * block_FifoPut() and block_FifoPace() must always be called from the same
+ * thread. The other functions can be called from any thread, but
+ * block_FifoGet() and block_FifoShow() should only be used by one thread.
+ * Blocks are exchanged through a ring buffer without taking the queue lock
+ * nor signaling a condition variable, unless the other side is sleeping.
+ * If the ring is full, blocks are queued on a locked overflow list.
+ *
+ * @param i_ring ring size in blocks (rounded up to a power of two)
+ * @return a new FIFO, or NULL on error.
+ */
+block_fifo_t *block_FifoNewSPSC( size_t i_ring )
+{
+    block_fifo_t *p_fifo = block_FifoNew();
+    if( !p_fifo )
+        return NULL;
+
+    size_t i_slots = 16;
+    while( i_slots < i_ring && i_slots < (SIZE_MAX / (2 * sizeof (block_t *))) )
+        i_slots *= 2;
+
+    p_fifo->pp_ring = malloc( i_slots * sizeof (block_t *) );
+    if( unlikely(p_fifo->pp_ring == NULL) )
+    {
+        block_FifoRelease( p_fifo );
+        return NULL;
+    }
+    p_fifo->i_ring_mask = i_slots - 1;
+    atomic_init( &p_fifo->i_ring_head, 0 );
+    atomic_init( &p_fifo->i_ring_tail, 0 );
+    atomic_init( &p_fifo->i_ring_depth, 0 );
+    atomic_init( &p_fifo->i_ring_size, 0 );
+    atomic_init( &p_fifo->b_ring_overflow, false );
+    atomic_init( &p_fifo->b_ring_wait, false );
+    atomic_init( &p_fifo->b_ring_wait_room, false );
+    atomic_init( &p_fifo->i_ring_pace_depth, SIZE_MAX );
+    atomic_init( &p_fifo->i_ring_pace_size, SIZE_MAX );
+    atomic_init( &p_fifo->b_ring_wake, false );
+    return p_fifo;
+}
+
+/**
+ * Queues one block (with p_next == NULL) in a lock-less FIFO.
+ * Only called from the writing thread.
+ */
+static void block_RingPush( block_fifo_t *p_fifo, block_t *p_block )
+{
+    /* Account before publishing, so that the counters never underflow */
+    atomic_fetch_add( &p_fifo->i_ring_depth, 1 );
+    atomic_fetch_add( &p_fifo->i_ring_size, p_block->i_buffer );
+
+    size_t tail = atomic_load_explicit( &p_fifo->i_ring_tail,
+                                        memory_order_relaxed );
+    size_t head = atomic_load_explicit( &p_fifo->i_ring_head,
+                                        memory_order_acquire );
+
+    /* Only the writer sets the overflow flag, so reading it unlocked as
+     * false is reliable. Once the overflow list is in use, keep using it
+     * until the reader has drained it to preserve ordering. */
+    if( !atomic_load_explicit( &p_fifo->b_ring_overflow, memory_order_acquire )
+     && tail - head <= p_fifo->i_ring_mask )
+    {
+        p_fifo->pp_ring[tail & p_fifo->i_ring_mask] = p_block;
+        atomic_store_explicit( &p_fifo->i_ring_tail, tail + 1,
+                               memory_order_release );
+        return;
+    }
+
+    vlc_mutex_lock( &p_fifo->lock );
+    *p_fifo->pp_last = p_block;
+    p_fifo->pp_last = &p_block->p_next;
+    atomic_store( &p_fifo->b_ring_overflow, true );
+    vlc_mutex_unlock( &p_fifo->lock );
+}
+
+/**
+ * Dequeues the first block of a lock-less FIFO, if any.
+ * This never sleeps. It can safely race with block_FifoEmpty().
+ */
+static block_t *block_RingPop( block_fifo_t *p_fifo )
+{
+    block_t *b = NULL;
+    size_t head = atomic_load_explicit( &p_fifo->i_ring_head,
+                                        memory_order_acquire );
+
+    for( ;; )
+    {
+        size_t tail = atomic_load_explicit( &p_fifo->i_ring_tail,
+                                            memory_order_acquire );
+        if( head == tail )
+            break;
+
+        /* The slot cannot be overwritten before head moves past it */
+        block_t *p_slot = p_fifo->pp_ring[head & p_fifo->i_ring_mask];
+        if( atomic_compare_exchange_weak_explicit( &p_fifo->i_ring_head,
+                                                   &head, head + 1,
+                                                   memory_order_acq_rel,
+                                                   memory_order_acquire ) )
+        {
+            b = p_slot;
+            break;
+        }
+    }
+
+    if( b == NULL
+     && atomic_load_explicit( &p_fifo->b_ring_overflow, memory_order_acquire ) )
+    {
+        vlc_mutex_lock( &p_fifo->lock );
+        b = p_fifo->p_first;
+        if( b != NULL )
+        {
+            p_fifo->p_first = b->p_next;
+            if( p_fifo->p_first == NULL )
+            {
+                p_fifo->pp_last = &p_fifo->p_first;
+                atomic_store( &p_fifo->b_ring_overflow, false );
+            }
+        }
+        vlc_mutex_unlock( &p_fifo->lock );
+    }
+
+    if( b == NULL )
+        return NULL;
+
+    b->p_next = NULL;
+    size_t size = atomic_fetch_sub( &p_fifo->i_ring_size, b->i_buffer )
+                - b->i_buffer;
+    size_t depth = atomic_fetch_sub( &p_fifo->i_ring_depth, 1 ) - 1;
+
+    /* Wake the writer up only if it is pacing and can now proceed */
+    if( atomic_load( &p_fifo->b_ring_wait_room )
+     && depth <= atomic_load( &p_fifo->i_ring_pace_depth )
+     && size <= atomic_load( &p_fifo->i_ring_pace_size ) )
+    {
+        vlc_mutex_lock( &p_fifo->lock );
+        vlc_cond_broadcast( &p_fifo->wait_room );
+        vlc_mutex_unlock( &p_fifo->lock );
+    }
+    return b;
+}
+
 void block_FifoRelease( block_fifo_t *p_fifo )
 {
     block_FifoEmpty( p_fifo );
+    free( p_fifo->pp_ring );
     vlc_cond_destroy( &p_fifo->wait_room );
     vlc_cond_destroy( &p_fifo->wait );
     vlc_mutex_destroy( &p_fifo->lock );
@@ -552,6 +1023,17 @@ void block_FifoEmpty( block_fifo_t *p_fifo )
 {
     block_t *block;
 
+    if( p_fifo->pp_ring != NULL )
+    {
+        while( (block = block_RingPop( p_fifo )) != NULL )
+            block_Release( block );
+
+        vlc_mutex_lock( &p_fifo->lock );
+        vlc_cond_broadcast( &p_fifo->wait_room );
+        vlc_mutex_unlock( &p_fifo->lock );
+        return;
+    }
+
     vlc_mutex_lock( &p_fifo->lock );
     block = p_fifo->p_first;
     if (block != NULL)
@@ -594,6 +1076,29 @@ void block_FifoPace (block_fifo_t *fifo, size_t max_depth, size_t max_size)
 {
     vlc_testcancel ();
 
+    if (fifo->pp_ring != NULL)
+    {
+        if (atomic_load (&fifo->i_ring_depth) <= max_depth
+         && atomic_load (&fifo->i_ring_size) <= max_size)
+            return;
+
+        vlc_mutex_lock (&fifo->lock);
+        mutex_cleanup_push (&fifo->lock);
+        atomic_store (&fifo->i_ring_pace_depth, max_depth);
+        atomic_store (&fifo->i_ring_pace_size, max_size);
+        for (;;)
+        {
+            atomic_store (&fifo->b_ring_wait_room, true);
+            if (atomic_load (&fifo->i_ring_depth) <= max_depth
+             && atomic_load (&fifo->i_ring_size) <= max_size)
+                break;
+            vlc_cond_wait (&fifo->wait_room, &fifo->lock);
+        }
+        atomic_store (&fifo->b_ring_wait_room, false);
+        vlc_cleanup_run ();
+        return;
+    }
+
     vlc_mutex_lock (&fifo->lock);
     while ((fifo->i_depth > max_depth) || (fifo->i_size > max_size))
     {
@@ -617,6 +1122,30 @@ size_t block_FifoPut( block_fifo_t *p_fifo, block_t *p_block )
 
     if (p_block == NULL)
         return 0;
+
+    if (p_fifo->pp_ring != NULL)
+    {
+        do
+        {
+            block_t *p_next = p_block->p_next;
+
+            p_block->p_next = NULL;
+            i_size += p_block->i_buffer;
+            block_RingPush (p_fifo, p_block);
+            p_block = p_next;
+        }
+        while (p_block != NULL);
+
+        /* Sequentially consistent with the reader going to sleep */
+        if (atomic_load (&p_fifo->b_ring_wait))
+        {
+            vlc_mutex_lock (&p_fifo->lock);
+            vlc_cond_signal (&p_fifo->wait);
+            vlc_mutex_unlock (&p_fifo->lock);
+        }
+        return i_size;
+    }
+
     for (p_last = p_block; ; p_last = p_last->p_next)
     {
         i_size += p_last->i_buffer;
@@ -640,6 +1169,12 @@ size_t block_FifoPut( block_fifo_t *p_fifo, block_t *p_block )
 void block_FifoWake( block_fifo_t *p_fifo )
 {
     vlc_mutex_lock( &p_fifo->lock );
+    if( p_fifo->pp_ring != NULL )
+    {
+        if( atomic_load( &p_fifo->i_ring_depth ) == 0 )
+            atomic_store( &p_fifo->b_ring_wake, true );
+    }
+    else
     if( p_fifo->p_first == NULL )
         p_fifo->b_force_wake = true;
     vlc_cond_broadcast( &p_fifo->wait );
@@ -658,6 +1193,27 @@ block_t *block_FifoGet( block_fifo_t *p_fifo )
 
     vlc_testcancel( );
 
+    if( p_fifo->pp_ring != NULL )
+    {
+        while( (b = block_RingPop( p_fifo )) == NULL )
+        {
+            if( atomic_exchange( &p_fifo->b_ring_wake, false ) )
+                return NULL;
+
+            vlc_mutex_lock( &p_fifo->lock );
+            mutex_cleanup_push( &p_fifo->lock );
+            /* The writer checks b_ring_wait after updating the depth */
+            atomic_store( &p_fifo->b_ring_wait, true );
+            while( atomic_load( &p_fifo->i_ring_depth ) == 0
+                && !atomic_load( &p_fifo->b_ring_wake ) )
+                vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
+            atomic_store( &p_fifo->b_ring_wait, false );
+            vlc_cleanup_run( );
+        }
+        atomic_store( &p_fifo->b_ring_wake, false );
+        return b;
+    }
+
     vlc_mutex_lock( &p_fifo->lock );
     mutex_cleanup_push( &p_fifo->lock );
 
@@ -714,10 +1270,35 @@ block_t *block_FifoShow( block_fifo_t *p_fifo )
     vlc_mutex_lock( &p_fifo->lock );
     mutex_cleanup_push( &p_fifo->lock );
 
-    while( p_fifo->p_first == NULL )
-        vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
+    if( p_fifo->pp_ring != NULL )
+    {
+        for( ;; )
+        {
+            size_t head = atomic_load( &p_fifo->i_ring_head );
+
+            if( head != atomic_load( &p_fifo->i_ring_tail ) )
+            {
+                b = p_fifo->pp_ring[head & p_fifo->i_ring_mask];
+                break;
+            }
+            if( p_fifo->p_first != NULL )
+            {
+                b = p_fifo->p_first;
+                break;
+            }
+            atomic_store( &p_fifo->b_ring_wait, true );
+            if( atomic_load( &p_fifo->i_ring_depth ) == 0 )
+                vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
+            atomic_store( &p_fifo->b_ring_wait, false );
+        }
+    }
+    else
+    {
+        while( p_fifo->p_first == NULL )
+            vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
 
-    b = p_fifo->p_first;
+        b = p_fifo->p_first;
+    }
 
     vlc_cleanup_run ();
     return b;
@@ -728,6 +1309,9 @@ size_t block_FifoSize (block_fifo_t *fifo)
 {
     size_t size;
 
+    if (fifo->pp_ring != NULL)
+        return atomic_load (&fifo->i_ring_size);
+
     vlc_mutex_lock (&fifo->lock);
     size = fifo->i_size;
     vlc_mutex_unlock (&fifo->lock);
@@ -739,6 +1323,9 @@ size_t block_FifoCount (block_fifo_t *fifo)
 {
     size_t depth;
 
+    if (fifo->pp_ring != NULL)
+        return atomic_load (&fifo->i_ring_depth);
+
     vlc_mutex_lock (&fifo->lock);
     depth = fifo->i_depth;
     vlc_mutex_unlock (&fifo->lock);
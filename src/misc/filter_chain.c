@@ -27,6 +27,7 @@
 
 #include <vlc_filter.h>
 #include <vlc_modules.h>
+#include <vlc_slices.h>
 #include <vlc_spu.h>
 #include <libvlc.h>
 #include <assert.h>
@@ -39,6 +40,7 @@ typedef struct chained_filter_t
     struct chained_filter_t *prev, *next;
     vlc_mouse_t *mouse;
     picture_t *pending;
+    bool sliced; /**< Holds the slice threads */
 } chained_filter_t;
 
 /* Only use this with filter objects from _this_ C module */
@@ -236,6 +238,7 @@ filter_t *filter_chain_AppendFilter( filter_chain_t *chain, const char *name,
         vlc_mouse_Init( mouse );
     chained->mouse = mouse;
     chained->pending = NULL;
+    chained->sliced = false;
 
     msg_Dbg( parent, "Filter '%s' (%p) appended to chain",
              (name != NULL) ? name : module_get_name(filter->p_module, false),
@@ -280,6 +283,8 @@ void filter_chain_DeleteFilter( filter_chain_t *chain, filter_t *filter )
     chain->length--;
 
     module_unneed( filter, filter->p_module );
+    if( chained->sliced )
+        vlc_slices_release();
 
     msg_Dbg( obj, "Filter %p removed from chain", filter );
     FilterDeletePictures( chained->pending );
@@ -366,12 +371,115 @@ const es_format_t *filter_chain_GetFmtOut( filter_chain_t *p_chain )
     return &p_chain->fmt_out;
 }
 
+/**
+ * Band processing
+ *
+ * Filters providing pf_video_slice are run on horizontal bands of the
+ * picture by the worker threads shared by the process (see vlc_slices.h),
+ * the calling thread processing bands too. The threads are held by the
+ * first such filter fed a large enough picture, until it is deleted.
+ */
+#define SLICE_ALIGN     16  /* lines, so that subsampled planes split evenly */
+#define SLICE_MIN_LINES 256 /* below this, threading costs more than it saves */
+
+typedef struct
+{
+    filter_t *filter;
+    picture_t *in, *out;
+    const void *data; /**< From pf_video_slice_prepare */
+} slice_job_t;
+
+/** Makes a view of the lines [y0, y1[ of the first plane, and of the
+ * matching lines of the other planes. */
+static void SliceView( picture_t *view, const picture_t *pic,
+                       int y0, int y1 )
+{
+    const int lines = pic->p[0].i_lines;
+    const bool last = y1 >= pic->p[0].i_visible_lines;
+
+    *view = *pic;
+    for( int i = 0; i < pic->i_planes; i++ )
+    {
+        plane_t *p = &view->p[i];
+        const int first = y0 * p->i_lines / lines;
+        const int end = last ? p->i_visible_lines : y1 * p->i_lines / lines;
+
+        p->p_pixels += first * p->i_pitch;
+        p->i_lines -= first;
+        p->i_visible_lines = end - first;
+    }
+    view->format.i_height -= y0;
+    view->format.i_visible_height = view->p[0].i_visible_lines;
+    view->p_next = NULL;
+}
+
+/** Processes band i out of n */
+static void SliceRun( void *data, unsigned i, unsigned n )
+{
+    const slice_job_t *job = data;
+    const int height = job->in->p[0].i_visible_lines;
+    const int step = ((height + n - 1) / n + SLICE_ALIGN - 1)
+                     & ~(SLICE_ALIGN - 1);
+    const int y0 = __MIN(height, (int)i * step);
+    const int y1 = __MIN(height, y0 + step);
+    picture_t view_in, view_out;
+
+    if( y0 >= y1 )
+        return;
+    SliceView( &view_in, job->in, y0, y1 );
+    SliceView( &view_out, job->out, y0, y1 );
+    job->filter->pf_video_slice( job->filter, &view_in, &view_out,
+                                 job->data );
+}
+
+static picture_t *FilterSlices( chained_filter_t *f, picture_t *p_pic )
+{
+    filter_t *p_filter = &f->filter;
+    picture_t *p_outpic = filter_NewPicture( p_filter );
+    if( p_outpic == NULL )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    /* Once per picture, so that all the bands use the same parameters */
+    const void *data = NULL;
+    if( p_filter->pf_video_slice_prepare != NULL )
+        data = p_filter->pf_video_slice_prepare( p_filter, p_pic );
+
+    if( p_outpic->i_planes == p_pic->i_planes
+     && p_outpic->p[0].i_visible_lines == p_pic->p[0].i_visible_lines )
+    {
+        slice_job_t job = {
+            .filter = p_filter, .in = p_pic, .out = p_outpic, .data = data,
+        };
+
+        if( !f->sliced )
+        {
+            vlc_slices_hold();
+            f->sliced = true;
+        }
+        vlc_slices_run( SliceRun, &job,
+                        p_pic->p[0].i_visible_lines / SLICE_ALIGN );
+    }
+    else
+        p_filter->pf_video_slice( p_filter, p_pic, p_outpic, data );
+
+    picture_CopyProperties( p_outpic, p_pic );
+    picture_Release( p_pic );
+    return p_outpic;
+}
+
 static picture_t *FilterChainVideoFilter( chained_filter_t *f, picture_t *p_pic )
 {
     for( ; f != NULL; f = f->next )
     {
         filter_t *p_filter = &f->filter;
-        p_pic = p_filter->pf_video_filter( p_filter, p_pic );
+        if( p_filter->pf_video_slice != NULL
+         && p_pic->p[0].i_visible_lines >= SLICE_MIN_LINES )
+            p_pic = FilterSlices( f, p_pic );
+        else
+            p_pic = p_filter->pf_video_filter( p_filter, p_pic );
         if( !p_pic )
             break;
         if( f->pending )
@@ -0,0 +1,151 @@
+/*****************************************************************************
+ * slices.c : band processing on worker threads
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include <vlc_slices.h>
+
+/* One pool for the whole process: the users run at the same time (filter
+ * chains, deinterlacers...), so private pools would oversubscribe the CPUs */
+#define SLICES_MAX 16
+
+static struct
+{
+    vlc_mutex_t lock; /**< Serializes starting and stopping the threads */
+    unsigned users;
+    unsigned count;
+    vlc_thread_t threads[SLICES_MAX - 1];
+
+    vlc_mutex_t job_lock;
+    vlc_cond_t wait; /**< Signals a new job (or exit) to the threads */
+    vlc_cond_t done; /**< Signals the last band of the job to the caller */
+    vlc_slice_cb cb; /**< Current job, NULL if none */
+    void *data;
+    unsigned slices, next, pending;
+    bool exit;
+} workers = {
+    .lock = VLC_STATIC_MUTEX,
+    .job_lock = VLC_STATIC_MUTEX,
+    .wait = VLC_STATIC_COND,
+    .done = VLC_STATIC_COND,
+};
+
+static void *SliceThread( void *data )
+{
+    (void) data;
+    vlc_mutex_lock( &workers.job_lock );
+    for( ;; )
+    {
+        while( !workers.exit
+            && (workers.cb == NULL || workers.next >= workers.slices) )
+            vlc_cond_wait( &workers.wait, &workers.job_lock );
+        if( workers.exit )
+            break;
+
+        vlc_slice_cb cb = workers.cb;
+        void *job = workers.data;
+        unsigned i = workers.next++, n = workers.slices;
+
+        vlc_mutex_unlock( &workers.job_lock );
+        cb( job, i, n );
+        vlc_mutex_lock( &workers.job_lock );
+
+        if( --workers.pending == 0 )
+            vlc_cond_signal( &workers.done );
+    }
+    vlc_mutex_unlock( &workers.job_lock );
+    return NULL;
+}
+
+void vlc_slices_hold( void )
+{
+    vlc_mutex_lock( &workers.lock );
+    if( workers.users++ == 0 )
+    {
+        unsigned count = __MIN(vlc_GetCPUCount(), SLICES_MAX) - 1;
+
+        workers.exit = false;
+        for( workers.count = 0; workers.count < count; workers.count++ )
+            if( vlc_clone( &workers.threads[workers.count], SliceThread, NULL,
+                           VLC_THREAD_PRIORITY_VIDEO ) )
+                break;
+    }
+    vlc_mutex_unlock( &workers.lock );
+}
+
+void vlc_slices_release( void )
+{
+    vlc_mutex_lock( &workers.lock );
+    assert( workers.users > 0 );
+    if( --workers.users == 0 )
+    {
+        vlc_mutex_lock( &workers.job_lock );
+        workers.exit = true;
+        vlc_cond_broadcast( &workers.wait );
+        vlc_mutex_unlock( &workers.job_lock );
+
+        for( unsigned i = 0; i < workers.count; i++ )
+            vlc_join( workers.threads[i], NULL );
+        workers.count = 0;
+    }
+    vlc_mutex_unlock( &workers.lock );
+}
+
+void vlc_slices_run( vlc_slice_cb cb, void *data, unsigned max )
+{
+    vlc_mutex_lock( &workers.job_lock );
+    const unsigned slices = __MIN(workers.count + 1, max);
+
+    /* If the threads are busy with another job, do not wait for them */
+    if( slices <= 1 || workers.cb != NULL )
+    {
+        vlc_mutex_unlock( &workers.job_lock );
+        cb( data, 0, 1 );
+        return;
+    }
+
+    workers.cb = cb;
+    workers.data = data;
+    workers.slices = slices;
+    workers.next = 0;
+    workers.pending = slices;
+    vlc_cond_broadcast( &workers.wait );
+
+    /* Take bands too, rather than waiting */
+    while( workers.next < slices )
+    {
+        unsigned i = workers.next++;
+
+        vlc_mutex_unlock( &workers.job_lock );
+        cb( data, i, slices );
+        vlc_mutex_lock( &workers.job_lock );
+        workers.pending--;
+    }
+    while( workers.pending > 0 )
+        vlc_cond_wait( &workers.done, &workers.job_lock );
+    workers.cb = NULL;
+    vlc_mutex_unlock( &workers.job_lock );
+}
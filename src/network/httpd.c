@@ -40,6 +40,7 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "../libvlc.h"
 
 #include <string.h>
@@ -49,6 +50,9 @@
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -63,10 +67,43 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* Stream data shared by all the clients of a stream */
+typedef struct
+{
+    atomic_uint refs;
+    int64_t     i_pos;      /* absolute position of the first byte */
+    block_t    *p_block;
+} httpd_segment_t;
+
+/* Maximum number of segments sent at once to a client */
+#define HTTPD_CL_SEGMENTS 16
+
 static void httpd_ClientClean(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
+static void httpd_SegmentRelease(httpd_segment_t *);
+
+/* A worker thread serves a share of the clients of a host */
+typedef struct
+{
+    httpd_host_t *host;
+    vlc_thread_t thread;
+
+    /* protects the clients of this worker, and their state */
+    vlc_mutex_t  lock;
+    int            i_client;
+    httpd_client_t **client;
+    unsigned       i_waiting;   /* clients waiting for stream data */
+    mtime_t        i_sweep;     /* next check of timeouts and waiting clients */
 
-/* each host run in his own thread */
+#ifdef HAVE_SYS_EPOLL_H
+    int            epfd;
+#else
+    struct pollfd  *ufd;
+    httpd_client_t **ufd_client;
+    unsigned       i_ufd;
+#endif
+} httpd_worker_t;
+
+/* each host runs in its own pool of worker threads */
 struct httpd_host_t
 {
     VLC_COMMON_MEMBERS
@@ -79,7 +116,11 @@ struct httpd_host_t
     unsigned     nfd;
     unsigned     port;
 
-    vlc_thread_t thread;
+    httpd_worker_t *worker;
+    unsigned     i_worker;
+    unsigned     i_next_worker; /* where to put the next client */
+
+    /* protects the URLs and the reference count */
     vlc_mutex_t lock;
     vlc_cond_t  wait;
 
@@ -90,9 +131,6 @@ struct httpd_host_t
     int         i_url;
     httpd_url_t **url;
 
-    int            i_client;
-    httpd_client_t **client;
-
     /* TLS data */
     vlc_tls_creds_t *p_tls;
 };
@@ -142,6 +180,7 @@ enum
 struct httpd_client_t
 {
     httpd_url_t *url;
+    httpd_worker_t *worker;
 
     int     i_ref;
 
@@ -149,6 +188,7 @@ struct httpd_client_t
 
     bool    b_stream_mode;
     uint8_t i_state;
+    short   i_events;       /* poll events waited for on the socket */
 
     mtime_t i_activity_date;
     mtime_t i_activity_timeout;
@@ -165,6 +205,11 @@ struct httpd_client_t
      */
     int64_t i_keyframe_wait_to_pass;
 
+    /* Stream segments being sent without copy, instead of the buffer.
+     * i_buffer is then the offset in the first one. */
+    httpd_segment_t *segment[HTTPD_CL_SEGMENTS];
+    unsigned i_segment;
+
     /* */
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
@@ -611,9 +656,15 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* ring of the last segments, in order, shared with the clients */
+    httpd_segment_t **pp_segments;
+    unsigned    i_segments_max;     /* allocated entries */
+    unsigned    i_segment_first;    /* entry of the oldest segment */
+    unsigned    i_segments;
+    size_t      i_segments_size;    /* bytes in the ring */
+
+    size_t      i_buffer_size;      /* bytes to keep in the ring */
+    size_t      i_instant_start;    /* bytes to keep for the last GOP */
     int64_t     i_buffer_pos;       /* absolute position from begining */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
@@ -622,6 +673,56 @@ struct httpd_stream_t
     httpd_header * p_http_headers;
 };
 
+static void httpd_SegmentRelease(httpd_segment_t *segment)
+{
+    if (atomic_fetch_sub(&segment->refs, 1) == 1) {
+        block_Release(segment->p_block);
+        free(segment);
+    }
+}
+
+static httpd_segment_t *httpd_StreamSegment(const httpd_stream_t *stream,
+                                            unsigned i)
+{
+    return stream->pp_segments[(stream->i_segment_first + i)
+                               % stream->i_segments_max];
+}
+
+/* Returns the segment holding the given position, -1 if none */
+static int httpd_StreamFind(const httpd_stream_t *stream, int64_t i_pos)
+{
+    unsigned i_low = 0, i_high = stream->i_segments;
+
+    while (i_low < i_high) {
+        unsigned i_mid = (i_low + i_high) / 2;
+
+        if (httpd_StreamSegment(stream, i_mid)->i_pos <= i_pos)
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+
+    if (i_low == 0)
+        return -1;
+
+    const httpd_segment_t *segment = httpd_StreamSegment(stream, i_low - 1);
+    if (i_pos >= segment->i_pos + (int64_t)segment->p_block->i_buffer)
+        return -1;
+    return i_low - 1;
+}
+
+/* Returns the last keyframe if new clients can start from it, -1 if not.
+ * Clients start live if the last group of pictures exceeds the limit. */
+static int64_t httpd_StreamInstantStart(const httpd_stream_t *stream)
+{
+    if (stream->i_instant_start == 0 || !stream->b_has_keyframes
+     || stream->i_buffer_pos - stream->i_last_keyframe_seen_pos
+                                      > (int64_t)stream->i_instant_start
+     || httpd_StreamFind(stream, stream->i_last_keyframe_seen_pos) < 0)
+        return -1;
+    return stream->i_last_keyframe_seen_pos;
+}
+
 static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query)
@@ -632,47 +733,58 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
+        assert(cl->i_segment == 0);
 
+        vlc_mutex_lock(&stream->lock);
         if (answer->i_body_offset >= stream->i_buffer_pos)
-            return VLC_EGENERIC;    /* wait, no data available */
+            goto wait;    /* wait, no data available */
 
         if (cl->i_keyframe_wait_to_pass >= 0) {
             if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
                 /* still waiting for the next keyframe */
-                return VLC_EGENERIC;
+                goto wait;
 
             /* seek to the new keyframe */
             answer->i_body_offset = stream->i_last_keyframe_seen_pos;
             cl->i_keyframe_wait_to_pass = -1;
         }
 
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
-            answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
+        int i = httpd_StreamFind(stream, answer->i_body_offset);
+        if (i < 0) {
+            /* this client isn't fast enough */
+            int64_t i_keyframe = httpd_StreamInstantStart(stream);
 
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
+            answer->i_body_offset = (i_keyframe >= 0) ? i_keyframe
+                                                      : stream->i_buffer_last_pos;
+            i = httpd_StreamFind(stream, answer->i_body_offset);
+            if (i < 0)
+                goto wait;
+        }
 
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
+        /* Reference the segments to send, rather than copying them */
+        int64_t i_start = answer->i_body_offset;
 
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
+        cl->i_buffer = i_start - httpd_StreamSegment(stream, i)->i_pos;
+        while ((unsigned)i < stream->i_segments
+            && cl->i_segment < HTTPD_CL_SEGMENTS
+            && answer->i_body_offset - i_start < HTTPD_CL_BUFSIZE) {
+            httpd_segment_t *segment = httpd_StreamSegment(stream, i++);
+
+            atomic_fetch_add(&segment->refs, 1);
+            cl->segment[cl->i_segment++] = segment;
+            answer->i_body_offset = segment->i_pos + segment->p_block->i_buffer;
+        }
+        vlc_mutex_unlock(&stream->lock);
 
         /* using HTTPD_MSG_ANSWER -> data available */
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
         answer->i_type   = HTTPD_MSG_ANSWER;
 
-        answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
-
-        answer->i_body_offset += i_write;
-
         return VLC_SUCCESS;
+wait:
+        vlc_mutex_unlock(&stream->lock);
+        return VLC_EGENERIC;
     } else {
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
@@ -706,7 +818,11 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
                 memcpy(answer->p_body, stream->p_header, stream->i_header);
             }
             answer->i_body_offset = stream->i_buffer_last_pos;
-            if (stream->b_has_keyframes)
+            if (httpd_StreamInstantStart(stream) >= 0) {
+                /* send the last group of pictures at once */
+                answer->i_body_offset = stream->i_last_keyframe_seen_pos;
+                cl->i_keyframe_wait_to_pass = -1;
+            } else if (stream->b_has_keyframes)
                 cl->i_keyframe_wait_to_pass = stream->i_last_keyframe_seen_pos;
             else
                 cl->i_keyframe_wait_to_pass = -1;
@@ -765,8 +881,13 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
 
     stream->i_header = 0;
     stream->p_header = NULL;
+    stream->pp_segments = NULL;
+    stream->i_segments_max = 0;
+    stream->i_segment_first = 0;
+    stream->i_segments = 0;
+    stream->i_segments_size = 0;
     stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->i_instant_start = 0;
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
@@ -802,29 +923,70 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
+static void httpd_StreamPush(httpd_stream_t *stream, httpd_segment_t *segment)
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
+    if (stream->i_segments >= stream->i_segments_max) {
+        unsigned i_max = __MAX(64, 2 * stream->i_segments_max);
+        httpd_segment_t **pp = xmalloc(i_max * sizeof(*pp));
+
+        for (unsigned i = 0; i < stream->i_segments; i++)
+            pp[i] = httpd_StreamSegment(stream, i);
+        free(stream->pp_segments);
+        stream->pp_segments = pp;
+        stream->i_segments_max = i_max;
+        stream->i_segment_first = 0;
+    }
 
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
+    stream->pp_segments[(stream->i_segment_first + stream->i_segments)
+                        % stream->i_segments_max] = segment;
+    stream->i_segments++;
+    stream->i_segments_size += segment->p_block->i_buffer;
 
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+    /* Forget the oldest segments. Clients still sending them keep them.
+     * The last group of pictures is kept for instant start, if it fits. */
+    while (stream->i_segments > 1
+        && stream->i_segments_size > stream->i_buffer_size) {
+        httpd_segment_t *oldest = httpd_StreamSegment(stream, 0);
+
+        if (stream->b_has_keyframes
+         && oldest->i_pos >= stream->i_last_keyframe_seen_pos
+         && stream->i_segments_size <= stream->i_instant_start)
+            break;
+
+        stream->i_segment_first = (stream->i_segment_first + 1)
+                                  % stream->i_segments_max;
+        stream->i_segments--;
+        stream->i_segments_size -= oldest->p_block->i_buffer;
+        httpd_SegmentRelease(oldest);
     }
+}
 
-    stream->i_buffer_pos += i_data;
+int httpd_StreamSetInstantStart(httpd_stream_t *stream, size_t i_max)
+{
+    vlc_mutex_lock(&stream->lock);
+    stream->i_instant_start = i_max;
+    vlc_mutex_unlock(&stream->lock);
+    return VLC_SUCCESS;
 }
 
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    if (!p_block || !p_block->p_buffer)
+    if (!p_block || !p_block->p_buffer || p_block->i_buffer == 0)
         return VLC_SUCCESS;
 
+    /* This is the only copy of the data, whatever the number of clients */
+    httpd_segment_t *segment = malloc(sizeof(*segment));
+    if (unlikely(segment == NULL))
+        return VLC_ENOMEM;
+
+    segment->p_block = block_Alloc(p_block->i_buffer);
+    if (unlikely(segment->p_block == NULL)) {
+        free(segment);
+        return VLC_ENOMEM;
+    }
+    memcpy(segment->p_block->p_buffer, p_block->p_buffer, p_block->i_buffer);
+    atomic_init(&segment->refs, 1);
+
     vlc_mutex_lock(&stream->lock);
 
     /* save this pointer (to be used by new connection) */
@@ -835,7 +997,9 @@ int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
         stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    segment->i_pos = stream->i_buffer_pos;
+    stream->i_buffer_pos += p_block->i_buffer;
+    httpd_StreamPush(stream, segment);
 
     vlc_mutex_unlock(&stream->lock);
     return VLC_SUCCESS;
@@ -849,17 +1013,20 @@ void httpd_StreamDelete(httpd_stream_t *stream)
         free(stream->p_http_headers[i].value);
     }
     free(stream->p_http_headers);
+    for (unsigned i = 0; i < stream->i_segments; i++)
+        httpd_SegmentRelease(httpd_StreamSegment(stream, i));
+    free(stream->pp_segments);
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
     free(stream);
 }
 
 /*****************************************************************************
  * Low level
  *****************************************************************************/
-static void* httpd_HostThread(void *);
+static int httpd_WorkersStart(httpd_host_t *);
+static void httpd_WorkersStop(httpd_host_t *);
 static httpd_host_t *httpd_HostCreate(vlc_object_t *, const char *,
                                        const char *, vlc_tls_creds_t *);
 
@@ -975,16 +1142,15 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     host->port     = port;
     host->i_url    = 0;
     host->url      = NULL;
-    host->i_client = 0;
-    host->client   = NULL;
+    host->i_next_worker = 0;
     host->p_tls    = p_tls;
 
-    /* create the thread */
-    if (vlc_clone(&host->thread, httpd_HostThread, host,
-                   VLC_THREAD_PRIORITY_LOW)) {
-        msg_Err(p_this, "cannot spawn http host thread");
+    /* create the threads */
+    if (httpd_WorkersStart(host)) {
+        msg_Err(p_this, "cannot spawn http host threads");
         goto error;
     }
+    msg_Dbg(host, "HTTP host served by %u thread(s)", host->i_worker);
 
     /* now add it to httpd */
     TAB_APPEND(httpd.i_host, httpd.host, host);
@@ -1029,24 +1195,13 @@ void httpd_HostDelete(httpd_host_t *host)
     }
     TAB_REMOVE(httpd.i_host, httpd.host, host);
 
-    vlc_cancel(host->thread);
-    vlc_join(host->thread, NULL);
+    httpd_WorkersStop(host);
 
     msg_Dbg(host, "HTTP host removed");
 
     for (int i = 0; i < host->i_url; i++)
         msg_Err(host, "url still registered: %s", host->url[i]->psz_url);
 
-    for (int i = 0; i < host->i_client; i++) {
-        httpd_client_t *cl = host->client[i];
-        msg_Warn(host, "client still connected");
-        httpd_ClientClean(cl);
-        TAB_REMOVE(host->i_client, host->client, cl);
-        free(cl);
-        i--;
-        /* TODO */
-    }
-
     vlc_tls_Delete(host->p_tls);
     net_ListenClose(host->fds);
     vlc_cond_destroy(&host->wait);
@@ -1084,7 +1239,7 @@ httpd_url_t *httpd_UrlNew(httpd_host_t *host, const char *psz_url,
     }
 
     TAB_APPEND(host->i_url, host->url, url);
-    vlc_cond_signal(&host->wait);
+    vlc_cond_broadcast(&host->wait); /* wake up every worker */
     vlc_mutex_unlock(&host->lock);
 
     return url;
@@ -1109,27 +1264,34 @@ void httpd_UrlDelete(httpd_url_t *url)
 
     vlc_mutex_lock(&host->lock);
     TAB_REMOVE(host->i_url, host->url, url);
+    vlc_mutex_unlock(&host->lock);
 
-    vlc_mutex_destroy(&url->lock);
-    free(url->psz_url);
-    free(url->psz_user);
-    free(url->psz_password);
+    /* New requests cannot reach the url anymore. Clients are only freed by
+     * their worker thread, which may hold events for them: shut them down. */
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *worker = &host->worker[i];
 
-    for (int i = 0; i < host->i_client; i++) {
-        httpd_client_t *client = host->client[i];
+        vlc_mutex_lock(&worker->lock);
+        for (int j = 0; j < worker->i_client; j++) {
+            httpd_client_t *client = worker->client[j];
 
-        if (client->url != url)
-            continue;
+            if (client->url != url)
+                continue;
 
-        /* TODO complete it */
-        msg_Warn(host, "force closing connections");
-        httpd_ClientClean(client);
-        TAB_REMOVE(host->i_client, host->client, client);
-        free(client);
-        i--;
+            /* TODO complete it */
+            msg_Warn(host, "force closing connections");
+            shutdown(client->fd, SHUT_RDWR);
+            client->url = NULL;
+            client->i_state = HTTPD_CLIENT_DEAD;
+        }
+        vlc_mutex_unlock(&worker->lock);
     }
+
+    vlc_mutex_destroy(&url->lock);
+    free(url->psz_url);
+    free(url->psz_user);
+    free(url->psz_password);
     free(url);
-    vlc_mutex_unlock(&host->lock);
 }
 
 static void httpd_MsgInit(httpd_message_t *msg)
@@ -1210,6 +1372,7 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->i_buffer = 0;
     cl->p_buffer = xmalloc(cl->i_buffer_size);
     cl->i_keyframe_wait_to_pass = -1;
+    cl->i_segment = 0;
     cl->b_stream_mode = false;
 
     httpd_MsgInit(&cl->query);
@@ -1238,6 +1401,10 @@ static void httpd_ClientClean(httpd_client_t *cl)
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
 
+    for (unsigned i = 0; i < cl->i_segment; i++)
+        httpd_SegmentRelease(cl->segment[i]);
+    cl->i_segment = 0;
+
     free(cl->p_buffer);
     cl->p_buffer = NULL;
 }
@@ -1251,6 +1418,8 @@ static httpd_client_t *httpd_ClientNew(int fd, vlc_tls_t *p_tls, mtime_t now)
     cl->i_ref   = 0;
     cl->fd      = fd;
     cl->url     = NULL;
+    cl->worker  = NULL;
+    cl->i_events = 0;
     cl->p_tls = p_tls;
 
     httpd_ClientInit(cl, now);
@@ -1592,10 +1761,99 @@ static void httpd_ClientRecv(httpd_client_t *cl)
         cl->i_activity_timeout = 0;
 }
 
+/* Everything queued was sent: get more body data, or finish */
+static void httpd_ClientSendNext(httpd_client_t *cl)
+{
+    if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
+        /* catch more body data */
+        int     i_msg = cl->query.i_type;
+        int64_t i_offset = cl->answer.i_body_offset;
+
+        httpd_MsgClean(&cl->answer);
+        cl->answer.i_body_offset = i_offset;
+
+        cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                                  &cl->answer, &cl->query);
+    }
+
+    if (cl->answer.i_body > 0) {
+        /* send the body data */
+        free(cl->p_buffer);
+        cl->p_buffer = cl->answer.p_body;
+        cl->i_buffer_size = cl->answer.i_body;
+        cl->i_buffer = 0;
+
+        cl->answer.i_body = 0;
+        cl->answer.p_body = NULL;
+    } else if (cl->i_segment == 0) /* send finished */
+        cl->i_state = HTTPD_CLIENT_SEND_DONE;
+}
+
+/* Sends stream segments straight from the memory shared by all clients */
+static ssize_t httpd_ClientSendSegments(httpd_client_t *cl)
+{
+    ssize_t i_len;
+
+#ifndef _WIN32
+    if (cl->p_tls == NULL) {
+        struct iovec iov[HTTPD_CL_SEGMENTS];
+        struct msghdr msg = {
+            .msg_iov = iov,
+            .msg_iovlen = cl->i_segment,
+        };
+
+        for (unsigned i = 0; i < cl->i_segment; i++) {
+            iov[i].iov_base = cl->segment[i]->p_block->p_buffer;
+            iov[i].iov_len = cl->segment[i]->p_block->i_buffer;
+        }
+        iov[0].iov_base = (uint8_t *)iov[0].iov_base + cl->i_buffer;
+        iov[0].iov_len -= cl->i_buffer;
+
+        do
+            i_len = sendmsg(cl->fd, &msg, 0);
+        while (i_len == -1 && errno == EINTR);
+    } else
+#endif
+    {
+        /* one segment at a time */
+        const block_t *p_block = cl->segment[0]->p_block;
+
+        i_len = httpd_NetSend(cl, p_block->p_buffer + cl->i_buffer,
+                              p_block->i_buffer - cl->i_buffer);
+    }
+
+    /* Release what was fully sent */
+    for (size_t i_sent = (i_len > 0) ? i_len : 0; cl->i_segment > 0;) {
+        size_t i_left = cl->segment[0]->p_block->i_buffer - cl->i_buffer;
+
+        if (i_sent < i_left) {
+            cl->i_buffer += i_sent;
+            break;
+        }
+        i_sent -= i_left;
+        cl->i_buffer = 0;
+        httpd_SegmentRelease(cl->segment[0]);
+        cl->i_segment--;
+        memmove(&cl->segment[0], &cl->segment[1],
+                cl->i_segment * sizeof(cl->segment[0]));
+    }
+    return i_len;
+}
+
 static void httpd_ClientSend(httpd_client_t *cl)
 {
     int i_len;
 
+    if (cl->i_segment > 0) {
+        i_len = httpd_ClientSendSegments(cl);
+        if (i_len >= 0) {
+            if (cl->i_segment == 0)
+                httpd_ClientSendNext(cl);
+            return;
+        }
+        goto error;
+    }
+
     if (cl->i_buffer < 0) {
         /* We need to create the header */
         int i_size = 0;
@@ -1632,41 +1890,20 @@ static void httpd_ClientSend(httpd_client_t *cl)
     if (i_len >= 0) {
         cl->i_buffer += i_len;
 
-        if (cl->i_buffer >= cl->i_buffer_size) {
-            if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
-                /* catch more body data */
-                int     i_msg = cl->query.i_type;
-                int64_t i_offset = cl->answer.i_body_offset;
-
-                httpd_MsgClean(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
-
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                                          &cl->answer, &cl->query);
-            }
-
-            if (cl->answer.i_body > 0) {
-                /* send the body data */
-                free(cl->p_buffer);
-                cl->p_buffer = cl->answer.p_body;
-                cl->i_buffer_size = cl->answer.i_body;
-                cl->i_buffer = 0;
+        if (cl->i_buffer >= cl->i_buffer_size)
+            httpd_ClientSendNext(cl);
+        return;
+    }
 
-                cl->answer.i_body = 0;
-                cl->answer.p_body = NULL;
-            } else /* send finished */
-                cl->i_state = HTTPD_CLIENT_SEND_DONE;
-        }
-    } else {
+error:
 #if defined(_WIN32)
-        if ((i_len < 0 && WSAGetLastError() != WSAEWOULDBLOCK) || (i_len == 0))
+    if ((i_len < 0 && WSAGetLastError() != WSAEWOULDBLOCK) || (i_len == 0))
 #else
-        if ((i_len < 0 && errno != EAGAIN) || (i_len == 0))
+    if ((i_len < 0 && errno != EAGAIN) || (i_len == 0))
 #endif
-        {
-            /* error */
-            cl->i_state = HTTPD_CLIENT_DEAD;
-        }
+    {
+        /* error */
+        cl->i_state = HTTPD_CLIENT_DEAD;
     }
 }
 
@@ -1721,362 +1958,624 @@ auth_failed:
     return false;
 }
 
-static void httpdLoop(httpd_host_t *host)
+/* Handles what does not depend on the network: requests received, answers
+ * sent and stream data to wait for */
+static void httpd_ClientProcess(httpd_host_t *host, httpd_client_t *cl)
 {
-    struct pollfd ufd[host->nfd + host->i_client];
-    unsigned nfd;
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        ufd[nfd].fd = host->fds[nfd];
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
-    }
-
-    /* add all socket that should be read/write and close dead connection */
-    while (host->i_url <= 0) {
-        mutex_cleanup_push(&host->lock);
-        vlc_cond_wait(&host->wait, &host->lock);
-        vlc_cleanup_pop();
-    }
-
-    mtime_t now = mdate();
-    bool b_low_delay = false;
-
-    int canc = vlc_savecancel();
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        int64_t i_offset;
-        httpd_client_t *cl = host->client[i_client];
-        if (cl->i_ref < 0 || (cl->i_ref == 0 &&
-                    (cl->i_state == HTTPD_CLIENT_DEAD ||
-                      (cl->i_activity_timeout > 0 &&
-                        cl->i_activity_date+cl->i_activity_timeout < now)))) {
-            httpd_ClientClean(cl);
-            TAB_REMOVE(host->i_client, host->client, cl);
-            free(cl);
-            i_client--;
-            continue;
-        }
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVE_DONE: {
+            httpd_message_t *answer = &cl->answer;
+            httpd_message_t *query  = &cl->query;
+
+            httpd_MsgInit(answer);
+
+            /* Handle what we received */
+            switch (query->i_type) {
+                case HTTPD_MSG_ANSWER:
+                    cl->url     = NULL;
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    break;
+
+                case HTTPD_MSG_OPTIONS:
+                    answer->i_type   = HTTPD_MSG_ANSWER;
+                    answer->i_proto  = query->i_proto;
+                    answer->i_status = 200;
+                    answer->i_body = 0;
+                    answer->p_body = NULL;
+
+                    httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
+                    httpd_MsgAdd(answer, "Content-Length", "0");
+
+                    switch(query->i_proto) {
+                    case HTTPD_PROTO_HTTP:
+                        answer->i_version = 1;
+                        httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
+                        break;
 
-        struct pollfd *pufd = ufd + nfd;
-        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
+                    case HTTPD_PROTO_RTSP:
+                        answer->i_version = 0;
 
-        pufd->fd = cl->fd;
-        pufd->events = pufd->revents = 0;
+                        const char *p = httpd_MsgGet(query, "Cseq");
+                        if (p)
+                            httpd_MsgAdd(answer, "Cseq", "%s", p);
+                        p = httpd_MsgGet(query, "Timestamp");
+                        if (p)
+                            httpd_MsgAdd(answer, "Timestamp", "%s", p);
 
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING:
-            case HTTPD_CLIENT_TLS_HS_IN:
-                pufd->events = POLLIN;
-                break;
-
-            case HTTPD_CLIENT_SENDING:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                pufd->events = POLLOUT;
-                break;
+                        p = httpd_MsgGet(query, "Require");
+                        if (p) {
+                            answer->i_status = 551;
+                            httpd_MsgAdd(query, "Unsupported", "%s", p);
+                        }
 
-            case HTTPD_CLIENT_RECEIVE_DONE: {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
+                        httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
+                                "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
+                        break;
+                    }
 
-                httpd_MsgInit(answer);
+                    cl->i_buffer = -1;  /* Force the creation of the answer in
+                                         * httpd_ClientSend */
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
 
-                /* Handle what we received */
-                switch (query->i_type) {
-                    case HTTPD_MSG_ANSWER:
-                        cl->url     = NULL;
+                case HTTPD_MSG_NONE:
+                    if (query->i_proto == HTTPD_PROTO_NONE) {
+                        cl->url = NULL;
                         cl->i_state = HTTPD_CLIENT_DEAD;
-                        break;
-
-                    case HTTPD_MSG_OPTIONS:
+                    } else {
+                        /* unimplemented */
+                        answer->i_proto  = query->i_proto ;
                         answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_proto  = query->i_proto;
-                        answer->i_status = 200;
-                        answer->i_body = 0;
-                        answer->p_body = NULL;
+                        answer->i_version= 0;
+                        answer->i_status = 501;
 
-                        httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
-                        httpd_MsgAdd(answer, "Content-Length", "0");
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
+                        answer->p_body = (uint8_t *)p;
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
 
-                        switch(query->i_proto) {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
-                            break;
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    }
+                    break;
 
-                        case HTTPD_PROTO_RTSP:
-                            answer->i_version = 0;
+                default: {
+                    int i_msg = query->i_type;
+                    bool b_auth_failed = false;
+                    bool b_deferred = false;
 
-                            const char *p = httpd_MsgGet(query, "Cseq");
-                            if (p)
-                                httpd_MsgAdd(answer, "Cseq", "%s", p);
-                            p = httpd_MsgGet(query, "Timestamp");
-                            if (p)
-                                httpd_MsgAdd(answer, "Timestamp", "%s", p);
+                    /* Search the url and trigger callbacks */
+                    vlc_mutex_lock(&host->lock);
+                    for (int i = 0; i < host->i_url; i++) {
+                        httpd_url_t *url = host->url[i];
 
-                            p = httpd_MsgGet(query, "Require");
-                            if (p) {
-                                answer->i_status = 551;
-                                httpd_MsgAdd(query, "Unsupported", "%s", p);
-                            }
+                        if (strcmp(url->psz_url, query->psz_url))
+                            continue;
+                        if (!url->catch[i_msg].cb)
+                            continue;
 
-                            httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
-                                    "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
-                            break;
+                        if (answer) {
+                            b_auth_failed = !httpdAuthOk(url->psz_user,
+                               url->psz_password,
+                               httpd_MsgGet(query, "Authorization")); /* BASIC id */
+                            if (b_auth_failed)
+                               break;
                         }
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in
-                                             * httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                        break;
-
-                    case HTTPD_MSG_NONE:
-                        if (query->i_proto == HTTPD_PROTO_NONE) {
-                            cl->url = NULL;
-                            cl->i_state = HTTPD_CLIENT_DEAD;
-                        } else {
-                            /* unimplemented */
-                            answer->i_proto  = query->i_proto ;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-                            answer->i_status = 501;
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                            answer->p_body = (uint8_t *)p;
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            cl->i_state = HTTPD_CLIENT_SENDING;
-                        }
-                        break;
+                        if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
+                            continue;
 
-                    default: {
-                        int i_msg = query->i_type;
-                        bool b_auth_failed = false;
-
-                        /* Search the url and trigger callbacks */
-                        for (int i = 0; i < host->i_url; i++) {
-                            httpd_url_t *url = host->url[i];
-
-                            if (strcmp(url->psz_url, query->psz_url))
-                                continue;
-                            if (!url->catch[i_msg].cb)
-                                continue;
-
-                            if (answer) {
-                                b_auth_failed = !httpdAuthOk(url->psz_user,
-                                   url->psz_password,
-                                   httpd_MsgGet(query, "Authorization")); /* BASIC id */
-                                if (b_auth_failed)
-                                   break;
-                            }
-
-                            if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
-                                continue;
-
-                            if (answer->i_proto == HTTPD_PROTO_NONE)
-                                cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
-                            else
-                                cl->i_buffer = -1;
-
-                            /* only one url can answer */
-                            answer = NULL;
-                            if (!cl->url)
-                                cl->url = url;
-                        }
+                        if (answer->i_type == HTTPD_MSG_NONE)
+                            b_deferred = true; /* will answer later */
+                        else if (answer->i_proto == HTTPD_PROTO_NONE)
+                            cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
+                        else
+                            cl->i_buffer = -1;
 
-                        if (answer) {
-                            answer->i_proto  = query->i_proto;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-
-                           if (b_auth_failed) {
-                                httpd_MsgAdd(answer, "WWW-Authenticate",
-                                        "Basic realm=\"VLC stream\"");
-                                answer->i_status = 401;
-                            } else
-                                answer->i_status = 404; /* no url registered */
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, answer->i_status,
-                                    query->psz_url);
-                            answer->p_body = (uint8_t *)p;
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
-                        }
+                        /* only one url can answer */
+                        answer = NULL;
+                        if (!cl->url)
+                            cl->url = url;
+                    }
+                    vlc_mutex_unlock(&host->lock);
 
-                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    if (answer) {
+                        answer->i_proto  = query->i_proto;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+
+                       if (b_auth_failed) {
+                            httpd_MsgAdd(answer, "WWW-Authenticate",
+                                    "Basic realm=\"VLC stream\"");
+                            answer->i_status = 401;
+                        } else
+                            answer->i_status = 404; /* no url registered */
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, answer->i_status,
+                                query->psz_url);
+                        answer->p_body = (uint8_t *)p;
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
                     }
+
+                    cl->i_state = b_deferred ? HTTPD_CLIENT_WAITING
+                                             : HTTPD_CLIENT_SENDING;
                 }
-                break;
             }
+            break;
+        }
 
-            case HTTPD_CLIENT_SEND_DONE:
-                if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
-                    const char *psz_connection = httpd_MsgGet(&cl->answer, "Connection");
-                    const char *psz_query = httpd_MsgGet(&cl->query, "Connection");
-                    bool b_connection = false;
-                    bool b_keepalive = false;
-                    bool b_query = false;
-
-                    cl->url = NULL;
-                    if (psz_connection) {
-                        b_connection = (strcasecmp(psz_connection, "Close") == 0);
-                        b_keepalive = (strcasecmp(psz_connection, "Keep-Alive") == 0);
-                    }
-
-                    if (psz_query)
-                        b_query = (strcasecmp(psz_query, "Close") == 0);
-
-                    if (((cl->query.i_proto == HTTPD_PROTO_HTTP) &&
-                                ((cl->query.i_version == 0 && b_keepalive) ||
-                                  (cl->query.i_version == 1 && !b_connection))) ||
-                            ((cl->query.i_proto == HTTPD_PROTO_RTSP) &&
-                              !b_query && !b_connection)) {
-                        httpd_MsgClean(&cl->query);
-                        httpd_MsgInit(&cl->query);
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free(cl->p_buffer);
-                        cl->p_buffer = xmalloc(cl->i_buffer_size);
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    } else
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    httpd_MsgClean(&cl->answer);
-                } else {
-                    i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean(&cl->answer);
+        case HTTPD_CLIENT_SEND_DONE:
+            if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
+                const char *psz_connection = httpd_MsgGet(&cl->answer, "Connection");
+                const char *psz_query = httpd_MsgGet(&cl->query, "Connection");
+                bool b_connection = false;
+                bool b_keepalive = false;
+                bool b_query = false;
+
+                cl->url = NULL;
+                if (psz_connection) {
+                    b_connection = (strcasecmp(psz_connection, "Close") == 0);
+                    b_keepalive = (strcasecmp(psz_connection, "Keep-Alive") == 0);
+                }
 
-                    cl->answer.i_body_offset = i_offset;
-                    free(cl->p_buffer);
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
+                if (psz_query)
+                    b_query = (strcasecmp(psz_query, "Close") == 0);
 
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
-                break;
+                if (((cl->query.i_proto == HTTPD_PROTO_HTTP) &&
+                            ((cl->query.i_version == 0 && b_keepalive) ||
+                              (cl->query.i_version == 1 && !b_connection))) ||
+                        ((cl->query.i_proto == HTTPD_PROTO_RTSP) &&
+                          !b_query && !b_connection)) {
+                    httpd_MsgClean(&cl->query);
+                    httpd_MsgInit(&cl->query);
 
-            case HTTPD_CLIENT_WAITING:
-                i_offset = cl->answer.i_body_offset;
-                int i_msg = cl->query.i_type;
+                    cl->i_buffer = 0;
+                    cl->i_buffer_size = 1000;
+                    free(cl->p_buffer);
+                    cl->p_buffer = xmalloc(cl->i_buffer_size);
+                    cl->i_state = HTTPD_CLIENT_RECEIVING;
+                } else
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                httpd_MsgClean(&cl->answer);
+            } else {
+                int64_t i_offset = cl->answer.i_body_offset;
+                httpd_MsgClean(&cl->answer);
 
-                httpd_MsgInit(&cl->answer);
                 cl->answer.i_body_offset = i_offset;
+                free(cl->p_buffer);
+                cl->p_buffer = NULL;
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 0;
 
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                        &cl->answer, &cl->query);
-                if (cl->answer.i_type != HTTPD_MSG_NONE) {
-                    /* we have new data, so re-enter send mode */
+                cl->i_state = HTTPD_CLIENT_WAITING;
+            }
+            break;
+
+        case HTTPD_CLIENT_WAITING: {
+            int64_t i_offset = cl->answer.i_body_offset;
+            int i_msg = cl->query.i_type;
+
+            httpd_MsgInit(&cl->answer);
+            cl->answer.i_body_offset = i_offset;
+
+            cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                    &cl->answer, &cl->query);
+            if (cl->answer.i_type != HTTPD_MSG_NONE) {
+                /* we have new data, so re-enter send mode */
+                if (!cl->b_stream_mode)
+                    cl->i_buffer = -1; /* deferred answer, starting with
+                                        * the header */
+                else if (cl->i_segment == 0) {
                     cl->i_buffer      = 0;
                     cl->p_buffer      = cl->answer.p_body;
                     cl->i_buffer_size = cl->answer.i_body;
                     cl->answer.p_body = NULL;
                     cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
                 }
+                cl->i_state = HTTPD_CLIENT_SENDING;
+            }
+            break;
         }
+    }
+}
 
-        if (pufd->events != 0)
-            nfd++;
-        else
-            b_low_delay = true;
+static short httpd_ClientEvents(const httpd_client_t *cl)
+{
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING:
+        case HTTPD_CLIENT_TLS_HS_IN:
+            return POLLIN;
+        case HTTPD_CLIENT_SENDING:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            return POLLOUT;
     }
-    vlc_mutex_unlock(&host->lock);
-    vlc_restorecancel(canc);
+    return 0;
+}
 
-    /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
-    int ret = poll(ufd, nfd, b_low_delay ? 20 : -1);
+#ifdef HAVE_SYS_EPOLL_H
+static uint32_t httpd_EpollEvents(short events)
+{
+    return ((events & POLLIN) ? EPOLLIN : 0)
+         | ((events & POLLOUT) ? EPOLLOUT : 0);
+}
+#endif
 
-    canc = vlc_savecancel();
-    vlc_mutex_lock(&host->lock);
-    switch(ret) {
-        case -1:
-            if (errno != EINTR) {
-                /* Kernel on low memory or a bug: pace */
-                msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
-                msleep(100000);
-            }
-        case 0:
-            vlc_restorecancel(canc);
-            return;
+/* Both called with the worker lock held */
+static void httpd_ClientAttach(httpd_worker_t *worker, httpd_client_t *cl)
+{
+    cl->worker = worker;
+    cl->i_events = httpd_ClientEvents(cl);
+    TAB_APPEND(worker->i_client, worker->client, cl);
+#ifdef HAVE_SYS_EPOLL_H
+    struct epoll_event ev = {
+        .events = httpd_EpollEvents(cl->i_events),
+        .data.ptr = cl,
+    };
+
+    if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, cl->fd, &ev))
+        cl->i_state = HTTPD_CLIENT_DEAD;
+#endif
+}
+
+static void httpd_ClientRemove(httpd_worker_t *worker, httpd_client_t *cl)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (cl->fd != -1)
+        epoll_ctl(worker->epfd, EPOLL_CTL_DEL, cl->fd,
+                  &(struct epoll_event){ .events = 0 });
+#endif
+    httpd_ClientClean(cl);
+    TAB_REMOVE(worker->i_client, worker->client, cl);
+    free(cl);
+}
+
+/* Runs the client until it waits for the network or for stream data.
+ * Returns true if the client was closed. */
+static bool httpd_ClientUpdate(httpd_worker_t *worker, httpd_client_t *cl,
+                               mtime_t now)
+{
+    uint8_t i_state;
+
+    do {
+        i_state = cl->i_state;
+        httpd_ClientProcess(worker->host, cl);
+    } while (cl->i_state != i_state);
+
+    if (cl->i_ref < 0 || (cl->i_ref == 0 &&
+                (cl->i_state == HTTPD_CLIENT_DEAD ||
+                  (cl->i_activity_timeout > 0 &&
+                    cl->i_activity_date+cl->i_activity_timeout < now)))) {
+        httpd_ClientRemove(worker, cl);
+        return true;
     }
 
-    /* Handle client sockets */
-    now = mdate();
-    nfd = host->nfd;
+    short i_events = httpd_ClientEvents(cl);
+    if (i_events != cl->i_events) {
+#ifdef HAVE_SYS_EPOLL_H
+        struct epoll_event ev = {
+            .events = httpd_EpollEvents(i_events),
+            .data.ptr = cl,
+        };
 
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        httpd_client_t *cl = host->client[i_client];
-        const struct pollfd *pufd = &ufd[nfd];
+        epoll_ctl(worker->epfd, EPOLL_CTL_MOD, cl->fd, &ev);
+#endif
+        cl->i_events = i_events;
+    }
 
-        assert(pufd < &ufd[sizeof(ufd) / sizeof(ufd[0])]);
+    /* we will check again in 20ms (not too big) if HTTPD_CLIENT_WAITING */
+    if (cl->i_state == HTTPD_CLIENT_WAITING && worker->i_sweep > now + 20000)
+        worker->i_sweep = now + 20000;
+    return false;
+}
+
+static void httpd_ClientEvent(httpd_worker_t *worker, httpd_client_t *cl,
+                              short revents, mtime_t now)
+{
+    cl->i_activity_date = now;
+
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
+        case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
+        case HTTPD_CLIENT_TLS_HS_IN:
+        case HTTPD_CLIENT_TLS_HS_OUT: httpd_ClientTlsHandshake(cl); break;
+        default:
+            /* not waiting for the socket: it can only be closed */
+            if (revents & (POLLERR|POLLHUP))
+                cl->i_state = HTTPD_CLIENT_DEAD;
+    }
+    httpd_ClientUpdate(worker, cl, now);
+}
+
+/* Checks for timeouts and for new stream data */
+static void httpd_WorkerSweep(httpd_worker_t *worker, mtime_t now)
+{
+    bool b_waiting = false;
 
-        if (cl->fd != pufd->fd)
-            continue; // we were not waiting for this client
-        ++nfd;
-        if (pufd->revents == 0)
-            continue; // no event received
+    for (int i = 0; i < worker->i_client; i++) {
+        httpd_client_t *cl = worker->client[i];
 
-        cl->i_activity_date = now;
+        if (httpd_ClientUpdate(worker, cl, now))
+            i--;
+        else if (cl->i_state == HTTPD_CLIENT_WAITING)
+            b_waiting = true;
+    }
+    worker->i_sweep = now + (b_waiting ? 20000 : 1000000);
+}
+
+/* Accepts new connections, and shares them out among the workers */
+static void httpd_HostAccept(httpd_host_t *host, mtime_t now)
+{
+    for (unsigned i = 0; i < host->nfd; i++) {
+        int fd;
+
+        while ((fd = vlc_accept(host->fds[i], NULL, NULL, true)) != -1) {
+            setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+                    &(int){ 1 }, sizeof(int));
 
-        switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
-            case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
-            case HTTPD_CLIENT_TLS_HS_IN:
-            case HTTPD_CLIENT_TLS_HS_OUT: httpd_ClientTlsHandshake(cl); break;
+            vlc_tls_t *p_tls;
+
+            if (host->p_tls != NULL)
+            {
+                const char *alpn[] = { "http/1.1", NULL };
+
+                p_tls = vlc_tls_SessionCreate(host->p_tls, fd, NULL, alpn);
+            }
+            else
+                p_tls = NULL;
+
+            httpd_client_t *cl = httpd_ClientNew(fd, p_tls, now);
+            if (unlikely(cl == NULL)) {
+                if (p_tls)
+                    vlc_tls_SessionDelete(p_tls);
+                net_Close(fd);
+                continue;
+            }
+
+            vlc_mutex_lock(&host->lock);
+            httpd_worker_t *worker =
+                &host->worker[host->i_next_worker++ % host->i_worker];
+            vlc_mutex_unlock(&host->lock);
+
+            vlc_mutex_lock(&worker->lock);
+            httpd_ClientAttach(worker, cl);
+            vlc_mutex_unlock(&worker->lock);
         }
     }
+}
 
-    /* Handle server sockets (accept new connections) */
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        httpd_client_t *cl;
-        int fd = ufd[nfd].fd;
+static int httpd_WorkerTimeout(const httpd_worker_t *worker)
+{
+    mtime_t delay = worker->i_sweep - mdate();
 
-        assert (fd == host->fds[nfd]);
+    return (delay > 0) ? (delay + 999) / 1000 : 0;
+}
 
-        if (ufd[nfd].revents == 0)
-            continue;
+static void httpd_PollError(httpd_host_t *host)
+{
+    if (errno != EINTR) {
+        /* Kernel on low memory or a bug: pace */
+        msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+        msleep(100000);
+    }
+}
 
-        /* */
-        fd = vlc_accept (fd, NULL, NULL, true);
-        if (fd == -1)
-            continue;
-        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                &(int){ 1 }, sizeof(int));
+#ifdef HAVE_SYS_EPOLL_H
+#define HTTPD_MAX_EVENTS 64
 
-        vlc_tls_t *p_tls;
+static void httpd_WorkerPoll(httpd_worker_t *worker)
+{
+    httpd_host_t *host = worker->host;
+    struct epoll_event ev[HTTPD_MAX_EVENTS];
+    int n = epoll_wait(worker->epfd, ev, HTTPD_MAX_EVENTS,
+                       httpd_WorkerTimeout(worker));
+    bool b_accept = false;
 
-        if (host->p_tls != NULL)
-        {
-            const char *alpn[] = { "http/1.1", NULL };
+    int canc = vlc_savecancel();
+    if (n == -1)
+        httpd_PollError(host);
+
+    mtime_t now = mdate();
+
+    vlc_mutex_lock(&worker->lock);
+    for (int i = 0; i < n; i++) {
+        httpd_client_t *cl = ev[i].data.ptr;
 
-            p_tls = vlc_tls_SessionCreate(host->p_tls, fd, NULL, alpn);
+        if (cl == NULL) { /* listening socket */
+            b_accept = true;
+            continue;
         }
-        else
-            p_tls = NULL;
 
-        cl = httpd_ClientNew(fd, p_tls, now);
+        short revents = 0;
+        if (ev[i].events & EPOLLIN)
+            revents |= POLLIN;
+        if (ev[i].events & EPOLLOUT)
+            revents |= POLLOUT;
+        if (ev[i].events & EPOLLERR)
+            revents |= POLLERR;
+        if (ev[i].events & EPOLLHUP)
+            revents |= POLLHUP;
+        httpd_ClientEvent(worker, cl, revents, now);
+    }
+    if (now >= worker->i_sweep)
+        httpd_WorkerSweep(worker, now);
+    vlc_mutex_unlock(&worker->lock);
 
-        TAB_APPEND(host->i_client, host->client, cl);
+    if (b_accept)
+        httpd_HostAccept(host, now);
+    vlc_restorecancel(canc);
+}
+#else
+/* Without epoll, there is a single worker, polling every socket */
+static void httpd_WorkerPoll(httpd_worker_t *worker)
+{
+    httpd_host_t *host = worker->host;
+    unsigned nfd;
+
+    vlc_mutex_lock(&worker->lock);
+    if (worker->i_ufd < host->nfd + worker->i_client) {
+        worker->i_ufd = host->nfd + worker->i_client;
+        worker->ufd = xrealloc(worker->ufd,
+                               worker->i_ufd * sizeof(*worker->ufd));
+        worker->ufd_client = xrealloc(worker->ufd_client,
+                                 worker->i_ufd * sizeof(*worker->ufd_client));
+    }
+
+    for (nfd = 0; nfd < host->nfd; nfd++) {
+        worker->ufd[nfd].fd = host->fds[nfd];
+        worker->ufd[nfd].events = POLLIN;
+        worker->ufd_client[nfd] = NULL;
+    }
+    for (int i = 0; i < worker->i_client; i++, nfd++) {
+        httpd_client_t *cl = worker->client[i];
+
+        worker->ufd[nfd].fd = cl->fd;
+        worker->ufd[nfd].events = cl->i_events;
+        worker->ufd_client[nfd] = cl;
+    }
+    vlc_mutex_unlock(&worker->lock);
+
+    int ret = poll(worker->ufd, nfd, httpd_WorkerTimeout(worker));
+    bool b_accept = false;
+
+    int canc = vlc_savecancel();
+    if (ret == -1)
+        httpd_PollError(host);
+
+    mtime_t now = mdate();
+
+    /* Clients are only ever removed by the worker thread itself */
+    vlc_mutex_lock(&worker->lock);
+    for (unsigned i = 0; ret > 0 && i < nfd; i++) {
+        if (worker->ufd[i].revents == 0)
+            continue;
+        if (worker->ufd_client[i] == NULL)
+            b_accept = true;
+        else
+            httpd_ClientEvent(worker, worker->ufd_client[i],
+                              worker->ufd[i].revents, now);
     }
+    if (now >= worker->i_sweep)
+        httpd_WorkerSweep(worker, now);
+    vlc_mutex_unlock(&worker->lock);
 
+    if (b_accept)
+        httpd_HostAccept(host, now);
     vlc_restorecancel(canc);
 }
+#endif
 
-static void* httpd_HostThread(void *data)
+static void* httpd_WorkerThread(void *data)
 {
-    httpd_host_t *host = data;
+    httpd_worker_t *worker = data;
+    httpd_host_t *host = worker->host;
 
-    vlc_mutex_lock(&host->lock);
-    while (host->i_ref > 0)
-        httpdLoop(host);
-    vlc_mutex_unlock(&host->lock);
+    for (;;) {
+        vlc_mutex_lock(&host->lock);
+        mutex_cleanup_push(&host->lock);
+        while (host->i_url <= 0)
+            vlc_cond_wait(&host->wait, &host->lock);
+        vlc_cleanup_pop();
+        vlc_mutex_unlock(&host->lock);
+
+        httpd_WorkerPoll(worker);
+    }
     return NULL;
 }
 
+static void httpd_WorkersStop(httpd_host_t *host)
+{
+    for (unsigned i = 0; i < host->i_worker; i++)
+        vlc_cancel(host->worker[i].thread);
+
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *worker = &host->worker[i];
+
+        vlc_join(worker->thread, NULL);
+
+        for (int j = 0; j < worker->i_client; j++) {
+            httpd_client_t *cl = worker->client[j];
+            if (cl->i_state != HTTPD_CLIENT_DEAD)
+                msg_Warn(host, "client still connected");
+            httpd_ClientClean(cl);
+            free(cl);
+            /* TODO */
+        }
+        free(worker->client);
+#ifdef HAVE_SYS_EPOLL_H
+        close(worker->epfd);
+#else
+        free(worker->ufd);
+        free(worker->ufd_client);
+#endif
+        vlc_mutex_destroy(&worker->lock);
+    }
+    free(host->worker);
+    host->worker = NULL;
+    host->i_worker = 0;
+}
+
+static int httpd_WorkersStart(httpd_host_t *host)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    /* The range of the option is not enforced on the command line */
+    unsigned count = VLC_CLIP(var_InheritInteger(host, "http-threads"), 1, 64);
+#else
+    unsigned count = 1;
+#endif
+
+    host->worker = malloc(count * sizeof(*host->worker));
+    if (unlikely(host->worker == NULL))
+        return VLC_ENOMEM;
+
+    for (host->i_worker = 0; host->i_worker < count; host->i_worker++) {
+        httpd_worker_t *worker = &host->worker[host->i_worker];
+
+        worker->host = host;
+        vlc_mutex_init(&worker->lock);
+        worker->i_client = 0;
+        worker->client = NULL;
+        worker->i_sweep = 0;
+#ifdef HAVE_SYS_EPOLL_H
+        worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (worker->epfd == -1) {
+            vlc_mutex_destroy(&worker->lock);
+            goto error;
+        }
+
+        for (unsigned i = 0; i < host->nfd; i++) {
+            struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+# ifdef EPOLLEXCLUSIVE
+            /* wake a single worker per new connection */
+            ev.events |= EPOLLEXCLUSIVE;
+# endif
+            epoll_ctl(worker->epfd, EPOLL_CTL_ADD, host->fds[i], &ev);
+        }
+#else
+        worker->ufd = NULL;
+        worker->ufd_client = NULL;
+        worker->i_ufd = 0;
+#endif
+
+        if (vlc_clone(&worker->thread, httpd_WorkerThread, worker,
+                      VLC_THREAD_PRIORITY_LOW)) {
+#ifdef HAVE_SYS_EPOLL_H
+            close(worker->epfd);
+#endif
+            vlc_mutex_destroy(&worker->lock);
+            goto error;
+        }
+    }
+    return VLC_SUCCESS;
+
+error:
+    httpd_WorkersStop(host);
+    return VLC_EGENERIC;
+}
+
 int httpd_StreamSetHTTPHeaders(httpd_stream_t * p_stream, httpd_header * p_headers, size_t i_headers)
 {
     if (!p_stream)
@@ -0,0 +1,144 @@
+/*****************************************************************************
+ * block_fifo.c: Test and benchmark for block_fifo_t
+ *****************************************************************************
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define BLOCKS (1 << 20)
+#define POOL   4096
+
+/* Blocks are recycled from a static pool, so that only the queue itself is
+ * measured, not the memory allocator. */
+static block_t pool[POOL];
+static uint8_t payload[188];
+
+static void release (block_t *block)
+{
+    (void) block;
+}
+
+struct bench
+{
+    block_fifo_t *fifo;
+    size_t max_depth;
+};
+
+static void *writer (void *data)
+{
+    struct bench *bench = data;
+
+    for (unsigned i = 0; i < BLOCKS; i++)
+    {
+        block_t *block = &pool[i % POOL];
+
+        block_Init (block, payload, sizeof (payload));
+        block->pf_release = release;
+        block->i_dts = i;
+        block_FifoPace (bench->fifo, bench->max_depth, SIZE_MAX);
+        block_FifoPut (bench->fifo, block);
+    }
+    return NULL;
+}
+
+static void run (const char *name, block_fifo_t *fifo, size_t max_depth)
+{
+    struct bench bench = { fifo, max_depth };
+    vlc_thread_t th;
+
+    assert (fifo != NULL);
+
+    mtime_t start = mdate ();
+    if (vlc_clone (&th, writer, &bench, VLC_THREAD_PRIORITY_LOW))
+        abort ();
+
+    for (unsigned i = 0; i < BLOCKS; i++)
+    {
+        block_t *block = block_FifoGet (fifo);
+
+        assert (block != NULL);
+        assert (block->i_dts == (mtime_t)i);
+        assert (block->p_next == NULL);
+        block_Release (block);
+    }
+    vlc_join (th, NULL);
+
+    mtime_t duration = mdate () - start;
+    assert (block_FifoCount (fifo) == 0);
+    block_FifoRelease (fifo);
+
+    printf ("%-6s max depth %4zu: %6.1f ns/block\n", name, max_depth,
+            duration * 1000. / BLOCKS);
+}
+
+static void test_semantics (block_fifo_t *fifo)
+{
+    block_t *chain = NULL, **pp = &chain;
+
+    /* More blocks than the ring can hold, so the overflow list is used */
+    for (unsigned i = 0; i < 100; i++)
+    {
+        block_t *block = block_Alloc (i);
+        assert (block != NULL);
+        block->i_dts = i;
+        *pp = block;
+        pp = &block->p_next;
+    }
+
+    assert (block_FifoPut (fifo, chain) == 99 * 100 / 2);
+    assert (block_FifoCount (fifo) == 100);
+    assert (block_FifoShow (fifo)->i_dts == 0);
+
+    for (unsigned i = 0; i < 50; i++)
+    {
+        block_t *block = block_FifoGet (fifo);
+        assert (block->i_dts == (mtime_t)i);
+        block_Release (block);
+    }
+
+    /* Pacing must not wait below the limit */
+    block_FifoPace (fifo, 50, SIZE_MAX);
+
+    block_FifoEmpty (fifo);
+    assert (block_FifoCount (fifo) == 0);
+
+    block_FifoWake (fifo);
+    assert (block_FifoGet (fifo) == NULL);
+    block_FifoRelease (fifo);
+}
+
+int main (void)
+{
+    test_semantics (block_FifoNew ());
+    test_semantics (block_FifoNewSPSC (16));
+
+    /* The writer must never get more than POOL blocks ahead */
+    run ("locked", block_FifoNew (), POOL / 2);
+    run ("SPSC", block_FifoNewSPSC (1024), POOL / 2);
+    run ("locked", block_FifoNew (), 10);
+    run ("SPSC", block_FifoNewSPSC (1024), 10);
+    return 0;
+}
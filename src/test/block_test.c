@@ -23,6 +23,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #undef NDEBUG
 #include <assert.h>
@@ -84,10 +85,45 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void *test_block_cache_thread (void *data)
+{
+    (void) data;
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        block_t *block = block_Alloc (188);
+        assert (block != NULL);
+        assert (block->i_size >= 188);
+        memset (block->p_buffer, i, 188);
+        block = block_Realloc (block, 0, 184);
+        assert (block != NULL);
+        block_Release (block);
+    }
+    return NULL;
+}
+
+static void test_block_cache (void)
+{
+    uint64_t hits, misses, hits2, misses2;
+    vlc_thread_t th;
+
+    block_CacheStats (&hits, &misses);
+    /* Thread-local counters are accounted when the thread exits */
+    if (vlc_clone (&th, test_block_cache_thread, NULL,
+                   VLC_THREAD_PRIORITY_LOW))
+        abort ();
+    vlc_join (th, NULL);
+    block_CacheStats (&hits2, &misses2);
+
+    assert (hits2 + misses2 - hits - misses == 1000);
+    assert (hits2 - hits >= 999);
+}
+
 int main (void)
 {
     test_block_File ();
     test_block ();
+    test_block_cache ();
     return 0;
 }
 
@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * stream_cache.c: Test for the stream segment cache
+ *****************************************************************************
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <vlc_common.h>
+/* The cache is internal to libvlccore */
+#include "../input/stream_cache.c"
+
+#undef NDEBUG
+#include <assert.h>
+
+#define SEGMENT 1000
+#define SIZE    (40 * SEGMENT + 123)
+
+static uint8_t ref[SIZE];
+static uint8_t buf[SIZE];
+
+static void test_sequential (const char *dir)
+{
+    stream_cache_t *cache = stream_CacheNew (4 * SEGMENT, SEGMENT,
+                                             8 * SEGMENT, dir);
+    stream_cache_stats_t stats;
+
+    assert (cache != NULL);
+    for (size_t pos = 0; pos < SIZE; pos += 100)
+        stream_CacheWrite (cache, pos, ref + pos, __MIN(100, SIZE - pos));
+
+    stream_CacheGetStats (cache, &stats);
+    assert (stats.i_misses == SIZE);
+    assert (stats.i_memory == 4 * SEGMENT - 877);
+    assert (stats.i_disk == (dir != NULL ? 8 * SEGMENT : 0));
+
+    /* The last segments are in memory */
+    size_t len = stream_CacheRead (cache, SIZE - 3000, buf, 3000);
+    assert (len == 3000);
+    assert (!memcmp (buf, ref + SIZE - 3000, len));
+
+    /* Older ones on disk, then gone */
+    const size_t start = SIZE - 4 * SEGMENT + 877 - 8 * SEGMENT;
+    len = stream_CacheRead (cache, start - 10, buf, SIZE);
+    assert (len == 0);
+    len = stream_CacheRead (cache, start + 10, buf, SIZE);
+    if (dir != NULL)
+    {
+        assert (len == SIZE - start - 10);
+        assert (!memcmp (buf, ref + start + 10, len));
+        /* Each segment went to the disk before being read back */
+        stream_CacheGetStats (cache, &stats);
+        assert (stats.i_disk_hits == len);
+    }
+    else
+        assert (len == 0);
+
+    stream_CacheReset (cache);
+    assert (stream_CacheRead (cache, SIZE - 10, buf, 10) == 0);
+    stream_CacheDelete (cache);
+}
+
+static void test_random (const char *dir)
+{
+    stream_cache_t *cache = stream_CacheNew (5 * SEGMENT, SEGMENT,
+                                             7 * SEGMENT, dir);
+    uint64_t hits = 0, misses = 0;
+
+    assert (cache != NULL);
+    srand (42);
+    for (unsigned i = 0; i < 100000; i++)
+    {
+        size_t pos = rand () % SIZE;
+        size_t len = 1 + rand () % (3 * SEGMENT);
+
+        if (len > SIZE - pos)
+            len = SIZE - pos;
+
+        if (rand () % 2)
+        {
+            stream_CacheWrite (cache, pos, ref + pos, len);
+            misses += len;
+        }
+        else
+        {
+            size_t got = stream_CacheRead (cache, pos, buf, len);
+
+            assert (got <= len);
+            assert (!memcmp (buf, ref + pos, got));
+            hits += got;
+        }
+    }
+
+    stream_cache_stats_t stats;
+    stream_CacheGetStats (cache, &stats);
+    assert (stats.i_hits == hits);
+    assert (stats.i_misses == misses);
+    assert (stats.i_memory <= 5 * SEGMENT);
+    assert (stats.i_disk <= 7 * SEGMENT);
+    stream_CacheDelete (cache);
+}
+
+int main (void)
+{
+    for (size_t i = 0; i < SIZE; i++)
+        ref[i] = rand ();
+
+    assert (stream_CacheNew (SEGMENT - 1, SEGMENT, 0, NULL) == NULL);
+
+    test_sequential (NULL);
+    test_sequential (".");
+    test_random (NULL);
+    test_random (".");
+    return 0;
+}
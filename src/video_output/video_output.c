@@ -142,6 +142,9 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
     /* Initialize locks */
     vlc_mutex_init(&vout->p->filter.lock);
     vlc_mutex_init(&vout->p->spu_lock);
+    vlc_mutex_init(&vout->p->prepare.lock);
+    vlc_cond_init(&vout->p->prepare.wait);
+    vlc_cond_init(&vout->p->prepare.done);
 
     /* Initialize subpicture unit */
     vout->p->spu = spu_Create(vout);
@@ -284,6 +287,9 @@ static void VoutDestructor(vlc_object_t *object)
     free(vout->p->splitter_name);
 
     /* Destroy the locks */
+    vlc_cond_destroy(&vout->p->prepare.done);
+    vlc_cond_destroy(&vout->p->prepare.wait);
+    vlc_mutex_destroy(&vout->p->prepare.lock);
     vlc_mutex_destroy(&vout->p->spu_lock);
     vlc_mutex_destroy(&vout->p->filter.lock);
     vout_control_Clean(&vout->p->control);
@@ -651,8 +657,134 @@ static picture_t *VoutVideoFilterStaticNewPicture(filter_t *filter)
     return picture_NewFromFormat(&filter->fmt_out.video);
 }
 
+/*****************************************************************************
+ * Interactive filtering ahead of display
+ *****************************************************************************
+ * Once the next picture is known, it goes through the interactive filters on
+ * a second thread, while the vout thread waits for the date of the current
+ * one. Only the vout thread queues jobs and uses their result, one at a time.
+ *****************************************************************************/
+static void *PrepareThread(void *object)
+{
+    vout_thread_t *vout = object;
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->prepare.lock);
+    for (;;) {
+        while (!sys->prepare.exit && !sys->prepare.is_busy)
+            vlc_cond_wait(&sys->prepare.wait, &sys->prepare.lock);
+        if (sys->prepare.exit)
+            break;
+
+        picture_t *torender = picture_Hold(sys->prepare.source);
+        vlc_mutex_unlock(&sys->prepare.lock);
+
+        vlc_mutex_lock(&sys->filter.lock);
+        picture_t *filtered = filter_chain_VideoFilter(sys->filter.chain_interactive, torender);
+        vlc_mutex_unlock(&sys->filter.lock);
+
+        vlc_mutex_lock(&sys->prepare.lock);
+        sys->prepare.filtered = filtered;
+        sys->prepare.is_busy  = false;
+        vlc_cond_signal(&sys->prepare.done);
+    }
+    vlc_mutex_unlock(&sys->prepare.lock);
+    return NULL;
+}
+
+static void ThreadPrepareStart(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    sys->prepare.source   = NULL;
+    sys->prepare.filtered = NULL;
+    sys->prepare.is_busy  = false;
+    sys->prepare.exit     = false;
+    sys->prepare.is_started =
+        !vlc_clone(&sys->prepare.thread, PrepareThread, vout,
+                   VLC_THREAD_PRIORITY_OUTPUT);
+}
+
+/* Must not be called with the filter lock held, unless the job is known
+ * to be finished */
+static void ThreadPrepareWait(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->prepare.lock);
+    while (sys->prepare.is_busy)
+        vlc_cond_wait(&sys->prepare.done, &sys->prepare.lock);
+    vlc_mutex_unlock(&sys->prepare.lock);
+}
+
+static void ThreadPrepareCancel(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    ThreadPrepareWait(vout);
+    if (sys->prepare.filtered)
+        picture_Release(sys->prepare.filtered);
+    sys->prepare.filtered = NULL;
+    if (sys->prepare.source)
+        picture_Release(sys->prepare.source);
+    sys->prepare.source = NULL;
+}
+
+static void ThreadPrepareStop(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    if (!sys->prepare.is_started)
+        return;
+    ThreadPrepareCancel(vout);
+
+    vlc_mutex_lock(&sys->prepare.lock);
+    sys->prepare.exit = true;
+    vlc_cond_signal(&sys->prepare.wait);
+    vlc_mutex_unlock(&sys->prepare.lock);
+
+    vlc_join(sys->prepare.thread, NULL);
+    sys->prepare.is_started = false;
+}
+
+/* Starts filtering the next picture, if the worker is free */
+static void ThreadPrepareNext(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+    picture_t *next = sys->displayed.next;
+
+    if (!sys->prepare.is_started || !next || sys->prepare.source ||
+        filter_chain_GetLength(sys->filter.chain_interactive) == 0)
+        return;
+
+    vlc_mutex_lock(&sys->prepare.lock);
+    sys->prepare.source  = picture_Hold(next);
+    sys->prepare.is_busy = true;
+    vlc_cond_signal(&sys->prepare.wait);
+    vlc_mutex_unlock(&sys->prepare.lock);
+}
+
+/* Returns the filtered picture if it was prepared from current, NULL
+ * otherwise */
+static picture_t *ThreadPrepareTake(vout_thread_t *vout, picture_t *current)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    if (sys->prepare.source != current)
+        return NULL;
+
+    ThreadPrepareWait(vout);
+    picture_t *filtered = sys->prepare.filtered;
+    sys->prepare.filtered = NULL;
+    picture_Release(sys->prepare.source);
+    sys->prepare.source = NULL;
+    return filtered;
+}
+
 static void ThreadFilterFlush(vout_thread_t *vout, bool is_locked)
 {
+    ThreadPrepareCancel(vout);
+
     if (vout->p->displayed.current)
         picture_Release( vout->p->displayed.current );
     vout->p->displayed.current = NULL;
@@ -771,6 +903,9 @@ static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool fra
 {
     bool is_late_dropped = vout->p->is_late_dropped && !vout->p->pause.is_on && !frame_by_frame;
 
+    /* Filters may be changed below, with the filter lock held */
+    ThreadPrepareWait(vout);
+
     vlc_mutex_lock(&vout->p->filter.lock);
 
     picture_t *picture = filter_chain_VideoFilter(vout->p->filter.chain_static, NULL);
@@ -832,13 +967,16 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
     vout_thread_sys_t *sys = vout->p;
     vout_display_t *vd = vout->p->display.vd;
 
-    picture_t *torender = picture_Hold(vout->p->displayed.current);
-
     vout_chrono_Start(&vout->p->render);
 
-    vlc_mutex_lock(&vout->p->filter.lock);
-    picture_t *filtered = filter_chain_VideoFilter(vout->p->filter.chain_interactive, torender);
-    vlc_mutex_unlock(&vout->p->filter.lock);
+    picture_t *filtered = ThreadPrepareTake(vout, vout->p->displayed.current);
+    if (!filtered) {
+        picture_t *torender = picture_Hold(vout->p->displayed.current);
+
+        vlc_mutex_lock(&vout->p->filter.lock);
+        filtered = filter_chain_VideoFilter(vout->p->filter.chain_interactive, torender);
+        vlc_mutex_unlock(&vout->p->filter.lock);
+    }
 
     if (!filtered)
         return VLC_EGENERIC;
@@ -1039,6 +1177,8 @@ static int ThreadDisplayPicture(vout_thread_t *vout, mtime_t *deadline)
     if (!paused || frame_by_frame)
         while (!vout->p->displayed.next && !ThreadDisplayPreparePicture(vout, false, frame_by_frame))
             ;
+    if (!frame_by_frame)
+        ThreadPrepareNext(vout);
 
     const mtime_t date = mdate();
     const mtime_t render_delay = vout_chrono_GetHigh(&vout->p->render) + VOUT_MWAIT_TOLERANCE;
@@ -1357,12 +1497,16 @@ static int ThreadStart(vout_thread_t *vout, const vout_display_state_t *state)
     vout->p->spu_blend_chroma        = 0;
     vout->p->spu_blend               = NULL;
 
+    ThreadPrepareStart(vout);
+
     video_format_Print(VLC_OBJECT(vout), "original format", &vout->p->original);
     return VLC_SUCCESS;
 }
 
 static void ThreadStop(vout_thread_t *vout, vout_display_state_t *state)
 {
+    ThreadPrepareStop(vout);
+
     if (vout->p->spu_blend)
         filter_DeleteBlend(vout->p->spu_blend);
 
@@ -122,6 +122,20 @@ struct vout_thread_sys_t
         filter_chain_t  *chain_interactive;
     } filter;
 
+    /* Interactive filtering of displayed.next, while the display thread
+     * waits to show displayed.current */
+    struct {
+        vlc_thread_t    thread;
+        bool            is_started;
+        vlc_mutex_t     lock;
+        vlc_cond_t      wait;       /* a job was queued, or exit */
+        vlc_cond_t      done;       /* the job is finished */
+        picture_t       *source;    /* held picture being filtered, if any */
+        picture_t       *filtered;  /* result for source */
+        bool            is_busy;
+        bool            exit;
+    } prepare;
+
     /* */
     vlc_mouse_t     mouse;
 
@@ -61,11 +61,35 @@ typedef struct {
     spu_heap_entry_t entry[VOUT_MAX_SUBPICTURES];
 } spu_heap_t;
 
+/* Number of scaled regions kept across subpictures, and how long an unused
+ * one is kept */
+#define SPU_CACHE_MAX   (4)
+#define SPU_CACHE_DELAY (10 * CLOCK_FREQ)
+
+/* */
+typedef struct {
+    picture_t       *source;         /**< picture of the region (key) */
+    video_format_t  fmt;             /**< format of the region (key) */
+    video_palette_t palette;         /**< palette of the region (key) */
+    unsigned        width;           /**< destination size (key) */
+    unsigned        height;
+    vlc_fourcc_t    chroma;          /**< destination chroma (key) */
+    bool            convert;
+
+    picture_t       *picture;        /**< scaled and converted picture */
+    mtime_t         date;            /**< last use */
+} spu_cache_entry_t;
+
+typedef struct {
+    spu_cache_entry_t entry[SPU_CACHE_MAX];
+} spu_cache_t;
+
 struct spu_private_t {
     vlc_mutex_t  lock;            /* lock to protect all followings fields */
     vlc_object_t *input;
 
     spu_heap_t   heap;
+    spu_cache_t  cache;            /**< scaled regions, keyed by content */
 
     int channel;             /**< number of subpicture channels registered */
     filter_t *text;                              /**< text renderer module */
@@ -156,6 +180,160 @@ static void SpuHeapClean(spu_heap_t *heap)
     }
 }
 
+/*****************************************************************************
+ * scaled regions cache
+ *****************************************************************************
+ * A region keeps its scaled picture as long as it lives (p_private), but a
+ * decoder sending the same bitmap again (DVB or PGS pages refresh, karaoke)
+ * creates a new region. The cache finds the scaled picture of such regions
+ * by comparing their content.
+ *****************************************************************************/
+static void SpuCacheInit(spu_cache_t *cache)
+{
+    for (int i = 0; i < SPU_CACHE_MAX; i++) {
+        spu_cache_entry_t *e = &cache->entry[i];
+
+        e->source  = NULL;
+        e->picture = NULL;
+    }
+}
+
+static void SpuCacheDeleteAt(spu_cache_t *cache, int index)
+{
+    spu_cache_entry_t *e = &cache->entry[index];
+
+    if (e->source)
+        picture_Release(e->source);
+    if (e->picture)
+        picture_Release(e->picture);
+
+    e->source  = NULL;
+    e->picture = NULL;
+}
+
+/* Remove the entries unused since date */
+static void SpuCacheClean(spu_cache_t *cache, mtime_t date)
+{
+    for (int i = 0; i < SPU_CACHE_MAX; i++) {
+        if (cache->entry[i].picture && cache->entry[i].date < date)
+            SpuCacheDeleteAt(cache, i);
+    }
+}
+
+static bool SpuCacheIsSameFormat(const video_format_t *a,
+                                 const video_format_t *b)
+{
+    return a->i_chroma         == b->i_chroma &&
+           a->i_width          == b->i_width &&
+           a->i_height         == b->i_height &&
+           a->i_x_offset       == b->i_x_offset &&
+           a->i_y_offset       == b->i_y_offset &&
+           a->i_visible_width  == b->i_visible_width &&
+           a->i_visible_height == b->i_visible_height;
+}
+
+static bool SpuCacheIsSamePicture(picture_t *a, picture_t *b)
+{
+    if (a == b)
+        return true;
+    if (!SpuCacheIsSameFormat(&a->format, &b->format) ||
+        a->i_planes != b->i_planes)
+        return false;
+
+    for (int i = 0; i < a->i_planes; i++) {
+        const plane_t *pa = &a->p[i];
+        const plane_t *pb = &b->p[i];
+
+        if (pa->i_visible_lines != pb->i_visible_lines ||
+            pa->i_visible_pitch != pb->i_visible_pitch)
+            return false;
+        for (int y = 0; y < pa->i_visible_lines; y++) {
+            if (memcmp(&pa->p_pixels[y * pa->i_pitch],
+                       &pb->p_pixels[y * pb->i_pitch], pa->i_visible_pitch))
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool SpuCacheMatch(const spu_cache_entry_t *e,
+                          const subpicture_region_t *region,
+                          unsigned width, unsigned height,
+                          vlc_fourcc_t chroma, bool convert)
+{
+    if (e->width != width || e->height != height ||
+        e->chroma != chroma || e->convert != convert ||
+        !SpuCacheIsSameFormat(&e->fmt, &region->fmt))
+        return false;
+
+    const video_palette_t *palette = region->fmt.p_palette;
+    if ((e->fmt.p_palette != NULL) != (palette != NULL))
+        return false;
+    if (palette &&
+        (e->palette.i_entries != palette->i_entries ||
+         memcmp(e->palette.palette, palette->palette,
+                palette->i_entries * sizeof(*palette->palette))))
+        return false;
+
+    return SpuCacheIsSamePicture(e->source, region->p_picture);
+}
+
+/* Return a reference to the scaled picture of a region, or NULL */
+static picture_t *SpuCacheGet(spu_cache_t *cache,
+                              const subpicture_region_t *region,
+                              unsigned width, unsigned height,
+                              vlc_fourcc_t chroma, bool convert)
+{
+    for (int i = 0; i < SPU_CACHE_MAX; i++) {
+        spu_cache_entry_t *e = &cache->entry[i];
+
+        if (!e->picture ||
+            !SpuCacheMatch(e, region, width, height, chroma, convert))
+            continue;
+
+        e->date = mdate();
+        return picture_Hold(e->picture);
+    }
+    return NULL;
+}
+
+/* Store the scaled picture of a region in place of the least recently
+ * used entry */
+static void SpuCachePut(spu_cache_t *cache,
+                        const subpicture_region_t *region,
+                        unsigned width, unsigned height,
+                        vlc_fourcc_t chroma, bool convert,
+                        picture_t *picture)
+{
+    int index = 0;
+    for (int i = 0; i < SPU_CACHE_MAX; i++) {
+        const spu_cache_entry_t *e = &cache->entry[i];
+
+        if (!e->picture) {
+            index = i;
+            break;
+        }
+        if (e->date < cache->entry[index].date)
+            index = i;
+    }
+    SpuCacheDeleteAt(cache, index);
+
+    spu_cache_entry_t *e = &cache->entry[index];
+
+    e->source  = picture_Hold(region->p_picture);
+    e->fmt     = region->fmt;
+    if (region->fmt.p_palette) {
+        e->palette       = *region->fmt.p_palette;
+        e->fmt.p_palette = &e->palette;
+    }
+    e->width   = width;
+    e->height  = height;
+    e->chroma  = chroma;
+    e->convert = convert;
+    e->picture = picture_Hold(picture);
+    e->date    = mdate();
+}
+
 static void FilterRelease(filter_t *filter)
 {
     if (filter->p_module)
@@ -799,6 +977,20 @@ static void SpuRenderRegion(spu_t *spu,
             }
         }
 
+        /* Look for the same region scaled for a previous subpicture */
+        if (!region->p_private && dst_width > 0 && dst_height > 0) {
+            picture_t *picture = SpuCacheGet(&sys->cache, region,
+                                             dst_width, dst_height,
+                                             chroma_list[0], convert_chroma);
+            if (picture) {
+                region->p_private = subpicture_region_private_New(&picture->format);
+                if (region->p_private)
+                    region->p_private->p_picture = picture;
+                else
+                    picture_Release(picture);
+            }
+        }
+
         /* Scale if needed into cache */
         if (!region->p_private && dst_width > 0 && dst_height > 0) {
             filter_t *scale = sys->scale;
@@ -859,6 +1051,10 @@ static void SpuRenderRegion(spu_t *spu,
                     if (!region->p_private->p_picture) {
                         subpicture_region_private_Delete(region->p_private);
                         region->p_private = NULL;
+                    } else {
+                        SpuCachePut(&sys->cache, region,
+                                    dst_width, dst_height,
+                                    chroma_list[0], convert_chroma, picture);
                     }
                 } else {
                     picture_Release(picture);
@@ -1199,6 +1395,7 @@ spu_t *spu_Create(vlc_object_t *object)
     vlc_mutex_init(&sys->lock);
 
     SpuHeapInit(&sys->heap);
+    SpuCacheInit(&sys->cache);
 
     sys->text = NULL;
     sys->scale = NULL;
@@ -1263,6 +1460,7 @@ void spu_Destroy(spu_t *spu)
 
     /* Destroy all remaining subpictures */
     SpuHeapClean(&sys->heap);
+    SpuCacheClean(&sys->cache, INT64_MAX);
 
     vlc_mutex_destroy(&sys->lock);
 
@@ -1455,6 +1653,7 @@ subpicture_t *spu_Render(spu_t *spu,
     /* Get an array of subpictures to render */
     SpuSelectSubpictures(spu, &subpicture_count, subpicture_array,
                          render_subtitle_date, render_osd_date, ignore_osd);
+    SpuCacheClean(&sys->cache, mdate() - SPU_CACHE_DELAY);
     if (subpicture_count <= 0) {
         vlc_mutex_unlock(&sys->lock);
         return NULL;
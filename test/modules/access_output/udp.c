@@ -0,0 +1,149 @@
+/*****************************************************************************
+ * udp.c: test for the UDP stream output
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+
+#include <vlc_sout.h>
+#include <vlc_block.h>
+
+/* Packets per part of the stream */
+#define PACKETS  20
+/* Size of the packets, also given as MTU so that each block is a packet */
+#define SIZE     1316
+/* Interval between the packets */
+#define INTERVAL 2000
+
+/* Opens a receiving socket on the loopback, and returns its port */
+static int test_socket( int *pi_port )
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof (addr);
+    int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    assert( fd != -1 );
+
+    memset( &addr, 0, sizeof (addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    assert( bind( fd, (struct sockaddr *)&addr, sizeof (addr) ) == 0 );
+    assert( getsockname( fd, (struct sockaddr *)&addr, &len ) == 0 );
+    *pi_port = ntohs( addr.sin_port );
+    return fd;
+}
+
+static void test_write( sout_access_out_t *p_access, uint32_t i_seq,
+                        mtime_t i_dts )
+{
+    block_t *p_block = block_Alloc( SIZE );
+    assert( p_block != NULL );
+
+    memset( p_block->p_buffer, 0, SIZE );
+    memcpy( p_block->p_buffer, &i_seq, sizeof (i_seq) );
+    p_block->i_dts = i_dts;
+    sout_AccessOutWrite( p_access, p_block );
+}
+
+/* Sends three parts of the stream, separated by a forward and a backward
+ * timestamp hole. Each part must be paced from the end of the previous one,
+ * without waiting for the far future dates nor bursting the past ones. */
+static void test_discontinuity( libvlc_int_t *p_libvlc, unsigned i_batch )
+{
+    char psz_access[64], psz_dst[32];
+    int i_port;
+    int fd = test_socket( &i_port );
+
+    snprintf( psz_access, sizeof (psz_access),
+              "udp{caching=50,batch=%u}", i_batch );
+    snprintf( psz_dst, sizeof (psz_dst), "127.0.0.1:%d", i_port );
+    sout_access_out_t *p_access = sout_AccessOutNew( p_libvlc, psz_access,
+                                                     psz_dst );
+    assert( p_access != NULL );
+
+    const mtime_t i_base = mdate();
+    uint32_t i_seq = 0;
+    for( int i = 0; i < PACKETS; i++, i_seq++ )
+        test_write( p_access, i_seq, i_base + i_seq * INTERVAL );
+    for( int i = 0; i < PACKETS; i++, i_seq++ )
+        test_write( p_access, i_seq,
+                    i_base + 60 * CLOCK_FREQ + i_seq * INTERVAL );
+    for( int i = 0; i < PACKETS; i++, i_seq++ )
+        test_write( p_access, i_seq,
+                    i_base - 60 * CLOCK_FREQ + i_seq * INTERVAL );
+
+    /* The first packet after the forward hole is dropped */
+    mtime_t pi_date[3 * PACKETS];
+    unsigned i_received = 0;
+    uint32_t i_last = 0;
+    struct pollfd ufd = { .fd = fd, .events = POLLIN };
+
+    while( i_received < 3 * PACKETS - 1 && poll( &ufd, 1, 3000 ) > 0 )
+    {
+        uint8_t p_buf[SIZE];
+        uint32_t i_recv_seq;
+
+        assert( recv( fd, p_buf, sizeof (p_buf), 0 ) == SIZE );
+        memcpy( &i_recv_seq, p_buf, sizeof (i_recv_seq) );
+        assert( i_recv_seq < 3 * PACKETS );
+        assert( i_received == 0 || i_recv_seq > i_last );
+        assert( i_recv_seq != PACKETS );
+        pi_date[i_recv_seq] = mdate();
+        i_last = i_recv_seq;
+        i_received++;
+    }
+    log( "received %u packets\n", i_received );
+    assert( i_received == 3 * PACKETS - 1 );
+
+    /* Packets after the backward hole are still paced */
+    assert( pi_date[3 * PACKETS - 1] - pi_date[2 * PACKETS]
+            >= (PACKETS - 1) * INTERVAL / 2 );
+
+    sout_AccessOutDelete( p_access );
+    close( fd );
+}
+
+int main( void )
+{
+#ifndef HAVE_SENDMMSG
+    return 77;
+#else
+    static const char *argv[] = {
+        "-v", "--ignore-config", "-I", "dummy", "--no-media-library",
+        "--mtu=1316",
+    };
+    libvlc_instance_t *p_vlc;
+
+    test_init();
+
+    p_vlc = libvlc_new( sizeof (argv) / sizeof (argv[0]), argv );
+    assert( p_vlc != NULL );
+
+    log( "Testing UDP output discontinuities with batches\n" );
+    test_discontinuity( p_vlc->p_libvlc_int, 8 );
+
+    libvlc_release( p_vlc );
+    return 0;
+#endif
+}
@@ -0,0 +1,179 @@
+/*****************************************************************************
+ * ts_index.c: test for the MPEG-TS seek index and its sidecar file
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../../modules/demux/ts_index.c"
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PKT 188
+
+static void check_entry( const ts_index_t *p_index, int i, int64_t i_pos,
+                         int64_t i_pcr, bool b_random_access )
+{
+    assert( i < p_index->i_count );
+    assert( p_index->p_entries[i].i_pos == i_pos );
+    assert( p_index->p_entries[i].i_pcr == i_pcr );
+    assert( p_index->p_entries[i].b_random_access == b_random_access );
+}
+
+static void test_add_find( ts_index_t *p_index )
+{
+    assert( ts_index_Find( p_index, 0 ) == -1 );
+
+    /* Invalid points */
+    ts_index_Add( p_index, -1, 0, true );
+    ts_index_Add( p_index, 0, -1, true );
+    assert( p_index->i_count == 0 && !p_index->b_changed );
+
+    ts_index_Add( p_index, 10 * PKT, 0, false );
+    check_entry( p_index, 0, 10 * PKT, 0, false );
+    assert( p_index->b_changed );
+
+    /* Closer than a step: dropped, unless replacing a non random access */
+    ts_index_Add( p_index, 20 * PKT, 10000, false );
+    assert( p_index->i_count == 1 );
+    ts_index_Add( p_index, 30 * PKT, 20000, true );
+    assert( p_index->i_count == 1 );
+    check_entry( p_index, 0, 30 * PKT, 20000, true );
+    ts_index_Add( p_index, 40 * PKT, 30000, true );
+    check_entry( p_index, 0, 30 * PKT, 20000, true );
+
+    ts_index_Add( p_index, 100 * PKT, 20000 + TS_INDEX_STEP, true );
+    ts_index_Add( p_index, 200 * PKT, 200000, false );
+    assert( p_index->i_count == 3 );
+
+    /* Positions out of the order of PCRs (discontinuity) */
+    ts_index_Add( p_index, 50 * PKT, 300000, true );
+    ts_index_Add( p_index, 300 * PKT, 150000, true );
+    assert( p_index->i_count == 3 );
+
+    /* Insertion between two points */
+    ts_index_Add( p_index, 150 * PKT, 130000, true );
+    assert( p_index->i_count == 4 );
+    check_entry( p_index, 0, 30 * PKT, 20000, true );
+    check_entry( p_index, 1, 100 * PKT, 20000 + TS_INDEX_STEP, true );
+    check_entry( p_index, 2, 150 * PKT, 130000, true );
+    check_entry( p_index, 3, 200 * PKT, 200000, false );
+
+    assert( ts_index_Find( p_index, 19999 ) == -1 );
+    assert( ts_index_Find( p_index, 20000 ) == 0 );
+    assert( ts_index_Find( p_index, 20000 + TS_INDEX_STEP - 1 ) == 0 );
+    assert( ts_index_Find( p_index, 129999 ) == 1 );
+    assert( ts_index_Find( p_index, 130000 ) == 2 );
+    assert( ts_index_Find( p_index, INT64_MAX ) == 3 );
+
+    /* Many points, in order */
+    for( int i = 0; i < 1000; i++ )
+        ts_index_Add( p_index, ( 1000 + i ) * PKT,
+                      1000000 + (int64_t)i * TS_INDEX_STEP, i & 1 );
+    assert( p_index->i_count == 1004 );
+    for( int i = 0; i < p_index->i_count; i++ )
+        assert( ts_index_Find( p_index, p_index->p_entries[i].i_pcr ) == i );
+}
+
+static void test_save_load( const ts_index_t *p_index, const char *psz_path )
+{
+    int64_t pcrs[3] = { 20000, 100000, 200000 };
+    int64_t pos[3] = { 30 * PKT, 120 * PKT, 200 * PKT };
+    static const uint8_t head[] = "\x47\x40\x00\x10";
+    const ts_index_info_t info = {
+        .i_size = 123456789,
+        .i_mtime = 1400000000,
+        .i_head = ts_index_Hash( head, sizeof( head ) ),
+        .i_packet_size = PKT,
+        .i_pid_ref_pcr = 0x100,
+        .i_first_pcr = 20000,
+        .i_last_pcr = 200000,
+        .i_pcrs_num = 3,
+        .p_pcrs = pcrs,
+        .p_pos = pos,
+    };
+
+    assert( ts_index_Save( p_index, &info, psz_path ) == VLC_SUCCESS );
+
+    int64_t pcrs2[3], pos2[3];
+    ts_index_info_t info2 = {
+        .i_packet_size = PKT,
+        .i_pcrs_num = 3,
+        .p_pcrs = pcrs2,
+        .p_pos = pos2,
+    };
+    ts_index_t index;
+
+    /* Scans done with another packet size, or number of PCRs */
+    ts_index_Init( &index );
+    info2.i_packet_size = 192;
+    assert( ts_index_Load( &index, &info2, psz_path ) != VLC_SUCCESS );
+    info2.i_packet_size = PKT;
+    info2.i_pcrs_num = 2;
+    assert( ts_index_Load( &index, &info2, psz_path ) != VLC_SUCCESS );
+    info2.i_pcrs_num = 3;
+    assert( index.i_count == 0 );
+
+    assert( ts_index_Load( &index, &info2, psz_path ) == VLC_SUCCESS );
+    assert( info2.i_size == info.i_size );
+    assert( info2.i_mtime == info.i_mtime );
+    assert( info2.i_head == info.i_head );
+    assert( info2.i_pid_ref_pcr == info.i_pid_ref_pcr );
+    assert( info2.i_first_pcr == info.i_first_pcr );
+    assert( info2.i_last_pcr == info.i_last_pcr );
+    assert( !memcmp( pcrs, pcrs2, sizeof( pcrs ) ) );
+    assert( !memcmp( pos, pos2, sizeof( pos ) ) );
+
+    assert( !index.b_changed );
+    assert( index.i_count == p_index->i_count );
+    for( int i = 0; i < index.i_count; i++ )
+        check_entry( &index, i, p_index->p_entries[i].i_pos,
+                     p_index->p_entries[i].i_pcr,
+                     p_index->p_entries[i].b_random_access );
+    ts_index_Clean( &index );
+}
+
+int main( void )
+{
+    char psz_path[] = "/tmp/vlc-ts_index-XXXXXX";
+    ts_index_t index;
+
+    /* 64-bit FNV-1a test vectors */
+    assert( ts_index_Hash( NULL, 0 ) == UINT64_C(0xcbf29ce484222325) );
+    assert( ts_index_Hash( (const uint8_t *)"a", 1 )
+            == UINT64_C(0xaf63dc4c8601ec8c) );
+
+    ts_index_Init( &index );
+    test_add_find( &index );
+
+    int fd = mkstemp( psz_path );
+    if( fd == -1 )
+    {
+        perror( "mkstemp" );
+        return 77;
+    }
+    close( fd );
+    test_save_load( &index, psz_path );
+    unlink( psz_path );
+
+    ts_index_Clean( &index );
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*****************************************************************************
+ * csa.c: test for the batched CSA (de)scrambling
+ *****************************************************************************
+ * Copyright (C) 2014 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#define TS_NO_CSA_CK_MSG
+#include "../../../../modules/mux/mpeg/csa.c"
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACKETS 600
+#define ROUNDS  10
+
+static uint8_t packets[PACKETS][188];
+static uint8_t scalar[PACKETS][188];
+static uint8_t batch[PACKETS][188];
+
+static void random_key( csa_t *c, bool odd )
+{
+    char psz_ck[17];
+
+    for( int i = 0; i < 16; i++ )
+        psz_ck[i] = "0123456789abcdef"[rand() & 15];
+    psz_ck[16] = '\0';
+    assert( csa_SetCW( NULL, c, psz_ck, odd ) == VLC_SUCCESS );
+}
+
+/* Random packets, with adaptation fields of random lengths so that the
+ * payloads end with partial blocks, or hold less than one block */
+static void random_packets( int i_count, bool b_scrambled )
+{
+    for( int i = 0; i < i_count; i++ )
+    {
+        uint8_t *pkt = packets[i];
+
+        for( int j = 0; j < 188; j++ )
+            pkt[j] = rand();
+        pkt[0] = 0x47;
+        pkt[3] &= b_scrambled ? 0xff : 0x3f;
+        if( b_scrambled && (rand() % 8) == 0 )
+            pkt[3] &= 0x7f; /* clear packets among scrambled ones */
+        if( pkt[3] & 0x20 )
+            pkt[4] = rand() % 184;
+    }
+    memcpy( scalar, packets, i_count * 188 );
+    memcpy( batch, packets, i_count * 188 );
+}
+
+static void test_batch( csa_t *c, int i_count )
+{
+    uint8_t *pp_pkt[PACKETS];
+
+    for( int i = 0; i < i_count; i++ )
+        pp_pkt[i] = batch[i];
+
+    /* Descrambling, with both keys */
+    random_packets( i_count, true );
+    for( int i = 0; i < i_count; i++ )
+        csa_Decrypt( c, scalar[i], 188 );
+    csa_DecryptBatch( c, pp_pkt, i_count, 188 );
+    assert( memcmp( scalar, batch, i_count * 188 ) == 0 );
+
+    /* Scrambling, and back */
+    random_packets( i_count, false );
+    csa_UseKey( NULL, c, rand() & 1 );
+    for( int i = 0; i < i_count; i++ )
+        csa_Encrypt( c, scalar[i], 188 );
+    csa_EncryptBatch( c, pp_pkt, i_count, 188 );
+    assert( memcmp( scalar, batch, i_count * 188 ) == 0 );
+
+    csa_DecryptBatch( c, pp_pkt, i_count, 188 );
+    assert( memcmp( packets, batch, i_count * 188 ) == 0 );
+}
+
+int main( void )
+{
+    static const int pi_counts[] = {
+        1, CSA_BATCH_MIN - 1, CSA_BATCH_MIN, 63, 64, 65, 127, 128, 129,
+        255, 256, 257, PACKETS,
+    };
+    const unsigned seed = 42;
+
+    srand( seed );
+    printf( "seed %u\n", seed );
+
+    csa_t *c = csa_New();
+    assert( c != NULL );
+
+    /* Each bitsliced implementation supported by the CPU */
+    const int i_bs = c->i_bs;
+    for( c->i_bs = 1; c->i_bs <= i_bs; c->i_bs++ )
+    {
+        printf( "bitsliced stream cypher, %d packets wide\n",
+                c->bs[c->i_bs - 1].i_batch );
+        for( int r = 0; r < ROUNDS; r++ )
+        {
+            random_key( c, false );
+            random_key( c, true );
+            for( size_t i = 0; i < sizeof (pi_counts) / sizeof (*pi_counts);
+                 i++ )
+                test_batch( c, pi_counts[i] );
+        }
+    }
+
+    csa_Delete( c );
+    return 0;
+}